@@ -3,6 +3,8 @@
 #define NEBUMONGO_APPLICATION_H_
 
 #include <memory>
+#include <stdint.h>
+#include <string>
 
 namespace nebu
 {
@@ -40,6 +42,16 @@ namespace nebu
 				}
 
 				/** Starts the main loop of the application.
+				 *  If <code>app.snapshot</code> is configured, the state of the previous run is restored from that
+				 *  file before the first iteration, and saved to it at the end of every iteration. Restored VMs
+				 *  without a Daemon restored by ApplicationHooks::restoreDaemon are announced to the
+				 *  VMEventHandlers through newVMAdded, so the DaemonManager deploys their Daemons as usual. Likewise, if
+				 *  <code>app.topologyImage</code> is configured, the topology is loaded from that TopologyImage at
+				 *  startup, and the image is rewritten after every successful refresh of the topology that changed it. The VM locations are
+				 *  also published after every refresh of the topology if ApplicationHooks::getWorldStatePublisher
+				 *  provides a publisher, and served if ApplicationHooks::getTopologyServer provides a server.
+				 *  If <code>app.daemons.prune</code> is set, the Daemons of VMs that leave the system are removed
+				 *  from the DaemonCollection of the ApplicationHooks.
 				 *  @return exit code.
 				 */
 				virtual int mainLoop();
@@ -50,12 +62,17 @@ namespace nebu
 				virtual void shutdown() { this->stopLoop = true; }
 
 			private:
+				void restoreSnapshot();
+				void saveSnapshot();
+
 				bool stopLoop;
 
 				std::shared_ptr<ApplicationHooks> applicationHooks;
 				std::shared_ptr<DaemonManager> daemonManager;
 				std::shared_ptr<TopologyManager> topologyManager;
 				std::shared_ptr<VMManager> vmManager;
+				std::string snapshotFilename;
+				uint64_t snapshotChecksum;
 			};
 
 		}
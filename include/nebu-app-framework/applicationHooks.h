@@ -2,12 +2,21 @@
 #ifndef NEBUAPPFRAMEWORK_APPLICATIONHOOKS_H_
 #define NEBUAPPFRAMEWORK_APPLICATIONHOOKS_H_
 
+#include "nebu-app-framework/circuitBreaker.h"
+#include "nebu-app-framework/daemon.h"
+
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace nebu
 {
+	namespace common
+	{
+		class AppPhysRequest;
+		class AppVirtRequest;
+		class NebuClient;
+	}
 	namespace app
 	{
 		namespace framework
@@ -16,8 +25,11 @@ namespace nebu
 			class Application;
 			class DaemonCollection;
 			class DaemonManager;
+			class HedgingAppVirtRequest;
 			class TopologyManager;
+			class TopologyServer;
 			class VMManager;
+			class WorldStatePublisher;
 
 			/** Interface of all hooks provided to an application built on libnebu-app-framework.
              *  The ApplicationHooks interface should be implemented by a single class in an application.
@@ -30,7 +42,9 @@ namespace nebu
 			{
 			public:
 				/** Empty constructor provided for inheritance. */
-				ApplicationHooks() : application() { }
+				ApplicationHooks() :
+						application(), circuitBreakerConfigured(false), topologyServerConfigured(false),
+						worldStatePublisherConfigured(false) { }
 				/** Empty destructor provided for inheritance. */
 				virtual ~ApplicationHooks() { }
 
@@ -74,6 +88,32 @@ namespace nebu
 				virtual void postDeployDaemons() { }
 				/** Hook called at the end of the main loop, before the application sleeps for a configured interval. */
 				virtual void postLoop() { }
+				/** Hook called when the CircuitBreaker guarding the Nebu middleware changes state.
+				 *  @param[in] previous the state before the change.
+				 *  @param[in] current the state after the change.
+				 */
+				virtual void circuitStateChanged(CircuitState previous __attribute__((unused)),
+						CircuitState current __attribute__((unused))) { }
+				/** Hook called at startup for every Daemon in the snapshot configured by <code>app.snapshot</code>
+				 *  whose host VM was restored, allowing the application to recreate it without relaunching.
+				 *  Restored VMs for which no Daemon is restored are announced to the VMEventHandlers as new VMs after
+				 *  all Daemons have been restored.
+				 *  <b>The provided implementation restores no Daemons</b>, so unless an application overrides this
+				 *  hook, a warm start announces every VM as new and the DaemonManager deploys all Daemons again, as
+				 *  for a cold start; a warning is logged when that happens. An implementation typically creates the
+				 *  Daemon of the given type for the host VM and marks it launched if it was, see testApplication.cpp
+				 *  for an example.
+				 *  @param[in] hostVM the restored VM hosting the Daemon.
+				 *  @param[in] type the type of the Daemon.
+				 *  @param[in] launched whether the Daemon had launched.
+				 *  @return the Daemon to add to the DaemonCollection, or an empty pointer to skip it.
+				 */
+				virtual std::shared_ptr<Daemon> restoreDaemon(
+						std::shared_ptr<nebu::common::VirtualMachine> hostVM __attribute__((unused)),
+						DaemonType type __attribute__((unused)), bool launched __attribute__((unused)))
+				{
+					return std::shared_ptr<Daemon>();
+				}
 
 				/** Getter for a concrete DaemonManager object, should be singleton.
 				 *  @return a DaemonManager object.
@@ -91,10 +131,64 @@ namespace nebu
 				 */
 				virtual std::shared_ptr<TopologyManager> getTopologyManager();
 				/** Getter for a VMManager object, should be singleton.
-				 *  The provided implementation returns a singleton of the VMManager class.
+				 *  The provided implementation returns a singleton of the VMManager class, with a refresh
+				 *  policy configured by <code>app.vms.stablePolls</code> and <code>app.vms.sweepBudget</code>, and a
+				 *  failure policy configured by <code>app.vms.quarantineThreshold</code> and <code>app.vms.maxBackoff</code>.
 				 *  @return a VMManager object.
 				 */
 				virtual std::shared_ptr<VMManager> getVMManager();
+				/** Getter for the NebuClient shared by the TopologyManager and VMManager, should be singleton.
+				 *  The provided implementation returns a NebuClient using a PooledRestClientAdapter with
+				 *  <code>nebu.poolSize</code> keep-alive connections, or the RestClientAdapter singleton if
+				 *  the pool size is configured as 0.
+				 *  @return a NebuClient object.
+				 */
+				virtual std::shared_ptr<nebu::common::NebuClient> getNebuClient();
+				/** Getter for the CircuitBreaker shared by all requests to the Nebu middleware, should be singleton.
+				 *  The provided implementation returns a CircuitBreaker configured by the
+				 *  <code>nebu.breaker.*</code> options, which reports state changes to circuitStateChanged,
+				 *  or an empty pointer if <code>nebu.breaker.failureThreshold</code> is 0.
+				 *  @return a CircuitBreaker object, or an empty pointer.
+				 */
+				virtual std::shared_ptr<CircuitBreaker> getCircuitBreaker();
+				/** Getter for the AppPhysRequest used by the TopologyManager.
+				 *  The provided implementation creates an AppPhysRequest using getNebuClient, guarded by
+				 *  getCircuitBreaker and decorated with a CachingAppPhysRequest if
+				 *  <code>nebu.cache.topologyTTL</code> is configured.
+				 *  @return an AppPhysRequest object.
+				 */
+				virtual std::shared_ptr<nebu::common::AppPhysRequest> getAppPhysRequest();
+				/** Getter for the AppVirtRequest used by the VMManager.
+				 *  The provided implementation creates an AppVirtRequest using getNebuClient, guarded by
+				 *  getCircuitBreaker, hedged by a HedgingAppVirtRequest if <code>nebu.hedge.percentile</code>
+				 *  is configured, and decorated with a CachingAppVirtRequest if <code>nebu.cache.vmIDsTTL</code>
+				 *  or <code>nebu.cache.vmTTL</code> is configured.
+				 *  @return an AppVirtRequest object.
+				 */
+				virtual std::shared_ptr<nebu::common::AppVirtRequest> getAppVirtRequest();
+				/** Getter for the HedgingAppVirtRequest created by the provided implementation of getAppVirtRequest,
+				 *  whose summary the Application logs every <code>nebu.hedge.summaryInterval</code> seconds.
+				 *  @return the HedgingAppVirtRequest, or an empty pointer if no requests are hedged.
+				 */
+				std::shared_ptr<HedgingAppVirtRequest> getHedgingAppVirtRequest() const
+				{
+					return this->hedgingAppVirtRequest;
+				}
+				/** Getter for the WorldStatePublisher sharing VM locations with other processes, should be singleton.
+				 *  The provided implementation returns a WorldStatePublisher for the shared memory segment named by
+				 *  <code>app.worldState.name</code>, with copies of <code>app.worldState.size</code> MiB, or an empty
+				 *  pointer if no name is configured or the segment cannot be created.
+				 *  @return a WorldStatePublisher object, or an empty pointer.
+				 */
+				virtual std::shared_ptr<WorldStatePublisher> getWorldStatePublisher();
+				/** Getter for the TopologyServer answering rack resolution queries, should be singleton.
+				 *  The provided implementation returns a running TopologyServer on the Unix domain socket
+				 *  <code>app.topologyServer.socket</code>, which also indexes IP addresses if
+				 *  <code>app.topologyServer.addresses</code> is set, or an empty pointer if no socket is
+				 *  configured or the server cannot be started.
+				 *  @return a TopologyServer object, or an empty pointer.
+				 */
+				virtual std::shared_ptr<TopologyServer> getTopologyServer();
 
 				/** Setter for the Application singleton, for use by the implementing Nebu application. */
 				virtual void setApplication(std::shared_ptr<Application> application)
@@ -107,9 +201,17 @@ namespace nebu
 				std::shared_ptr<Application> application;
 
 			private:
+				std::shared_ptr<CircuitBreaker> circuitBreaker;
+				bool circuitBreakerConfigured;
 				std::shared_ptr<DaemonCollection> daemonCollection;
+				std::shared_ptr<HedgingAppVirtRequest> hedgingAppVirtRequest;
+				std::shared_ptr<nebu::common::NebuClient> nebuClient;
 				std::shared_ptr<TopologyManager> topologyManager;
+				std::shared_ptr<TopologyServer> topologyServer;
+				bool topologyServerConfigured;
 				std::shared_ptr<VMManager> vmManager;
+				std::shared_ptr<WorldStatePublisher> worldStatePublisher;
+				bool worldStatePublisherConfigured;
 			};
 
 			/** Initialization function to create application-specific hooks and singletons.
@@ -0,0 +1,60 @@
+
+#ifndef NEBUAPPFRAMEWORK_CACHINGAPPPHYSREQUEST_H_
+#define NEBUAPPFRAMEWORK_CACHINGAPPPHYSREQUEST_H_
+
+#include "nebu-app-framework/responseCache.h"
+
+#include "nebu/appPhysRequest.h"
+#include "nebu/topology/physicalRoot.h"
+
+#include <memory>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Decorates an AppPhysRequest with a ResponseCache for the physical topology.
+			 *  The cached PhysicalRoot is shared between callers and must not be modified.
+			 */
+			class CachingAppPhysRequest : public nebu::common::AppPhysRequest
+			{
+			public:
+				/** Creates a CachingAppPhysRequest.
+				 *  @param[in] appPhysRequest the AppPhysRequest to query on a cache miss.
+				 *  @param[in] topologyTTL the time to keep the physical topology in milliseconds.
+				 *  @param[in] negativeTTL the time to keep a failed request in milliseconds.
+				 */
+				CachingAppPhysRequest(std::shared_ptr<nebu::common::AppPhysRequest> appPhysRequest,
+						unsigned int topologyTTL, unsigned int negativeTTL);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CachingAppPhysRequest() { }
+
+				/** Retrieves the physical topology of the application, from the cache if possible.
+				 *  @return the root of the topology.
+				 */
+				virtual std::shared_ptr<nebu::common::PhysicalRoot> getPhysicalTopology();
+
+				/** Removes the cached topology, so the next request queries the Nebu middleware. */
+				virtual void clear();
+
+				/** Getter for the counters of the cache.
+				 *  @return the statistics.
+				 */
+				ResponseCache<std::shared_ptr<nebu::common::PhysicalRoot> >::Statistics getStatistics() const
+				{
+					return this->topologyCache.getStatistics();
+				}
+
+			private:
+				std::shared_ptr<nebu::common::AppPhysRequest> appPhysRequest;
+				ResponseCache<std::shared_ptr<nebu::common::PhysicalRoot> > topologyCache;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,78 @@
+
+#ifndef NEBUAPPFRAMEWORK_CACHINGAPPVIRTREQUEST_H_
+#define NEBUAPPFRAMEWORK_CACHINGAPPVIRTREQUEST_H_
+
+#include "nebu-app-framework/responseCache.h"
+
+#include "nebu/appVirtRequest.h"
+#include "nebu/virtualMachine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Decorates an AppVirtRequest with a ResponseCache for each of its endpoints.
+			 *  The list of VM identifiers and the individual VirtualMachines are kept for separate times to
+			 *  live, so an application refreshing more often than the information changes does not query
+			 *  the Nebu middleware on every refresh.
+			 */
+			class CachingAppVirtRequest : public nebu::common::AppVirtRequest
+			{
+			public:
+				/** Creates a CachingAppVirtRequest.
+				 *  @param[in] appVirtRequest the AppVirtRequest to query on a cache miss.
+				 *  @param[in] vmIDsTTL the time to keep the list of VM identifiers in milliseconds.
+				 *  @param[in] vmTTL the time to keep a VirtualMachine in milliseconds.
+				 *  @param[in] negativeTTL the time to keep a failed request in milliseconds.
+				 */
+				CachingAppVirtRequest(std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest,
+						unsigned int vmIDsTTL, unsigned int vmTTL, unsigned int negativeTTL);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CachingAppVirtRequest() { }
+
+				/** Retrieves the identifiers of the VMs of the application, from the cache if possible.
+				 *  @return the list of VM identifiers.
+				 */
+				virtual std::vector<std::string> getVirtualMachineIDs();
+				/** Retrieves a VirtualMachine, from the cache if possible.
+				 *  @param[in] uuid the unique ID of the VM.
+				 *  @return the VirtualMachine.
+				 */
+				virtual nebu::common::VirtualMachine getVirtualMachine(const std::string &uuid);
+
+				/** Removes all cached responses, so the next requests query the Nebu middleware. */
+				virtual void clear();
+
+				/** Getter for the counters of the cache of VM identifiers.
+				 *  @return the statistics.
+				 */
+				ResponseCache<std::vector<std::string> >::Statistics getVirtualMachineIDsStatistics() const
+				{
+					return this->vmIDsCache.getStatistics();
+				}
+				/** Getter for the counters of the cache of VirtualMachines.
+				 *  @return the statistics.
+				 */
+				ResponseCache<nebu::common::VirtualMachine>::Statistics getVirtualMachineStatistics() const
+				{
+					return this->vmCache.getStatistics();
+				}
+
+			private:
+				std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest;
+				ResponseCache<std::vector<std::string> > vmIDsCache;
+				ResponseCache<nebu::common::VirtualMachine> vmCache;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,136 @@
+
+#ifndef NEBUAPPFRAMEWORK_CHILDPROCESS_H_
+#define NEBUAPPFRAMEWORK_CHILDPROCESS_H_
+
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandResult.h"
+
+#include <chrono>
+#include <sys/types.h>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** A child process started for a Command using posix_spawn.
+			 *  posix_spawn avoids copying the page tables of the application (it uses vfork semantics),
+			 *  and commands are executed without an intermediate shell unless the Command asks for one.
+			 *  The standard output and error of a capturing Command are connected to non-blocking pipes,
+			 *  which can be drained incrementally using readOutput or all at once using run.
+			 *  Termination of the process is signalled through a pidfd where the kernel supports it, so a
+			 *  process is complete when it exits, even if a background child still holds its pipes open.
+			 *  Commands with a timeout run in their own process group, which is signalled as a whole.
+			 */
+			class ChildProcess
+			{
+			public:
+				/** Creates an object without a running process. */
+				ChildProcess() : pid(-1), inputFd(-1), outputFd(-1), errorFd(-1), pidFd(-1), processGroup(false),
+						timeout(), killGracePeriod(), deadline(), termSent(false), killSent(false) { }
+				/** Destructor, closes the pipes. A running process is not waited for. */
+				virtual ~ChildProcess();
+
+				/** Starts a process executing the Command.
+				 *  @param[in] command the Command to execute.
+				 *  @return 0 on success, or the errno value describing why the process could not be started.
+				 */
+				int spawn(const Command &command);
+
+				/** Getter for the process ID of the child.
+				 *  @return the process ID, or -1 if no process was started.
+				 */
+				pid_t getPid() const
+				{
+					return this->pid;
+				}
+				/** Getter for the write end of the standard input pipe.
+				 *  @return the file descriptor, or -1 if the Command does not pipe its input or the pipe is closed.
+				 */
+				int getInputFd() const
+				{
+					return this->inputFd;
+				}
+				/** Closes the standard input pipe, signalling end-of-file to the process. */
+				void closeInput()
+				{
+					this->closeFd(this->inputFd);
+				}
+				/** Getter for the read end of the standard output pipe.
+				 *  @return the file descriptor, or -1 if output is not captured or the pipe is closed.
+				 */
+				int getOutputFd() const
+				{
+					return this->outputFd;
+				}
+				/** Getter for the read end of the standard error pipe.
+				 *  @return the file descriptor, or -1 if output is not captured or the pipe is closed.
+				 */
+				int getErrorFd() const
+				{
+					return this->errorFd;
+				}
+
+				/** Getter for a pidfd referring to the child, which becomes readable when the child terminates.
+				 *  @return the file descriptor, or -1 if the kernel does not support pidfds.
+				 */
+				int getPidFd() const
+				{
+					return this->pidFd;
+				}
+
+				/** Reads all data currently available on the output pipes into the result.
+				 *  Pipes that have reached end-of-file are closed.
+				 *  @param[in,out] result the result to append the output to.
+				 *  @return true iff at least one pipe is still open.
+				 */
+				bool readOutput(CommandResult &result);
+				/** Waits until the process has terminated, storing its wait status in the result.
+				 *  @param[in,out] result the result to store the status in.
+				 */
+				void wait(CommandResult &result);
+				/** Checks if the process has terminated without blocking, storing its wait status in the result.
+				 *  @param[in,out] result the result to store the status in.
+				 *  @return true iff the process has terminated (or was never started).
+				 */
+				bool tryWait(CommandResult &result);
+				/** Sends a signal to the process, or to its process group if it has its own.
+				 *  @param[in] signal the signal to send.
+				 */
+				void signal(int signal);
+				/** Enforces the timeout of the Command, sending SIGTERM or SIGKILL when a deadline has passed.
+				 *  @param[in,out] result the result to mark as timed out.
+				 *  @return the number of milliseconds until the next deadline, or -1 if there is none.
+				 */
+				int enforceTimeout(CommandResult &result);
+				/** Collects all output of the process and waits for it to terminate.
+				 *  @param[in,out] result the result to store the output and status in.
+				 */
+				void run(CommandResult &result);
+
+			private:
+				ChildProcess(const ChildProcess &);
+				ChildProcess &operator=(const ChildProcess &);
+
+				void closeFd(int &fd);
+
+				pid_t pid;
+				int inputFd;
+				int outputFd;
+				int errorFd;
+				int pidFd;
+				bool processGroup;
+				std::chrono::milliseconds timeout;
+				std::chrono::milliseconds killGracePeriod;
+				std::chrono::steady_clock::time_point deadline;
+				bool termSent;
+				bool killSent;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,147 @@
+
+#ifndef NEBUAPPFRAMEWORK_CIRCUITBREAKER_H_
+#define NEBUAPPFRAMEWORK_CIRCUITBREAKER_H_
+
+#include "nebu/util/exceptions.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** States of a CircuitBreaker. */
+			enum class CircuitState {
+				/** Requests are passed on. */
+				CLOSED,
+				/** Requests are rejected until the backoff period has passed. */
+				OPEN,
+				/** A single probe request is passed on to test if the service has recovered. */
+				HALF_OPEN
+			};
+
+			/** Thrown instead of passing a request on while the circuit is open.
+			 *  It is a NebuServerException, so callers that do not distinguish it handle it like any other
+			 *  failure of the Nebu middleware; callers that do can tell that the request was never made.
+			 */
+			class CircuitOpenException : public nebu::common::NebuServerException
+			{
+			public:
+				/** Creates a CircuitOpenException.
+				 *  @param[in] message the description of the rejected request.
+				 */
+				CircuitOpenException(const std::string &message) : NebuServerException(message) { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~CircuitOpenException() { }
+			};
+
+			/** Protects a failing service from requests that are likely to fail as well.
+			 *  The circuit opens after a number of consecutive failures, after which requests are rejected
+			 *  for a backoff period. When the period has passed, a single probe request is allowed (half-open):
+			 *  if it succeeds the circuit closes, otherwise it opens again with double the backoff period,
+			 *  up to a maximum.
+			 *  A CircuitBreaker is thread-safe, and is usually shared between all requests to a service.
+			 */
+			class CircuitBreaker
+			{
+			public:
+				/** Function called when the state of the circuit changes, with the old and new state. */
+				typedef std::function<void(CircuitState, CircuitState)> StateListener;
+
+				/** Counters describing the behaviour of the circuit. */
+				struct Statistics
+				{
+					/** The number of requests that were passed on and succeeded. */
+					uint64_t successes;
+					/** The number of requests that were passed on and failed. */
+					uint64_t failures;
+					/** The number of requests that were passed on and whose outcome was ignored. */
+					uint64_t ignored;
+					/** The number of requests that were rejected. */
+					uint64_t rejected;
+					/** The number of probe requests passed on in the half-open state. */
+					uint64_t probes;
+					/** The number of times the circuit opened. */
+					uint64_t opened;
+				};
+
+				/** Creates a closed CircuitBreaker.
+				 *  @param[in] failureThreshold the number of consecutive failures opening the circuit.
+				 *  @param[in] backoff the initial time the circuit stays open, in milliseconds.
+				 *  @param[in] maxBackoff the maximum time the circuit stays open, in milliseconds.
+				 */
+				CircuitBreaker(unsigned int failureThreshold, unsigned int backoff, unsigned int maxBackoff);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CircuitBreaker() { }
+
+				/** Checks if a request may be passed on, moving an open circuit to half-open when its
+				 *  backoff period has passed. Every allowed request must be followed by a call to
+				 *  recordSuccess, recordFailure or recordIgnored.
+				 *  @return true iff the request may be passed on.
+				 */
+				virtual bool allowRequest();
+				/** Records the success of an allowed request, closing the circuit. */
+				virtual void recordSuccess();
+				/** Records the failure of an allowed request, opening the circuit if the failure threshold is
+				 *  reached or the request was a probe.
+				 */
+				virtual void recordFailure();
+				/** Records the end of an allowed request whose failure says nothing about the health of the
+				 *  service, such as a request for a single bad record. A probe request ends without changing the
+				 *  state, so the next request is allowed as a probe.
+				 */
+				virtual void recordIgnored();
+
+				/** Sets a function to call when the state of the circuit changes.
+				 *  The function is called without holding the lock of the CircuitBreaker.
+				 *  @param[in] listener the function to call.
+				 */
+				void setStateListener(StateListener listener);
+
+				/** Getter for the state of the circuit.
+				 *  @return the state.
+				 */
+				CircuitState getState() const;
+				/** Getter for the time the circuit stays open the next time it opens.
+				 *  @return the backoff period in milliseconds.
+				 */
+				unsigned int getBackoff() const;
+				/** Getter for the counters of the circuit.
+				 *  @return the statistics.
+				 */
+				Statistics getStatistics() const;
+
+				/** Creates a human readable name of a state for logging.
+				 *  @param[in] state the state.
+				 *  @return the name of the state.
+				 */
+				static std::string toString(CircuitState state);
+
+			private:
+				void transition(CircuitState state, std::unique_lock<std::mutex> &lock);
+
+				unsigned int failureThreshold;
+				std::chrono::milliseconds initialBackoff;
+				std::chrono::milliseconds maxBackoff;
+				mutable std::mutex breakerMutex;
+				CircuitState state;
+				unsigned int consecutiveFailures;
+				std::chrono::milliseconds backoff;
+				std::chrono::steady_clock::time_point openUntil;
+				bool probing;
+				StateListener listener;
+				Statistics statistics;
+			};
+
+		}
+	}
+}
+
+#endif
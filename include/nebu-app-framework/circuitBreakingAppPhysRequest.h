@@ -0,0 +1,49 @@
+
+#ifndef NEBUAPPFRAMEWORK_CIRCUITBREAKINGAPPPHYSREQUEST_H_
+#define NEBUAPPFRAMEWORK_CIRCUITBREAKINGAPPPHYSREQUEST_H_
+
+#include "nebu-app-framework/circuitBreaker.h"
+
+#include "nebu/appPhysRequest.h"
+#include "nebu/topology/physicalRoot.h"
+
+#include <memory>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Decorates an AppPhysRequest with a CircuitBreaker.
+			 *  Requests rejected by the CircuitBreaker fail immediately with a CircuitOpenException, which
+			 *  callers can handle like any other NebuServerException.
+			 */
+			class CircuitBreakingAppPhysRequest : public nebu::common::AppPhysRequest
+			{
+			public:
+				/** Creates a CircuitBreakingAppPhysRequest.
+				 *  @param[in] appPhysRequest the AppPhysRequest to pass allowed requests on to.
+				 *  @param[in] circuitBreaker the CircuitBreaker guarding the Nebu middleware.
+				 */
+				CircuitBreakingAppPhysRequest(std::shared_ptr<nebu::common::AppPhysRequest> appPhysRequest,
+						std::shared_ptr<CircuitBreaker> circuitBreaker);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CircuitBreakingAppPhysRequest() { }
+
+				/** Retrieves the physical topology of the application if the circuit allows it.
+				 *  @return the root of the topology.
+				 */
+				virtual std::shared_ptr<nebu::common::PhysicalRoot> getPhysicalTopology();
+
+			private:
+				std::shared_ptr<nebu::common::AppPhysRequest> appPhysRequest;
+				std::shared_ptr<CircuitBreaker> circuitBreaker;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,59 @@
+
+#ifndef NEBUAPPFRAMEWORK_CIRCUITBREAKINGAPPVIRTREQUEST_H_
+#define NEBUAPPFRAMEWORK_CIRCUITBREAKINGAPPVIRTREQUEST_H_
+
+#include "nebu-app-framework/circuitBreaker.h"
+
+#include "nebu/appVirtRequest.h"
+#include "nebu/virtualMachine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Decorates an AppVirtRequest with a CircuitBreaker.
+			 *  Requests rejected by the CircuitBreaker fail immediately with a CircuitOpenException, which
+			 *  callers can handle like any other NebuServerException.
+			 *  Only failures of the list of VMs count towards opening the circuit. Failures of a single VM are
+			 *  ignored, as they also occur for bad records, which the VMManager quarantines, and abandoned hedged
+			 *  requests while the server is healthy.
+			 */
+			class CircuitBreakingAppVirtRequest : public nebu::common::AppVirtRequest
+			{
+			public:
+				/** Creates a CircuitBreakingAppVirtRequest.
+				 *  @param[in] appVirtRequest the AppVirtRequest to pass allowed requests on to.
+				 *  @param[in] circuitBreaker the CircuitBreaker guarding the Nebu middleware.
+				 */
+				CircuitBreakingAppVirtRequest(std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest,
+						std::shared_ptr<CircuitBreaker> circuitBreaker);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CircuitBreakingAppVirtRequest() { }
+
+				/** Retrieves the identifiers of the VMs of the application if the circuit allows it.
+				 *  @return the list of VM identifiers.
+				 */
+				virtual std::vector<std::string> getVirtualMachineIDs();
+				/** Retrieves a VirtualMachine if the circuit allows it.
+				 *  @param[in] uuid the unique ID of the VM.
+				 *  @return the VirtualMachine.
+				 */
+				virtual nebu::common::VirtualMachine getVirtualMachine(const std::string &uuid);
+
+			private:
+				std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest;
+				std::shared_ptr<CircuitBreaker> circuitBreaker;
+			};
+
+		}
+	}
+}
+
+#endif
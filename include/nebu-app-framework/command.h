@@ -0,0 +1,219 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMAND_H_
+#define NEBUAPPFRAMEWORK_COMMAND_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Describes a command to be executed by the CommandRunner.
+			 *  A Command is an argument vector that is executed directly, without a shell, unless it is
+			 *  created through \link shell(const std::string &) shell \endlink. The environment of the command
+			 *  is inherited from the application, with optional additions and removals.
+			 */
+			class Command
+			{
+			public:
+				/** Creates a Command executing the given argument vector without a shell.
+				 *  The program (the first argument) is looked up in the PATH if it does not contain a '/'.
+				 *  @param[in] arguments the program followed by its arguments.
+				 */
+				Command(const std::vector<std::string> &arguments);
+				/** Empty destructor provided for inheritance. */
+				virtual ~Command() { }
+
+				/** Creates a Command executing a command line through <code>/bin/sh -c</code>.
+				 *  @param[in] commandLine the command line to pass to the shell.
+				 *  @return the Command.
+				 */
+				static Command shell(const std::string &commandLine);
+
+				/** Getter for the argument vector of the Command, including the program.
+				 *  @return the argument vector.
+				 */
+				const std::vector<std::string> &getArguments() const
+				{
+					return this->arguments;
+				}
+				/** Replaces the argument vector of the Command, keeping all other properties.
+				 *  @param[in] arguments the program followed by its arguments.
+				 */
+				void setArguments(const std::vector<std::string> &arguments)
+				{
+					this->arguments = arguments;
+				}
+				/** Checks if the Command is executed through a shell.
+				 *  @return true iff the Command was created using shell.
+				 */
+				bool usesShell() const
+				{
+					return this->useShell;
+				}
+
+				/** Sets an environment variable for the Command, overriding any inherited value.
+				 *  @param[in] name the name of the variable.
+				 *  @param[in] value the value of the variable.
+				 */
+				void setEnvironment(const std::string &name, const std::string &value);
+				/** Removes an inherited environment variable from the environment of the Command.
+				 *  @param[in] name the name of the variable.
+				 */
+				void unsetEnvironment(const std::string &name);
+				/** Sets whether the Command inherits the environment of the application (the default).
+				 *  Variables set through setEnvironment are always passed.
+				 *  @param[in] inherit true iff the environment should be inherited.
+				 */
+				void setInheritEnvironment(bool inherit)
+				{
+					this->inheritEnvironment = inherit;
+				}
+				/** Builds the environment of the Command as a list of <code>name=value</code> strings.
+				 *  @return the environment to pass to the Command.
+				 */
+				std::vector<std::string> buildEnvironment() const;
+				/** Checks if the Command modifies the inherited environment.
+				 *  @return true iff the environment of the application can not be passed unchanged.
+				 */
+				bool hasCustomEnvironment() const
+				{
+					return !this->inheritEnvironment || !this->environment.empty() || !this->unsetVariables.empty();
+				}
+
+				/** Sets whether the standard output and error of the Command are captured (the default).
+				 *  Captured commands read their standard input from /dev/null. Commands that are not captured
+				 *  share the standard input, output and error of the application.
+				 *  @param[in] capture true iff the output should be captured.
+				 */
+				void setCaptureOutput(bool capture)
+				{
+					this->captureOutput = capture;
+				}
+				/** Checks if the standard output and error of the Command are captured.
+				 *  @return true iff the output is captured.
+				 */
+				bool capturesOutput() const
+				{
+					return this->captureOutput;
+				}
+
+				/** Sets whether the standard input of a captured Command is connected to a pipe instead of /dev/null.
+				 *  The write end of the pipe is available through ChildProcess::getInputFd.
+				 *  @param[in] pipeInput true iff the input should be a pipe.
+				 */
+				void setPipeInput(bool pipeInput)
+				{
+					this->pipeInput = pipeInput;
+				}
+				/** Checks if the standard input of a captured Command is connected to a pipe.
+				 *  @return true iff the input is a pipe.
+				 */
+				bool pipesInput() const
+				{
+					return this->pipeInput;
+				}
+
+				/** Sets the label under which the Command is recorded in the CommandMetrics.
+				 *  Commands serving the same purpose, such as a status check, should share a label.
+				 *  @param[in] label the label of the Command.
+				 */
+				void setLabel(const std::string &label)
+				{
+					this->label = label;
+				}
+				/** Getter for the label under which the Command is recorded in the CommandMetrics.
+				 *  @return the label set using setLabel, or "shell" or the program name if none was set.
+				 */
+				std::string getLabel() const;
+
+				/** Sets whether the result of the Command may be shared with identical Commands.
+				 *  Commands are not shared by default, so they are always executed when requested. Commands
+				 *  without side effects, e.g., status queries, can opt in to be coalesced or cached by the
+				 *  CommandRunner.
+				 *  @param[in] cacheable true iff the result may be shared.
+				 */
+				void setCacheable(bool cacheable)
+				{
+					this->cacheable = cacheable;
+				}
+				/** Checks if the result of the Command may be shared with identical Commands.
+				 *  @return true iff the result may be shared.
+				 */
+				bool isCacheable() const
+				{
+					return this->cacheable;
+				}
+
+				/** Sets a timeout for the Command.
+				 *  When the timeout expires, the process group of the Command receives SIGTERM, followed by
+				 *  SIGKILL if it has not terminated within the kill grace period.
+				 *  @param[in] milliseconds the timeout in milliseconds, or 0 for no timeout (the default).
+				 */
+				void setTimeout(unsigned int milliseconds)
+				{
+					this->timeout = milliseconds;
+				}
+				/** Getter for the timeout of the Command.
+				 *  @return the timeout in milliseconds, or 0 if the Command has no timeout.
+				 */
+				unsigned int getTimeout() const
+				{
+					return this->timeout;
+				}
+				/** Sets the time between SIGTERM and SIGKILL when the timeout of the Command expires.
+				 *  @param[in] milliseconds the grace period in milliseconds.
+				 */
+				void setKillGracePeriod(unsigned int milliseconds)
+				{
+					this->killGracePeriod = milliseconds;
+				}
+				/** Getter for the time between SIGTERM and SIGKILL when the timeout of the Command expires.
+				 *  @return the grace period in milliseconds.
+				 */
+				unsigned int getKillGracePeriod() const
+				{
+					return this->killGracePeriod;
+				}
+
+				/** Creates a human readable representation of the Command for logging.
+				 *  @return the command line, or the arguments separated by spaces.
+				 */
+				std::string toString() const;
+				/** Creates a command line that executes the Command when interpreted by <code>/bin/sh</code>.
+				 *  The environment and other properties of the Command are not included.
+				 *  @return the command line, or the quoted arguments separated by spaces.
+				 */
+				std::string toShellCommandLine() const;
+
+				/** Quotes a string for literal use in a shell command line.
+				 *  @param[in] str the string to quote.
+				 *  @return the quoted string.
+				 */
+				static std::string quote(const std::string &str);
+
+			private:
+				std::vector<std::string> arguments;
+				std::string label;
+				bool useShell;
+				bool inheritEnvironment;
+				bool captureOutput;
+				bool pipeInput;
+				bool cacheable;
+				unsigned int timeout;
+				unsigned int killGracePeriod;
+				std::map<std::string, std::string> environment;
+				std::set<std::string> unsetVariables;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMANDBATCH_H_
+#define NEBUAPPFRAMEWORK_COMMANDBATCH_H_
+
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandResult.h"
+#include "nebu-app-framework/commandRunner.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Collects shell commands for a number of hosts and executes them with one process per host.
+			 *  Commands added for the same host are combined into a single shell script, which is executed
+			 *  through the invoker of the batch (for example over ssh). The commands of a host run in the
+			 *  order they were added, each in its own subshell, and the output and exit code of every
+			 *  command is separated again when the batch is flushed. Every flush is recorded in the
+			 *  CommandMetrics.
+			 */
+			class CommandBatch
+			{
+			public:
+				/** Function creating the Command that executes a script on a host. */
+				typedef std::function<Command(const std::string &host, const std::string &script)> Invoker;
+
+				/** Creates an empty CommandBatch.
+				 *  @param[in] invoker the function creating the Command for the script of a host.
+				 */
+				CommandBatch(Invoker invoker = &CommandBatch::localInvoker);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CommandBatch() { }
+
+				/** Adds a shell command line to the batch.
+				 *  @param[in] host the host to run the command on.
+				 *  @param[in] commandLine the command line, interpreted by <code>/bin/sh</code>.
+				 *  @return the index of the command in the results of flush().
+				 */
+				virtual size_t add(const std::string &host, const std::string &commandLine);
+				/** Adds a Command to the batch.
+				 *  Only the arguments of the Command are used; they are quoted so they reach the program unchanged.
+				 *  @param[in] host the host to run the command on.
+				 *  @param[in] command the Command to run.
+				 *  @return the index of the command in the results of flush().
+				 */
+				virtual size_t add(const std::string &host, const Command &command);
+
+				/** Executes all commands added since the last flush, one process per host in parallel.
+				 *  A command whose exit status cannot be read back from the output of its host fails with the
+				 *  spawn error EPROTO.
+				 *  @param[in] runner the CommandRunner used to execute the scripts.
+				 *  @return the result of every command, in the order the commands were added.
+				 */
+				virtual std::vector<CommandResult> flush(const CommandRunner &runner);
+				/** Executes all commands added since the last flush using the global CommandRunner.
+				 *  @return the result of every command, in the order the commands were added.
+				 */
+				std::vector<CommandResult> flush()
+				{
+					return this->flush(*CommandRunner::getInstance());
+				}
+
+				/** Getter for the number of commands waiting for the next flush.
+				 *  @return the number of pending commands.
+				 */
+				size_t getPendingCommands() const
+				{
+					return this->pending.size();
+				}
+				/** Controls whether the remaining commands of a host are skipped after one of them fails.
+				 *  Skipped commands are reported with a spawn error of ECANCELED.
+				 *  @param[in] stopOnFailure true to skip commands after a failure.
+				 */
+				void setStopOnFailure(bool stopOnFailure)
+				{
+					this->stopOnFailure = stopOnFailure;
+				}
+				/** Sets the timeout for the combined invocation of each host.
+				 *  @param[in] timeout the timeout in milliseconds, or 0 for no timeout.
+				 */
+				void setTimeout(unsigned int timeout)
+				{
+					this->timeout = timeout;
+				}
+
+				/** Invoker running the script on the local machine, ignoring the host.
+				 *  @param[in] host the host the script is meant for.
+				 *  @param[in] script the script to run.
+				 *  @return the Command running the script with <code>/bin/sh -c</code>.
+				 */
+				static Command localInvoker(const std::string &host, const std::string &script);
+				/** Invoker running the script on the host using ssh in batch mode.
+				 *  @param[in] host the host to run the script on.
+				 *  @param[in] script the script to run.
+				 *  @return the Command running the script over ssh.
+				 */
+				static Command sshInvoker(const std::string &host, const std::string &script);
+
+			private:
+				struct PendingCommand
+				{
+					std::string host;
+					std::string commandLine;
+				};
+
+				void splitResults(const std::string &marker, const CommandResult &invocation,
+						const std::vector<size_t> &indices, std::vector<CommandResult> &results) const;
+				static bool parseMarker(const std::string &line, size_t index, int &exitCode);
+
+				Invoker invoker;
+				bool stopOnFailure;
+				unsigned int timeout;
+				std::vector<PendingCommand> pending;
+			};
+
+		}
+	}
+}
+
+#endif
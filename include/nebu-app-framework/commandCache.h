@@ -0,0 +1,102 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMANDCACHE_H_
+#define NEBUAPPFRAMEWORK_COMMANDCACHE_H_
+
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandResult.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Shares the results of identical Commands.
+			 *  Identical Commands that are requested while one of them is running wait for that execution
+			 *  instead of starting their own process (singleflight). Results of completed Commands are kept
+			 *  for a short time to live, and returned for identical Commands requested within that time.
+			 *  Only Commands for which isCacheable holds are shared; failures to start a Command and
+			 *  Commands that timed out are shared with waiting Commands, but not kept. Commands served from a
+			 *  kept result or by waiting are also counted in the CommandMetrics under their label.
+			 */
+			class CommandCache
+			{
+			public:
+				/** Function executing a Command that is not shared. */
+				typedef std::function<void(const Command &, CommandResult &)> Runner;
+
+				/** Counters describing the effectiveness of the cache. */
+				struct Statistics
+				{
+					/** The number of Commands that were executed. */
+					uint64_t misses;
+					/** The number of Commands that waited for an identical running Command. */
+					uint64_t coalesced;
+					/** The number of Commands served from a kept result. */
+					uint64_t hits;
+				};
+
+				/** Creates a CommandCache.
+				 *  @param[in] ttl the time to keep results in milliseconds, or 0 to only coalesce running Commands.
+				 */
+				CommandCache(unsigned int ttl);
+				/** Empty destructor provided for inheritance. */
+				virtual ~CommandCache() { }
+
+				/** Checks if the result of a Command can be shared.
+				 *  @param[in] command the Command to check.
+				 *  @return true iff the Command is cacheable and does not use a custom environment or piped input.
+				 */
+				virtual bool isCacheable(const Command &command) const;
+				/** Returns the result of a Command, executing it only if no identical Command is running or cached.
+				 *  @param[in] command the Command, for which isCacheable must hold.
+				 *  @param[out] result the result of the Command.
+				 *  @param[in] runner the function executing the Command if needed.
+				 */
+				virtual void execute(const Command &command, CommandResult &result, const Runner &runner);
+				/** Removes all kept results. Running Commands are still shared. */
+				virtual void clear();
+
+				/** Getter for the time results are kept.
+				 *  @return the time to live in milliseconds.
+				 */
+				unsigned int getTTL() const
+				{
+					return this->ttl.count();
+				}
+				/** Getter for the counters of the cache.
+				 *  @return the statistics.
+				 */
+				Statistics getStatistics() const;
+
+			private:
+				struct Entry
+				{
+					CommandResult result;
+					std::chrono::steady_clock::time_point expires;
+				};
+
+				static std::string createKey(const Command &command);
+				void purgeExpired(std::chrono::steady_clock::time_point now);
+
+				std::chrono::milliseconds ttl;
+				mutable std::mutex cacheMutex;
+				std::map<std::string, Entry> entries;
+				std::map<std::string, std::shared_future<CommandResult> > running;
+				Statistics statistics;
+			};
+
+		}
+	}
+}
+
+#endif
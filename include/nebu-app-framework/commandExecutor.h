@@ -0,0 +1,106 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMANDEXECUTOR_H_
+#define NEBUAPPFRAMEWORK_COMMANDEXECUTOR_H_
+
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandResult.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Executes Commands asynchronously using a single reaper thread.
+			 *  The reaper thread starts child processes, collects their output and detects their termination
+			 *  by waiting on pidfds and output pipes with epoll, so the number of threads does not grow with the
+			 *  number of running commands. At most a configured number of children run at the same time;
+			 *  further commands are queued in submission order. Timeouts of Commands are enforced by the
+			 *  reaper thread.
+			 */
+			class CommandExecutor
+			{
+			public:
+				/** Function called with the result of an asynchronously executed Command. */
+				typedef std::function<void(const CommandResult &)> Callback;
+
+				/** Creates a CommandExecutor and starts its reaper thread.
+				 *  @param[in] maxConcurrentChildren the maximum number of children running at the same time.
+				 */
+				CommandExecutor(unsigned int maxConcurrentChildren);
+				/** Destructor, cancels queued Commands, kills running children and stops the reaper thread. */
+				virtual ~CommandExecutor();
+
+				/** Queues a Command for execution.
+				 *  @param[in] command the Command to execute.
+				 *  @return a future that becomes ready when the Command has completed.
+				 */
+				virtual std::future<CommandResult> submit(const Command &command);
+				/** Queues a Command for execution, calling a function when it has completed.
+				 *  The callback is called on the reaper thread: it should return quickly, and must not wait for
+				 *  other Commands of this executor.
+				 *  @param[in] command the Command to execute.
+				 *  @param[in] callback the function to call with the result of the Command.
+				 */
+				virtual void submit(const Command &command, Callback callback);
+				/** Blocks until all submitted Commands have completed and their callbacks have returned. */
+				virtual void waitAll();
+
+				/** Sets the maximum number of children running at the same time.
+				 *  @param[in] maxConcurrentChildren the maximum number of children, at least 1.
+				 */
+				void setMaxConcurrentChildren(unsigned int maxConcurrentChildren);
+				/** Getter for the maximum number of children running at the same time.
+				 *  @return the maximum number of children.
+				 */
+				unsigned int getMaxConcurrentChildren() const;
+				/** Getter for the number of children that are currently running.
+				 *  @return the number of running children.
+				 */
+				unsigned int getRunningChildren() const;
+				/** Getter for the number of Commands waiting for a free slot.
+				 *  @return the number of queued Commands.
+				 */
+				unsigned int getQueuedCommands() const;
+
+			private:
+				struct Job;
+
+				CommandExecutor(const CommandExecutor &);
+				CommandExecutor &operator=(const CommandExecutor &);
+
+				void reaperLoop();
+				void wakeReaper();
+				void startQueuedJobs();
+				void watchFd(int fd, uint64_t key);
+				void completeJob(std::shared_ptr<Job> job);
+
+				mutable std::mutex jobsMutex;
+				std::condition_variable idle;
+				std::deque<std::shared_ptr<Job>> queue;
+				std::map<uint64_t, std::shared_ptr<Job>> running;
+				unsigned int maxConcurrentChildren;
+				unsigned int outstanding;
+				uint64_t nextJobID;
+				bool stopping;
+				int epollFd;
+				int wakeFd;
+				std::thread reaper;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,187 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMANDMETRICS_H_
+#define NEBUAPPFRAMEWORK_COMMANDMETRICS_H_
+
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandResult.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Number of buckets in the latency histograms of CommandMetrics; bucket i holds latencies below 2^i milliseconds. */
+#define COMMANDMETRICS_BUCKETS 24
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Collects statistics about the Commands executed by the CommandRunner and CommandExecutor.
+			 *  Statistics are kept per label (see Command::setLabel), and include a histogram of wall times,
+			 *  the time spent starting processes, and counters of exit codes, signals, timeouts and failures
+			 *  to start. Commands that were not executed because the CommandCache shared the result of an
+			 *  identical Command are counted separately. A gauge tracks the number of Commands running at the same time, and separate counters
+			 *  track how many commands were combined by CommandBatch.
+			 */
+			class CommandMetrics
+			{
+			public:
+				/** Statistics of the Commands with the same label. */
+				struct LabelStatistics
+				{
+					/** Creates empty statistics. */
+					LabelStatistics();
+
+					/** Estimates a percentile of the wall time from the histogram.
+					 *  @param[in] percentile the percentile to calculate, between 0 and 100.
+					 *  @return the upper bound of the bucket containing the percentile in milliseconds.
+					 */
+					double getLatencyPercentile(double percentile) const;
+					/** Calculates the mean wall time.
+					 *  @return the mean wall time in milliseconds, or 0 if no Command completed.
+					 */
+					double getMeanLatency() const;
+					/** Calculates the mean time spent starting a process.
+					 *  @return the mean spawn time in milliseconds, or 0 if no process was started.
+					 */
+					double getMeanSpawnTime() const;
+
+					/** The number of completed Commands. */
+					uint64_t count;
+					/** The sum of the wall times of the completed Commands, in microseconds. */
+					uint64_t totalTime;
+					/** The longest wall time of a completed Command, in microseconds. */
+					uint64_t maxTime;
+					/** Histogram of wall times; bucket i counts Commands taking less than 2^i milliseconds. */
+					std::vector<uint64_t> buckets;
+					/** The number of processes started. */
+					uint64_t spawns;
+					/** The sum of the times spent starting processes, in microseconds. */
+					uint64_t totalSpawnTime;
+					/** The number of Commands that could not be started. */
+					uint64_t spawnFailures;
+					/** The number of Commands that were terminated because their timeout expired. */
+					uint64_t timeouts;
+					/** The number of Commands that exited, by exit code. */
+					std::map<int, uint64_t> exitCodes;
+					/** The number of Commands terminated by a signal, by signal number. */
+					std::map<int, uint64_t> signals;
+					/** The number of Commands served from a result kept by the CommandCache. */
+					uint64_t cacheHits;
+					/** The number of Commands that waited for an identical running Command in the CommandCache. */
+					uint64_t coalesced;
+				};
+
+				/** Statistics of the CommandBatches executed in the application. */
+				struct BatchStatistics
+				{
+					/** Creates empty statistics. */
+					BatchStatistics() : batches(0), commands(0), invocations(0) { }
+
+					/** The number of flushed batches. */
+					uint64_t batches;
+					/** The number of commands executed through batches. */
+					uint64_t commands;
+					/** The number of processes spawned to execute them. */
+					uint64_t invocations;
+				};
+
+				/** Creates empty metrics. */
+				CommandMetrics();
+				/** Empty destructor provided for inheritance. */
+				virtual ~CommandMetrics() { }
+
+				/** Records that a Command has started, updating the gauge of running Commands. */
+				virtual void commandStarted();
+				/** Records the time spent starting the process of a Command.
+				 *  @param[in] command the Command.
+				 *  @param[in] duration the time spent in posix_spawn.
+				 */
+				virtual void recordSpawn(const Command &command, std::chrono::microseconds duration);
+				/** Records the completion of a Command that was reported to commandStarted.
+				 *  @param[in] command the Command.
+				 *  @param[in] result the result of the Command.
+				 *  @param[in] wallTime the time between the start and the completion of the Command.
+				 */
+				virtual void commandCompleted(const Command &command, const CommandResult &result,
+						std::chrono::microseconds wallTime);
+				/** Records that a Command was served from a result kept by the CommandCache.
+				 *  @param[in] command the Command.
+				 */
+				virtual void recordCacheHit(const Command &command);
+				/** Records that a Command waited for an identical running Command in the CommandCache.
+				 *  @param[in] command the Command.
+				 */
+				virtual void recordCoalesced(const Command &command);
+				/** Records the flush of a CommandBatch.
+				 *  @param[in] commands the number of commands in the batch.
+				 *  @param[in] invocations the number of processes spawned to execute them.
+				 */
+				virtual void recordBatch(size_t commands, size_t invocations);
+
+				/** Getter for the statistics of all labels.
+				 *  @return a copy of the statistics, by label.
+				 */
+				virtual std::map<std::string, LabelStatistics> getStatistics() const;
+				/** Getter for the statistics of the CommandBatches.
+				 *  @return a copy of the statistics.
+				 */
+				virtual BatchStatistics getBatchStatistics() const;
+				/** Getter for the number of Commands currently running.
+				 *  @return the number of running Commands.
+				 */
+				unsigned int getRunningCommands() const
+				{
+					return this->runningCommands;
+				}
+				/** Getter for the highest number of Commands running at the same time.
+				 *  @return the peak number of running Commands.
+				 */
+				unsigned int getPeakRunningCommands() const
+				{
+					return this->peakRunningCommands;
+				}
+				/** Clears all statistics, except the number of running Commands. */
+				virtual void reset();
+
+				/** Creates a multi-line summary of the statistics for logging.
+				 *  @return the summary, with one line per label.
+				 */
+				virtual std::string toString() const;
+				/** Logs a summary if CONFIG_APP_COMMAND_METRICSINTERVAL seconds have passed since the last summary. */
+				virtual void logSummaryIfDue();
+
+				/** Getter of the global instance of the CommandMetrics class.
+				 *  @return the global instance.
+				 */
+				static std::shared_ptr<CommandMetrics> getInstance();
+				/** Setter of the global instance of the CommandMetrics class.
+				 *  @param[in] instance the global instance.
+				 */
+				static void setInstance(std::shared_ptr<CommandMetrics> instance);
+
+			private:
+				static std::shared_ptr<CommandMetrics> instance;
+				static std::mutex instanceMutex;
+
+				mutable std::mutex metricsMutex;
+				std::map<std::string, LabelStatistics> statistics;
+				BatchStatistics batchStatistics;
+				std::atomic<unsigned int> runningCommands;
+				std::atomic<unsigned int> peakRunningCommands;
+				std::chrono::steady_clock::time_point lastSummary;
+			};
+
+		}
+	}
+}
+
+#endif
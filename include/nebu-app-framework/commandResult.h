@@ -0,0 +1,144 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMANDRESULT_H_
+#define NEBUAPPFRAMEWORK_COMMANDRESULT_H_
+
+#include <string>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Holds the outcome of a Command executed by the CommandRunner.
+			 *  The output buffers keep their capacity when the result is cleared, so a single CommandResult
+			 *  can be reused for many commands without reallocating.
+			 */
+			class CommandResult
+			{
+			public:
+				/** Creates an empty result. */
+				CommandResult() : waitStatus(0), spawnError(0), timedOut(false), output(), error() { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~CommandResult() { }
+
+				/** Resets the result for reuse, keeping the capacity of the output buffers. */
+				void clear()
+				{
+					this->waitStatus = 0;
+					this->spawnError = 0;
+					this->timedOut = false;
+					this->output.clear();
+					this->error.clear();
+				}
+
+				/** Getter for the raw status as returned by waitpid.
+				 *  @return the wait status of the command.
+				 */
+				int getWaitStatus() const
+				{
+					return this->waitStatus;
+				}
+				/** Setter for the raw status as returned by waitpid.
+				 *  @param[in] waitStatus the wait status of the command.
+				 */
+				void setWaitStatus(int waitStatus)
+				{
+					this->waitStatus = waitStatus;
+				}
+
+				/** Checks if the command terminated normally.
+				 *  @return true iff the command exited.
+				 */
+				bool hasExited() const;
+				/** Getter for the exit code of the command.
+				 *  @return the exit code, or -1 if the command did not exit normally.
+				 */
+				int getExitCode() const;
+				/** Checks if the command was terminated by a signal.
+				 *  @return true iff the command was terminated by a signal.
+				 */
+				bool wasSignaled() const;
+				/** Getter for the signal that terminated the command.
+				 *  @return the signal number, or 0 if the command was not terminated by a signal.
+				 */
+				int getSignal() const;
+				/** Checks if the command exited with exit code 0.
+				 *  @return true iff the command succeeded.
+				 */
+				bool succeeded() const
+				{
+					return this->hasExited() && this->getExitCode() == 0;
+				}
+
+				/** Getter for the error that prevented the command from starting.
+				 *  A command that could not be started is reported as having exited with code 127.
+				 *  @return the errno value, or 0 if the command was started.
+				 */
+				int getSpawnError() const
+				{
+					return this->spawnError;
+				}
+				/** Setter for the error that prevented the command from starting.
+				 *  @param[in] spawnError the errno value.
+				 */
+				void setSpawnError(int spawnError);
+
+				/** Checks if the command was terminated because its timeout expired.
+				 *  @return true iff the command timed out.
+				 */
+				bool hasTimedOut() const
+				{
+					return this->timedOut;
+				}
+				/** Marks the command as terminated because its timeout expired.
+				 *  @param[in] timedOut true iff the command timed out.
+				 */
+				void setTimedOut(bool timedOut)
+				{
+					this->timedOut = timedOut;
+				}
+
+				/** Getter for the captured standard output of the command.
+				 *  @return the standard output.
+				 */
+				const std::string &getOutput() const
+				{
+					return this->output;
+				}
+				/** Getter for the buffer holding the standard output of the command.
+				 *  @return the standard output buffer.
+				 */
+				std::string &getOutputBuffer()
+				{
+					return this->output;
+				}
+				/** Getter for the captured standard error of the command.
+				 *  @return the standard error.
+				 */
+				const std::string &getError() const
+				{
+					return this->error;
+				}
+				/** Getter for the buffer holding the standard error of the command.
+				 *  @return the standard error buffer.
+				 */
+				std::string &getErrorBuffer()
+				{
+					return this->error;
+				}
+
+			private:
+				int waitStatus;
+				int spawnError;
+				bool timedOut;
+				std::string output;
+				std::string error;
+			};
+
+		}
+	}
+}
+
+#endif
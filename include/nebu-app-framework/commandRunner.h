@@ -4,11 +4,29 @@
 #ifndef NEBUAPPFRAMEWORK_COMMANDRUNNER_H_
 #define NEBUAPPFRAMEWORK_COMMANDRUNNER_H_
 
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandCache.h"
+#include "nebu-app-framework/commandExecutor.h"
+#include "nebu-app-framework/commandResult.h"
+#include "nebu-app-framework/commandTemplate.h"
+#include "nebu-app-framework/daemon.h"
+#include "nebu-app-framework/fanOutSummary.h"
+#include "nebu-app-framework/shellWorkerPool.h"
+
+#include "nebu/virtualMachine.h"
+
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 
 /** Convenience wrapper for \link nebu::app::framework::CommandRunner::runCommand(const std::string &) const runCommand \endlink on the global instance. */
 #define NEBU_RUNCOMMAND(cmd) nebu::app::framework::CommandRunner::getInstance()->runCommand(cmd)
+/** Variant of NEBU_RUNCOMMAND(cmd) for commands without side effects, which may be coalesced or cached. */
+#define NEBU_RUNCOMMAND_CACHED(cmd) nebu::app::framework::CommandRunner::getInstance()->runCommand(cmd, true)
 
 namespace nebu
 {
@@ -17,22 +35,114 @@ namespace nebu
 		namespace framework
 		{
 
-			/** Wrapper class for executing commands using the system function.
+			/** Wrapper class for executing commands in child processes.
+			 *  Processes are started using posix_spawn rather than system(), which avoids forking the
+			 *  application and leaves the signal dispositions of the application untouched.
+			 *  Optionally, small commands are sent to a pool of persistent shell workers instead, see
+			 *  setShellWorkerPool and the CONFIG_APP_COMMAND_SHELLWORKERS option. Identical synchronous commands
+			 *  that opt in with Command::setCacheable can share their results, see setCommandCache and the
+			 *  CONFIG_APP_COMMAND_COALESCE and CONFIG_APP_COMMAND_CACHETTL options.
 			 *  For most applications, the NEBU_RUNCOMMAND(cmd) wrapper should be used.
 			 */
 			class CommandRunner
 			{
 			public:
+				/** Function called with the result of a fan-out Command on a single VirtualMachine. */
+				typedef std::function<void(const std::shared_ptr<nebu::common::VirtualMachine> &,
+						const CommandResult &)> FanOutCallback;
+
 				/** Empty constructor. */
-				CommandRunner() { }
+				CommandRunner() : executorMutex(), executor(), shellWorkerPool(), shellWorkerPoolConfigured(false),
+						commandCache(), commandCacheConfigured(false) { }
 				/** Empty destructor provided for inheritance. */
 				virtual ~CommandRunner() { }
 
-				/** Executes a command using the system function.
+				/** Executes a command line using <code>/bin/sh -c</code>.
+				 *  The command shares the standard input, output and error of the application, like system(),
+				 *  and its result is never shared.
 				 *  @param[in] command the command to be executed.
-				 *  @return the exit status of the command.
+				 *  @return the exit status of the command, in the format returned by system().
 				 */
 				virtual int runCommand(const std::string &command) const;
+				/** Executes a command line using <code>/bin/sh -c</code>, optionally sharing its result.
+				 *  When the command is cacheable, its output is only shown by the execution that actually ran.
+				 *  @param[in] command the command to be executed.
+				 *  @param[in] cacheable true if the command has no side effects and its result may be shared.
+				 *  @return the exit status of the command, in the format returned by system().
+				 */
+				virtual int runCommand(const std::string &command, bool cacheable) const;
+				/** Executes a Command and waits for it to terminate.
+				 *  @param[in] command the Command to execute.
+				 *  @return the result of the Command, including any captured output.
+				 */
+				virtual CommandResult execute(const Command &command) const;
+				/** Executes a Command and waits for it to terminate, reusing the buffers of a CommandResult.
+				 *  @param[in] command the Command to execute.
+				 *  @param[out] result the result of the Command, cleared before execution.
+				 */
+				virtual void execute(const Command &command, CommandResult &result) const;
+				/** Executes a Command asynchronously.
+				 *  The number of Commands running at the same time is limited by the CONFIG_APP_COMMAND_MAXCONCURRENT
+				 *  option; further Commands are queued.
+				 *  @param[in] command the Command to execute.
+				 *  @return a future that becomes ready when the Command has completed.
+				 */
+				virtual std::future<CommandResult> executeAsync(const Command &command) const;
+				/** Executes a Command asynchronously, calling a function when it has completed.
+				 *  The callback is called on the thread collecting the results of all asynchronous Commands:
+				 *  it should return quickly, and must not wait for other asynchronous Commands.
+				 *  @param[in] command the Command to execute.
+				 *  @param[in] callback the function to call with the result of the Command.
+				 */
+				virtual void executeAsync(const Command &command, CommandExecutor::Callback callback) const;
+				/** Blocks until all asynchronously executed Commands have completed. */
+				virtual void waitAll() const;
+				/** Executes a CommandTemplate on a number of VirtualMachines in parallel and waits for completion.
+				 *  At most parallelism Commands of the fan-out run at the same time, in addition to the limit
+				 *  imposed by CONFIG_APP_COMMAND_MAXCONCURRENT. Stragglers can be bounded by setting a timeout
+				 *  on the prototype Command of the template.
+				 *  @param[in] commandTemplate the CommandTemplate to instantiate for every VirtualMachine.
+				 *  @param[in] vms the VirtualMachines to run the Command for.
+				 *  @param[in] parallelism the maximum number of Commands of the fan-out running at the same time.
+				 *  @param[in] callback optional function called on the calling thread for every result, in order of completion.
+				 *  @return the aggregated results of the fan-out.
+				 */
+				virtual FanOutSummary fanOut(const CommandTemplate &commandTemplate,
+						const std::vector<std::shared_ptr<nebu::common::VirtualMachine> > &vms,
+						unsigned int parallelism, FanOutCallback callback = FanOutCallback()) const;
+				/** Executes a CommandTemplate on the hosts of a number of Daemons in parallel and waits for completion.
+				 *  Every hosting VirtualMachine is used once, even if it hosts multiple of the Daemons. Daemons without a host
+				 *  VirtualMachine are skipped.
+				 *  @param[in] commandTemplate the CommandTemplate to instantiate for every host.
+				 *  @param[in] daemons the Daemons whose hosts to run the Command on.
+				 *  @param[in] parallelism the maximum number of Commands of the fan-out running at the same time.
+				 *  @param[in] callback optional function called on the calling thread for every result, in order of completion.
+				 *  @return the aggregated results of the fan-out.
+				 */
+				virtual FanOutSummary fanOut(const CommandTemplate &commandTemplate,
+						const std::set<std::shared_ptr<Daemon> > &daemons,
+						unsigned int parallelism, FanOutCallback callback = FanOutCallback()) const;
+
+				/** Sets the pool of shell workers used for synchronous Commands the pool can execute.
+				 *  By default, a pool is created on first use if CONFIG_APP_COMMAND_SHELLWORKERS is positive.
+				 *  @param[in] pool the pool to use, or nullptr to spawn every Command.
+				 */
+				virtual void setShellWorkerPool(std::shared_ptr<ShellWorkerPool> pool);
+				/** Getter for the pool of shell workers used for synchronous Commands.
+				 *  @return the pool, or nullptr if Commands are always spawned.
+				 */
+				virtual std::shared_ptr<ShellWorkerPool> getShellWorkerPool() const;
+
+				/** Sets the cache used to share the results of identical synchronous Commands.
+				 *  By default, a cache is created on first use if CONFIG_APP_COMMAND_COALESCE or
+				 *  CONFIG_APP_COMMAND_CACHETTL is positive.
+				 *  @param[in] cache the cache to use, or nullptr to execute every Command.
+				 */
+				virtual void setCommandCache(std::shared_ptr<CommandCache> cache);
+				/** Getter for the cache used to share the results of identical synchronous Commands.
+				 *  @return the cache, or nullptr if every Command is executed.
+				 */
+				virtual std::shared_ptr<CommandCache> getCommandCache() const;
 
 				/** Getter of the global instance of the CommandRunner class.
 				 *  @return the global instance.
@@ -43,8 +153,26 @@ namespace nebu
 				 */
 				static void setInstance(std::shared_ptr<CommandRunner> instance);
 
+			protected:
+				/** Executes a Command in a new process or on a shell worker, without sharing its result.
+				 *  @param[in] command the Command to execute.
+				 *  @param[out] result the result of the Command, cleared before execution.
+				 */
+				virtual void executeDirect(const Command &command, CommandResult &result) const;
+				/** Getter for the executor of asynchronous Commands, which is created on first use.
+				 *  @return the CommandExecutor.
+				 */
+				std::shared_ptr<CommandExecutor> getExecutor() const;
+
 			private:
 				static std::shared_ptr<CommandRunner> instance;
+
+				mutable std::mutex executorMutex;
+				mutable std::shared_ptr<CommandExecutor> executor;
+				mutable std::shared_ptr<ShellWorkerPool> shellWorkerPool;
+				mutable bool shellWorkerPoolConfigured;
+				mutable std::shared_ptr<CommandCache> commandCache;
+				mutable bool commandCacheConfigured;
 			};
 
 		}
@@ -0,0 +1,56 @@
+
+#ifndef NEBUAPPFRAMEWORK_COMMANDTEMPLATE_H_
+#define NEBUAPPFRAMEWORK_COMMANDTEMPLATE_H_
+
+#include "nebu-app-framework/command.h"
+
+#include "nebu/virtualMachine.h"
+
+#include <string>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** A Command with placeholders that are filled in for a specific VirtualMachine.
+			 *  The placeholders <code>{hostname}</code>, <code>{uuid}</code> and <code>{host}</code> are replaced
+			 *  in every argument by the hostname, unique ID and physical host ID of the VirtualMachine.
+			 *  For example, <code>Command::shell("ssh {hostname} uptime")</code> can be instantiated for each VM.
+			 */
+			class CommandTemplate
+			{
+			public:
+				/** Creates a CommandTemplate from a Command containing placeholders.
+				 *  All other properties of the Command, such as its timeout, are copied to each instantiation.
+				 *  @param[in] prototype the Command containing placeholders.
+				 */
+				CommandTemplate(const Command &prototype) : prototype(prototype) { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~CommandTemplate() { }
+
+				/** Creates the Command for a VirtualMachine by replacing the placeholders.
+				 *  @param[in] vm the VirtualMachine to instantiate the Command for.
+				 *  @return the instantiated Command.
+				 */
+				virtual Command instantiate(const nebu::common::VirtualMachine &vm) const;
+
+				/** Getter for the Command containing the placeholders.
+				 *  @return the prototype Command.
+				 */
+				const Command &getPrototype() const
+				{
+					return this->prototype;
+				}
+
+			private:
+				Command prototype;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -4,19 +4,52 @@
 #ifndef NEBUAPPFRAMEWORK_CONFIGURATION_H_
 #define NEBUAPPFRAMEWORK_CONFIGURATION_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
-#define CONFIG_APP_INTERVAL "app.interval"
-#define CONFIG_APP_UUID     "app.uuid"
-#define CONFIG_NEBU_URL     "nebu.url"
+#define CONFIG_APP_COMMAND_CACHETTL          "app.command.cacheTTL"
+#define CONFIG_APP_COMMAND_COALESCE          "app.command.coalesce"
+#define CONFIG_APP_COMMAND_MAXCONCURRENT     "app.command.maxConcurrent"
+#define CONFIG_APP_COMMAND_METRICSINTERVAL   "app.command.metricsInterval"
+#define CONFIG_APP_COMMAND_SHELLWORKERS      "app.command.shellWorkers"
+#define CONFIG_APP_CONFIG                    "app.config"
+#define CONFIG_APP_DAEMONS_PRUNE             "app.daemons.prune"
+#define CONFIG_APP_INTERVAL                  "app.interval"
+#define CONFIG_APP_SNAPSHOT                  "app.snapshot"
+#define CONFIG_APP_TOPOLOGYIMAGE             "app.topologyImage"
+#define CONFIG_APP_TOPOLOGYSERVER_ADDRESSES  "app.topologyServer.addresses"
+#define CONFIG_APP_TOPOLOGYSERVER_SOCKET     "app.topologyServer.socket"
+#define CONFIG_APP_UUID                      "app.uuid"
+#define CONFIG_APP_VMS_MAXBACKOFF            "app.vms.maxBackoff"
+#define CONFIG_APP_VMS_QUARANTINETHRESHOLD   "app.vms.quarantineThreshold"
+#define CONFIG_APP_VMS_STABLEPOLLS           "app.vms.stablePolls"
+#define CONFIG_APP_VMS_SWEEPBUDGET           "app.vms.sweepBudget"
+#define CONFIG_APP_WORLDSTATE_NAME           "app.worldState.name"
+#define CONFIG_APP_WORLDSTATE_SIZE           "app.worldState.size"
+#define CONFIG_NEBU_BREAKER_BACKOFF          "nebu.breaker.backoff"
+#define CONFIG_NEBU_BREAKER_FAILURETHRESHOLD "nebu.breaker.failureThreshold"
+#define CONFIG_NEBU_BREAKER_MAXBACKOFF       "nebu.breaker.maxBackoff"
+#define CONFIG_NEBU_CACHE_NEGATIVETTL        "nebu.cache.negativeTTL"
+#define CONFIG_NEBU_CACHE_TOPOLOGYTTL        "nebu.cache.topologyTTL"
+#define CONFIG_NEBU_CACHE_VMIDSTTL           "nebu.cache.vmIDsTTL"
+#define CONFIG_NEBU_CACHE_VMTTL              "nebu.cache.vmTTL"
+#define CONFIG_NEBU_HEDGE_MAXRATE            "nebu.hedge.maxRate"
+#define CONFIG_NEBU_HEDGE_MINDELAY           "nebu.hedge.minDelay"
+#define CONFIG_NEBU_HEDGE_PERCENTILE         "nebu.hedge.percentile"
+#define CONFIG_NEBU_HEDGE_SUMMARYINTERVAL    "nebu.hedge.summaryInterval"
+#define CONFIG_NEBU_POOLSIZE                 "nebu.poolSize"
+#define CONFIG_NEBU_TIMEOUT                  "nebu.timeout"
+#define CONFIG_NEBU_URL                      "nebu.url"
 
 /** Convenience wrapper for \link nebu::app::framework::Configuration::getOption(const std::string &option) const getOption \endlink on the global instance. */
 #define CONFIG_GET(x) nebu::app::framework::Configuration::getGlobalConfiguration()->getOption(x)
 /** Convenience wrapper for \link nebu::app::framework::Configuration::getOptionInt(const std::string &option) const getOptionInt \endlink on the global instance. */
 #define CONFIG_GETINT(x) nebu::app::framework::Configuration::getGlobalConfiguration()->getOptionInt(x)
+/** Convenience wrapper for \link nebu::app::framework::Configuration::getOptionDouble(const std::string &option) const getOptionDouble \endlink on the global instance. */
+#define CONFIG_GETDOUBLE(x) nebu::app::framework::Configuration::getGlobalConfiguration()->getOptionDouble(x)
 
 namespace nebu
 {
@@ -25,7 +58,11 @@ namespace nebu
 		namespace framework
 		{
 
-			/** Class holding the configuration of an application */
+			/** Class holding the configuration of an application.
+			 *  The global Configuration is published as an immutable snapshot: it can be read from any thread
+			 *  without locking, and is only replaced as a whole through setGlobalConfiguration or
+			 *  updateGlobalConfiguration.
+			 */
 			class Configuration
 			{
 			public:
@@ -46,6 +83,12 @@ namespace nebu
 				 *  @return the value of the option interpreted as an integer.
 				 */
 				int getOptionInt(const std::string &option) const;
+				/** Retrieves the value of an option as a floating point number.
+				 *  @param[in] option the name of the option.
+				 *  @throws std::out_of_range if the option does not exist.
+				 *  @return the value of the option interpreted as a floating point number.
+				 */
+				double getOptionDouble(const std::string &option) const;
 				/** Sets the value of an option.
 				 *  Overrides the previous value if it exists.
 				 *  @param[in] option the option to set.
@@ -53,34 +96,66 @@ namespace nebu
 				 */
 				void setOption(const std::string &option, const std::string &value);
 				/** Retrieve a reference to an option.
+				 *  Intended for building a Configuration before it is published.
 				 *  @param[in] option the option to retrieve.
 				 *  @return a reference to the option.
 				 */
 				std::string &operator[](const std::string &option);
 				/** Write all configuration options to the logger */
 				void logConfiguration() const;
+				/** Reads options from a configuration file, overriding any existing values.
+				 *  The file consists of <code>key = value</code> lines. Lines starting with '#' or ';' are
+				 *  comments. A <code>[section]</code> header prefixes all following keys with "section.",
+				 *  so <code>url</code> in section <code>[nebu]</code> sets the option <code>nebu.url</code>.
+				 *  @param[in] filename the configuration file to read.
+				 *  @return true iff the file could be read.
+				 */
+				bool loadFile(const std::string &filename);
 
-				/** Creates a new Configuration using a command-line argument parser. */
+				/** Creates a new Configuration using a command-line argument parser.
+				 *  Options are layered: default values are overridden by the configuration file given
+				 *  through CONFIG_APP_CONFIG (if any), which is in turn overridden by the command line.
+				 */
 				static void fromArguments(std::vector<std::string> &args);
+				/** Rebuilds the global Configuration from the default values, the configuration file and
+				 *  the command line arguments parsed by fromArguments, and publishes it as a new snapshot.
+				 *  Options changed through updateGlobalConfiguration since the last call to fromArguments or
+				 *  setGlobalConfiguration are applied on top, so they survive the reload.
+				 *  The previous snapshot is kept if the configuration file cannot be read.
+				 *  @return true iff a new Configuration was published.
+				 */
+				static bool reload();
 				/** Adds a new command line option to the global map of accepted options. */
 				static void addCommandLineOption(const std::string &cmd, const std::string &optionName);
 				/** Adds a default value for a configuration option. */
 				static void addDefaultValue(const std::string &optionName, const std::string &defaultValue);
 
 				/** Retrieves the global Configuration.
+				 *  Lock-free and wait-free; safe to call from any thread. The returned snapshot is immutable
+				 *  and is not affected by later updates.
 				 *  @return the global Configuration.
 				 */
-				static std::shared_ptr<Configuration> getGlobalConfiguration();
+				static std::shared_ptr<const Configuration> getGlobalConfiguration();
 				/** Sets the global Configuration to the given value.
+				 *  Options changed earlier through updateGlobalConfiguration are no longer applied by reload.
 				 *  @param configuration the new global Configuration.
 				 */
-				static void setGlobalConfiguration(std::shared_ptr<Configuration> configuration);
+				static void setGlobalConfiguration(std::shared_ptr<const Configuration> configuration);
+				/** Updates the global Configuration by copy-and-swap.
+				 *  The update function is applied to a copy of the current snapshot, after which the copy is
+				 *  published. Concurrent updates are serialised, so no update is lost. Options changed by the
+				 *  update are kept when the configuration is reloaded.
+				 *  @param[in] update function modifying the copy of the global Configuration.
+				 */
+				static void updateGlobalConfiguration(const std::function<void(Configuration &)> &update);
 
 			private:
-				static std::shared_ptr<Configuration> globalConfiguration;
+				static std::shared_ptr<Configuration> createLayered(bool &fileLoaded);
 
 				std::map<std::string, std::string> options;
 				static std::map<std::string, std::string> commandLineOptions;
+				static std::map<std::string, std::string> commandLineValues;
+				static std::map<std::string, std::string> updatedValues;
 				static std::map<std::string, std::string> defaultValues;
 			};
 
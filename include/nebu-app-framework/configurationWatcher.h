@@ -0,0 +1,61 @@
+
+#ifndef NEBUAPPFRAMEWORK_CONFIGURATIONWATCHER_H_
+#define NEBUAPPFRAMEWORK_CONFIGURATIONWATCHER_H_
+
+#include <string>
+#include <thread>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Watches a configuration file and reloads the global Configuration when it changes.
+			 *  Changes are detected using inotify on the directory containing the file, so both in-place
+			 *  writes and editors that replace the file through rename() are picked up. Every change results
+			 *  in a call to Configuration::reload(), which publishes a new snapshot of the configuration.
+			 */
+			class ConfigurationWatcher
+			{
+			public:
+				/** Creates a watcher for the given configuration file. The watcher is not started.
+				 *  @param[in] filename the configuration file to watch.
+				 */
+				ConfigurationWatcher(const std::string &filename);
+				/** Destructor, stops the watcher thread if it is running. */
+				virtual ~ConfigurationWatcher();
+
+				/** Starts watching the configuration file on a background thread.
+				 *  @return true iff the watcher is running.
+				 */
+				virtual bool start();
+				/** Stops watching the configuration file and joins the background thread. */
+				virtual void stop();
+				/** Checks if the watcher thread is running.
+				 *  @return true iff the watcher is running.
+				 */
+				virtual bool isRunning() const
+				{
+					return this->watcher.joinable();
+				}
+
+			private:
+				ConfigurationWatcher(const ConfigurationWatcher &);
+				ConfigurationWatcher &operator=(const ConfigurationWatcher &);
+
+				void watchLoop();
+
+				std::string directory;
+				std::string basename;
+				int inotifyFd;
+				int stopFd;
+				std::thread watcher;
+			};
+
+		}
+	}
+}
+
+#endif
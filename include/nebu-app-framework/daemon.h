@@ -8,6 +8,7 @@
 
 #include <memory>
 #include <time.h>
+#include <vector>
 
 namespace nebu
 {
@@ -21,12 +22,50 @@ namespace nebu
 			 */
 			typedef unsigned int DaemonType;
 
+			class DaemonCollection;
+
 			/**	Represents a daemon managed by the application.
 			 *  Daemons are managed by a DaemonManager and are contained in a DaemonCollection.
 			 */
 			class Daemon
 			{
 			public:
+				/** The launch state of a Daemon.
+				 *  Assigning it reports the change to every DaemonCollection holding the Daemon, so their launch state
+				 *  indexes stay up to date however the Daemon is launched.
+				 */
+				class LaunchState
+				{
+				public:
+					/** Creates the launch state of an unlaunched Daemon.
+					 *  @param[in] daemon the Daemon the launch state belongs to.
+					 */
+					explicit LaunchState(const Daemon *daemon) : daemon(daemon), launched(false), collections() { }
+
+					/** Changes the launch state and reports it to the DaemonCollections holding the Daemon.
+					 *  @param[in] launched true iff the Daemon has launched.
+					 *  @return this launch state.
+					 */
+					LaunchState &operator=(bool launched);
+					/** Converts the launch state to a boolean.
+					 *  @return true iff the Daemon has launched.
+					 */
+					operator bool() const
+					{
+						return this->launched;
+					}
+
+				private:
+					friend class DaemonCollection;
+
+					LaunchState(const LaunchState &);
+					LaunchState &operator=(const LaunchState &);
+
+					const Daemon *daemon;
+					bool launched;
+					std::vector<DaemonCollection *> collections;
+				};
+
 				/** Creates a new Daemon on the given VirtualMachine.
 				 *  @param hostVM the VirtualMachine hosting the Daemon.
 				 */
@@ -56,9 +95,10 @@ namespace nebu
 				 */
 				virtual bool launch() = 0;
 				/** Checks if the Daemon has been launched.
+				 *  Not virtual, as DaemonCollection indexes Daemons by the same launch state.
 				 *  @return true iff the Daemon has launched succesfully.
 				 */
-				virtual bool hasLaunched() const
+				bool hasLaunched() const
 				{
 					return this->launched;
 				}
@@ -78,10 +118,13 @@ namespace nebu
 			protected:
 				/** The discovery time of the Daemon. */
 				time_t discoveryTime;
-				/** True iff the Daemon has been launched succesfully. */
-				bool launched;
+				/** True iff the Daemon has been launched succesfully. Implementations of launch() set it on success. */
+				LaunchState launched;
 				/** The VirtualMachine hosting the Daemon. */
 				std::shared_ptr<nebu::common::VirtualMachine> hostVM;
+
+			private:
+				friend class DaemonCollection;
 			};
 
 		}
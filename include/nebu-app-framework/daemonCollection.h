@@ -3,10 +3,15 @@
 #define NEBUAPPFRAMEWORK_DAEMONCOLLECTION_H_
 
 #include "nebu-app-framework/daemon.h"
+#include "nebu-app-framework/daemonQuery.h"
+#include "nebu-app-framework/vmEventHandler.h"
 
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace nebu
 {
@@ -17,14 +22,74 @@ namespace nebu
 
 			/** Holds a collection of Daemons in the system for easy retrieval.
 			 *  Provides several accessor functions to retrieve a subset of all daemons, e.g., based on their type.
+			 *
+			 *  The collection is indexed by DaemonType and launch state. The range and count accessors answer from
+			 *  the index in constant time, without copying; the set accessors copy their results and are kept for
+			 *  compatibility. Daemons report changes of their launch state to the collections holding them, so the
+			 *  index is up to date wherever a Daemon is launched, including during DaemonManager::deployDaemons.
+			 *
+			 *  The collection is also indexed by the UUID of the VirtualMachine hosting each Daemon. As a
+			 *  VMEventHandler, it removes the Daemons of a VirtualMachine when that VirtualMachine leaves the
+			 *  system. The Application registers the DaemonCollection of its ApplicationHooks with the VMManager
+			 *  if <code>app.daemons.prune</code> is set. It does so after the DaemonManager, which can
+			 *  therefore still find the Daemons of a removed VirtualMachine in its own oldVMRemoved.
 			 */
-			class DaemonCollection
+			class DaemonCollection : public VMEventHandler
 			{
 			public:
+				/** A non-owning view of Daemons in the collection, which is invalidated by any change to the
+				 *  collection. Its order is unspecified.
+				 */
+				class Range
+				{
+				public:
+					/** Iterator over the Daemons in a Range. */
+					typedef std::vector<std::shared_ptr<Daemon>>::const_iterator const_iterator;
+
+					/** Creates a Range of the Daemons between two iterators.
+					 *  @param[in] first the first Daemon.
+					 *  @param[in] last the end of the Range.
+					 */
+					Range(const_iterator first, const_iterator last) : first(first), last(last) { }
+
+					/** Getter for the first Daemon of the Range.
+					 *  @return an iterator to the first Daemon.
+					 */
+					const_iterator begin() const
+					{
+						return this->first;
+					}
+					/** Getter for the end of the Range.
+					 *  @return an iterator past the last Daemon.
+					 */
+					const_iterator end() const
+					{
+						return this->last;
+					}
+					/** Getter for the number of Daemons in the Range.
+					 *  @return the number of Daemons.
+					 */
+					size_t size() const
+					{
+						return this->last - this->first;
+					}
+					/** Checks whether the Range is empty.
+					 *  @return true iff the Range holds no Daemons.
+					 */
+					bool empty() const
+					{
+						return this->first == this->last;
+					}
+
+				private:
+					const_iterator first;
+					const_iterator last;
+				};
+
 				/** Empty constructor. */
-				DaemonCollection() { }
-				/** Virtual destructor provided for inheritance. */
-				virtual ~DaemonCollection() { }
+				DaemonCollection() : daemons(), types(), vms(), entries() { }
+				/** Stops the Daemons in the collection from reporting their launch state to it. */
+				virtual ~DaemonCollection();
 
 				/** Getter for a set containing all Daemons.
 				 *  @return set of Daemon objects.
@@ -46,19 +111,166 @@ namespace nebu
 				 */
 				virtual std::set<std::shared_ptr<Daemon>> getLaunchedDaemonsForType(DaemonType type);
 				/** Getter for the set of Daemons with a custom filter.
+				 *  Filters that capture context, or callers that do not need a set, should use query instead.
 				 *  @param[in] includeInResults a predicate that should be true iff the Daemon should be included
 				 *                          in the result set of the function.
 				 *  @return filtered set of Daemons.
 				 */
 				virtual std::set<std::shared_ptr<Daemon>> getDaemonsFiltered(bool (*includeInResults)(std::shared_ptr<Daemon>));
 
-				/** Adds a Daemon to the collection.
+				/** Getter for a view of all Daemons.
+				 *  @return a Range of all Daemons.
+				 */
+				Range getDaemonRange() const
+				{
+					return Range(this->daemons.begin(), this->daemons.end());
+				}
+				/** Getter for a view of the Daemons of a DaemonType.
+				 *  @param[in] type the type of Daemon to return.
+				 *  @return a Range of the Daemons of DaemonType type.
+				 */
+				Range getDaemonRangeForType(DaemonType type) const;
+				/** Getter for a view of the launched Daemons of a DaemonType.
+				 *  @param[in] type the type of Daemon to return.
+				 *  @return a Range of the launched Daemons of DaemonType type.
+				 */
+				Range getLaunchedDaemonRangeForType(DaemonType type) const;
+				/** Getter for a view of the unlaunched Daemons of a DaemonType.
+				 *  @param[in] type the type of Daemon to return.
+				 *  @return a Range of the unlaunched Daemons of DaemonType type.
+				 */
+				Range getUnlaunchedDaemonRangeForType(DaemonType type) const;
+				/** Getter for a view of the Daemons hosted by a VirtualMachine.
+				 *  @param[in] uuid the UUID of the VirtualMachine.
+				 *  @return a Range of the Daemons hosted by the VirtualMachine.
+				 */
+				Range getDaemonRangeForVM(const std::string &uuid) const;
+
+				/** Starts a lazy query over all Daemons.
+				 *  @return a DaemonQuery selecting all Daemons.
+				 */
+				DaemonQuery<> query() const
+				{
+					return DaemonQuery<>(this->daemons.begin(), this->daemons.end());
+				}
+				/** Starts a lazy query over the Daemons of a DaemonType, which only visits Daemons of that type.
+				 *  @param[in] type the type of Daemon to query.
+				 *  @return a DaemonQuery selecting the Daemons of DaemonType type.
+				 */
+				DaemonQuery<> query(DaemonType type) const
+				{
+					Range daemons = this->getDaemonRangeForType(type);
+					return DaemonQuery<>(daemons.begin(), daemons.end());
+				}
+				/** Starts a lazy query over the launched or unlaunched Daemons of a DaemonType, which only visits
+				 *  Daemons of that type and launch state.
+				 *  @param[in] type the type of Daemon to query.
+				 *  @param[in] launched true to query the launched Daemons, false to query the unlaunched Daemons.
+				 *  @return a DaemonQuery selecting the Daemons of DaemonType type with the given launch state.
+				 */
+				DaemonQuery<> query(DaemonType type, bool launched) const
+				{
+					Range daemons = launched ? this->getLaunchedDaemonRangeForType(type) :
+							this->getUnlaunchedDaemonRangeForType(type);
+					return DaemonQuery<>(daemons.begin(), daemons.end());
+				}
+				/** Starts a lazy query over the Daemons hosted by a VirtualMachine, which only visits those Daemons.
+				 *  @param[in] uuid the UUID of the VirtualMachine.
+				 *  @return a DaemonQuery selecting the Daemons hosted by the VirtualMachine.
+				 */
+				DaemonQuery<> queryForVM(const std::string &uuid) const
+				{
+					Range daemons = this->getDaemonRangeForVM(uuid);
+					return DaemonQuery<>(daemons.begin(), daemons.end());
+				}
+
+				/** Getter for the number of Daemons.
+				 *  @return the number of Daemons.
+				 */
+				size_t getDaemonCount() const
+				{
+					return this->daemons.size();
+				}
+				/** Getter for the number of Daemons of a DaemonType.
+				 *  @param[in] type the type of Daemon to count.
+				 *  @return the number of Daemons of DaemonType type.
+				 */
+				size_t getDaemonCountForType(DaemonType type) const;
+				/** Getter for the number of launched Daemons of a DaemonType.
+				 *  @param[in] type the type of Daemon to count.
+				 *  @return the number of launched Daemons of DaemonType type.
+				 */
+				size_t getLaunchedDaemonCountForType(DaemonType type) const;
+				/** Getter for the number of unlaunched Daemons of a DaemonType.
+				 *  @param[in] type the type of Daemon to count.
+				 *  @return the number of unlaunched Daemons of DaemonType type.
+				 */
+				size_t getUnlaunchedDaemonCountForType(DaemonType type) const;
+				/** Getter for the number of Daemons hosted by a VirtualMachine.
+				 *  @param[in] uuid the UUID of the VirtualMachine.
+				 *  @return the number of Daemons hosted by the VirtualMachine.
+				 */
+				size_t getDaemonCountForVM(const std::string &uuid) const;
+
+				/** Adds a Daemon to the collection. Adding a Daemon that is already in the collection has no effect.
 				 *  @param[in] daemon the Daemon to add.
 				 */
 				virtual void addDaemon(std::shared_ptr<Daemon> daemon);
+				/** Removes a Daemon from the collection.
+				 *  @param[in] daemon the Daemon to remove.
+				 *  @return true iff the Daemon was in the collection.
+				 */
+				virtual bool removeDaemon(std::shared_ptr<Daemon> daemon);
+				/** Removes all Daemons hosted by a VirtualMachine from the collection.
+				 *  @param[in] uuid the UUID of the VirtualMachine.
+				 *  @return the number of Daemons removed.
+				 */
+				virtual size_t removeDaemonsForVM(const std::string &uuid);
+				/** Removes all Daemons of a DaemonType from the collection.
+				 *  @param[in] type the type of Daemon to remove.
+				 *  @return the number of Daemons removed.
+				 */
+				virtual size_t removeDaemonsForType(DaemonType type);
+				virtual void newVMAdded(std::shared_ptr<nebu::common::VirtualMachine> vm);
+				virtual void existingVMChanged(std::shared_ptr<nebu::common::VirtualMachine> vm,
+						const VMEvent event);
+				/** Removes the Daemons hosted by the VirtualMachine that has left the system.
+				 *  @param[in] vm the VirtualMachine that has left the system.
+				 */
+				virtual void oldVMRemoved(const nebu::common::VirtualMachine &vm);
 
 			private:
-				std::map<int, std::set<std::shared_ptr<Daemon>>> daemons;
+				friend class Daemon::LaunchState;
+
+				// The Daemons of a type are partitioned into launched Daemons followed by unlaunched ones
+				struct TypeIndex
+				{
+					std::vector<std::shared_ptr<Daemon>> daemons;
+					size_t launchedCount;
+
+					TypeIndex() : daemons(), launchedCount(0) { }
+				};
+
+				// Positions of a Daemon in each of the vectors holding it, for removal by swapping with the last one
+				struct Entry
+				{
+					DaemonType type;
+					std::string vmUUID;
+					size_t position;
+					size_t typePosition;
+					size_t vmPosition;
+				};
+
+				const TypeIndex *findType(DaemonType type) const;
+				void launchStateChanged(const Daemon *daemon, bool launched);
+				void setLaunched(const Entry &entry, bool launched);
+				void swapInType(TypeIndex &index, size_t first, size_t second);
+				void eraseDaemon(std::shared_ptr<Daemon> daemon);
+
+				std::vector<std::shared_ptr<Daemon>> daemons;
+				std::unordered_map<DaemonType, TypeIndex> types;
+				std::unordered_map<std::string, std::vector<std::shared_ptr<Daemon>>> vms;
+				std::unordered_map<const Daemon *, Entry> entries;
 			};
 
 		}
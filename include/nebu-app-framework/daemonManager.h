@@ -27,7 +27,10 @@ namespace nebu
 
 				/** Hook used by the main loop to trigger a refresh of the Daemons. */
 				virtual void refreshDaemons() = 0;
-				/** Hook used to deploy new Daemons. */
+				/** Hook used to deploy new Daemons.
+				 *  Launching a Daemon updates the launch state index of the DaemonCollection holding it immediately, so
+				 *  launched and unlaunched Daemons can be queried from the collection while deploying.
+				 */
 				virtual void deployDaemons() = 0;
 
 				virtual void newVMAdded(std::shared_ptr<nebu::common::VirtualMachine> vm) = 0;
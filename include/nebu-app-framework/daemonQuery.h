@@ -0,0 +1,174 @@
+
+#ifndef NEBUAPPFRAMEWORK_DAEMONQUERY_H_
+#define NEBUAPPFRAMEWORK_DAEMONQUERY_H_
+
+#include "nebu-app-framework/daemon.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Predicate accepting every Daemon. */
+			class AnyDaemon
+			{
+			public:
+				/** Evaluates the predicate.
+				 *  @return true.
+				 */
+				bool operator()(const std::shared_ptr<Daemon> &) const
+				{
+					return true;
+				}
+			};
+
+			/** Predicate accepting Daemons accepted by two predicates, evaluated in order.
+			 *  @tparam First the type of the predicate evaluated first.
+			 *  @tparam Second the type of the predicate evaluated if the first accepts a Daemon.
+			 */
+			template<typename First, typename Second>
+			class BothDaemonPredicates
+			{
+			public:
+				/** Creates the predicate.
+				 *  @param[in] first the predicate evaluated first.
+				 *  @param[in] second the predicate evaluated if the first accepts a Daemon.
+				 */
+				BothDaemonPredicates(First first, Second second) : first(first), second(second) { }
+
+				/** Evaluates the predicate.
+				 *  @param[in] daemon the Daemon to check.
+				 *  @return true iff both predicates accept the Daemon.
+				 */
+				bool operator()(const std::shared_ptr<Daemon> &daemon) const
+				{
+					return this->first(daemon) && this->second(daemon);
+				}
+
+			private:
+				First first;
+				Second second;
+			};
+
+			/** A lazy query over a sequence of Daemons, typically obtained from DaemonCollection::query or
+			 *  DaemonCollection::queryForVM, which start from the narrowest range of their index.
+			 *  Filters are composed into the type of the query, so they can be inlined and can capture any
+			 *  context, and nothing is evaluated until one of the terminal operations count, any, first,
+			 *  forEach or toSet is called. count is the only operation that visits every Daemon; the others
+			 *  stop at the first Daemon that decides their result. Like the Range it was created from, a query
+			 *  is invalidated by any change to its DaemonCollection.
+			 *
+			 *  For example, counting the unlaunched Daemons of a type on a given rack:
+			 *  \code
+			 *  size_t count = collection.query(type, false).where(
+			 *          [&](const std::shared_ptr<Daemon> &daemon) { return rackOf(daemon) == rack; }).count();
+			 *  \endcode
+			 *
+			 *  @tparam Predicate the type of the function object selecting Daemons, which is called with a
+			 *          const reference to the std::shared_ptr of each Daemon.
+			 */
+			template<typename Predicate = AnyDaemon>
+			class DaemonQuery
+			{
+			public:
+				/** Iterator over the Daemons visited by the query. */
+				typedef std::vector<std::shared_ptr<Daemon>>::const_iterator const_iterator;
+
+				/** Creates a query over the Daemons between two iterators.
+				 *  @param[in] first the first Daemon.
+				 *  @param[in] last the end of the sequence.
+				 *  @param[in] predicate the function object selecting Daemons.
+				 */
+				DaemonQuery(const_iterator first, const_iterator last, Predicate predicate = Predicate()) :
+						rangeBegin(first), rangeEnd(last), predicate(predicate) { }
+
+				/** Narrows the query with a custom filter.
+				 *  @param[in] filter a function object that should be true iff the Daemon should be selected.
+				 *  @return a query selecting the Daemons accepted by both this query and the filter.
+				 */
+				template<typename Filter>
+				DaemonQuery<BothDaemonPredicates<Predicate, Filter>> where(Filter filter) const
+				{
+					return DaemonQuery<BothDaemonPredicates<Predicate, Filter>>(this->rangeBegin, this->rangeEnd,
+							BothDaemonPredicates<Predicate, Filter>(this->predicate, filter));
+				}
+				/** Counts the selected Daemons.
+				 *  @return the number of selected Daemons.
+				 */
+				size_t count() const
+				{
+					size_t count = 0;
+					for (const_iterator daemon = this->rangeBegin; daemon != this->rangeEnd; daemon++) {
+						if (this->predicate(*daemon)) {
+							count++;
+						}
+					}
+					return count;
+				}
+				/** Checks whether any Daemon is selected, stopping at the first one.
+				 *  @return true iff at least one Daemon is selected.
+				 */
+				bool any() const
+				{
+					return this->find() != this->rangeEnd;
+				}
+				/** Getter for the first selected Daemon, stopping the query there.
+				 *  @return the first selected Daemon, or an empty pointer if none is selected.
+				 */
+				std::shared_ptr<Daemon> first() const
+				{
+					const_iterator daemon = this->find();
+					return (daemon != this->rangeEnd) ? *daemon : std::shared_ptr<Daemon>();
+				}
+				/** Calls a function for every selected Daemon.
+				 *  @param[in] function a function object called with a const reference to each selected Daemon.
+				 */
+				template<typename Function>
+				void forEach(Function function) const
+				{
+					for (const_iterator daemon = this->rangeBegin; daemon != this->rangeEnd; daemon++) {
+						if (this->predicate(*daemon)) {
+							function(*daemon);
+						}
+					}
+				}
+				/** Copies the selected Daemons into a set.
+				 *  @return set of the selected Daemons.
+				 */
+				std::set<std::shared_ptr<Daemon>> toSet() const
+				{
+					std::set<std::shared_ptr<Daemon>> daemons;
+					for (const_iterator daemon = this->rangeBegin; daemon != this->rangeEnd; daemon++) {
+						if (this->predicate(*daemon)) {
+							daemons.insert(*daemon);
+						}
+					}
+					return daemons;
+				}
+
+			private:
+				const_iterator find() const
+				{
+					const_iterator daemon = this->rangeBegin;
+					while (daemon != this->rangeEnd && !this->predicate(*daemon)) {
+						daemon++;
+					}
+					return daemon;
+				}
+
+				const_iterator rangeBegin;
+				const_iterator rangeEnd;
+				Predicate predicate;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,100 @@
+
+#ifndef NEBUAPPFRAMEWORK_FANOUTSUMMARY_H_
+#define NEBUAPPFRAMEWORK_FANOUTSUMMARY_H_
+
+#include "nebu-app-framework/commandResult.h"
+
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Aggregated outcome of running a CommandTemplate on many hosts.
+			 *  Every host is counted exactly once: as a success (exit code 0), as a straggler (killed because
+			 *  its timeout expired) or as a failure (any other outcome).
+			 */
+			class FanOutSummary
+			{
+			public:
+				/** Creates an empty summary. */
+				FanOutSummary() : successes(0), failedHosts(), stragglerHosts(), latencies() { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~FanOutSummary() { }
+
+				/** Records the outcome of the command on a single host.
+				 *  @param[in] hostname the hostname of the host.
+				 *  @param[in] result the result of the command.
+				 *  @param[in] latency the wall time of the command in milliseconds.
+				 */
+				void addResult(const std::string &hostname, const CommandResult &result, unsigned int latency);
+
+				/** Getter for the number of hosts the command ran on.
+				 *  @return the number of hosts.
+				 */
+				unsigned int getTotal() const
+				{
+					return this->latencies.size();
+				}
+				/** Getter for the number of hosts on which the command succeeded.
+				 *  @return the number of successes.
+				 */
+				unsigned int getSuccesses() const
+				{
+					return this->successes;
+				}
+				/** Getter for the number of hosts on which the command failed.
+				 *  @return the number of failures.
+				 */
+				unsigned int getFailures() const
+				{
+					return this->failedHosts.size();
+				}
+				/** Getter for the number of hosts on which the command timed out.
+				 *  @return the number of stragglers.
+				 */
+				unsigned int getStragglers() const
+				{
+					return this->stragglerHosts.size();
+				}
+				/** Getter for the hostnames of hosts on which the command failed.
+				 *  @return the failed hosts.
+				 */
+				const std::vector<std::string> &getFailedHosts() const
+				{
+					return this->failedHosts;
+				}
+				/** Getter for the hostnames of hosts on which the command timed out.
+				 *  @return the straggling hosts.
+				 */
+				const std::vector<std::string> &getStragglerHosts() const
+				{
+					return this->stragglerHosts;
+				}
+
+				/** Calculates a percentile of the command latencies.
+				 *  @param[in] percentile the percentile to calculate, between 0 and 100.
+				 *  @return the latency in milliseconds, or 0 if no command ran.
+				 */
+				unsigned int getLatencyPercentile(double percentile) const;
+				/** Creates a single-line description of the summary for logging.
+				 *  @return the description.
+				 */
+				std::string toString() const;
+
+			private:
+				unsigned int successes;
+				std::vector<std::string> failedHosts;
+				std::vector<std::string> stragglerHosts;
+				std::vector<unsigned int> latencies;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,137 @@
+
+#ifndef NEBUAPPFRAMEWORK_HEDGINGAPPVIRTREQUEST_H_
+#define NEBUAPPFRAMEWORK_HEDGINGAPPVIRTREQUEST_H_
+
+#include "nebu-app-framework/latencyWindow.h"
+
+#include "nebu/appVirtRequest.h"
+#include "nebu/virtualMachine.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Decorates an AppVirtRequest with hedged requests for individual VirtualMachines.
+			 *  If a request for a VirtualMachine has not completed within a percentile of the recent
+			 *  latencies of such requests, an identical (hedge) request is made, and the first successful
+			 *  response is returned. The other request can not be interrupted; it is abandoned and its
+			 *  response discarded.
+			 *  The number of hedge requests is limited to a percentage of all requests using a token
+			 *  bucket, so hedging can not multiply the load on a struggling middleware. Requests that can
+			 *  not be hedged, because too few latencies are known or no token is available, are made on the
+			 *  calling thread. Requests that may be hedged are made on a small pool of persistent worker
+			 *  threads, so the caller can return the first response; when all workers are busy, the request
+			 *  is made on the calling thread without hedging.
+			 *  The decorated AppVirtRequest must support concurrent requests.
+			 */
+			class HedgingAppVirtRequest : public nebu::common::AppVirtRequest
+			{
+			public:
+				/** Counters describing the effect of hedging. */
+				struct Statistics
+				{
+					/** The number of requests for a VirtualMachine. */
+					uint64_t requests;
+					/** The number of requests for which a hedge request was made. */
+					uint64_t hedged;
+					/** The number of hedged requests answered by the hedge request. */
+					uint64_t hedgeWins;
+					/** The number of requests that exceeded the hedge delay, but were not hedged due to the rate limit. */
+					uint64_t throttled;
+				};
+
+				/** Creates a HedgingAppVirtRequest.
+				 *  @param[in] appVirtRequest the AppVirtRequest to make (hedge) requests with.
+				 *  @param[in] percentile the percentile of recent latencies after which a hedge request is made.
+				 *  @param[in] maxRate the maximum percentage of requests that is hedged.
+				 *  @param[in] minDelay the minimum time before a hedge request is made, in milliseconds.
+				 */
+				HedgingAppVirtRequest(std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest,
+						double percentile, double maxRate, unsigned int minDelay);
+				/** Destructor, stops the worker threads once their current request has completed. */
+				virtual ~HedgingAppVirtRequest();
+
+				/** Retrieves the identifiers of the VMs of the application, without hedging.
+				 *  @return the list of VM identifiers.
+				 */
+				virtual std::vector<std::string> getVirtualMachineIDs();
+				/** Retrieves a VirtualMachine, hedging the request if it is slow.
+				 *  @param[in] uuid the unique ID of the VM.
+				 *  @return the VirtualMachine.
+				 */
+				virtual nebu::common::VirtualMachine getVirtualMachine(const std::string &uuid);
+
+				/** Getter for the time after which a request is currently hedged.
+				 *  @return the delay in microseconds, or 0 if too few latencies are known to hedge requests.
+				 */
+				unsigned int getHedgeDelay() const;
+				/** Computes a percentile of the latencies of recent requests as seen by callers.
+				 *  @param[in] percentile the percentile, between 0 and 100.
+				 *  @return the latency in microseconds.
+				 */
+				unsigned int getLatencyPercentile(double percentile) const
+				{
+					return this->latencies.getPercentile(percentile);
+				}
+				/** Computes a percentile of the latencies of recent first (non-hedge) requests, which is what
+				 *  callers would have seen without hedging.
+				 *  @param[in] percentile the percentile, between 0 and 100.
+				 *  @return the latency in microseconds.
+				 */
+				unsigned int getPrimaryLatencyPercentile(double percentile) const
+				{
+					return this->primaryLatencies->getPercentile(percentile);
+				}
+				/** Getter for the counters of the HedgingAppVirtRequest.
+				 *  @return the statistics.
+				 */
+				Statistics getStatistics() const;
+				/** Creates a human readable summary of the effect of hedging for logging.
+				 *  @return the summary.
+				 */
+				std::string toString() const;
+				/** Logs the summary of toString if an interval has passed since the last summary.
+				 *  @param[in] interval the minimum time between summaries in seconds, or 0 to never log.
+				 */
+				void logSummaryIfDue(unsigned int interval);
+
+			private:
+				struct Race;
+				struct Workers;
+
+				HedgingAppVirtRequest(const HedgingAppVirtRequest &);
+				HedgingAppVirtRequest &operator=(const HedgingAppVirtRequest &);
+
+				bool launch(std::shared_ptr<Race> race, const std::string &uuid, bool hedge);
+				bool hasHedgeToken() const;
+				bool acquireHedgeToken();
+				void releaseHedgeToken();
+
+				std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest;
+				double percentile;
+				double maxRate;
+				unsigned int minDelay;
+				mutable std::mutex hedgeMutex;
+				double tokens;
+				LatencyWindow latencies;
+				std::shared_ptr<LatencyWindow> primaryLatencies;
+				std::shared_ptr<Workers> workers;
+				Statistics statistics;
+				std::chrono::steady_clock::time_point lastSummary;
+			};
+
+		}
+	}
+}
+
+#endif
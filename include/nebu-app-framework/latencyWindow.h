@@ -0,0 +1,55 @@
+
+#ifndef NEBUAPPFRAMEWORK_LATENCYWINDOW_H_
+#define NEBUAPPFRAMEWORK_LATENCYWINDOW_H_
+
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Keeps the most recent latencies of an operation to estimate its percentiles.
+			 *  Once the window is full, every new latency replaces the oldest one. A LatencyWindow is
+			 *  thread-safe.
+			 */
+			class LatencyWindow
+			{
+			public:
+				/** Creates an empty LatencyWindow.
+				 *  @param[in] capacity the number of latencies to keep.
+				 */
+				LatencyWindow(size_t capacity);
+				/** Empty destructor provided for inheritance. */
+				virtual ~LatencyWindow() { }
+
+				/** Adds a latency, replacing the oldest one if the window is full.
+				 *  @param[in] latency the latency in microseconds.
+				 */
+				void add(unsigned int latency);
+				/** Computes a percentile of the latencies in the window using the nearest rank method.
+				 *  @param[in] percentile the percentile, between 0 and 100.
+				 *  @return the latency in microseconds, or 0 if the window is empty.
+				 */
+				unsigned int getPercentile(double percentile) const;
+				/** Getter for the number of latencies in the window.
+				 *  @return the number of latencies, at most the capacity.
+				 */
+				size_t size() const;
+
+			private:
+				size_t capacity;
+				mutable std::mutex windowMutex;
+				std::vector<unsigned int> latencies;
+				size_t next;
+			};
+
+		}
+	}
+}
+
+#endif
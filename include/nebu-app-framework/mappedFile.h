@@ -0,0 +1,79 @@
+
+#ifndef NEBUAPPFRAMEWORK_MAPPEDFILE_H_
+#define NEBUAPPFRAMEWORK_MAPPEDFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** A file mapped read-only into memory.
+			 *  The mapping is private to the process and is released when the MappedFile is closed or destroyed.
+			 */
+			class MappedFile
+			{
+			public:
+				/** Creates a MappedFile without a mapping. */
+				MappedFile() : data(NULL), size(0) { }
+				/** Releases the mapping, if any. */
+				virtual ~MappedFile();
+
+				/** Maps a file into memory, replacing the current mapping.
+				 *  @param[in] filename the file to map.
+				 *  @return true iff the file was mapped, false if it does not exist, is empty or cannot be read.
+				 */
+				bool open(const std::string &filename);
+				/** Releases the mapping, if any. */
+				void close();
+
+				/** Getter for the mapped contents of the file.
+				 *  @return the first byte of the file, or NULL if no file is mapped.
+				 */
+				const char *getData() const
+				{
+					return this->data;
+				}
+				/** Getter for the size of the mapped file.
+				 *  @return the size in bytes, or 0 if no file is mapped.
+				 */
+				size_t getSize() const
+				{
+					return this->size;
+				}
+
+			private:
+				MappedFile(const MappedFile &);
+				MappedFile &operator=(const MappedFile &);
+
+				const char *data;
+				size_t size;
+			};
+
+			/** Writes a file atomically: the data is written to a temporary file in the same directory,
+			 *  flushed to disk and renamed over the target, so readers see either the old or the new contents.
+			 *  @param[in] filename the file to write.
+			 *  @param[in] data the contents of the file.
+			 *  @param[in] size the size of the contents in bytes.
+			 *  @return true iff the file was written.
+			 */
+			bool writeFileAtomically(const std::string &filename, const char *data, size_t size);
+
+			/** Computes the hash of the contents of a file (64-bit FNV-1a), to detect whether a file needs rewriting.
+			 *  The hash is stable across processes and builds, so it may also be stored in the file itself.
+			 *  @param[in] data the contents.
+			 *  @param[in] size the size of the contents in bytes.
+			 *  @return the hash.
+			 */
+			uint64_t hashContents(const char *data, size_t size);
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,116 @@
+
+#ifndef NEBUAPPFRAMEWORK_POOLEDRESTCLIENTADAPTER_H_
+#define NEBUAPPFRAMEWORK_POOLEDRESTCLIENTADAPTER_H_
+
+#include "nebu/restClientAdapter.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** RestClientAdapter keeping persistent HTTP/1.1 connections to the Nebu server.
+			 *  Connections are kept alive after a request and reused by later requests from any thread,
+			 *  which avoids a TCP handshake for every request. The number of open connections is limited
+			 *  by the pool size; requests wait for a connection when all of them are in use.
+			 *  Only plain <code>http://</code> URLs are pooled; other URLs are handled by the RestClientAdapter.
+			 */
+			class PooledRestClientAdapter : public nebu::common::RestClientAdapter
+			{
+			public:
+				/** Counters describing the use of the connection pool. */
+				struct Statistics
+				{
+					/** The number of requests sent over pooled connections. */
+					uint64_t requests;
+					/** The number of connections opened. */
+					uint64_t connectionsOpened;
+					/** The number of requests sent over a connection that was used before. */
+					uint64_t connectionsReused;
+				};
+
+				/** Creates a PooledRestClientAdapter without open connections.
+				 *  @param[in] poolSize the maximum number of open connections.
+				 *  @param[in] timeout the deadline of a request in milliseconds, covering waiting for a connection,
+				 *                     connecting, sending and receiving.
+				 */
+				PooledRestClientAdapter(unsigned int poolSize, unsigned int timeout);
+				/** Destructor, closes all idle connections. The adapter must not be in use. */
+				virtual ~PooledRestClientAdapter();
+
+				virtual RestClient::response get(const std::string &url);
+				virtual RestClient::response post(const std::string &url, const std::string &contentType,
+						const std::string &data);
+				virtual RestClient::response put(const std::string &url, const std::string &contentType,
+						const std::string &data);
+				virtual RestClient::response del(const std::string &url);
+
+				/** Sends an HTTP request over a pooled connection.
+				 *  Idle connections that the server has closed are discarded before a request is sent. If a
+				 *  reused connection is still closed by the server before answering, GET, HEAD and DELETE
+				 *  requests are retried once on a new connection; other requests fail. Requests that time out
+				 *  are never retried. Interim 1xx responses are skipped.
+				 *  @param[in] method the HTTP method.
+				 *  @param[in] url the URL, which must start with <code>http://</code>; IPv6 hosts are enclosed
+				 *                 in brackets.
+				 *  @param[in] contentType the content type of the data, or an empty string if there is none.
+				 *  @param[in] data the body of the request.
+				 *  @return the response; the code is -1 if no response was received.
+				 */
+				virtual RestClient::response request(const std::string &method, const std::string &url,
+						const std::string &contentType, const std::string &data);
+
+				/** Sets whether connections are kept open after a request (the default).
+				 *  @param[in] keepAlive false to close every connection after a single request.
+				 */
+				void setKeepAlive(bool keepAlive)
+				{
+					this->keepAlive = keepAlive;
+				}
+				/** Getter for the maximum number of open connections.
+				 *  @return the pool size.
+				 */
+				unsigned int getPoolSize() const
+				{
+					return this->poolSize;
+				}
+				/** Getter for the counters of the pool.
+				 *  @return the statistics.
+				 */
+				Statistics getStatistics() const;
+
+			private:
+				PooledRestClientAdapter(const PooledRestClientAdapter &);
+				PooledRestClientAdapter &operator=(const PooledRestClientAdapter &);
+
+				int acquireConnection(const std::string &host, const std::string &port,
+						std::chrono::steady_clock::time_point deadline, bool &reused);
+				void releaseConnection(const std::string &host, const std::string &port, int fd, bool reusable);
+				int connectTo(const std::string &host, const std::string &port,
+						std::chrono::steady_clock::time_point deadline) const;
+
+				unsigned int poolSize;
+				unsigned int timeout;
+				bool keepAlive;
+				mutable std::mutex poolMutex;
+				std::condition_variable available;
+				std::map<std::string, std::vector<int> > idle;
+				unsigned int openConnections;
+				Statistics statistics;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,196 @@
+
+#ifndef NEBUAPPFRAMEWORK_RESPONSECACHE_H_
+#define NEBUAPPFRAMEWORK_RESPONSECACHE_H_
+
+#include "nebu-app-framework/circuitBreaker.h"
+
+#include "nebu/util/exceptions.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+/** Number of cached responses above which expired responses are removed when a new response is stored. */
+#define RESPONSECACHE_PURGE_THRESHOLD 256
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Keeps responses of a single Nebu endpoint for a time to live, indexed by a key such as a UUID.
+			 *  Failed requests (a NebuServerException) are kept as well, for a separate and usually shorter
+			 *  time to live, so a failing endpoint is not queried again on every call. A cached failure is
+			 *  rethrown as a copy of the original exception. Requests rejected by a CircuitBreaker were never
+			 *  made, so they are not kept.
+			 *  Responses are fetched without holding the lock of the cache, so concurrent misses for the
+			 *  same key may each query the endpoint.
+			 */
+			template<typename Value>
+			class ResponseCache
+			{
+			public:
+				/** Function fetching a response from the endpoint. */
+				typedef std::function<Value()> Fetcher;
+
+				/** Counters describing the effectiveness of the cache. */
+				struct Statistics
+				{
+					/** The number of responses that were fetched from the endpoint. */
+					uint64_t misses;
+					/** The number of responses served from the cache. */
+					uint64_t hits;
+					/** The number of fetches that failed with a NebuServerException. */
+					uint64_t failures;
+					/** The number of cached failures that were rethrown. */
+					uint64_t negativeHits;
+				};
+
+				/** Creates a ResponseCache.
+				 *  @param[in] ttl the time to keep responses in milliseconds, or 0 to not keep them.
+				 *  @param[in] negativeTTL the time to keep failures in milliseconds, or 0 to not keep them.
+				 */
+				ResponseCache(unsigned int ttl, unsigned int negativeTTL) :
+						ttl(ttl), negativeTTL(negativeTTL), cacheMutex(), entries(),
+						purgeThreshold(RESPONSECACHE_PURGE_THRESHOLD), statistics()
+				{
+					this->statistics.misses = 0;
+					this->statistics.hits = 0;
+					this->statistics.failures = 0;
+					this->statistics.negativeHits = 0;
+				}
+				/** Empty destructor provided for inheritance. */
+				virtual ~ResponseCache() { }
+
+				/** Returns the cached response for a key, or fetches and caches it if none is available.
+				 *  @param[in] key the key identifying the response.
+				 *  @param[in] fetch the function fetching the response from the endpoint.
+				 *  @return the response.
+				 *  @throws NebuServerException if fetching the response failed, now or within the negative TTL.
+				 */
+				Value get(const std::string &key, const Fetcher &fetch)
+				{
+					std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+					{
+						std::lock_guard<std::mutex> lock(this->cacheMutex);
+						typename std::map<std::string, Entry>::iterator it = this->entries.find(key);
+						if (it != this->entries.end() && it->second.expires > now) {
+							if (it->second.failure) {
+								this->statistics.negativeHits++;
+								throw *it->second.failure;
+							}
+							this->statistics.hits++;
+							return *it->second.value;
+						}
+						this->statistics.misses++;
+					}
+
+					Entry entry;
+					try {
+						entry.value = std::make_shared<Value>(fetch());
+					} catch (CircuitOpenException &) {
+						throw;
+					} catch (nebu::common::NebuServerException &ex) {
+						std::lock_guard<std::mutex> lock(this->cacheMutex);
+						this->statistics.failures++;
+						if (this->negativeTTL.count() > 0) {
+							entry.failure = std::make_shared<nebu::common::NebuServerException>(ex);
+							entry.expires = std::chrono::steady_clock::now() + this->negativeTTL;
+							this->store(key, entry);
+						} else {
+							this->entries.erase(key);
+						}
+						throw;
+					}
+
+					if (this->ttl.count() > 0) {
+						std::lock_guard<std::mutex> lock(this->cacheMutex);
+						entry.expires = std::chrono::steady_clock::now() + this->ttl;
+						this->store(key, entry);
+					}
+					return *entry.value;
+				}
+
+				/** Removes the cached response or failure for a key.
+				 *  @param[in] key the key identifying the response.
+				 */
+				void invalidate(const std::string &key)
+				{
+					std::lock_guard<std::mutex> lock(this->cacheMutex);
+					this->entries.erase(key);
+				}
+				/** Removes all cached responses and failures. */
+				void clear()
+				{
+					std::lock_guard<std::mutex> lock(this->cacheMutex);
+					this->entries.clear();
+				}
+
+				/** Getter for the time responses are kept.
+				 *  @return the time to live in milliseconds.
+				 */
+				unsigned int getTTL() const
+				{
+					return this->ttl.count();
+				}
+				/** Getter for the time failures are kept.
+				 *  @return the time to live in milliseconds.
+				 */
+				unsigned int getNegativeTTL() const
+				{
+					return this->negativeTTL.count();
+				}
+				/** Getter for the counters of the cache.
+				 *  @return the statistics.
+				 */
+				Statistics getStatistics() const
+				{
+					std::lock_guard<std::mutex> lock(this->cacheMutex);
+					return this->statistics;
+				}
+
+			private:
+				struct Entry
+				{
+					std::shared_ptr<Value> value;
+					std::shared_ptr<nebu::common::NebuServerException> failure;
+					std::chrono::steady_clock::time_point expires;
+				};
+
+				void store(const std::string &key, const Entry &entry)
+				{
+					if (this->entries.size() >= this->purgeThreshold) {
+						std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+						for (typename std::map<std::string, Entry>::iterator it = this->entries.begin();
+								it != this->entries.end(); ) {
+							if (it->second.expires <= now) {
+								this->entries.erase(it++);
+							} else {
+								it++;
+							}
+						}
+						this->purgeThreshold = std::max<size_t>(RESPONSECACHE_PURGE_THRESHOLD, 2 * this->entries.size());
+					}
+					this->entries[key] = entry;
+				}
+
+				std::chrono::milliseconds ttl;
+				std::chrono::milliseconds negativeTTL;
+				mutable std::mutex cacheMutex;
+				std::map<std::string, Entry> entries;
+				size_t purgeThreshold;
+				Statistics statistics;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,98 @@
+
+#ifndef NEBUAPPFRAMEWORK_SHELLWORKERPOOL_H_
+#define NEBUAPPFRAMEWORK_SHELLWORKERPOOL_H_
+
+#include "nebu-app-framework/command.h"
+#include "nebu-app-framework/commandResult.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** A pool of long-lived shell processes executing commands sent to them over a pipe.
+			 *  Every command is written to the standard input of an idle worker, evaluated in a subshell, and
+			 *  followed by a marker line on the standard output and error carrying its exit code. This saves
+			 *  the process creation and shell startup of every command, which dominates the cost of small commands.
+			 *  The exit code is reported as the shell sees it, so a command killed by signal N exits with 128 + N
+			 *  instead of being reported as signaled.
+			 *  Commands with a timeout, a custom environment or uncaptured output are not suitable for workers (see
+			 *  canExecute), the latter because their output would only be seen once they have completed.
+			 *  When a worker cannot accept a command it is replaced and the command is spawned as a separate process;
+			 *  a worker that dies while running a command reports the command as failed.
+			 */
+			class ShellWorkerPool
+			{
+			public:
+				/** Counters describing the use of the pool. */
+				struct Statistics
+				{
+					/** The number of commands executed by workers. */
+					uint64_t executed;
+					/** The number of worker processes started. */
+					uint64_t workersStarted;
+					/** The number of commands spawned as separate processes because no worker could run them. */
+					uint64_t fallbacks;
+				};
+
+				/** Creates a pool of workers, which are started when they are first needed.
+				 *  @param[in] size the maximum number of workers.
+				 */
+				ShellWorkerPool(unsigned int size);
+				/** Destructor, terminates all workers. The pool must not be in use. */
+				virtual ~ShellWorkerPool();
+
+				/** Checks if a Command can be executed by a worker.
+				 *  @param[in] command the Command to check.
+				 *  @return true iff the Command has no timeout and no custom environment, and captures its output.
+				 */
+				virtual bool canExecute(const Command &command) const;
+				/** Executes a Command on an idle worker, waiting for one to become available if needed.
+				 *  @param[in] command the Command to execute, for which canExecute must hold.
+				 *  @param[out] result the result of the Command, cleared before execution.
+				 */
+				virtual void execute(const Command &command, CommandResult &result);
+
+				/** Getter for the maximum number of workers.
+				 *  @return the size of the pool.
+				 */
+				unsigned int getSize() const
+				{
+					return this->size;
+				}
+				/** Getter for the counters of the pool.
+				 *  @return the statistics.
+				 */
+				Statistics getStatistics() const;
+
+			private:
+				class Worker;
+
+				ShellWorkerPool(const ShellWorkerPool &);
+				ShellWorkerPool &operator=(const ShellWorkerPool &);
+
+				std::unique_ptr<Worker> acquire();
+				void release(std::unique_ptr<Worker> worker);
+
+				unsigned int size;
+				mutable std::mutex poolMutex;
+				std::condition_variable available;
+				std::vector<std::unique_ptr<Worker> > idle;
+				unsigned int busy;
+				Statistics statistics;
+			};
+
+		}
+	}
+}
+
+#endif
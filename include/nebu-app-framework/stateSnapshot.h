@@ -0,0 +1,125 @@
+
+#ifndef NEBUAPPFRAMEWORK_STATESNAPSHOT_H_
+#define NEBUAPPFRAMEWORK_STATESNAPSHOT_H_
+
+#include "nebu-app-framework/daemon.h"
+
+#include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			class DaemonCollection;
+			class TopologyManager;
+			class VMManager;
+
+			/** A compact copy of the state of the framework, used to start warm after a restart.
+			 *  The snapshot holds the VMs known to the VMManager, the physical topology and the launch state of
+			 *  the Daemons. It is written atomically and loaded through a read-only memory mapping; a snapshot that
+			 *  is truncated, corrupt or written by an incompatible version is rejected as a whole.
+			 */
+			class StateSnapshot
+			{
+			public:
+				/** A VM in the snapshot, with the number of refreshes since its status last changed. */
+				struct VMRecord
+				{
+					/** The VM. */
+					std::shared_ptr<nebu::common::VirtualMachine> vm;
+					/** The number of refreshes since the status of the VM last changed. */
+					unsigned int unchangedPolls;
+				};
+
+				/** The launch state of a Daemon in the snapshot. */
+				struct DaemonRecord
+				{
+					/** The unique ID of the VM hosting the Daemon. */
+					std::string vmUUID;
+					/** The type of the Daemon. */
+					DaemonType type;
+					/** Whether the Daemon had launched. */
+					bool launched;
+				};
+
+				/** Creates an empty snapshot. */
+				StateSnapshot() : vms(), topology(), daemons() { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~StateSnapshot() { }
+
+				/** Replaces the contents of the snapshot by the current state of the framework.
+				 *  @param[in] vmManager the VMManager to copy the VMs from.
+				 *  @param[in] topologyManager the TopologyManager to copy the topology from.
+				 *  @param[in] daemonCollection the DaemonCollection to copy the launch states from.
+				 */
+				virtual void capture(const VMManager &vmManager, const TopologyManager &topologyManager,
+						DaemonCollection &daemonCollection);
+				/** Writes the snapshot to a file, replacing it atomically.
+				 *  @param[in] filename the file to write.
+				 *  @return true iff the snapshot was written.
+				 */
+				virtual bool save(const std::string &filename) const;
+				/** Writes the snapshot to a file like save, unless the file exists and was last written with the
+				 *  same contents, which saves rewriting and syncing an unchanged snapshot.
+				 *  @param[in] filename the file to write.
+				 *  @param[in,out] lastChecksum the checksum of the contents last written to the file, or 0 if they are
+				 *                              unknown; updated when the file is written.
+				 *  @return true iff the file holds the snapshot.
+				 */
+				virtual bool saveIfChanged(const std::string &filename, uint64_t &lastChecksum) const;
+				/** Replaces the contents of the snapshot by those of a file.
+				 *  @param[in] filename the file to load.
+				 *  @return true iff the file exists and holds a valid snapshot; otherwise the snapshot is empty.
+				 */
+				virtual bool load(const std::string &filename);
+
+				/** Getter for the VMs in the snapshot.
+				 *  @return the VMs, ordered by unique ID.
+				 */
+				const std::vector<VMRecord> &getVMs() const
+				{
+					return this->vms;
+				}
+				/** Getter for the physical topology in the snapshot.
+				 *  @return the root of the topology, or an empty pointer if the snapshot is empty.
+				 */
+				std::shared_ptr<nebu::common::PhysicalRoot> getTopology() const
+				{
+					return this->topology;
+				}
+				/** Getter for the launch states of the Daemons in the snapshot.
+				 *  @return the launch states.
+				 */
+				const std::vector<DaemonRecord> &getDaemons() const
+				{
+					return this->daemons;
+				}
+
+				/** The version of the file format written by save. */
+				static const uint32_t VERSION;
+
+			private:
+				std::string serialise() const;
+				bool write(const std::string &filename, const std::string &payload, uint64_t payloadChecksum) const;
+				bool deserialise(const char *data, size_t size);
+				void clear();
+
+				std::vector<VMRecord> vms;
+				std::shared_ptr<nebu::common::PhysicalRoot> topology;
+				std::vector<DaemonRecord> daemons;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,153 @@
+
+#ifndef NEBUAPPFRAMEWORK_TOPOLOGYFORMAT_H_
+#define NEBUAPPFRAMEWORK_TOPOLOGYFORMAT_H_
+
+#include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Interface of an output format of the TopologyWriter.
+			 *  A format renders one file from a single pass over the VMs: begin is called once, followed by a
+			 *  call to addVM for every VM whose host is part of the topology, in order, and a call to end.
+			 *  Formats may keep state between begin and end, but are only used by one writer at a time.
+			 */
+			class TopologyFormat
+			{
+			public:
+				/** The physical location of a VM. */
+				struct Location
+				{
+					/** The ID of the data center. */
+					std::string dataCenter;
+					/** The ID of the rack. */
+					std::string rack;
+					/** The ID of the host. */
+					std::string host;
+					/** The network location "/dataCenter/rack/host". */
+					std::string path;
+				};
+
+				/** Empty destructor provided for inheritance. */
+				virtual ~TopologyFormat() { }
+
+				/** Starts rendering a file.
+				 *  @param[in] topology the physical topology hosting the virtualised application.
+				 *  @param[out] output the buffer receiving the file.
+				 */
+				virtual void begin(std::shared_ptr<nebu::common::PhysicalRoot> topology, std::string &output) = 0;
+				/** Renders a VM.
+				 *  @param[in] vm the VM.
+				 *  @param[in] location the location of the host of the VM.
+				 *  @param[out] output the buffer receiving the file.
+				 */
+				virtual void addVM(const std::shared_ptr<nebu::common::VirtualMachine> &vm, const Location &location,
+						std::string &output) = 0;
+				/** Finishes rendering a file.
+				 *  @param[out] output the buffer receiving the file.
+				 */
+				virtual void end(std::string &output) = 0;
+			};
+
+			/** Text format mapping hostnames to network locations, one "hostname\t/dataCenter/rack/host" line
+			 *  per VM.
+			 */
+			class TextTopologyFormat : public TopologyFormat
+			{
+			public:
+				/** Empty destructor provided for inheritance. */
+				virtual ~TextTopologyFormat() { }
+
+				virtual void begin(std::shared_ptr<nebu::common::PhysicalRoot> topology, std::string &output);
+				virtual void addVM(const std::shared_ptr<nebu::common::VirtualMachine> &vm, const Location &location,
+						std::string &output);
+				virtual void end(std::string &output);
+			};
+
+			/** Format of the table file used by the Hadoop TableMapping (<code>net.topology.table.file.name</code>),
+			 *  with one "name /dataCenter/rack/host" line for the hostname and for every address of a VM.
+			 */
+			class HadoopTableTopologyFormat : public TopologyFormat
+			{
+			public:
+				/** Function returning the IP addresses of a VM. */
+				typedef std::function<std::vector<std::string>(const nebu::common::VirtualMachine &)> AddressResolver;
+
+				/** Creates a format keyed by hostname only. */
+				HadoopTableTopologyFormat() : addressResolver() { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~HadoopTableTopologyFormat() { }
+
+				/** Sets the function used to look up the IP addresses of VMs, which are added to the table
+				 *  alongside their hostnames. VMs do not carry their addresses, so these are typically looked up
+				 *  by the application, e.g., in DNS or its own inventory.
+				 *  @param[in] addressResolver the function, or an empty function to only list hostnames.
+				 */
+				void setAddressResolver(AddressResolver addressResolver)
+				{
+					this->addressResolver = addressResolver;
+				}
+
+				virtual void begin(std::shared_ptr<nebu::common::PhysicalRoot> topology, std::string &output);
+				virtual void addVM(const std::shared_ptr<nebu::common::VirtualMachine> &vm, const Location &location,
+						std::string &output);
+				virtual void end(std::string &output);
+
+			private:
+				AddressResolver addressResolver;
+			};
+
+			/** JSON format, an object with a "vms" array holding the hostname, UUID, data center, rack and host
+			 *  of every VM.
+			 */
+			class JsonTopologyFormat : public TopologyFormat
+			{
+			public:
+				/** Creates a JSON format. */
+				JsonTopologyFormat() : first(true) { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~JsonTopologyFormat() { }
+
+				virtual void begin(std::shared_ptr<nebu::common::PhysicalRoot> topology, std::string &output);
+				virtual void addVM(const std::shared_ptr<nebu::common::VirtualMachine> &vm, const Location &location,
+						std::string &output);
+				virtual void end(std::string &output);
+
+			private:
+				bool first;
+			};
+
+			/** Binary format, a TopologyImage of the topology and the VMs, for lookups without parsing. */
+			class BinaryTopologyFormat : public TopologyFormat
+			{
+			public:
+				/** Creates a binary format. */
+				BinaryTopologyFormat() : topology(), vms() { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~BinaryTopologyFormat() { }
+
+				virtual void begin(std::shared_ptr<nebu::common::PhysicalRoot> topology, std::string &output);
+				virtual void addVM(const std::shared_ptr<nebu::common::VirtualMachine> &vm, const Location &location,
+						std::string &output);
+				virtual void end(std::string &output);
+
+			private:
+				std::shared_ptr<nebu::common::PhysicalRoot> topology;
+				std::vector<std::shared_ptr<nebu::common::VirtualMachine>> vms;
+			};
+
+		}
+	}
+}
+
+#endif
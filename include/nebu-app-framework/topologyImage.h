@@ -0,0 +1,225 @@
+
+#ifndef NEBUAPPFRAMEWORK_TOPOLOGYIMAGE_H_
+#define NEBUAPPFRAMEWORK_TOPOLOGYIMAGE_H_
+
+#include "nebu-app-framework/mappedFile.h"
+
+#include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Header of a topology image.
+			 *  An image consists of the header followed by dense arrays of data centers, racks, hosts, a host index
+			 *  sorted by host ID, VMs sorted by hostname and a string table. All fields are 32-bit values in the
+			 *  byte order of the writer. Strings are stored as offsets into the string table and nodes refer to
+			 *  each other by array index, so an image can be used at any address, e.g., through mmap.
+			 */
+			struct TopologyImageHeader
+			{
+				/** The characters "NEBUTOPO". */
+				char magic[8];
+				/** The version of the format. */
+				uint32_t version;
+				/** The size of this header in bytes. */
+				uint32_t headerSize;
+				/** The number of data centers. */
+				uint32_t dataCenterCount;
+				/** The number of racks. */
+				uint32_t rackCount;
+				/** The number of hosts. */
+				uint32_t hostCount;
+				/** The number of VMs. */
+				uint32_t vmCount;
+				/** The offset of the data center array. */
+				uint32_t dataCenterOffset;
+				/** The offset of the rack array. */
+				uint32_t rackOffset;
+				/** The offset of the host array. */
+				uint32_t hostOffset;
+				/** The offset of the host index, an array of host indices sorted by host ID. */
+				uint32_t hostIndexOffset;
+				/** The offset of the VM array. */
+				uint32_t vmOffset;
+				/** The offset of the string table. */
+				uint32_t stringOffset;
+				/** The size of the string table, which ends with a null character. */
+				uint32_t stringSize;
+				/** The ID of the root of the topology. */
+				uint32_t rootID;
+			};
+
+			/** A data center in a topology image, whose racks are stored consecutively. */
+			struct TopologyImageDataCenter
+			{
+				/** The ID of the data center. */
+				uint32_t id;
+				/** The index of the first rack. */
+				uint32_t firstRack;
+				/** The number of racks. */
+				uint32_t rackCount;
+			};
+
+			/** A rack in a topology image, whose hosts are stored consecutively. */
+			struct TopologyImageRack
+			{
+				/** The ID of the rack. */
+				uint32_t id;
+				/** The index of the data center containing the rack. */
+				uint32_t dataCenter;
+				/** The index of the first host. */
+				uint32_t firstHost;
+				/** The number of hosts. */
+				uint32_t hostCount;
+			};
+
+			/** A host in a topology image. */
+			struct TopologyImageHost
+			{
+				/** The ID of the host. */
+				uint32_t id;
+				/** The index of the rack containing the host. */
+				uint32_t rack;
+			};
+
+			/** A VM in a topology image. */
+			struct TopologyImageVM
+			{
+				/** The unique ID of the VM. */
+				uint32_t uuid;
+				/** The hostname of the VM. */
+				uint32_t hostname;
+				/** The index of the host of the VM, or TopologyImage::NO_HOST if it is not in the topology. */
+				uint32_t host;
+				/** The status of the VM: 0 for unknown, 1 for on and 2 for off. */
+				uint32_t status;
+			};
+
+			/** A read-only, position-independent binary representation of the physical topology and the
+			 *  placement of VMs.
+			 *  An image is built from the topology tree, and can be opened from memory or mapped from a file
+			 *  without parsing. Lookups of hosts and VMs are binary searches in the image, and return pointers
+			 *  into it that remain valid while the image is open.
+			 */
+			class TopologyImage
+			{
+			public:
+				/** The location of a host or VM in the topology. */
+				struct Location
+				{
+					/** The ID of the data center. */
+					const char *dataCenter;
+					/** The ID of the rack. */
+					const char *rack;
+					/** The ID of the host. */
+					const char *host;
+				};
+
+				/** Creates a TopologyImage that is not open. */
+				TopologyImage() : file(), data(NULL), size(0) { }
+				/** Empty destructor provided for inheritance. */
+				virtual ~TopologyImage() { }
+
+				/** Builds an image of a topology and the placement of VMs.
+				 *  @param[in] topology the physical topology.
+				 *  @param[in] vms the VMs to include.
+				 *  @return the image.
+				 */
+				static std::string build(std::shared_ptr<nebu::common::PhysicalRoot> topology,
+						const std::vector<std::shared_ptr<nebu::common::VirtualMachine>> &vms);
+
+				/** Opens an image in memory, which must remain valid and unchanged while the image is open.
+				 *  @param[in] data the first byte of the image, aligned to 4 bytes.
+				 *  @param[in] size the size of the image in bytes.
+				 *  @return true iff the memory holds a valid image.
+				 */
+				bool open(const char *data, size_t size);
+				/** Opens an image by mapping a file read-only.
+				 *  @param[in] filename the file holding the image.
+				 *  @return true iff the file holds a valid image.
+				 */
+				bool load(const std::string &filename);
+				/** Closes the image. */
+				void close();
+				/** Checks whether an image is open.
+				 *  @return true iff an image is open.
+				 */
+				bool isOpen() const
+				{
+					return this->data != NULL;
+				}
+
+				/** Getter for the ID of the root of the topology.
+				 *  @return the ID.
+				 */
+				const char *getRootID() const;
+				/** Getter for the number of data centers in the image.
+				 *  @return the number of data centers.
+				 */
+				uint32_t getDataCenterCount() const;
+				/** Getter for the number of racks in the image.
+				 *  @return the number of racks.
+				 */
+				uint32_t getRackCount() const;
+				/** Getter for the number of hosts in the image.
+				 *  @return the number of hosts.
+				 */
+				uint32_t getHostCount() const;
+				/** Getter for the number of VMs in the image.
+				 *  @return the number of VMs.
+				 */
+				uint32_t getVMCount() const;
+
+				/** Finds the location of a host.
+				 *  @param[in] hostID the unique ID of the host.
+				 *  @param[out] location the location of the host.
+				 *  @return true iff the host was found.
+				 */
+				bool findHost(const std::string &hostID, Location &location) const;
+				/** Finds the location of the host of a VM.
+				 *  @param[in] hostname the hostname of the VM.
+				 *  @param[out] location the location of the host of the VM.
+				 *  @return true iff the VM was found and its host is part of the topology.
+				 */
+				bool findVM(const std::string &hostname, Location &location) const;
+				/** Creates a topology tree from the image.
+				 *  @return the root of the topology, or an empty pointer if no image is open.
+				 */
+				std::shared_ptr<nebu::common::PhysicalRoot> toTopology() const;
+
+				/** The version of the format written by build. */
+				static const uint32_t VERSION;
+				/** The host index of a VM that is not part of the topology. */
+				static const uint32_t NO_HOST;
+
+			private:
+				TopologyImage(const TopologyImage &);
+				TopologyImage &operator=(const TopologyImage &);
+
+				bool attach(const char *data, size_t size);
+				bool validate() const;
+				const TopologyImageHeader *getHeader() const;
+				const char *getString(uint32_t offset) const;
+				template<class T> const T *getArray(uint32_t offset) const;
+				void getLocation(uint32_t host, Location &location) const;
+
+				MappedFile file;
+				const char *data;
+				size_t size;
+			};
+
+		}
+	}
+}
+
+#endif
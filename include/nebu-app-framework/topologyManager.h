@@ -7,8 +7,11 @@
 #include "nebu/topology/physicalHost.h"
 #include "nebu/topology/physicalRack.h"
 #include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
 
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace nebu
 {
@@ -32,6 +35,24 @@ namespace nebu
 				 *  @return true iff the refresh succeeded.
 				 */
 				virtual bool refreshTopology();
+				/** Replaces the topology by one from a previous run of the application, until the next refresh.
+				 *  @param[in] physicalRoot the root of the topology; an empty pointer is ignored.
+				 */
+				virtual void restoreTopology(std::shared_ptr<nebu::common::PhysicalRoot> physicalRoot);
+				/** Writes the topology and the placement of VMs as a TopologyImage, replacing the file atomically.
+				 *  The write is skipped if the image is identical to the last one written to the same file,
+				 *  as long as that file still exists.
+				 *  @param[in] filename the file to write.
+				 *  @param[in] vms the VMs to include in the image.
+				 *  @return true iff the image was written or the file already holds it.
+				 */
+				virtual bool writeImage(const std::string &filename,
+						const std::vector<std::shared_ptr<nebu::common::VirtualMachine>> &vms) const;
+				/** Replaces the topology by the one in a TopologyImage, until the next refresh.
+				 *  @param[in] filename the file holding the image.
+				 *  @return true iff the file holds a valid image.
+				 */
+				virtual bool loadImage(const std::string &filename);
 
 				/** Getter for the root of the physical topology.
 				 *  @return the PhysicalRoot of the topology.
@@ -74,6 +95,8 @@ namespace nebu
 			private:
 				std::shared_ptr<nebu::common::AppPhysRequest> appPhysRequest;
 				std::shared_ptr<nebu::common::PhysicalRoot> physicalRoot;
+				mutable std::string lastImageFilename;
+				mutable uint64_t lastImageHash;
 
 				std::shared_ptr<nebu::common::PhysicalHost> findHost(
 						std::shared_ptr<nebu::common::PhysicalDataCenter> haystack, const std::string &hostID) const;
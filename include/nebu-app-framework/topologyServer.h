@@ -0,0 +1,197 @@
+
+#ifndef NEBUAPPFRAMEWORK_TOPOLOGYSERVER_H_
+#define NEBUAPPFRAMEWORK_TOPOLOGYSERVER_H_
+
+#include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Serves rack resolution for VMs over a Unix domain socket, e.g., for a Hadoop topology script.
+			 *  A request frame is a 32-bit length in network byte order followed by that many bytes of queries,
+			 *  each a 16-bit length in network byte order followed by a hostname or IP address. The response
+			 *  frame has the same layout and holds the location "/dataCenter/rack/host" of every query in order,
+			 *  or an empty string for unknown names. Clients may send several frames on one connection and
+			 *  receive the responses in the same order.
+			 *
+			 *  Queries are answered on a single thread multiplexing all clients with epoll, from an in-memory
+			 *  index that is replaced as a whole on every update. Requests from a client are not read while
+			 *  several megabytes of its responses are unsent.
+			 */
+			class TopologyServer
+			{
+			public:
+				/** Function returning the IP addresses of a hostname, or none if they could not be looked up. */
+				typedef std::function<std::vector<std::string>(const std::string &)> AddressLookup;
+
+				/** Creates a server for the given socket. The server is not started.
+				 *  @param[in] socketPath the path of the Unix domain socket.
+				 */
+				TopologyServer(const std::string &socketPath);
+				/** Destructor, stops the server if it is running and waits for the address lookup in progress. */
+				virtual ~TopologyServer();
+
+				/** Creates the socket, replacing a stale socket with the same path, and starts serving queries
+				 *  on a background thread.
+				 *  @return true iff the server is running.
+				 */
+				virtual bool start();
+				/** Stops serving queries, closes all connections and removes the socket. */
+				virtual void stop();
+				/** Checks if the server thread is running.
+				 *  @return true iff the server is running.
+				 */
+				virtual bool isRunning() const
+				{
+					return this->server.joinable();
+				}
+
+				/** Enables adding the IP addresses of VMs to the index. Addresses are looked up on a background
+				 *  thread, only for hostnames that are new since the last update, and are added to the index as
+				 *  their lookups complete. Lookups that fail or find no address are retried by later updates, with
+				 *  exponential backoff.
+				 *  @param[in] resolveAddresses whether to index the IP addresses of VMs.
+				 */
+				void setResolveAddresses(bool resolveAddresses)
+				{
+					this->resolveAddresses = resolveAddresses;
+				}
+				/** Sets the function used to look up the IP addresses of VMs, which defaults to the system
+				 *  resolver. It is called on the background thread and must be set before the first update.
+				 *  @param[in] addressLookup the function.
+				 */
+				void setAddressLookup(AddressLookup addressLookup)
+				{
+					this->addressLookup = addressLookup;
+				}
+
+				/** Replaces the index with the locations of the given VMs.
+				 *  VMs whose host is not part of the topology, or without a hostname, are not indexed.
+				 *  @param[in] topology the physical topology.
+				 *  @param[in] vms the VMs to index.
+				 */
+				virtual void update(std::shared_ptr<nebu::common::PhysicalRoot> topology,
+						const std::vector<std::shared_ptr<nebu::common::VirtualMachine>> &vms);
+				/** Resolves a hostname or IP address using the current index.
+				 *  @param[in] name the hostname or IP address of a VM.
+				 *  @param[out] path the location "/dataCenter/rack/host" of the VM.
+				 *  @return true iff the name was found.
+				 */
+				bool resolve(const std::string &name, std::string &path) const;
+
+				/** Getter for the number of names in the current index.
+				 *  @return the number of names.
+				 */
+				size_t getIndexSize() const;
+				/** Getter for the number of queries answered since the server was created.
+				 *  @return the number of queries.
+				 */
+				uint64_t getQueryCount() const
+				{
+					return this->queries.load();
+				}
+
+				/** The largest request frame accepted, in bytes; clients sending larger frames are disconnected. */
+				static const uint32_t MAX_FRAME_SIZE;
+
+			private:
+				TopologyServer(const TopologyServer &);
+				TopologyServer &operator=(const TopologyServer &);
+
+				typedef std::unordered_map<std::string, std::string> Index;
+				struct Connection;
+
+				// The addresses of a hostname, and the state of their lookup
+				struct Addresses
+				{
+					std::vector<std::string> values;
+					bool queued;
+					unsigned int failures;
+					std::chrono::steady_clock::time_point retry;
+
+					Addresses() : values(), queued(false), failures(0), retry() { }
+				};
+
+				std::shared_ptr<const Index> getIndex() const;
+				void resolveLoop();
+				void stopResolver();
+				void serveLoop();
+				void acceptConnections(std::unordered_map<int, Connection> &connections);
+				bool receive(int fd, Connection &connection);
+				bool answerFrames(Connection &connection);
+				bool send(int fd, Connection &connection);
+				bool answer(const char *request, uint32_t size, std::string &response, std::string &key);
+
+				std::string socketPath;
+				bool resolveAddresses;
+				int listenFd;
+				int epollFd;
+				int stopFd;
+				std::thread server;
+				mutable std::mutex indexMutex;
+				std::shared_ptr<const Index> index;
+				std::atomic<uint64_t> queries;
+				// Guards the addresses and the lookup queue, and orders the replacements of the index
+				std::mutex updateMutex;
+				std::condition_variable resolverCondition;
+				std::thread resolver;
+				bool resolverStopping;
+				AddressLookup addressLookup;
+				std::unordered_map<std::string, Addresses> addresses;
+				std::deque<std::string> pending;
+			};
+
+			/** Client for a TopologyServer, keeping a single connection open between queries. */
+			class TopologyClient
+			{
+			public:
+				/** Creates a client for the given socket. The client connects on the first query.
+				 *  @param[in] socketPath the path of the Unix domain socket of the server.
+				 */
+				TopologyClient(const std::string &socketPath);
+				/** Destructor, closes the connection. */
+				virtual ~TopologyClient();
+
+				/** Resolves a batch of hostnames or IP addresses in a single round trip.
+				 *  @param[in] names the hostnames or IP addresses, each at most 65535 bytes.
+				 *  @param[out] paths the location of every name in order, or an empty string for unknown names.
+				 *  @return true iff the server answered; the connection is closed otherwise.
+				 */
+				bool resolve(const std::vector<std::string> &names, std::vector<std::string> &paths);
+				/** Closes the connection, if any. */
+				void close();
+
+			private:
+				TopologyClient(const TopologyClient &);
+				TopologyClient &operator=(const TopologyClient &);
+
+				bool connect();
+
+				std::string socketPath;
+				int fd;
+				std::string buffer;
+			};
+
+		}
+	}
+}
+
+#endif
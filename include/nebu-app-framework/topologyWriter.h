@@ -2,9 +2,15 @@
 #ifndef NEBUAPPFRAMEWORK_TOPOLOGYWRITER_H_
 #define NEBUAPPFRAMEWORK_TOPOLOGYWRITER_H_
 
+#include "nebu-app-framework/topologyFormat.h"
+
 #include "nebu/topology/physicalRoot.h"
 #include "nebu/virtualMachine.h"
 
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace nebu
@@ -14,30 +20,63 @@ namespace nebu
 		namespace framework
 		{
 
-			/** Utility class used to output the topology to a file. */
+			/** Utility class used to output the topology to one or more files.
+			 *  Every file has its own TopologyFormat, and all files are rendered from a single pass over the VMs.
+			 *  Files are replaced atomically, so readers never observe a partially written file, and are only
+			 *  rewritten when their contents change. The location of every host is computed once and kept for as
+			 *  long as the topology holds the same hosts in the same places, whether or not it is the same object,
+			 *  and files are rendered into buffers that are reused across writes, so a write costs one lookup per
+			 *  VM and one per host.
+			 */
 			class TopologyWriter
 			{
 			public:
-				/** Empty constructor. */
-				TopologyWriter() { }
+				/** Creates a writer with a TextTopologyFormat output, whose filename is set through
+				 *  \link setFilename(const std::string &) setFilename \endlink.
+				 */
+				TopologyWriter();
 				/** Empty destructor provided for inheritance. */
 				virtual ~TopologyWriter() { }
 
-				/** Writes a mapping from hostname to physical location to a file.
-				 *  Uses the filename specified through \link setFilename(const std::string &) setFilename \endlink
+				/** Writes a mapping from hostname to physical location to every output file.
+				 *  The text output uses the filename specified through
+				 *  \link setFilename(const std::string &) setFilename \endlink. Outputs without a filename are
+				 *  skipped, and files are not touched if their contents are the same as the last ones written.
 				 *  @param[in] topology the physical topology hosting the virtualised application.
 				 *  @param[in] vms a vector of VirtualMachines to map to the topology.
 				 */
 				virtual void write(std::shared_ptr<nebu::common::PhysicalRoot> topology,
 						std::vector<std::shared_ptr<nebu::common::VirtualMachine>> vms);
 
-				/** Sets a filename for use by the writer.
-				 *  @param filename the filename to set.
+				/** Sets a filename for use by the text output.
+				 *  @param filename the filename to set, or an empty string to disable the text output.
 				 */
 				virtual void setFilename(const std::string &filename);
+				/** Adds an output file in another format.
+				 *  @param[in] filename the file to write.
+				 *  @param[in] format the format of the file.
+				 */
+				virtual void addOutput(const std::string &filename, std::shared_ptr<TopologyFormat> format);
 
 			protected:
+				/** The filename of the text output, which subclasses may change between writes. */
 				std::string filename;
+
+			private:
+				struct Output
+				{
+					std::string filename;
+					std::shared_ptr<TopologyFormat> format;
+					std::string buffer;
+					uint64_t contentHash;
+					bool written;
+				};
+
+				bool isIndexed(std::shared_ptr<nebu::common::PhysicalRoot> topology) const;
+				void indexHosts(std::shared_ptr<nebu::common::PhysicalRoot> topology);
+
+				std::vector<Output> outputs;
+				std::unordered_map<std::string, TopologyFormat::Location> hostLocations;
 			};
 
 		}
@@ -7,6 +7,7 @@
 #include "nebu/appVirtRequest.h"
 #include "nebu/virtualMachine.h"
 
+#include <chrono>
 #include <list>
 #include <memory>
 #include <string>
@@ -20,22 +21,97 @@ namespace nebu
 		namespace framework
 		{
 
-			/** Manages the list and states of VirtualMachines in the application. */
+			/** Manages the list and states of VirtualMachines in the application.
+			 *  By default, every known VM is refreshed in every call to refreshVMList. With a refresh policy
+			 *  (see setRefreshPolicy), only VMs that changed recently are refreshed every time, while stable
+			 *  VMs are refreshed round-robin within a budget, so the number of requests to the Nebu middleware
+			 *  scales with the churn rather than the number of VMs. VMs that disappear from the list of VM
+			 *  identifiers are always removed immediately.
+			 */
 			class VMManager
 			{
 			public:
+				/** Metadata kept for every VirtualMachine to decide how often it is refreshed. */
+				struct RefreshState
+				{
+					/** The time the status of the VM last changed, or the VM was detected. */
+					std::chrono::steady_clock::time_point lastChange;
+					/** The last known status of the VM. */
+					nebu::common::VMStatus status;
+					/** The number of consecutive refreshes in which the status of the VM did not change. */
+					unsigned int unchangedPolls;
+				};
+
+				/** Failure tracking kept for every VM identifier for which the last request failed. */
+				struct FailureState
+				{
+					/** Creates the state of a VM without failures. */
+					FailureState() : consecutiveFailures(0), skipRefreshes(0), quarantined(false), lastError() { }
+
+					/** The number of consecutive failed requests for the VM. */
+					unsigned int consecutiveFailures;
+					/** The number of refreshes in which the VM is not requested before it is retried. */
+					unsigned int skipRefreshes;
+					/** Whether the VM is quarantined. */
+					bool quarantined;
+					/** The error of the last failed request. */
+					std::string lastError;
+				};
+
+				/** The outcome of the last call to refreshVMList. */
+				struct RefreshStatistics
+				{
+					/** Creates empty statistics. */
+					RefreshStatistics() : listed(false), circuitOpen(false), requested(0), succeeded(0), failed(0),
+							skipped(0), added(0), changed(0), removed(0), quarantined(0) { }
+
+					/** Whether the list of VM identifiers was retrieved. */
+					bool listed;
+					/** Whether the refresh ended early because a CircuitBreaker rejected a request. */
+					bool circuitOpen;
+					/** The number of VMs requested from the Nebu middleware. */
+					unsigned int requested;
+					/** The number of successful requests. */
+					unsigned int succeeded;
+					/** The number of failed requests. */
+					unsigned int failed;
+					/** The number of VMs not requested because they are backing off after failures. */
+					unsigned int skipped;
+					/** The number of new VMs. */
+					unsigned int added;
+					/** The number of VMs whose status changed. */
+					unsigned int changed;
+					/** The number of removed VMs. */
+					unsigned int removed;
+					/** The number of quarantined VMs after the refresh. */
+					unsigned int quarantined;
+				};
+
 				/** Creates a VMManager using the given connection to the Nebu middleware.
 				 *  @param[in] appVirtRequest a connection to the Nebu middleware for the AppVirtRequest.
 				 */
 				VMManager(std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest) :
-					vmEventHandlers(), appVirtRequest(appVirtRequest), vmList() { }
+					vmEventHandlers(), appVirtRequest(appVirtRequest), vmList(), refreshStates(),
+					stablePolls(0), sweepBudget(0), sweepCursor(), failures(), quarantineThreshold(0), maxBackoff(1),
+					lastRefresh() { }
 				/** Empty destructor provided for inheritance. */
 				virtual ~VMManager() { }
 
 				/** Refreshes the list of VMs and detects any changes in that list.
-				 *  @return true iff no exceptions occured in contacting the middleware.
+				 *  When a CircuitBreaker rejects a request (a CircuitOpenException), the remaining VMs are not
+				 *  requested in this refresh and no failure is recorded for any VM, as the failure is not theirs.
+				 *  The details of the refresh are available through getLastRefreshStatistics.
+				 *  @return true iff no exceptions occured in contacting the middleware, other than for
+				 *          quarantined VMs.
 				 */
 				virtual bool refreshVMList();
+				/** Getter for the outcome of the last call to refreshVMList.
+				 *  @return the statistics of the last refresh.
+				 */
+				const RefreshStatistics &getLastRefreshStatistics() const
+				{
+					return this->lastRefresh;
+				}
 
 				/** Retrieves a list of all VirtualMachines known to the VMManager.
 				 *  @return a vector of VirtualMachines.
@@ -57,6 +133,65 @@ namespace nebu
 				 */
 				virtual void registerVMEventHandler(std::shared_ptr<VMEventHandler> eventHandler);
 
+				/** Sets how often known VMs are refreshed.
+				 *  A VM that is ON becomes stable after stablePolls refreshes without a change, a VM that is OFF
+				 *  after a single refresh without a change. VMs in an UNKNOWN state are never stable.
+				 *  Stable VMs are refreshed in a round-robin sweep of at most sweepBudget VMs per call to
+				 *  refreshVMList, all other VMs are refreshed in every call. VMs that are backing off after
+				 *  failures (see setFailurePolicy) are left out of the sweep, and do not count against its budget.
+				 *  @param[in] stablePolls the number of unchanged refreshes after which a VM is stable, or 0 to
+				 *                         refresh all VMs in every call (the default).
+				 *  @param[in] sweepBudget the maximum number of stable VMs refreshed per call, at least 1.
+				 */
+				virtual void setRefreshPolicy(unsigned int stablePolls, unsigned int sweepBudget);
+				/** Getter for the number of unchanged refreshes after which a VM that is ON is stable.
+				 *  @return the number of refreshes, or 0 if all VMs are refreshed in every call.
+				 */
+				unsigned int getStablePolls() const
+				{
+					return this->stablePolls;
+				}
+				/** Sets how VMs for which requests fail are retried.
+				 *  After n consecutive failed requests for a VM, it is not requested in the next
+				 *  min(2^(n-1), maxBackoff) refreshes. After quarantineThreshold consecutive failures the VM is
+				 *  quarantined: it is retried once every maxBackoff + 1 refreshes, its failures no longer fail
+				 *  refreshVMList, and it is listed by getQuarantinedVMs until a request succeeds.
+				 *  @param[in] quarantineThreshold the number of consecutive failures after which a VM is
+				 *                                 quarantined, or 0 to retry failed VMs in every refresh (the default).
+				 *  @param[in] maxBackoff the maximum number of refreshes in which a failed VM is skipped, at least 1.
+				 */
+				virtual void setFailurePolicy(unsigned int quarantineThreshold, unsigned int maxBackoff);
+				/** Retrieves the identifiers of all quarantined VMs, including new VMs that could never be retrieved.
+				 *  @return a sorted vector of VM identifiers.
+				 */
+				virtual std::vector<std::string> getQuarantinedVMs() const;
+				/** Getter for the failure tracking of a VM identifier.
+				 *  @param[in] uuid the unique ID of the VM.
+				 *  @return the failure tracking, which is empty if the last request for the VM succeeded.
+				 */
+				virtual FailureState getFailureState(const std::string &uuid) const;
+				/** Getter for the refresh metadata of a VirtualMachine.
+				 *  @param[in] uuid the unique ID of the VM.
+				 *  @return the refresh metadata.
+				 *  @throws std::out_of_range if the VM is not known.
+				 */
+				virtual RefreshState getRefreshState(const std::string &uuid) const;
+
+				/** Adds a VirtualMachine from a previous run of the application, without notifying the
+				 *  VMEventHandlers. The next calls to refreshVMList reconcile restored VMs with the Nebu middleware
+				 *  like any other known VM, so only real differences are notified. VMs whose state the
+				 *  VMEventHandlers can not restore should be announced with notifyVMAdded.
+				 *  @param[in] vm the VM to restore, replacing a known VM with the same ID.
+				 *  @param[in] unchangedPolls the number of refreshes since the status of the VM last changed.
+				 */
+				virtual void restoreVM(std::shared_ptr<nebu::common::VirtualMachine> vm, unsigned int unchangedPolls);
+				/** Notifies the VMEventHandlers of a known VirtualMachine as if it was new, e.g., for a restored VM
+				 *  whose state the handlers could not restore.
+				 *  @param[in] uuid the unique ID of the VM.
+				 *  @return true iff the VM is known and the VMEventHandlers were notified.
+				 */
+				virtual bool notifyVMAdded(const std::string &uuid);
+
 			protected:
 				void addVM(std::shared_ptr<nebu::common::VirtualMachine> vm);
 				void updateVM(std::shared_ptr<nebu::common::VirtualMachine> vm,
@@ -67,10 +202,25 @@ namespace nebu
 				bool updateVMs(std::vector<std::string> &filteredVMIds);
 				void removeVMs(std::vector<std::string> &retrievedVMIds);
 
+				void endRefreshOnOpenCircuit(const std::string &error);
+				bool isBackingOff(const std::string &uuid);
+				void recordSuccess(const std::string &uuid);
+				bool recordFailure(const std::string &uuid, const std::string &error);
+				bool isStable(const RefreshState &state) const;
+				std::vector<std::string> selectVMsToRefresh(const std::vector<std::string> &vmIDs);
+
 			private:
 				std::list<std::shared_ptr<VMEventHandler>> vmEventHandlers;
 				std::shared_ptr<nebu::common::AppVirtRequest> appVirtRequest;
 				std::unordered_map<std::string, std::shared_ptr<nebu::common::VirtualMachine>> vmList;
+				std::unordered_map<std::string, RefreshState> refreshStates;
+				unsigned int stablePolls;
+				unsigned int sweepBudget;
+				std::string sweepCursor;
+				std::unordered_map<std::string, FailureState> failures;
+				unsigned int quarantineThreshold;
+				unsigned int maxBackoff;
+				RefreshStatistics lastRefresh;
 			};
 
 		}
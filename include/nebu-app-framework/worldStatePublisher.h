@@ -0,0 +1,86 @@
+
+#ifndef NEBUAPPFRAMEWORK_WORLDSTATEPUBLISHER_H_
+#define NEBUAPPFRAMEWORK_WORLDSTATEPUBLISHER_H_
+
+#include "nebu-app-framework/worldStateReader.h"
+
+#include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Publishes the mapping from VM hostnames to their physical location in a shared memory segment.
+			 *  The segment holds two copies of a read-only hash table, updated as a latch so that readers in other
+			 *  processes, using a WorldStateReader, never wait for the publisher and always see a single generation.
+			 *  The segment is created when the publisher is opened and removed when it is destroyed. Either way,
+			 *  the segment it replaces or removes is retired first, so that attached readers stop reading it.
+			 */
+			class WorldStatePublisher
+			{
+			public:
+				/** Creates a publisher for a shared memory segment.
+				 *  @param[in] name the name of the segment, starting with a slash, e.g. "/nebu-world".
+				 *  @param[in] bufferSize the size of each copy of the world state in bytes.
+				 */
+				WorldStatePublisher(const std::string &name, size_t bufferSize);
+				/** Retires and removes the shared memory segment. */
+				virtual ~WorldStatePublisher();
+
+				/** Creates the shared memory segment, retiring and replacing an existing segment with the same name.
+				 *  @return true iff the segment was created.
+				 */
+				bool open();
+				/** Publishes a new generation of the world state.
+				 *  VMs whose host is not part of the topology, or without a hostname, are not published.
+				 *  @param[in] topology the physical topology.
+				 *  @param[in] vms the VMs to publish.
+				 *  @return true iff the world state was published, false if the segment is not open or the world
+				 *          state does not fit in a copy.
+				 */
+				bool publish(std::shared_ptr<nebu::common::PhysicalRoot> topology,
+						const std::vector<std::shared_ptr<nebu::common::VirtualMachine>> &vms);
+
+				/** Getter for the name of the shared memory segment.
+				 *  @return the name.
+				 */
+				const std::string &getName() const
+				{
+					return this->name;
+				}
+				/** Getter for the generation of the last publication.
+				 *  @return the generation, or 0 if nothing has been published.
+				 */
+				uint64_t getGeneration() const
+				{
+					return this->generation;
+				}
+
+			private:
+				WorldStatePublisher(const WorldStatePublisher &);
+				WorldStatePublisher &operator=(const WorldStatePublisher &);
+
+				void render(std::shared_ptr<nebu::common::PhysicalRoot> topology,
+						const std::vector<std::shared_ptr<nebu::common::VirtualMachine>> &vms);
+
+				std::string name;
+				size_t bufferSize;
+				char *segment;
+				size_t segmentSize;
+				uint64_t generation;
+				std::string image;
+			};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,364 @@
+
+#ifndef NEBUAPPFRAMEWORK_WORLDSTATEREADER_H_
+#define NEBUAPPFRAMEWORK_WORLDSTATEREADER_H_
+
+#include <atomic>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Control block at the start of a world state segment.
+			 *  The segment holds two copies of the world state, each of bufferSize bytes, following the control
+			 *  block. The copies are updated as a latch: the publisher increments the sequence, rewrites the first
+			 *  copy, increments the sequence again and rewrites the second copy. Readers use the copy selected by
+			 *  the lowest bit of the sequence, which is never the copy being rewritten, and retry if the sequence
+			 *  changed during their lookup. A publisher retires the segment before it stops updating it, after
+			 *  which readers must attach to the segment that replaces it, if any.
+			 */
+			struct WorldStateControl
+			{
+				/** The characters "NEBUWRLD". */
+				char magic[8];
+				/** The version of the layout. */
+				uint32_t version;
+				/** Nonzero once the publisher no longer updates the segment. */
+				std::atomic<uint32_t> retired;
+				/** The size of each copy of the world state in bytes. */
+				uint64_t bufferSize;
+				/** The latch sequence number. */
+				std::atomic<uint64_t> sequence;
+				/** Padding to 64 bytes. */
+				char padding[32];
+			};
+
+			/** Header of a copy of the world state, followed by the hash table and the string table. */
+			struct WorldStateBuffer
+			{
+				/** The generation of the world state, incremented on every publication. */
+				uint64_t generation;
+				/** The number of VMs in the hash table. */
+				uint32_t entryCount;
+				/** The number of buckets in the hash table, a power of two. */
+				uint32_t bucketCount;
+				/** The offset of the hash table from the start of this header. */
+				uint32_t bucketOffset;
+				/** The offset of the string table from the start of this header. */
+				uint32_t stringOffset;
+				/** The size of the string table in bytes. */
+				uint32_t stringSize;
+				/** Reserved, zero. */
+				uint32_t reserved;
+			};
+
+			/** A bucket of the hash table, keyed by hostname with linear probing.
+			 *  Strings are offsets into the string table, where offset 0 is the empty string; a bucket with an
+			 *  empty hostname is unused.
+			 */
+			struct WorldStateEntry
+			{
+				/** The hash of the hostname. */
+				uint32_t hash;
+				/** The hostname of the VM. */
+				uint32_t hostname;
+				/** The unique ID of the VM. */
+				uint32_t uuid;
+				/** The ID of the data center hosting the VM. */
+				uint32_t dataCenter;
+				/** The ID of the rack hosting the VM. */
+				uint32_t rack;
+				/** The ID of the physical host of the VM. */
+				uint32_t host;
+			};
+
+			/** The version of the world state layout. */
+			const uint32_t WORLDSTATE_VERSION = 1;
+
+			/** Computes the hash of a hostname in the world state hash table (32-bit FNV-1a).
+			 *  @param[in] data the hostname.
+			 *  @param[in] length the length of the hostname.
+			 *  @return the hash.
+			 */
+			inline uint32_t worldStateHash(const char *data, size_t length)
+			{
+				uint32_t hash = 2166136261U;
+				for (size_t i = 0; i < length; i++) {
+					hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619U;
+				}
+				return hash;
+			}
+
+			/** Reads the world state published by a WorldStatePublisher in another process.
+			 *  Lookups are lock-free and never block the publisher. The reader only depends on the C++ standard
+			 *  library and POSIX, so sidecar tools can use it without linking the framework.
+			 *
+			 *  When the publisher retires its segment, e.g. because it restarted and replaced the segment, the
+			 *  next read attaches to the segment published under the same name, or fails if there is none. As
+			 *  reads may therefore attach again, a reader should not be shared by several threads.
+			 */
+			class WorldStateReader
+			{
+			public:
+				/** The location of a VM in the world state. */
+				struct Location
+				{
+					/** The generation of the world state the location was read from. */
+					uint64_t generation;
+					/** The unique ID of the VM. */
+					std::string uuid;
+					/** The ID of the data center hosting the VM. */
+					std::string dataCenter;
+					/** The ID of the rack hosting the VM. */
+					std::string rack;
+					/** The ID of the physical host of the VM. */
+					std::string host;
+				};
+
+				/** Creates a reader that is not attached to a segment. */
+				WorldStateReader() : name(), segment(NULL), segmentSize(0) { }
+				/** Detaches from the segment, if any. */
+				virtual ~WorldStateReader()
+				{
+					this->close();
+				}
+
+				/** Attaches to a world state segment.
+				 *  @param[in] name the name of the shared memory segment, as passed to the publisher.
+				 *  @return true iff the segment exists and has a compatible layout.
+				 */
+				bool open(const std::string &name)
+				{
+					this->name = name;
+					return this->attach();
+				}
+
+				/** Detaches from the segment, if any. */
+				void close()
+				{
+					this->detach();
+					this->name.clear();
+				}
+
+				/** Checks whether the reader is attached to a segment that has not been retired.
+				 *  @return true iff the reader is attached.
+				 */
+				bool isOpen() const
+				{
+					return this->segment != NULL && this->getControl()->retired.load(std::memory_order_acquire) == 0;
+				}
+
+				/** Getter for the generation of the published world state.
+				 *  @return the generation, or 0 if nothing has been published or the reader is not attached.
+				 */
+				uint64_t getGeneration() const
+				{
+					uint64_t generation = 0;
+					this->read([&generation](const WorldStateBuffer *buffer, const char *) -> bool {
+						generation = buffer->generation;
+						return true;
+					});
+					return generation;
+				}
+
+				/** Looks up the location of a VM by hostname.
+				 *  @param[in] hostname the hostname of the VM.
+				 *  @param[out] location the location of the VM, read from a single generation.
+				 *  @return true iff the VM was found.
+				 */
+				bool lookup(const std::string &hostname, Location &location) const
+				{
+					return this->read([this, &hostname, &location](const WorldStateBuffer *buffer,
+							const char *strings) -> bool {
+						const WorldStateEntry *entry = this->find(buffer, strings, hostname.data(), hostname.size());
+						if (!entry) {
+							return false;
+						}
+						location.generation = buffer->generation;
+						location.uuid = this->getString(buffer, strings, entry->uuid);
+						location.dataCenter = this->getString(buffer, strings, entry->dataCenter);
+						location.rack = this->getString(buffer, strings, entry->rack);
+						location.host = this->getString(buffer, strings, entry->host);
+						return true;
+					});
+				}
+
+				/** Resolves a hostname to its network location, without allocating memory.
+				 *  @param[in] hostname the hostname of the VM.
+				 *  @param[out] path a buffer receiving the null-terminated location "/dataCenter/rack/host".
+				 *  @param[in] size the size of the buffer.
+				 *  @return the length of the location, or 0 if the VM was not found or the buffer is too small.
+				 */
+				size_t resolve(const char *hostname, char *path, size_t size) const
+				{
+					size_t length = 0;
+					size_t hostnameLength = strlen(hostname);
+					this->read([this, hostname, hostnameLength, path, size, &length](const WorldStateBuffer *buffer,
+							const char *strings) -> bool {
+						length = 0;
+						const WorldStateEntry *entry = this->find(buffer, strings, hostname, hostnameLength);
+						uint32_t parts[] = { entry ? entry->dataCenter : 0, entry ? entry->rack : 0, entry ? entry->host : 0 };
+						for (int i = 0; entry && i < 3; i++) {
+							const char *part;
+							size_t partLength = this->getString(buffer, strings, parts[i], part);
+							if (length + 1 + partLength >= size) {
+								length = 0;
+								return false;
+							}
+							path[length++] = '/';
+							memcpy(path + length, part, partLength);
+							length += partLength;
+						}
+						if (length < size) {
+							path[length] = '\0';
+						}
+						return length > 0;
+					});
+					return length;
+				}
+
+			private:
+				WorldStateReader(const WorldStateReader &);
+				WorldStateReader &operator=(const WorldStateReader &);
+
+				const WorldStateControl *getControl() const
+				{
+					return reinterpret_cast<const WorldStateControl *>(this->segment);
+				}
+
+				bool attach() const
+				{
+					this->detach();
+					int fd = shm_open(this->name.c_str(), O_RDONLY, 0);
+					if (fd < 0) {
+						return false;
+					}
+					struct stat status;
+					if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(WorldStateControl)) {
+						::close(fd);
+						return false;
+					}
+					void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+					::close(fd);
+					if (mapping == MAP_FAILED) {
+						return false;
+					}
+
+					this->segment = static_cast<const char *>(mapping);
+					this->segmentSize = status.st_size;
+					const WorldStateControl *control = this->getControl();
+					if (memcmp(control->magic, "NEBUWRLD", sizeof(control->magic)) != 0 ||
+							control->version != WORLDSTATE_VERSION ||
+							control->bufferSize > (this->segmentSize - sizeof(WorldStateControl)) / 2 ||
+							control->bufferSize < sizeof(WorldStateBuffer) ||
+							control->retired.load(std::memory_order_acquire) != 0) {
+						this->detach();
+						return false;
+					}
+					return true;
+				}
+
+				void detach() const
+				{
+					if (this->segment) {
+						munmap(const_cast<char *>(this->segment), this->segmentSize);
+						this->segment = NULL;
+						this->segmentSize = 0;
+					}
+				}
+
+				// Runs a read against a consistent copy, retrying while the publisher rewrites it; a retired segment
+				// holds the last state of a publisher that has stopped, so it is replaced before reading
+				template<class Read> bool read(Read function) const
+				{
+					if (this->segment && this->getControl()->retired.load(std::memory_order_acquire) != 0) {
+						this->attach();
+					}
+					if (!this->segment) {
+						return false;
+					}
+					const WorldStateControl *control = this->getControl();
+					while (true) {
+						uint64_t sequence = control->sequence.load(std::memory_order_acquire);
+						const WorldStateBuffer *buffer = reinterpret_cast<const WorldStateBuffer *>(
+								this->segment + sizeof(WorldStateControl) + (sequence & 1) * control->bufferSize);
+						bool result = false;
+						if (this->isValid(buffer, control->bufferSize)) {
+							result = function(buffer, reinterpret_cast<const char *>(buffer) + buffer->stringOffset);
+						}
+						std::atomic_thread_fence(std::memory_order_acquire);
+						if (control->sequence.load(std::memory_order_relaxed) == sequence) {
+							return result;
+						}
+					}
+				}
+
+				// Checks the bounds of a copy, which may be read while it is being rewritten
+				bool isValid(const WorldStateBuffer *buffer, uint64_t bufferSize) const
+				{
+					uint64_t bucketEnd = static_cast<uint64_t>(buffer->bucketOffset) +
+							static_cast<uint64_t>(buffer->bucketCount) * sizeof(WorldStateEntry);
+					return buffer->bucketCount > 0 && (buffer->bucketCount & (buffer->bucketCount - 1)) == 0 &&
+							buffer->bucketOffset >= sizeof(WorldStateBuffer) && bucketEnd <= buffer->stringOffset &&
+							buffer->stringSize > 0 &&
+							static_cast<uint64_t>(buffer->stringOffset) + buffer->stringSize <= bufferSize;
+				}
+
+				// Strings are bounded by the string table, as a copy being rewritten may lack terminators
+				size_t getString(const WorldStateBuffer *buffer, const char *strings, uint32_t offset,
+						const char *&value) const
+				{
+					if (offset >= buffer->stringSize) {
+						offset = 0;
+					}
+					value = strings + offset;
+					return strnlen(value, buffer->stringSize - offset);
+				}
+
+				std::string getString(const WorldStateBuffer *buffer, const char *strings, uint32_t offset) const
+				{
+					const char *value;
+					size_t length = this->getString(buffer, strings, offset, value);
+					return std::string(value, length);
+				}
+
+				const WorldStateEntry *find(const WorldStateBuffer *buffer, const char *strings,
+						const char *hostname, size_t length) const
+				{
+					const WorldStateEntry *buckets = reinterpret_cast<const WorldStateEntry *>(
+							reinterpret_cast<const char *>(buffer) + buffer->bucketOffset);
+					uint32_t hash = worldStateHash(hostname, length);
+					uint32_t mask = buffer->bucketCount - 1;
+					for (uint32_t probe = 0; probe < buffer->bucketCount; probe++) {
+						const WorldStateEntry &entry = buckets[(hash + probe) & mask];
+						if (entry.hostname == 0 || entry.hostname >= buffer->stringSize) {
+							return NULL;
+						}
+						if (entry.hash == hash && buffer->stringSize - entry.hostname > length &&
+								memcmp(strings + entry.hostname, hostname, length) == 0 &&
+								strings[entry.hostname + length] == '\0') {
+							return &entry;
+						}
+					}
+					return NULL;
+				}
+
+				std::string name;
+				mutable const char *segment;
+				mutable size_t segmentSize;
+			};
+
+		}
+	}
+}
+
+#endif
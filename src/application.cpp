@@ -1,17 +1,29 @@
 
 #include "nebu-app-framework/application.h"
 #include "nebu-app-framework/applicationHooks.h"
+#include "nebu-app-framework/commandMetrics.h"
 #include "nebu-app-framework/configuration.h"
+#include "nebu-app-framework/daemonCollection.h"
 #include "nebu-app-framework/daemonManager.h"
+#include "nebu-app-framework/hedgingAppVirtRequest.h"
+#include "nebu-app-framework/stateSnapshot.h"
 #include "nebu-app-framework/topologyManager.h"
+#include "nebu-app-framework/topologyServer.h"
 #include "nebu-app-framework/vmManager.h"
+#include "nebu-app-framework/worldStatePublisher.h"
 
 #include "log4cxx/logger.h"
 
+#include <set>
 #include <unistd.h>
 
 // Using declarations - standard library
+using std::set;
 using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
 
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.Application"));
 
@@ -25,13 +37,22 @@ namespace nebu
 			Application::Application(shared_ptr<DaemonManager> daemonManager,
 					shared_ptr<TopologyManager> topologyManager, shared_ptr<VMManager> vmManager) :
 					stopLoop(false), daemonManager(daemonManager), topologyManager(topologyManager),
-					vmManager(vmManager)
+					vmManager(vmManager), snapshotFilename(), snapshotChecksum(0)
 			{
 				vmManager->registerVMEventHandler(daemonManager);
 			}
 
 			int Application::mainLoop()
 			{
+				string topologyImage = CONFIG_GET(CONFIG_APP_TOPOLOGYIMAGE);
+				if (!topologyImage.empty()) {
+					this->topologyManager->loadImage(topologyImage);
+				}
+				this->restoreSnapshot();
+				if (CONFIG_GETINT(CONFIG_APP_DAEMONS_PRUNE) != 0) {
+					this->vmManager->registerVMEventHandler(this->applicationHooks->getDaemonCollection());
+				}
+
 				while (!this->stopLoop) {
 					LOG4CXX_TRACE(logger, "PreLoop");
 					this->applicationHooks->preLoop();
@@ -46,9 +67,20 @@ namespace nebu
 					LOG4CXX_TRACE(logger, "PreRefreshTopology");
 					this->applicationHooks->preRefreshTopology();
 					LOG4CXX_TRACE(logger, "RefreshTopology");
-					this->topologyManager->refreshTopology();
+					bool topologyRefreshed = this->topologyManager->refreshTopology();
 					LOG4CXX_TRACE(logger, "PostRefreshTopology");
 					this->applicationHooks->postRefreshTopology();
+					if (topologyRefreshed && !CONFIG_GET(CONFIG_APP_TOPOLOGYIMAGE).empty()) {
+						this->topologyManager->writeImage(CONFIG_GET(CONFIG_APP_TOPOLOGYIMAGE), this->vmManager->getVMs());
+					}
+					shared_ptr<WorldStatePublisher> worldStatePublisher = this->applicationHooks->getWorldStatePublisher();
+					if (worldStatePublisher) {
+						worldStatePublisher->publish(this->topologyManager->getRoot(), this->vmManager->getVMs());
+					}
+					shared_ptr<TopologyServer> topologyServer = this->applicationHooks->getTopologyServer();
+					if (topologyServer) {
+						topologyServer->update(this->topologyManager->getRoot(), this->vmManager->getVMs());
+					}
 
 					LOG4CXX_TRACE(logger, "PreRefreshDaemons");
 					this->applicationHooks->preRefreshDaemons();
@@ -66,6 +98,13 @@ namespace nebu
 
 					LOG4CXX_TRACE(logger, "PostLoop");
 					this->applicationHooks->postLoop();
+					CommandMetrics::getInstance()->logSummaryIfDue();
+					shared_ptr<HedgingAppVirtRequest> hedgingAppVirtRequest =
+							this->applicationHooks->getHedgingAppVirtRequest();
+					if (hedgingAppVirtRequest) {
+						hedgingAppVirtRequest->logSummaryIfDue(CONFIG_GETINT(CONFIG_NEBU_HEDGE_SUMMARYINTERVAL));
+					}
+					this->saveSnapshot();
 
 					LOG4CXX_DEBUG(logger, "Waiting for next round...");
 					sleep(CONFIG_GETINT(CONFIG_APP_INTERVAL));
@@ -74,6 +113,69 @@ namespace nebu
 				return 0;
 			}
 
+			void Application::restoreSnapshot()
+			{
+				string filename = CONFIG_GET(CONFIG_APP_SNAPSHOT);
+				StateSnapshot snapshot;
+				if (filename.empty() || !snapshot.load(filename)) {
+					return;
+				}
+
+				const vector<StateSnapshot::VMRecord> &vms = snapshot.getVMs();
+				for (vector<StateSnapshot::VMRecord>::const_iterator it = vms.begin(); it != vms.end(); it++) {
+					this->vmManager->restoreVM(it->vm, it->unchangedPolls);
+				}
+				this->topologyManager->restoreTopology(snapshot.getTopology());
+
+				unsigned int restoredDaemons = 0;
+				set<string> vmsWithDaemons;
+				shared_ptr<DaemonCollection> daemonCollection = this->applicationHooks->getDaemonCollection();
+				const vector<StateSnapshot::DaemonRecord> &daemons = snapshot.getDaemons();
+				for (vector<StateSnapshot::DaemonRecord>::const_iterator it = daemons.begin(); it != daemons.end(); it++) {
+					shared_ptr<VirtualMachine> hostVM = this->vmManager->getVM(it->vmUUID);
+					if (hostVM) {
+						shared_ptr<Daemon> daemon = this->applicationHooks->restoreDaemon(hostVM, it->type, it->launched);
+						if (daemon) {
+							daemonCollection->addDaemon(daemon);
+							vmsWithDaemons.insert(it->vmUUID);
+							restoredDaemons++;
+						}
+					}
+				}
+
+				// The VMEventHandlers, e.g. the DaemonManager, only learn of VMs whose Daemons were not restored
+				// through newVMAdded, as they would for a cold start
+				unsigned int announcedVMs = 0;
+				for (vector<StateSnapshot::VMRecord>::const_iterator it = vms.begin(); it != vms.end(); it++) {
+					if (vmsWithDaemons.find(it->vm->getUUID()) == vmsWithDaemons.end()) {
+						this->vmManager->notifyVMAdded(it->vm->getUUID());
+						announcedVMs++;
+					}
+				}
+				LOG4CXX_INFO(logger, "Warm start with " << vms.size() << " VMs and " << restoredDaemons << " daemons, " <<
+						announcedVMs << " VMs announced as new");
+				if (restoredDaemons == 0 && !daemons.empty()) {
+					LOG4CXX_WARN(logger, "None of the " << daemons.size() << " daemons in the snapshot were restored, so " <<
+							"all VMs are announced as new as for a cold start; implement ApplicationHooks::restoreDaemon " <<
+							"to restore them");
+				}
+			}
+
+			void Application::saveSnapshot()
+			{
+				string filename = CONFIG_GET(CONFIG_APP_SNAPSHOT);
+				if (!filename.empty()) {
+					StateSnapshot snapshot;
+					snapshot.capture(*this->vmManager, *this->topologyManager,
+							*this->applicationHooks->getDaemonCollection());
+					if (filename != this->snapshotFilename) {
+						this->snapshotFilename = filename;
+						this->snapshotChecksum = 0;
+					}
+					snapshot.saveIfChanged(filename, this->snapshotChecksum);
+				}
+			}
+
 		}
 	}
 }
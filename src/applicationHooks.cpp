@@ -1,9 +1,17 @@
 
 #include "nebu-app-framework/applicationHooks.h"
+#include "nebu-app-framework/cachingAppPhysRequest.h"
+#include "nebu-app-framework/cachingAppVirtRequest.h"
+#include "nebu-app-framework/circuitBreakingAppPhysRequest.h"
+#include "nebu-app-framework/circuitBreakingAppVirtRequest.h"
 #include "nebu-app-framework/configuration.h"
 #include "nebu-app-framework/daemonCollection.h"
+#include "nebu-app-framework/hedgingAppVirtRequest.h"
+#include "nebu-app-framework/pooledRestClientAdapter.h"
 #include "nebu-app-framework/topologyManager.h"
+#include "nebu-app-framework/topologyServer.h"
 #include "nebu-app-framework/vmManager.h"
+#include "nebu-app-framework/worldStatePublisher.h"
 #include "nebu/appPhysRequest.h"
 #include "nebu/appVirtRequest.h"
 #include "nebu/nebuClient.h"
@@ -11,6 +19,8 @@
 
 #include "log4cxx/basicconfigurator.h"
 
+#include <algorithm>
+
 // Using declarations - nebu-common
 using nebu::common::AppPhysRequest;
 using nebu::common::AppVirtRequest;
@@ -19,6 +29,7 @@ using nebu::common::RestClientAdapter;
 // Using declarations - standard library
 using std::make_shared;
 using std::shared_ptr;
+using std::string;
 
 namespace nebu
 {
@@ -44,11 +55,7 @@ namespace nebu
 			shared_ptr<TopologyManager> ApplicationHooks::getTopologyManager()
 			{
 				if (!this->topologyManager) {
-					shared_ptr<NebuClient> nebuClient = make_shared<NebuClient>(RestClientAdapter::getInstance(),
-							CONFIG_GET(CONFIG_NEBU_URL));
-					shared_ptr<AppPhysRequest> appPhysRequest = make_shared<AppPhysRequest>(nebuClient,
-							CONFIG_GET(CONFIG_APP_UUID));
-					this->topologyManager = make_shared<TopologyManager>(appPhysRequest);
+					this->topologyManager = make_shared<TopologyManager>(this->getAppPhysRequest());
 				}
 				return this->topologyManager;
 			}
@@ -56,15 +63,118 @@ namespace nebu
 			shared_ptr<VMManager> ApplicationHooks::getVMManager()
 			{
 				if (!this->vmManager) {
-					shared_ptr<NebuClient> nebuClient = make_shared<NebuClient>(RestClientAdapter::getInstance(),
-							CONFIG_GET(CONFIG_NEBU_URL));
-					shared_ptr<AppVirtRequest> appVirtRequest = make_shared<AppVirtRequest>(nebuClient,
-							CONFIG_GET(CONFIG_APP_UUID));
-					this->vmManager = make_shared<VMManager>(appVirtRequest);
+					this->vmManager = make_shared<VMManager>(this->getAppVirtRequest());
+					this->vmManager->setRefreshPolicy(CONFIG_GETINT(CONFIG_APP_VMS_STABLEPOLLS),
+							CONFIG_GETINT(CONFIG_APP_VMS_SWEEPBUDGET));
+					this->vmManager->setFailurePolicy(CONFIG_GETINT(CONFIG_APP_VMS_QUARANTINETHRESHOLD),
+							CONFIG_GETINT(CONFIG_APP_VMS_MAXBACKOFF));
 				}
 				return this->vmManager;
 			}
 
+			shared_ptr<NebuClient> ApplicationHooks::getNebuClient()
+			{
+				if (!this->nebuClient) {
+					shared_ptr<RestClientAdapter> restClientAdapter;
+					int poolSize = CONFIG_GETINT(CONFIG_NEBU_POOLSIZE);
+					if (poolSize > 0) {
+						restClientAdapter = make_shared<PooledRestClientAdapter>(poolSize,
+								CONFIG_GETINT(CONFIG_NEBU_TIMEOUT));
+					} else {
+						restClientAdapter = RestClientAdapter::getInstance();
+					}
+					this->nebuClient = make_shared<NebuClient>(restClientAdapter, CONFIG_GET(CONFIG_NEBU_URL));
+				}
+				return this->nebuClient;
+			}
+
+			shared_ptr<CircuitBreaker> ApplicationHooks::getCircuitBreaker()
+			{
+				if (!this->circuitBreakerConfigured) {
+					int failureThreshold = CONFIG_GETINT(CONFIG_NEBU_BREAKER_FAILURETHRESHOLD);
+					if (failureThreshold > 0) {
+						this->circuitBreaker = make_shared<CircuitBreaker>(failureThreshold,
+								CONFIG_GETINT(CONFIG_NEBU_BREAKER_BACKOFF), CONFIG_GETINT(CONFIG_NEBU_BREAKER_MAXBACKOFF));
+						this->circuitBreaker->setStateListener([this](CircuitState previous, CircuitState current) {
+							this->circuitStateChanged(previous, current);
+						});
+					}
+					this->circuitBreakerConfigured = true;
+				}
+				return this->circuitBreaker;
+			}
+
+			shared_ptr<AppPhysRequest> ApplicationHooks::getAppPhysRequest()
+			{
+				shared_ptr<AppPhysRequest> appPhysRequest = make_shared<AppPhysRequest>(this->getNebuClient(),
+						CONFIG_GET(CONFIG_APP_UUID));
+				shared_ptr<CircuitBreaker> circuitBreaker = this->getCircuitBreaker();
+				if (circuitBreaker) {
+					appPhysRequest = make_shared<CircuitBreakingAppPhysRequest>(appPhysRequest, circuitBreaker);
+				}
+				int topologyTTL = CONFIG_GETINT(CONFIG_NEBU_CACHE_TOPOLOGYTTL);
+				if (topologyTTL > 0) {
+					appPhysRequest = make_shared<CachingAppPhysRequest>(appPhysRequest, topologyTTL,
+							CONFIG_GETINT(CONFIG_NEBU_CACHE_NEGATIVETTL));
+				}
+				return appPhysRequest;
+			}
+
+			shared_ptr<AppVirtRequest> ApplicationHooks::getAppVirtRequest()
+			{
+				shared_ptr<AppVirtRequest> appVirtRequest = make_shared<AppVirtRequest>(this->getNebuClient(),
+						CONFIG_GET(CONFIG_APP_UUID));
+				shared_ptr<CircuitBreaker> circuitBreaker = this->getCircuitBreaker();
+				if (circuitBreaker) {
+					appVirtRequest = make_shared<CircuitBreakingAppVirtRequest>(appVirtRequest, circuitBreaker);
+				}
+				double hedgePercentile = CONFIG_GETDOUBLE(CONFIG_NEBU_HEDGE_PERCENTILE);
+				if (hedgePercentile > 0) {
+					this->hedgingAppVirtRequest = make_shared<HedgingAppVirtRequest>(appVirtRequest, hedgePercentile,
+							CONFIG_GETDOUBLE(CONFIG_NEBU_HEDGE_MAXRATE), CONFIG_GETINT(CONFIG_NEBU_HEDGE_MINDELAY));
+					appVirtRequest = this->hedgingAppVirtRequest;
+				}
+				int vmIDsTTL = CONFIG_GETINT(CONFIG_NEBU_CACHE_VMIDSTTL);
+				int vmTTL = CONFIG_GETINT(CONFIG_NEBU_CACHE_VMTTL);
+				if (vmIDsTTL > 0 || vmTTL > 0) {
+					appVirtRequest = make_shared<CachingAppVirtRequest>(appVirtRequest, std::max(vmIDsTTL, 0),
+							std::max(vmTTL, 0), CONFIG_GETINT(CONFIG_NEBU_CACHE_NEGATIVETTL));
+				}
+				return appVirtRequest;
+			}
+
+			shared_ptr<WorldStatePublisher> ApplicationHooks::getWorldStatePublisher()
+			{
+				if (!this->worldStatePublisherConfigured) {
+					string name = CONFIG_GET(CONFIG_APP_WORLDSTATE_NAME);
+					if (!name.empty()) {
+						shared_ptr<WorldStatePublisher> publisher = make_shared<WorldStatePublisher>(name,
+								static_cast<size_t>(CONFIG_GETINT(CONFIG_APP_WORLDSTATE_SIZE)) << 20);
+						if (publisher->open()) {
+							this->worldStatePublisher = publisher;
+						}
+					}
+					this->worldStatePublisherConfigured = true;
+				}
+				return this->worldStatePublisher;
+			}
+
+			shared_ptr<TopologyServer> ApplicationHooks::getTopologyServer()
+			{
+				if (!this->topologyServerConfigured) {
+					string socketPath = CONFIG_GET(CONFIG_APP_TOPOLOGYSERVER_SOCKET);
+					if (!socketPath.empty()) {
+						shared_ptr<TopologyServer> server = make_shared<TopologyServer>(socketPath);
+						server->setResolveAddresses(CONFIG_GETINT(CONFIG_APP_TOPOLOGYSERVER_ADDRESSES) != 0);
+						if (server->start()) {
+							this->topologyServer = server;
+						}
+					}
+					this->topologyServerConfigured = true;
+				}
+				return this->topologyServer;
+			}
+
 		}
 	}
 }
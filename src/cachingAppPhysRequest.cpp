@@ -0,0 +1,54 @@
+
+#include "nebu-app-framework/cachingAppPhysRequest.h"
+
+#include "log4cxx/logger.h"
+
+// Using declarations - standard library
+using std::shared_ptr;
+// Using declarations - nebu-common
+using nebu::common::AppPhysRequest;
+using nebu::common::NebuClient;
+using nebu::common::PhysicalRoot;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CachingAppPhysRequest"));
+
+/** Key under which the physical topology is cached. */
+#define CACHINGAPPPHYSREQUEST_TOPOLOGY_KEY ""
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CachingAppPhysRequest::CachingAppPhysRequest(shared_ptr<AppPhysRequest> appPhysRequest,
+					unsigned int topologyTTL, unsigned int negativeTTL) :
+					AppPhysRequest(shared_ptr<NebuClient>(), ""), appPhysRequest(appPhysRequest),
+					topologyCache(topologyTTL, negativeTTL)
+			{
+				LOG4CXX_DEBUG(logger, "Caching the topology for " << topologyTTL << " ms and failures for " <<
+						negativeTTL << " ms");
+			}
+
+			shared_ptr<PhysicalRoot> CachingAppPhysRequest::getPhysicalTopology()
+			{
+				shared_ptr<PhysicalRoot> physicalRoot = this->topologyCache.get(CACHINGAPPPHYSREQUEST_TOPOLOGY_KEY,
+						[this]() {
+					return this->appPhysRequest->getPhysicalTopology();
+				});
+				if (!physicalRoot) {
+					// An invalid tree is not worth keeping
+					this->topologyCache.invalidate(CACHINGAPPPHYSREQUEST_TOPOLOGY_KEY);
+				}
+				return physicalRoot;
+			}
+
+			void CachingAppPhysRequest::clear()
+			{
+				this->topologyCache.clear();
+			}
+
+		}
+	}
+}
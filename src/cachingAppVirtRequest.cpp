@@ -0,0 +1,58 @@
+
+#include "nebu-app-framework/cachingAppVirtRequest.h"
+
+#include "log4cxx/logger.h"
+
+// Using declarations - standard library
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::AppVirtRequest;
+using nebu::common::NebuClient;
+using nebu::common::VirtualMachine;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CachingAppVirtRequest"));
+
+/** Key under which the list of VM identifiers is cached. */
+#define CACHINGAPPVIRTREQUEST_IDS_KEY ""
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CachingAppVirtRequest::CachingAppVirtRequest(shared_ptr<AppVirtRequest> appVirtRequest,
+					unsigned int vmIDsTTL, unsigned int vmTTL, unsigned int negativeTTL) :
+					AppVirtRequest(shared_ptr<NebuClient>(), ""), appVirtRequest(appVirtRequest),
+					vmIDsCache(vmIDsTTL, negativeTTL), vmCache(vmTTL, negativeTTL)
+			{
+				LOG4CXX_DEBUG(logger, "Caching VM identifiers for " << vmIDsTTL << " ms, VMs for " << vmTTL <<
+						" ms and failures for " << negativeTTL << " ms");
+			}
+
+			vector<string> CachingAppVirtRequest::getVirtualMachineIDs()
+			{
+				return this->vmIDsCache.get(CACHINGAPPVIRTREQUEST_IDS_KEY, [this]() {
+					return this->appVirtRequest->getVirtualMachineIDs();
+				});
+			}
+
+			VirtualMachine CachingAppVirtRequest::getVirtualMachine(const string &uuid)
+			{
+				return this->vmCache.get(uuid, [this, &uuid]() {
+					return this->appVirtRequest->getVirtualMachine(uuid);
+				});
+			}
+
+			void CachingAppVirtRequest::clear()
+			{
+				this->vmIDsCache.clear();
+				this->vmCache.clear();
+			}
+
+		}
+	}
+}
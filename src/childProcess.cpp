@@ -0,0 +1,282 @@
+
+#include "nebu-app-framework/childProcess.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+extern char **environ;
+
+// Using declarations - standard library
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+#define CHILDPROCESS_READ_SIZE 65536
+#define CHILDPROCESS_POLL_INTERVAL 50
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			ChildProcess::~ChildProcess()
+			{
+				this->closeFd(this->inputFd);
+				this->closeFd(this->outputFd);
+				this->closeFd(this->errorFd);
+				this->closeFd(this->pidFd);
+			}
+
+			void ChildProcess::closeFd(int &fd)
+			{
+				if (fd >= 0) {
+					close(fd);
+					fd = -1;
+				}
+			}
+
+			int ChildProcess::spawn(const Command &command)
+			{
+				const vector<string> &arguments = command.getArguments();
+				if (arguments.empty()) {
+					return EINVAL;
+				}
+
+				vector<char *> argv;
+				for (vector<string>::const_iterator it = arguments.begin(); it != arguments.end(); it++) {
+					argv.push_back(const_cast<char *>(it->c_str()));
+				}
+				argv.push_back(NULL);
+
+				vector<string> environment;
+				vector<char *> envp;
+				char **envpPtr = environ;
+				if (command.hasCustomEnvironment()) {
+					environment = command.buildEnvironment();
+					for (vector<string>::iterator it = environment.begin(); it != environment.end(); it++) {
+						envp.push_back(const_cast<char *>(it->c_str()));
+					}
+					envp.push_back(NULL);
+					envpPtr = &envp[0];
+				}
+
+				int inputPipe[2] = { -1, -1 };
+				int outputPipe[2] = { -1, -1 };
+				int errorPipe[2] = { -1, -1 };
+				posix_spawn_file_actions_t fileActions;
+				posix_spawn_file_actions_init(&fileActions);
+				if (command.capturesOutput()) {
+					if (pipe2(outputPipe, O_CLOEXEC) != 0 || pipe2(errorPipe, O_CLOEXEC) != 0 ||
+							(command.pipesInput() && pipe2(inputPipe, O_CLOEXEC) != 0)) {
+						int error = errno;
+						for (int i = 0; i < 2; i++) {
+							this->closeFd(inputPipe[i]);
+							this->closeFd(outputPipe[i]);
+							this->closeFd(errorPipe[i]);
+						}
+						posix_spawn_file_actions_destroy(&fileActions);
+						return error;
+					}
+					if (command.pipesInput()) {
+						posix_spawn_file_actions_adddup2(&fileActions, inputPipe[0], STDIN_FILENO);
+					} else {
+						posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+					}
+					posix_spawn_file_actions_adddup2(&fileActions, outputPipe[1], STDOUT_FILENO);
+					posix_spawn_file_actions_adddup2(&fileActions, errorPipe[1], STDERR_FILENO);
+				}
+
+				// Children start with an empty signal mask and default handlers for signals the application
+				// commonly ignores, regardless of the state of the calling thread.
+				posix_spawnattr_t attributes;
+				posix_spawnattr_init(&attributes);
+				sigset_t signals;
+				sigemptyset(&signals);
+				posix_spawnattr_setsigmask(&attributes, &signals);
+				sigaddset(&signals, SIGPIPE);
+				sigaddset(&signals, SIGCHLD);
+				sigaddset(&signals, SIGINT);
+				sigaddset(&signals, SIGQUIT);
+				posix_spawnattr_setsigdefault(&attributes, &signals);
+				short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+				this->processGroup = command.getTimeout() > 0;
+				if (this->processGroup) {
+					posix_spawnattr_setpgroup(&attributes, 0);
+					flags |= POSIX_SPAWN_SETPGROUP;
+				}
+				posix_spawnattr_setflags(&attributes, flags);
+
+				int error = posix_spawnp(&this->pid, argv[0], &fileActions, &attributes, &argv[0], envpPtr);
+
+				posix_spawnattr_destroy(&attributes);
+				posix_spawn_file_actions_destroy(&fileActions);
+				this->closeFd(inputPipe[0]);
+				this->closeFd(outputPipe[1]);
+				this->closeFd(errorPipe[1]);
+
+				if (error != 0) {
+					this->pid = -1;
+					this->closeFd(inputPipe[1]);
+					this->closeFd(outputPipe[0]);
+					this->closeFd(errorPipe[0]);
+					return error;
+				}
+
+				this->inputFd = inputPipe[1];
+				this->outputFd = outputPipe[0];
+				this->errorFd = errorPipe[0];
+				if (this->outputFd >= 0) {
+					fcntl(this->outputFd, F_SETFL, fcntl(this->outputFd, F_GETFL) | O_NONBLOCK);
+					fcntl(this->errorFd, F_SETFL, fcntl(this->errorFd, F_GETFL) | O_NONBLOCK);
+				}
+				this->pidFd = syscall(SYS_pidfd_open, this->pid, 0);
+				if (this->pidFd >= 0) {
+					fcntl(this->pidFd, F_SETFD, FD_CLOEXEC);
+				}
+
+				this->timeout = milliseconds(command.getTimeout());
+				this->killGracePeriod = milliseconds(command.getKillGracePeriod());
+				this->deadline = steady_clock::now() + this->timeout;
+				this->termSent = false;
+				this->killSent = false;
+				return 0;
+			}
+
+			static bool drainFd(int fd, string &buffer)
+			{
+				char data[CHILDPROCESS_READ_SIZE];
+				while (true) {
+					ssize_t length = read(fd, data, sizeof(data));
+					if (length > 0) {
+						buffer.append(data, length);
+					} else if (length == 0) {
+						return false;
+					} else if (errno == EINTR) {
+						continue;
+					} else {
+						return errno == EAGAIN || errno == EWOULDBLOCK;
+					}
+				}
+			}
+
+			bool ChildProcess::readOutput(CommandResult &result)
+			{
+				if (this->outputFd >= 0 && !drainFd(this->outputFd, result.getOutputBuffer())) {
+					this->closeFd(this->outputFd);
+				}
+				if (this->errorFd >= 0 && !drainFd(this->errorFd, result.getErrorBuffer())) {
+					this->closeFd(this->errorFd);
+				}
+				return this->outputFd >= 0 || this->errorFd >= 0;
+			}
+
+			void ChildProcess::wait(CommandResult &result)
+			{
+				if (this->pid < 0) {
+					return;
+				}
+
+				int status;
+				while (waitpid(this->pid, &status, 0) < 0) {
+					if (errno != EINTR) {
+						status = 127 << 8;
+						break;
+					}
+				}
+				result.setWaitStatus(status);
+				this->pid = -1;
+				this->closeFd(this->pidFd);
+			}
+
+			bool ChildProcess::tryWait(CommandResult &result)
+			{
+				if (this->pid < 0) {
+					return true;
+				}
+
+				int status;
+				pid_t waited = waitpid(this->pid, &status, WNOHANG);
+				if (waited == 0 || (waited < 0 && errno == EINTR)) {
+					return false;
+				}
+				result.setWaitStatus(waited < 0 ? (127 << 8) : status);
+				this->pid = -1;
+				this->closeFd(this->pidFd);
+				return true;
+			}
+
+			void ChildProcess::signal(int signal)
+			{
+				if (this->pid > 0) {
+					kill(this->processGroup ? -this->pid : this->pid, signal);
+				}
+			}
+
+			int ChildProcess::enforceTimeout(CommandResult &result)
+			{
+				if (this->pid < 0 || this->timeout.count() == 0 || this->killSent) {
+					return -1;
+				}
+
+				steady_clock::time_point now = steady_clock::now();
+				if (!this->termSent && now >= this->deadline) {
+					this->signal(SIGTERM);
+					this->termSent = true;
+					result.setTimedOut(true);
+				}
+				if (this->termSent && now >= this->deadline + this->killGracePeriod) {
+					this->signal(SIGKILL);
+					this->killSent = true;
+					return -1;
+				}
+
+				steady_clock::time_point next = this->termSent ? this->deadline + this->killGracePeriod : this->deadline;
+				return duration_cast<milliseconds>(next - now).count() + 1;
+			}
+
+			void ChildProcess::run(CommandResult &result)
+			{
+				while (true) {
+					bool open = this->readOutput(result);
+					if (this->tryWait(result)) {
+						this->readOutput(result);
+						return;
+					}
+
+					int timeout = this->enforceTimeout(result);
+					if (this->pidFd < 0 && !open) {
+						if (timeout < 0 && !this->termSent) {
+							this->wait(result);
+							return;
+						}
+						if (timeout < 0 || timeout > CHILDPROCESS_POLL_INTERVAL) {
+							timeout = CHILDPROCESS_POLL_INTERVAL;
+						}
+					}
+
+					struct pollfd fds[3] = {
+						{ this->outputFd, POLLIN, 0 },
+						{ this->errorFd, POLLIN, 0 },
+						{ this->pidFd, POLLIN, 0 }
+					};
+					poll(fds, 3, timeout);
+				}
+			}
+
+		}
+	}
+}
@@ -0,0 +1,163 @@
+
+#include "nebu-app-framework/circuitBreaker.h"
+
+#include "log4cxx/logger.h"
+
+#include <algorithm>
+
+// Using declarations - standard library
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::unique_lock;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CircuitBreaker"));
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CircuitBreaker::CircuitBreaker(unsigned int failureThreshold, unsigned int backoff,
+					unsigned int maxBackoff) :
+					failureThreshold(std::max(failureThreshold, 1U)), initialBackoff(backoff),
+					maxBackoff(std::max(backoff, maxBackoff)), breakerMutex(), state(CircuitState::CLOSED),
+					consecutiveFailures(0), backoff(backoff), openUntil(), probing(false), listener(), statistics()
+			{
+				this->statistics.successes = 0;
+				this->statistics.failures = 0;
+				this->statistics.ignored = 0;
+				this->statistics.rejected = 0;
+				this->statistics.probes = 0;
+				this->statistics.opened = 0;
+			}
+
+			bool CircuitBreaker::allowRequest()
+			{
+				unique_lock<mutex> lock(this->breakerMutex);
+				if (this->state == CircuitState::OPEN && steady_clock::now() >= this->openUntil) {
+					this->transition(CircuitState::HALF_OPEN, lock);
+				}
+
+				switch (this->state)
+				{
+				case CircuitState::CLOSED:
+					return true;
+				case CircuitState::HALF_OPEN:
+					if (!this->probing) {
+						this->probing = true;
+						this->statistics.probes++;
+						return true;
+					}
+					break;
+				case CircuitState::OPEN:
+					break;
+				}
+				this->statistics.rejected++;
+				return false;
+			}
+
+			void CircuitBreaker::recordSuccess()
+			{
+				unique_lock<mutex> lock(this->breakerMutex);
+				this->statistics.successes++;
+				this->consecutiveFailures = 0;
+				this->probing = false;
+				this->backoff = this->initialBackoff;
+				if (this->state != CircuitState::CLOSED) {
+					this->transition(CircuitState::CLOSED, lock);
+				}
+			}
+
+			void CircuitBreaker::recordFailure()
+			{
+				unique_lock<mutex> lock(this->breakerMutex);
+				this->statistics.failures++;
+				this->consecutiveFailures++;
+
+				if (this->state == CircuitState::HALF_OPEN && this->probing) {
+					// The service has not recovered, so wait longer before probing again
+					this->probing = false;
+					this->backoff = std::min(this->backoff * 2, this->maxBackoff);
+				} else if (this->state != CircuitState::CLOSED ||
+						this->consecutiveFailures < this->failureThreshold) {
+					return;
+				}
+
+				this->openUntil = steady_clock::now() + this->backoff;
+				this->statistics.opened++;
+				this->transition(CircuitState::OPEN, lock);
+			}
+
+			void CircuitBreaker::recordIgnored()
+			{
+				lock_guard<mutex> lock(this->breakerMutex);
+				this->statistics.ignored++;
+				this->probing = false;
+			}
+
+			void CircuitBreaker::transition(CircuitState state, unique_lock<mutex> &lock)
+			{
+				CircuitState previous = this->state;
+				this->state = state;
+				if (state == CircuitState::OPEN) {
+					LOG4CXX_WARN(logger, "Circuit opened after " << this->consecutiveFailures <<
+							" consecutive failures, rejecting requests for " << this->backoff.count() << " ms");
+				} else {
+					LOG4CXX_INFO(logger, "Circuit " << CircuitBreaker::toString(previous) << " -> " <<
+							CircuitBreaker::toString(state));
+				}
+
+				StateListener listener = this->listener;
+				if (listener) {
+					lock.unlock();
+					listener(previous, state);
+					lock.lock();
+				}
+			}
+
+			void CircuitBreaker::setStateListener(StateListener listener)
+			{
+				lock_guard<mutex> lock(this->breakerMutex);
+				this->listener = listener;
+			}
+
+			CircuitState CircuitBreaker::getState() const
+			{
+				lock_guard<mutex> lock(this->breakerMutex);
+				return this->state;
+			}
+
+			unsigned int CircuitBreaker::getBackoff() const
+			{
+				lock_guard<mutex> lock(this->breakerMutex);
+				return this->backoff.count();
+			}
+
+			CircuitBreaker::Statistics CircuitBreaker::getStatistics() const
+			{
+				lock_guard<mutex> lock(this->breakerMutex);
+				return this->statistics;
+			}
+
+			string CircuitBreaker::toString(CircuitState state)
+			{
+				switch (state)
+				{
+				case CircuitState::CLOSED:
+					return "closed";
+				case CircuitState::OPEN:
+					return "open";
+				case CircuitState::HALF_OPEN:
+					return "half-open";
+				}
+				return "unknown";
+			}
+
+		}
+	}
+}
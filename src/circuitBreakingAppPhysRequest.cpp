@@ -0,0 +1,43 @@
+
+#include "nebu-app-framework/circuitBreakingAppPhysRequest.h"
+
+// Using declarations - standard library
+using std::shared_ptr;
+// Using declarations - nebu-common
+using nebu::common::AppPhysRequest;
+using nebu::common::NebuClient;
+using nebu::common::PhysicalRoot;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CircuitBreakingAppPhysRequest::CircuitBreakingAppPhysRequest(shared_ptr<AppPhysRequest> appPhysRequest,
+					shared_ptr<CircuitBreaker> circuitBreaker) :
+					AppPhysRequest(shared_ptr<NebuClient>(), ""), appPhysRequest(appPhysRequest),
+					circuitBreaker(circuitBreaker)
+			{
+
+			}
+
+			shared_ptr<PhysicalRoot> CircuitBreakingAppPhysRequest::getPhysicalTopology()
+			{
+				if (!this->circuitBreaker->allowRequest()) {
+					throw CircuitOpenException("Circuit breaker is open, not requesting the topology");
+				}
+				try {
+					shared_ptr<PhysicalRoot> physicalRoot = this->appPhysRequest->getPhysicalTopology();
+					this->circuitBreaker->recordSuccess();
+					return physicalRoot;
+				} catch (...) {
+					this->circuitBreaker->recordFailure();
+					throw;
+				}
+			}
+
+		}
+	}
+}
@@ -0,0 +1,62 @@
+
+#include "nebu-app-framework/circuitBreakingAppVirtRequest.h"
+
+// Using declarations - standard library
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::AppVirtRequest;
+using nebu::common::NebuClient;
+using nebu::common::VirtualMachine;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CircuitBreakingAppVirtRequest::CircuitBreakingAppVirtRequest(shared_ptr<AppVirtRequest> appVirtRequest,
+					shared_ptr<CircuitBreaker> circuitBreaker) :
+					AppVirtRequest(shared_ptr<NebuClient>(), ""), appVirtRequest(appVirtRequest),
+					circuitBreaker(circuitBreaker)
+			{
+
+			}
+
+			vector<string> CircuitBreakingAppVirtRequest::getVirtualMachineIDs()
+			{
+				if (!this->circuitBreaker->allowRequest()) {
+					throw CircuitOpenException("Circuit breaker is open, not requesting the VM list");
+				}
+				try {
+					vector<string> vmIDs = this->appVirtRequest->getVirtualMachineIDs();
+					this->circuitBreaker->recordSuccess();
+					return vmIDs;
+				} catch (...) {
+					this->circuitBreaker->recordFailure();
+					throw;
+				}
+			}
+
+			VirtualMachine CircuitBreakingAppVirtRequest::getVirtualMachine(const string &uuid)
+			{
+				if (!this->circuitBreaker->allowRequest()) {
+					throw CircuitOpenException("Circuit breaker is open, not requesting VM " + uuid);
+				}
+				try {
+					VirtualMachine vm = this->appVirtRequest->getVirtualMachine(uuid);
+					this->circuitBreaker->recordSuccess();
+					return vm;
+				} catch (...) {
+					// A single VM can fail on its own, e.g. a bad record or an abandoned hedge; an unavailable
+					// server also fails the list of VMs, which opens the circuit
+					this->circuitBreaker->recordIgnored();
+					throw;
+				}
+			}
+
+		}
+	}
+}
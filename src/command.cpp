@@ -0,0 +1,132 @@
+
+#include "nebu-app-framework/command.h"
+
+#include <string.h>
+
+extern char **environ;
+
+// Using declarations - standard library
+using std::map;
+using std::string;
+using std::vector;
+
+#define COMMAND_DEFAULT_KILL_GRACE_PERIOD 2000
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			Command::Command(const vector<string> &arguments) :
+					arguments(arguments), label(), useShell(false), inheritEnvironment(true), captureOutput(true), pipeInput(false),
+					cacheable(false), timeout(0), killGracePeriod(COMMAND_DEFAULT_KILL_GRACE_PERIOD), environment(),
+					unsetVariables()
+			{
+
+			}
+
+			Command Command::shell(const string &commandLine)
+			{
+				Command command(vector<string> { "/bin/sh", "-c", commandLine });
+				command.useShell = true;
+				return command;
+			}
+
+			void Command::setEnvironment(const string &name, const string &value)
+			{
+				this->unsetVariables.erase(name);
+				this->environment[name] = value;
+			}
+
+			void Command::unsetEnvironment(const string &name)
+			{
+				this->environment.erase(name);
+				this->unsetVariables.insert(name);
+			}
+
+			vector<string> Command::buildEnvironment() const
+			{
+				vector<string> result;
+				if (this->inheritEnvironment) {
+					for (char **var = environ; *var != NULL; var++) {
+						const char *separator = strchr(*var, '=');
+						string name = separator ? string(*var, separator - *var) : string(*var);
+						if (this->environment.count(name) == 0 && this->unsetVariables.count(name) == 0) {
+							result.push_back(*var);
+						}
+					}
+				}
+				for (map<string, string>::const_iterator it = this->environment.begin();
+					it != this->environment.end();
+					it++)
+				{
+					result.push_back(it->first + "=" + it->second);
+				}
+				return result;
+			}
+
+			string Command::getLabel() const
+			{
+				if (!this->label.empty()) {
+					return this->label;
+				} else if (this->useShell) {
+					return "shell";
+				} else if (this->arguments.empty()) {
+					return "";
+				}
+
+				const string &program = this->arguments.front();
+				string::size_type slash = program.rfind('/');
+				return (slash == string::npos) ? program : program.substr(slash + 1);
+			}
+
+			string Command::toString() const
+			{
+				if (this->useShell) {
+					return this->arguments.back();
+				}
+
+				string result;
+				for (vector<string>::const_iterator it = this->arguments.begin(); it != this->arguments.end(); it++) {
+					if (it != this->arguments.begin()) {
+						result += " ";
+					}
+					result += *it;
+				}
+				return result;
+			}
+
+			string Command::toShellCommandLine() const
+			{
+				if (this->useShell) {
+					return this->arguments.back();
+				}
+
+				string result;
+				for (vector<string>::const_iterator it = this->arguments.begin(); it != this->arguments.end(); it++) {
+					if (it != this->arguments.begin()) {
+						result += " ";
+					}
+					result += Command::quote(*it);
+				}
+				return result;
+			}
+
+			string Command::quote(const string &str)
+			{
+				string quoted = "'";
+				for (string::const_iterator it = str.begin(); it != str.end(); it++) {
+					if (*it == '\'') {
+						quoted += "'\\''";
+					} else {
+						quoted += *it;
+					}
+				}
+				return quoted + "'";
+			}
+
+		}
+	}
+}
@@ -0,0 +1,191 @@
+
+#include "nebu-app-framework/commandBatch.h"
+#include "nebu-app-framework/commandMetrics.h"
+
+#include "log4cxx/logger.h"
+
+#include <atomic>
+#include <errno.h>
+#include <future>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::future;
+using std::map;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+/** Prefix of the lines separating the output of the commands in a combined script. */
+#define COMMANDBATCH_MARKER_PREFIX "__NEBU_BATCH_"
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CommandBatch"));
+
+static atomic<uint64_t> markerCounter(0);
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CommandBatch::CommandBatch(Invoker invoker) : invoker(invoker), stopOnFailure(false), timeout(0), pending()
+			{
+			}
+
+			size_t CommandBatch::add(const string &host, const string &commandLine)
+			{
+				PendingCommand command;
+				command.host = host;
+				command.commandLine = commandLine;
+				this->pending.push_back(command);
+				return this->pending.size() - 1;
+			}
+
+			size_t CommandBatch::add(const string &host, const Command &command)
+			{
+				return this->add(host, command.toShellCommandLine());
+			}
+
+			vector<CommandResult> CommandBatch::flush(const CommandRunner &runner)
+			{
+				vector<PendingCommand> commands;
+				commands.swap(this->pending);
+				vector<CommandResult> results(commands.size());
+
+				// Group the commands by host, keeping the order in which they were added
+				map<string, vector<size_t> > hosts;
+				for (size_t i = 0; i < commands.size(); i++) {
+					hosts[commands[i].host].push_back(i);
+				}
+
+				stringstream markerStream;
+				markerStream << COMMANDBATCH_MARKER_PREFIX << getpid() << "_" << markerCounter++;
+				string marker = markerStream.str();
+
+				vector<future<CommandResult> > invocations;
+				for (map<string, vector<size_t> >::const_iterator host = hosts.begin(); host != hosts.end(); host++) {
+					stringstream script;
+					for (size_t i = 0; i < host->second.size(); i++) {
+						script << "(" << commands[host->second[i]].commandLine << "\n) </dev/null\n" <<
+								"nebu_rc=$?\n" <<
+								"printf '\\n%s %d %d\\n' '" << marker << "' " << i << " $nebu_rc\n" <<
+								"printf '\\n%s %d\\n' '" << marker << "' " << i << " >&2\n";
+						if (this->stopOnFailure) {
+							script << "[ $nebu_rc -eq 0 ] || exit $nebu_rc\n";
+						}
+					}
+
+					Command command = this->invoker(host->first, script.str());
+					command.setTimeout(this->timeout);
+					invocations.push_back(runner.executeAsync(command));
+				}
+
+				vector<future<CommandResult> >::iterator invocation = invocations.begin();
+				for (map<string, vector<size_t> >::const_iterator host = hosts.begin(); host != hosts.end(); host++) {
+					this->splitResults(marker, invocation->get(), host->second, results);
+					invocation++;
+				}
+
+				CommandMetrics::getInstance()->recordBatch(commands.size(), hosts.size());
+				LOG4CXX_DEBUG(logger, "Executed " << commands.size() << " commands using " << hosts.size() <<
+						" processes");
+				return results;
+			}
+
+			void CommandBatch::splitResults(const string &marker, const CommandResult &invocation,
+					const vector<size_t> &indices, vector<CommandResult> &results) const
+			{
+				const string &output = invocation.getOutput();
+				const string &error = invocation.getError();
+				string separator = "\n" + marker + " ";
+				string::size_type outputPosition = 0;
+				string::size_type errorPosition = 0;
+				bool failed = false;
+
+				for (size_t i = 0; i < indices.size(); i++) {
+					CommandResult &result = results[indices[i]];
+					string::size_type outputEnd = output.find(separator, outputPosition);
+					if (outputEnd == string::npos) {
+						// The command did not complete: it was skipped, or the invocation itself failed
+						if (failed && this->stopOnFailure) {
+							result.setSpawnError(ECANCELED);
+						} else {
+							result.setWaitStatus(invocation.getWaitStatus());
+							result.setSpawnError(invocation.getSpawnError());
+							result.setTimedOut(invocation.hasTimedOut());
+							result.getOutputBuffer().assign(output, outputPosition, string::npos);
+							result.getErrorBuffer().assign(error, errorPosition, string::npos);
+						}
+						outputPosition = output.size();
+						errorPosition = error.size();
+						failed = true;
+						continue;
+					}
+
+					result.getOutputBuffer().assign(output, outputPosition, outputEnd - outputPosition);
+					string::size_type lineStart = outputEnd + separator.size();
+					string::size_type lineEnd = output.find('\n', lineStart);
+					outputPosition = (lineEnd == string::npos) ? output.size() : lineEnd + 1;
+					int exitCode = 0;
+					if (parseMarker(output.substr(lineStart, (lineEnd == string::npos) ? string::npos :
+							lineEnd - lineStart), i, exitCode)) {
+						result.setWaitStatus((exitCode & 0xff) << 8);
+						failed = failed || exitCode != 0;
+					} else {
+						LOG4CXX_WARN(logger, "Malformed exit status marker for command " << i << " of a batch");
+						result.setSpawnError(EPROTO);
+						failed = true;
+					}
+
+					string::size_type errorEnd = error.find(separator, errorPosition);
+					if (errorEnd == string::npos) {
+						result.getErrorBuffer().assign(error, errorPosition, string::npos);
+						errorPosition = error.size();
+					} else {
+						result.getErrorBuffer().assign(error, errorPosition, errorEnd - errorPosition);
+						lineEnd = error.find('\n', errorEnd + separator.size());
+						errorPosition = (lineEnd == string::npos) ? error.size() : lineEnd + 1;
+					}
+				}
+			}
+
+			bool CommandBatch::parseMarker(const string &line, size_t index, int &exitCode)
+			{
+				// The marker is followed by "<index> <exit code>"
+				const char *start = line.c_str();
+				char *end;
+				errno = 0;
+				unsigned long parsedIndex = strtoul(start, &end, 10);
+				if (end == start || *end != ' ' || errno != 0 || parsedIndex != index) {
+					return false;
+				}
+				start = end + 1;
+				long parsedExitCode = strtol(start, &end, 10);
+				if (end == start || *end != '\0' || errno != 0 || parsedExitCode < 0 || parsedExitCode > 255) {
+					return false;
+				}
+				exitCode = static_cast<int>(parsedExitCode);
+				return true;
+			}
+
+			Command CommandBatch::localInvoker(const string &, const string &script)
+			{
+				return Command::shell(script);
+			}
+
+			Command CommandBatch::sshInvoker(const string &host, const string &script)
+			{
+				return Command(vector<string> { "ssh", "-o", "BatchMode=yes", host, "/bin/sh -c " +
+						Command::quote(script) });
+			}
+
+		}
+	}
+}
@@ -0,0 +1,139 @@
+
+#include "nebu-app-framework/commandCache.h"
+#include "nebu-app-framework/commandMetrics.h"
+
+#include "log4cxx/logger.h"
+
+// Using declarations - standard library
+using std::lock_guard;
+using std::map;
+using std::mutex;
+using std::promise;
+using std::shared_future;
+using std::string;
+using std::unique_lock;
+using std::vector;
+using std::chrono::steady_clock;
+
+/** Number of kept results above which expired results are removed when a new result is stored. */
+#define COMMANDCACHE_PURGE_THRESHOLD 256
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CommandCache"));
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			CommandCache::CommandCache(unsigned int ttl) :
+					ttl(ttl), cacheMutex(), entries(), running(), statistics()
+			{
+				this->statistics.misses = 0;
+				this->statistics.coalesced = 0;
+				this->statistics.hits = 0;
+			}
+
+			bool CommandCache::isCacheable(const Command &command) const
+			{
+				return command.isCacheable() && !command.hasCustomEnvironment() && !command.pipesInput();
+			}
+
+			string CommandCache::createKey(const Command &command)
+			{
+				// Arguments cannot contain NUL characters, so they are used to separate the parts of the key
+				string key;
+				key += command.capturesOutput() ? 'c' : 'u';
+				key += std::to_string(command.getTimeout());
+				const vector<string> &arguments = command.getArguments();
+				for (vector<string>::const_iterator it = arguments.begin(); it != arguments.end(); it++) {
+					key += '\0';
+					key += *it;
+				}
+				return key;
+			}
+
+			void CommandCache::execute(const Command &command, CommandResult &result, const Runner &runner)
+			{
+				string key = CommandCache::createKey(command);
+				promise<CommandResult> flight;
+				{
+					unique_lock<mutex> lock(this->cacheMutex);
+					map<string, Entry>::iterator entry = this->entries.find(key);
+					if (entry != this->entries.end()) {
+						if (entry->second.expires > steady_clock::now()) {
+							this->statistics.hits++;
+							result = entry->second.result;
+							lock.unlock();
+							CommandMetrics::getInstance()->recordCacheHit(command);
+							return;
+						}
+						this->entries.erase(entry);
+					}
+
+					map<string, shared_future<CommandResult> >::iterator other = this->running.find(key);
+					if (other != this->running.end()) {
+						this->statistics.coalesced++;
+						shared_future<CommandResult> future = other->second;
+						lock.unlock();
+						CommandMetrics::getInstance()->recordCoalesced(command);
+						LOG4CXX_DEBUG(logger, "Waiting for identical command: '" << command.toString() << "'");
+						result = future.get();
+						return;
+					}
+
+					this->statistics.misses++;
+					this->running[key] = flight.get_future().share();
+				}
+
+				try {
+					runner(command, result);
+				} catch (...) {
+					lock_guard<mutex> lock(this->cacheMutex);
+					this->running.erase(key);
+					flight.set_exception(std::current_exception());
+					throw;
+				}
+
+				lock_guard<mutex> lock(this->cacheMutex);
+				this->running.erase(key);
+				if (this->ttl.count() > 0 && result.getSpawnError() == 0 && !result.hasTimedOut()) {
+					steady_clock::time_point now = steady_clock::now();
+					if (this->entries.size() >= COMMANDCACHE_PURGE_THRESHOLD) {
+						this->purgeExpired(now);
+					}
+					Entry &entry = this->entries[key];
+					entry.result = result;
+					entry.expires = now + this->ttl;
+				}
+				flight.set_value(result);
+			}
+
+			void CommandCache::purgeExpired(steady_clock::time_point now)
+			{
+				map<string, Entry>::iterator it = this->entries.begin();
+				while (it != this->entries.end()) {
+					if (it->second.expires <= now) {
+						it = this->entries.erase(it);
+					} else {
+						it++;
+					}
+				}
+			}
+
+			void CommandCache::clear()
+			{
+				lock_guard<mutex> lock(this->cacheMutex);
+				this->entries.clear();
+			}
+
+			CommandCache::Statistics CommandCache::getStatistics() const
+			{
+				lock_guard<mutex> lock(this->cacheMutex);
+				return this->statistics;
+			}
+
+		}
+	}
+}
@@ -0,0 +1,318 @@
+
+#include "nebu-app-framework/commandExecutor.h"
+#include "nebu-app-framework/childProcess.h"
+#include "nebu-app-framework/commandMetrics.h"
+
+#include "log4cxx/logger.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::future;
+using std::lock_guard;
+using std::make_shared;
+using std::map;
+using std::mutex;
+using std::promise;
+using std::shared_ptr;
+using std::thread;
+using std::unique_lock;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CommandExecutor"));
+
+#define COMMANDEXECUTOR_MAX_EVENTS 64
+#define COMMANDEXECUTOR_POLL_INTERVAL 50
+
+// Keys registered with epoll: the job ID shifted left by two bits, with the type of descriptor in the low bits.
+#define COMMANDEXECUTOR_KEY_WAKE 0
+#define COMMANDEXECUTOR_KEY_OUTPUT 1
+#define COMMANDEXECUTOR_KEY_PIDFD 2
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			struct CommandExecutor::Job
+			{
+				Job(const Command &command, Callback callback) :
+						id(0), command(command), callback(callback), process(), result(), started(false), startTime() { }
+
+				uint64_t id;
+				Command command;
+				Callback callback;
+				ChildProcess process;
+				CommandResult result;
+				bool started;
+				steady_clock::time_point startTime;
+			};
+
+			CommandExecutor::CommandExecutor(unsigned int maxConcurrentChildren) :
+					jobsMutex(), idle(), queue(), running(), maxConcurrentChildren(maxConcurrentChildren),
+					outstanding(0), nextJobID(1), stopping(false), epollFd(-1), wakeFd(-1), reaper()
+			{
+				if (this->maxConcurrentChildren == 0) {
+					this->maxConcurrentChildren = 1;
+				}
+				this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+				this->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+				this->watchFd(this->wakeFd, COMMANDEXECUTOR_KEY_WAKE);
+				this->reaper = thread(&CommandExecutor::reaperLoop, this);
+			}
+
+			CommandExecutor::~CommandExecutor()
+			{
+				{
+					lock_guard<mutex> lock(this->jobsMutex);
+					this->stopping = true;
+				}
+				this->wakeReaper();
+				this->reaper.join();
+				close(this->epollFd);
+				close(this->wakeFd);
+			}
+
+			future<CommandResult> CommandExecutor::submit(const Command &command)
+			{
+				shared_ptr<promise<CommandResult>> result = make_shared<promise<CommandResult>>();
+				this->submit(command, [result](const CommandResult &commandResult) {
+					result->set_value(commandResult);
+				});
+				return result->get_future();
+			}
+
+			void CommandExecutor::submit(const Command &command, Callback callback)
+			{
+				shared_ptr<Job> job = make_shared<Job>(command, callback);
+				{
+					lock_guard<mutex> lock(this->jobsMutex);
+					job->id = this->nextJobID++;
+					this->queue.push_back(job);
+					this->outstanding++;
+				}
+				this->wakeReaper();
+			}
+
+			void CommandExecutor::waitAll()
+			{
+				unique_lock<mutex> lock(this->jobsMutex);
+				while (this->outstanding > 0) {
+					this->idle.wait(lock);
+				}
+			}
+
+			void CommandExecutor::setMaxConcurrentChildren(unsigned int maxConcurrentChildren)
+			{
+				{
+					lock_guard<mutex> lock(this->jobsMutex);
+					this->maxConcurrentChildren = (maxConcurrentChildren > 0) ? maxConcurrentChildren : 1;
+				}
+				this->wakeReaper();
+			}
+
+			unsigned int CommandExecutor::getMaxConcurrentChildren() const
+			{
+				lock_guard<mutex> lock(this->jobsMutex);
+				return this->maxConcurrentChildren;
+			}
+
+			unsigned int CommandExecutor::getRunningChildren() const
+			{
+				lock_guard<mutex> lock(this->jobsMutex);
+				return this->running.size();
+			}
+
+			unsigned int CommandExecutor::getQueuedCommands() const
+			{
+				lock_guard<mutex> lock(this->jobsMutex);
+				return this->queue.size();
+			}
+
+			void CommandExecutor::wakeReaper()
+			{
+				uint64_t value = 1;
+				if (write(this->wakeFd, &value, sizeof(value)) != sizeof(value)) {
+					LOG4CXX_WARN(logger, "Could not wake the reaper thread");
+				}
+			}
+
+			void CommandExecutor::watchFd(int fd, uint64_t key)
+			{
+				if (fd < 0) {
+					return;
+				}
+				struct epoll_event event;
+				event.events = EPOLLIN;
+				event.data.u64 = key;
+				epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event);
+			}
+
+			void CommandExecutor::startQueuedJobs()
+			{
+				while (true) {
+					shared_ptr<Job> job;
+					{
+						lock_guard<mutex> lock(this->jobsMutex);
+						if (this->queue.empty()) {
+							return;
+						}
+						if (this->stopping) {
+							job = this->queue.front();
+							job->result.setSpawnError(ECANCELED);
+						} else if (this->running.size() < this->maxConcurrentChildren) {
+							job = this->queue.front();
+						} else {
+							return;
+						}
+						this->queue.pop_front();
+					}
+
+					if (job->result.getSpawnError() != 0) {
+						this->completeJob(job);
+						continue;
+					}
+
+					LOG4CXX_DEBUG(logger, "Executing command: '" << job->command.toString() << "'");
+					shared_ptr<CommandMetrics> metrics = CommandMetrics::getInstance();
+					metrics->commandStarted();
+					job->started = true;
+					job->startTime = steady_clock::now();
+					int error = job->process.spawn(job->command);
+					metrics->recordSpawn(job->command, duration_cast<microseconds>(steady_clock::now() - job->startTime));
+					if (error != 0) {
+						LOG4CXX_WARN(logger, "Could not start command '" << job->command.toString() << "': " <<
+								strerror(error));
+						job->result.setSpawnError(error);
+						this->completeJob(job);
+						continue;
+					}
+
+					{
+						lock_guard<mutex> lock(this->jobsMutex);
+						this->running[job->id] = job;
+					}
+					this->watchFd(job->process.getOutputFd(), (job->id << 2) | COMMANDEXECUTOR_KEY_OUTPUT);
+					this->watchFd(job->process.getErrorFd(), (job->id << 2) | COMMANDEXECUTOR_KEY_OUTPUT);
+					this->watchFd(job->process.getPidFd(), (job->id << 2) | COMMANDEXECUTOR_KEY_PIDFD);
+				}
+			}
+
+			void CommandExecutor::completeJob(shared_ptr<Job> job)
+			{
+				{
+					lock_guard<mutex> lock(this->jobsMutex);
+					this->running.erase(job->id);
+				}
+
+				if (job->started) {
+					CommandMetrics::getInstance()->commandCompleted(job->command, job->result,
+							duration_cast<microseconds>(steady_clock::now() - job->startTime));
+				}
+				if (job->result.hasTimedOut()) {
+					LOG4CXX_WARN(logger, "Command timed out: '" << job->command.toString() << "'");
+				}
+				try {
+					job->callback(job->result);
+				} catch (...) {
+					LOG4CXX_WARN(logger, "Callback of command '" << job->command.toString() << "' threw an exception");
+				}
+
+				lock_guard<mutex> lock(this->jobsMutex);
+				this->outstanding--;
+				if (this->outstanding == 0) {
+					this->idle.notify_all();
+				}
+			}
+
+			void CommandExecutor::reaperLoop()
+			{
+				struct epoll_event events[COMMANDEXECUTOR_MAX_EVENTS];
+				bool killed = false;
+
+				while (true) {
+					this->startQueuedJobs();
+
+					// Copy the running jobs; only this thread removes them, so the copy stays valid.
+					map<uint64_t, shared_ptr<Job>> jobs;
+					bool stop;
+					{
+						lock_guard<mutex> lock(this->jobsMutex);
+						jobs = this->running;
+						stop = this->stopping;
+					}
+					if (stop && !killed) {
+						for (map<uint64_t, shared_ptr<Job>>::iterator it = jobs.begin(); it != jobs.end(); it++) {
+							it->second->process.signal(SIGKILL);
+						}
+						killed = true;
+					}
+					if (stop && jobs.empty()) {
+						return;
+					}
+
+					// Find the nearest timeout deadline. Without pidfd support, children are polled.
+					int timeout = -1;
+					bool pollChildren = false;
+					for (map<uint64_t, shared_ptr<Job>>::iterator it = jobs.begin(); it != jobs.end(); it++) {
+						int jobTimeout = it->second->process.enforceTimeout(it->second->result);
+						if (jobTimeout >= 0 && (timeout < 0 || jobTimeout < timeout)) {
+							timeout = jobTimeout;
+						}
+						pollChildren |= (it->second->process.getPidFd() < 0);
+					}
+					if (pollChildren && (timeout < 0 || timeout > COMMANDEXECUTOR_POLL_INTERVAL)) {
+						timeout = COMMANDEXECUTOR_POLL_INTERVAL;
+					}
+
+					int count = epoll_wait(this->epollFd, events, COMMANDEXECUTOR_MAX_EVENTS, timeout);
+					for (int i = 0; i < count; i++) {
+						uint64_t key = events[i].data.u64;
+						if (key == COMMANDEXECUTOR_KEY_WAKE) {
+							uint64_t value;
+							if (read(this->wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+								LOG4CXX_WARN(logger, "Could not read wake-up event");
+							}
+							continue;
+						}
+
+						map<uint64_t, shared_ptr<Job>>::iterator it = jobs.find(key >> 2);
+						if (it == jobs.end()) {
+							continue;
+						}
+						shared_ptr<Job> job = it->second;
+						job->process.readOutput(job->result);
+						if ((key & 3) == COMMANDEXECUTOR_KEY_PIDFD && job->process.tryWait(job->result)) {
+							job->process.readOutput(job->result);
+							jobs.erase(it);
+							this->completeJob(job);
+						}
+					}
+
+					if (pollChildren) {
+						for (map<uint64_t, shared_ptr<Job>>::iterator it = jobs.begin(); it != jobs.end(); ) {
+							shared_ptr<Job> job = (it++)->second;
+							if (job->process.getPidFd() < 0) {
+								job->process.readOutput(job->result);
+								if (job->process.tryWait(job->result)) {
+									job->process.readOutput(job->result);
+									this->completeJob(job);
+								}
+							}
+						}
+					}
+				}
+			}
+
+		}
+	}
+}
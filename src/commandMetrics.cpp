@@ -0,0 +1,232 @@
+
+#include "nebu-app-framework/commandMetrics.h"
+#include "nebu-app-framework/configuration.h"
+
+#include "log4cxx/logger.h"
+
+#include <iomanip>
+#include <sstream>
+
+// Using declarations - standard library
+using std::lock_guard;
+using std::make_shared;
+using std::map;
+using std::mutex;
+using std::shared_ptr;
+using std::string;
+using std::stringstream;
+using std::chrono::microseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CommandMetrics"));
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			shared_ptr<CommandMetrics> CommandMetrics::instance;
+			mutex CommandMetrics::instanceMutex;
+
+			CommandMetrics::LabelStatistics::LabelStatistics() :
+					count(0), totalTime(0), maxTime(0), buckets(COMMANDMETRICS_BUCKETS, 0), spawns(0), totalSpawnTime(0),
+					spawnFailures(0), timeouts(0), exitCodes(), signals(), cacheHits(0), coalesced(0)
+			{
+			}
+
+			double CommandMetrics::LabelStatistics::getLatencyPercentile(double percentile) const
+			{
+				if (this->count == 0) {
+					return 0;
+				}
+
+				double rank = percentile / 100.0 * this->count;
+				uint64_t seen = 0;
+				for (unsigned int i = 0; i < this->buckets.size(); i++) {
+					seen += this->buckets[i];
+					if (seen >= rank && this->buckets[i] > 0) {
+						// The last bucket is unbounded, so the maximum is the best estimate
+						return (i + 1 == this->buckets.size()) ? this->maxTime / 1000.0 : (1 << i);
+					}
+				}
+				return this->maxTime / 1000.0;
+			}
+
+			double CommandMetrics::LabelStatistics::getMeanLatency() const
+			{
+				return (this->count == 0) ? 0 : this->totalTime / 1000.0 / this->count;
+			}
+
+			double CommandMetrics::LabelStatistics::getMeanSpawnTime() const
+			{
+				return (this->spawns == 0) ? 0 : this->totalSpawnTime / 1000.0 / this->spawns;
+			}
+
+			CommandMetrics::CommandMetrics() :
+					metricsMutex(), statistics(), batchStatistics(), runningCommands(0), peakRunningCommands(0),
+					lastSummary(steady_clock::now())
+			{
+			}
+
+			void CommandMetrics::commandStarted()
+			{
+				unsigned int running = ++this->runningCommands;
+				unsigned int peak = this->peakRunningCommands;
+				while (running > peak && !this->peakRunningCommands.compare_exchange_weak(peak, running)) {
+				}
+			}
+
+			void CommandMetrics::recordSpawn(const Command &command, microseconds duration)
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				LabelStatistics &label = this->statistics[command.getLabel()];
+				label.spawns++;
+				label.totalSpawnTime += duration.count();
+			}
+
+			void CommandMetrics::commandCompleted(const Command &command, const CommandResult &result,
+					microseconds wallTime)
+			{
+				this->runningCommands--;
+
+				uint64_t time = wallTime.count();
+				unsigned int bucket = 0;
+				while (bucket + 1 < COMMANDMETRICS_BUCKETS && time >= (uint64_t(1000) << bucket)) {
+					bucket++;
+				}
+
+				lock_guard<mutex> lock(this->metricsMutex);
+				LabelStatistics &label = this->statistics[command.getLabel()];
+				label.count++;
+				label.totalTime += time;
+				if (time > label.maxTime) {
+					label.maxTime = time;
+				}
+				label.buckets[bucket]++;
+				if (result.getSpawnError() != 0) {
+					label.spawnFailures++;
+				} else if (result.wasSignaled()) {
+					label.signals[result.getSignal()]++;
+				} else {
+					label.exitCodes[result.getExitCode()]++;
+				}
+				if (result.hasTimedOut()) {
+					label.timeouts++;
+				}
+			}
+
+			void CommandMetrics::recordCacheHit(const Command &command)
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				this->statistics[command.getLabel()].cacheHits++;
+			}
+
+			void CommandMetrics::recordCoalesced(const Command &command)
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				this->statistics[command.getLabel()].coalesced++;
+			}
+
+			void CommandMetrics::recordBatch(size_t commands, size_t invocations)
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				this->batchStatistics.batches++;
+				this->batchStatistics.commands += commands;
+				this->batchStatistics.invocations += invocations;
+			}
+
+			map<string, CommandMetrics::LabelStatistics> CommandMetrics::getStatistics() const
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				return this->statistics;
+			}
+
+			CommandMetrics::BatchStatistics CommandMetrics::getBatchStatistics() const
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				return this->batchStatistics;
+			}
+
+			void CommandMetrics::reset()
+			{
+				lock_guard<mutex> lock(this->metricsMutex);
+				this->statistics.clear();
+				this->batchStatistics = BatchStatistics();
+				this->peakRunningCommands = this->runningCommands.load();
+			}
+
+			string CommandMetrics::toString() const
+			{
+				map<string, LabelStatistics> statistics = this->getStatistics();
+				BatchStatistics batches = this->getBatchStatistics();
+				stringstream str;
+				str << std::fixed << std::setprecision(1);
+				str << "Commands running: " << this->getRunningCommands() << " (peak " <<
+						this->getPeakRunningCommands() << ")";
+				if (batches.batches > 0) {
+					str << "; " << batches.commands << " batched commands in " << batches.invocations << " processes";
+				}
+				for (map<string, LabelStatistics>::const_iterator it = statistics.begin(); it != statistics.end(); it++) {
+					const LabelStatistics &label = it->second;
+					uint64_t failures = label.spawnFailures;
+					for (map<int, uint64_t>::const_iterator code = label.exitCodes.begin();
+							code != label.exitCodes.end(); code++) {
+						if (code->first != 0) {
+							failures += code->second;
+						}
+					}
+					for (map<int, uint64_t>::const_iterator signal = label.signals.begin();
+							signal != label.signals.end(); signal++) {
+						failures += signal->second;
+					}
+
+					str << std::endl << "\t" << it->first << ": " << label.count << " commands, " << failures <<
+							" failed, " << label.timeouts << " timed out; mean " << label.getMeanLatency() << " ms, p50 <" <<
+							label.getLatencyPercentile(50) << " ms, p99 <" << label.getLatencyPercentile(99) <<
+							" ms, max " << (label.maxTime / 1000.0) << " ms; spawn " << label.getMeanSpawnTime() << " ms";
+					if (label.cacheHits > 0 || label.coalesced > 0) {
+						str << "; " << label.cacheHits << " cached, " << label.coalesced << " coalesced";
+					}
+				}
+				return str.str();
+			}
+
+			void CommandMetrics::logSummaryIfDue()
+			{
+				int interval = CONFIG_GETINT(CONFIG_APP_COMMAND_METRICSINTERVAL);
+				if (interval <= 0) {
+					return;
+				}
+
+				{
+					lock_guard<mutex> lock(this->metricsMutex);
+					steady_clock::time_point now = steady_clock::now();
+					if (now - this->lastSummary < seconds(interval)) {
+						return;
+					}
+					this->lastSummary = now;
+				}
+				LOG4CXX_INFO(logger, this->toString());
+			}
+
+			shared_ptr<CommandMetrics> CommandMetrics::getInstance()
+			{
+				lock_guard<mutex> lock(CommandMetrics::instanceMutex);
+				if (!CommandMetrics::instance) {
+					CommandMetrics::instance = make_shared<CommandMetrics>();
+				}
+				return CommandMetrics::instance;
+			}
+
+			void CommandMetrics::setInstance(shared_ptr<CommandMetrics> instance)
+			{
+				lock_guard<mutex> lock(CommandMetrics::instanceMutex);
+				CommandMetrics::instance = instance;
+			}
+
+		}
+	}
+}
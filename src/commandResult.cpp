@@ -0,0 +1,43 @@
+
+#include "nebu-app-framework/commandResult.h"
+
+#include <sys/wait.h>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			bool CommandResult::hasExited() const
+			{
+				return WIFEXITED(this->waitStatus);
+			}
+
+			int CommandResult::getExitCode() const
+			{
+				return this->hasExited() ? WEXITSTATUS(this->waitStatus) : -1;
+			}
+
+			bool CommandResult::wasSignaled() const
+			{
+				return WIFSIGNALED(this->waitStatus);
+			}
+
+			int CommandResult::getSignal() const
+			{
+				return this->wasSignaled() ? WTERMSIG(this->waitStatus) : 0;
+			}
+
+			void CommandResult::setSpawnError(int spawnError)
+			{
+				this->spawnError = spawnError;
+				if (spawnError != 0) {
+					this->waitStatus = 127 << 8;
+				}
+			}
+
+		}
+	}
+}
@@ -1,12 +1,34 @@
 
 #include "nebu-app-framework/commandRunner.h"
+#include "nebu-app-framework/childProcess.h"
+#include "nebu-app-framework/commandMetrics.h"
+#include "nebu-app-framework/configuration.h"
 
 #include "log4cxx/logger.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <string.h>
+#include <utility>
+
 // Using declarations - standard library
+using std::condition_variable;
+using std::deque;
+using std::future;
+using std::lock_guard;
 using std::make_shared;
+using std::mutex;
+using std::pair;
+using std::set;
 using std::shared_ptr;
 using std::string;
+using std::unique_lock;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
 
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.CommandRunner"));
 
@@ -21,12 +43,225 @@ namespace nebu
 
 			int CommandRunner::runCommand(const string &command) const
 			{
-				LOG4CXX_DEBUG(logger, "Executing shell command: '" << command << "'");
-				int result = system(command.c_str());
-				LOG4CXX_DEBUG(logger, "Shell command returned with: " << result);
+				return this->runCommand(command, false);
+			}
+
+			int CommandRunner::runCommand(const string &command, bool cacheable) const
+			{
+				Command shellCommand = Command::shell(command);
+				shellCommand.setCaptureOutput(false);
+				shellCommand.setCacheable(cacheable);
+
+				CommandResult result;
+				this->execute(shellCommand, result);
+				return result.getWaitStatus();
+			}
+
+			CommandResult CommandRunner::execute(const Command &command) const
+			{
+				CommandResult result;
+				this->execute(command, result);
 				return result;
 			}
 
+			void CommandRunner::execute(const Command &command, CommandResult &result) const
+			{
+				shared_ptr<CommandCache> cache = this->getCommandCache();
+				if (cache && cache->isCacheable(command)) {
+					cache->execute(command, result, [this](const Command &command, CommandResult &result) {
+						this->executeDirect(command, result);
+					});
+				} else {
+					this->executeDirect(command, result);
+				}
+			}
+
+			void CommandRunner::executeDirect(const Command &command, CommandResult &result) const
+			{
+				typedef std::chrono::steady_clock Clock;
+
+				LOG4CXX_DEBUG(logger, "Executing command: '" << command.toString() << "'");
+				shared_ptr<CommandMetrics> metrics = CommandMetrics::getInstance();
+				metrics->commandStarted();
+				Clock::time_point start = Clock::now();
+
+				shared_ptr<ShellWorkerPool> pool = this->getShellWorkerPool();
+				if (pool && pool->canExecute(command)) {
+					pool->execute(command, result);
+				} else {
+					result.clear();
+					ChildProcess process;
+					int error = process.spawn(command);
+					metrics->recordSpawn(command, duration_cast<microseconds>(Clock::now() - start));
+					if (error != 0) {
+						LOG4CXX_WARN(logger, "Could not start command '" << command.toString() << "': " << strerror(error));
+						result.setSpawnError(error);
+					} else {
+						process.run(result);
+					}
+				}
+				metrics->commandCompleted(command, result, duration_cast<microseconds>(Clock::now() - start));
+
+				if (result.wasSignaled()) {
+					LOG4CXX_DEBUG(logger, "Command terminated by signal " << result.getSignal());
+				} else {
+					LOG4CXX_DEBUG(logger, "Command exited with code " << result.getExitCode());
+				}
+			}
+
+			future<CommandResult> CommandRunner::executeAsync(const Command &command) const
+			{
+				return this->getExecutor()->submit(command);
+			}
+
+			void CommandRunner::executeAsync(const Command &command, CommandExecutor::Callback callback) const
+			{
+				this->getExecutor()->submit(command, callback);
+			}
+
+			void CommandRunner::waitAll() const
+			{
+				shared_ptr<CommandExecutor> executor;
+				{
+					lock_guard<mutex> lock(this->executorMutex);
+					executor = this->executor;
+				}
+				if (executor) {
+					executor->waitAll();
+				}
+			}
+
+			FanOutSummary CommandRunner::fanOut(const CommandTemplate &commandTemplate,
+					const vector<shared_ptr<VirtualMachine> > &vms, unsigned int parallelism, FanOutCallback callback) const
+			{
+				typedef std::chrono::steady_clock Clock;
+				typedef pair<size_t, CommandResult> Completion;
+
+				LOG4CXX_DEBUG(logger, "Fanning out '" << commandTemplate.getPrototype().toString() << "' to " <<
+						vms.size() << " hosts");
+				if (parallelism == 0) {
+					parallelism = 1;
+				}
+
+				// Completions are handed over to the calling thread, which runs the callbacks and keeps the pipeline full.
+				// The callbacks share ownership of the hand-over, as commands still run if the calling thread throws
+				struct Completions
+				{
+					mutex completionMutex;
+					condition_variable completed;
+					deque<Completion> completions;
+				};
+				shared_ptr<Completions> state = make_shared<Completions>();
+				vector<Clock::time_point> startTimes(vms.size());
+
+				FanOutSummary summary;
+				size_t submitted = 0;
+				size_t finished = 0;
+				while (finished < vms.size()) {
+					while (submitted < vms.size() && submitted - finished < parallelism) {
+						size_t index = submitted++;
+						startTimes[index] = Clock::now();
+						this->executeAsync(commandTemplate.instantiate(*vms[index]),
+								[index, state](const CommandResult &result) {
+							lock_guard<mutex> lock(state->completionMutex);
+							state->completions.push_back(Completion(index, result));
+							state->completed.notify_one();
+						});
+					}
+
+					Completion completion;
+					{
+						unique_lock<mutex> lock(state->completionMutex);
+						state->completed.wait(lock, [&state]() { return !state->completions.empty(); });
+						completion = std::move(state->completions.front());
+						state->completions.pop_front();
+					}
+					finished++;
+
+					const shared_ptr<VirtualMachine> &vm = vms[completion.first];
+					unsigned int latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+							Clock::now() - startTimes[completion.first]).count();
+					summary.addResult(vm->getHostname(), completion.second, latency);
+					if (!completion.second.succeeded()) {
+						LOG4CXX_DEBUG(logger, "Fan-out command failed on " << vm->getHostname());
+					}
+					if (callback) {
+						callback(vm, completion.second);
+					}
+				}
+
+				LOG4CXX_INFO(logger, "Fan-out of '" << commandTemplate.getPrototype().toString() << "' to " <<
+						summary.toString());
+				return summary;
+			}
+
+			FanOutSummary CommandRunner::fanOut(const CommandTemplate &commandTemplate,
+					const set<shared_ptr<Daemon> > &daemons, unsigned int parallelism, FanOutCallback callback) const
+			{
+				set<shared_ptr<VirtualMachine> > seen;
+				vector<shared_ptr<VirtualMachine> > vms;
+				for (set<shared_ptr<Daemon> >::const_iterator it = daemons.begin(); it != daemons.end(); it++) {
+					shared_ptr<VirtualMachine> vm = (*it)->getHostVM();
+					if (!vm) {
+						LOG4CXX_WARN(logger, "Not fanning out to a Daemon without a host VM");
+						continue;
+					}
+					if (seen.insert(vm).second) {
+						vms.push_back(vm);
+					}
+				}
+				return this->fanOut(commandTemplate, vms, parallelism, callback);
+			}
+
+			shared_ptr<CommandExecutor> CommandRunner::getExecutor() const
+			{
+				lock_guard<mutex> lock(this->executorMutex);
+				if (!this->executor) {
+					this->executor = make_shared<CommandExecutor>(CONFIG_GETINT(CONFIG_APP_COMMAND_MAXCONCURRENT));
+				}
+				return this->executor;
+			}
+
+			void CommandRunner::setShellWorkerPool(shared_ptr<ShellWorkerPool> pool)
+			{
+				lock_guard<mutex> lock(this->executorMutex);
+				this->shellWorkerPool = pool;
+				this->shellWorkerPoolConfigured = true;
+			}
+
+			shared_ptr<ShellWorkerPool> CommandRunner::getShellWorkerPool() const
+			{
+				lock_guard<mutex> lock(this->executorMutex);
+				if (!this->shellWorkerPoolConfigured) {
+					int workers = CONFIG_GETINT(CONFIG_APP_COMMAND_SHELLWORKERS);
+					if (workers > 0) {
+						this->shellWorkerPool = make_shared<ShellWorkerPool>(workers);
+					}
+					this->shellWorkerPoolConfigured = true;
+				}
+				return this->shellWorkerPool;
+			}
+
+			void CommandRunner::setCommandCache(shared_ptr<CommandCache> cache)
+			{
+				lock_guard<mutex> lock(this->executorMutex);
+				this->commandCache = cache;
+				this->commandCacheConfigured = true;
+			}
+
+			shared_ptr<CommandCache> CommandRunner::getCommandCache() const
+			{
+				lock_guard<mutex> lock(this->executorMutex);
+				if (!this->commandCacheConfigured) {
+					int ttl = CONFIG_GETINT(CONFIG_APP_COMMAND_CACHETTL);
+					if (ttl > 0 || CONFIG_GETINT(CONFIG_APP_COMMAND_COALESCE) > 0) {
+						this->commandCache = make_shared<CommandCache>(ttl > 0 ? ttl : 0);
+					}
+					this->commandCacheConfigured = true;
+				}
+				return this->commandCache;
+			}
+
 			shared_ptr<CommandRunner> CommandRunner::getInstance()
 			{
 				if (!CommandRunner::instance) {
@@ -0,0 +1,44 @@
+
+#include "nebu-app-framework/commandTemplate.h"
+
+#include <vector>
+
+// Using declarations - standard library
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			static void replaceAll(string &str, const string &placeholder, const string &value)
+			{
+				string::size_type position = 0;
+				while ((position = str.find(placeholder, position)) != string::npos) {
+					str.replace(position, placeholder.size(), value);
+					position += value.size();
+				}
+			}
+
+			Command CommandTemplate::instantiate(const VirtualMachine &vm) const
+			{
+				vector<string> arguments = this->prototype.getArguments();
+				for (vector<string>::iterator it = arguments.begin(); it != arguments.end(); it++) {
+					replaceAll(*it, "{hostname}", vm.getHostname());
+					replaceAll(*it, "{uuid}", vm.getUUID());
+					replaceAll(*it, "{host}", vm.getPhysicalHostID());
+				}
+
+				Command command(this->prototype);
+				command.setArguments(arguments);
+				return command;
+			}
+
+		}
+	}
+}
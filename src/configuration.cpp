@@ -3,11 +3,21 @@
 
 #include "log4cxx/logger.h"
 
+#include <atomic>
+#include <fstream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 // Using declarations - standard library
+using std::atomic;
+using std::function;
+using std::getline;
+using std::ifstream;
 using std::make_shared;
+using std::lock_guard;
 using std::map;
+using std::mutex;
 using std::shared_ptr;
 using std::string;
 using std::stringstream;
@@ -22,16 +32,80 @@ namespace nebu
 		namespace framework
 		{
 
-			shared_ptr<Configuration> Configuration::globalConfiguration;
+			/*  The global snapshot is reached through an atomic pointer to a heap-allocated shared_ptr, so readers
+			 *  never lock. While copying the shared_ptr, a reader is counted in one of two counters, selected by
+			 *  the current phase. A writer replaces the pointer, then flips the phase twice, each time waiting
+			 *  for the counter that new readers no longer use to drain, before freeing the superseded holder.
+			 *  Reads are therefore wait-free, and at most one superseded holder exists at any time; writes, which
+			 *  are serialised anyway, wait for no more than the readers already copying the old snapshot.
+			 */
+			typedef shared_ptr<const Configuration> SnapshotHolder;
+
+			static atomic<SnapshotHolder *> globalSnapshot(nullptr);
+			static atomic<unsigned int> readerPhase(0);
+			static atomic<unsigned int> activeReaders[2] = { { 0 }, { 0 } };
+			static mutex writerMutex;
+
+			static void waitForReaders()
+			{
+				for (int i = 0; i < 2; i++) {
+					unsigned int phase = readerPhase.fetch_xor(1);
+					while (activeReaders[phase].load() != 0) {
+						std::this_thread::yield();
+					}
+				}
+			}
+
+			static void publishSnapshot(shared_ptr<const Configuration> configuration)
+			{
+				SnapshotHolder *previous = globalSnapshot.exchange(new SnapshotHolder(configuration));
+				if (previous) {
+					waitForReaders();
+					delete previous;
+				}
+			}
 
 			map<string, string> Configuration::commandLineOptions {
+				{ "--config",   CONFIG_APP_CONFIG },
 				{ "--interval", CONFIG_APP_INTERVAL },
 				{ "--app",      CONFIG_APP_UUID },
 				{ "--nebu",     CONFIG_NEBU_URL }
 			};
+			map<string, string> Configuration::commandLineValues;
+			map<string, string> Configuration::updatedValues;
 			map<string, string> Configuration::defaultValues {
+				{ CONFIG_APP_COMMAND_CACHETTL, "0" },
+				{ CONFIG_APP_COMMAND_COALESCE, "0" },
+				{ CONFIG_APP_COMMAND_MAXCONCURRENT, "64" },
+				{ CONFIG_APP_COMMAND_METRICSINTERVAL, "300" },
+				{ CONFIG_APP_COMMAND_SHELLWORKERS, "0" },
+				{ CONFIG_APP_CONFIG, "" },
+				{ CONFIG_APP_DAEMONS_PRUNE, "0" },
 				{ CONFIG_APP_INTERVAL, "60" },
+				{ CONFIG_APP_SNAPSHOT, "" },
+				{ CONFIG_APP_TOPOLOGYIMAGE, "" },
+				{ CONFIG_APP_TOPOLOGYSERVER_ADDRESSES, "0" },
+				{ CONFIG_APP_TOPOLOGYSERVER_SOCKET, "" },
 				{ CONFIG_APP_UUID, "" },
+				{ CONFIG_APP_VMS_MAXBACKOFF, "32" },
+				{ CONFIG_APP_VMS_QUARANTINETHRESHOLD, "5" },
+				{ CONFIG_APP_VMS_STABLEPOLLS, "0" },
+				{ CONFIG_APP_VMS_SWEEPBUDGET, "16" },
+				{ CONFIG_APP_WORLDSTATE_NAME, "" },
+				{ CONFIG_APP_WORLDSTATE_SIZE, "64" },
+				{ CONFIG_NEBU_BREAKER_BACKOFF, "1000" },
+				{ CONFIG_NEBU_BREAKER_FAILURETHRESHOLD, "5" },
+				{ CONFIG_NEBU_BREAKER_MAXBACKOFF, "60000" },
+				{ CONFIG_NEBU_CACHE_NEGATIVETTL, "2000" },
+				{ CONFIG_NEBU_CACHE_TOPOLOGYTTL, "0" },
+				{ CONFIG_NEBU_CACHE_VMIDSTTL, "0" },
+				{ CONFIG_NEBU_CACHE_VMTTL, "0" },
+				{ CONFIG_NEBU_HEDGE_MAXRATE, "5" },
+				{ CONFIG_NEBU_HEDGE_MINDELAY, "5" },
+				{ CONFIG_NEBU_HEDGE_PERCENTILE, "0" },
+				{ CONFIG_NEBU_HEDGE_SUMMARYINTERVAL, "300" },
+				{ CONFIG_NEBU_POOLSIZE, "4" },
+				{ CONFIG_NEBU_TIMEOUT, "30000" },
 				{ CONFIG_NEBU_URL, "http://localhost:8080" }
 			};
 
@@ -40,17 +114,60 @@ namespace nebu
 				this->options = Configuration::defaultValues;
 			}
 
-			shared_ptr<Configuration> Configuration::getGlobalConfiguration()
+			shared_ptr<const Configuration> Configuration::getGlobalConfiguration()
 			{
-				if (!Configuration::globalConfiguration) {
-					Configuration::setGlobalConfiguration(make_shared<Configuration>());
+				unsigned int phase = readerPhase.load();
+				activeReaders[phase].fetch_add(1);
+				SnapshotHolder *holder = globalSnapshot.load();
+				shared_ptr<const Configuration> configuration;
+				if (holder) {
+					configuration = *holder;
+				}
+				activeReaders[phase].fetch_sub(1);
+				if (configuration) {
+					return configuration;
+				}
+
+				// Only writers free holders, so the current one can be read directly under the writer lock
+				lock_guard<mutex> lock(writerMutex);
+				if (!globalSnapshot.load()) {
+					publishSnapshot(make_shared<Configuration>());
 				}
-				return Configuration::globalConfiguration;
+				return *globalSnapshot.load();
 			}
 
-			void Configuration::setGlobalConfiguration(shared_ptr<Configuration> configuration)
+			void Configuration::setGlobalConfiguration(shared_ptr<const Configuration> configuration)
 			{
-				Configuration::globalConfiguration = configuration;
+				lock_guard<mutex> lock(writerMutex);
+				Configuration::updatedValues.clear();
+				publishSnapshot(configuration);
+			}
+
+			void Configuration::updateGlobalConfiguration(const function<void(Configuration &)> &update)
+			{
+				lock_guard<mutex> lock(writerMutex);
+				SnapshotHolder *holder = globalSnapshot.load();
+				shared_ptr<const Configuration> current;
+				if (holder) {
+					current = *holder;
+				}
+				if (!current) {
+					current = make_shared<Configuration>();
+				}
+				shared_ptr<Configuration> updated = make_shared<Configuration>(*current);
+				update(*updated);
+
+				// Changed options are remembered so reload() can apply them on top of the reloaded file
+				for (map<string, string>::const_iterator it = updated->options.begin();
+					it != updated->options.end();
+					it++)
+				{
+					map<string, string>::const_iterator previous = current->options.find(it->first);
+					if (previous == current->options.end() || previous->second != it->second) {
+						Configuration::updatedValues[it->first] = it->second;
+					}
+				}
+				publishSnapshot(updated);
 			}
 
 			string Configuration::getOption(const string &option) const
@@ -64,6 +181,13 @@ namespace nebu
 				intAsString >> result;
 				return result;
 			}
+			double Configuration::getOptionDouble(const string &option) const
+			{
+				stringstream doubleAsString(this->getOption(option));
+				double result;
+				doubleAsString >> result;
+				return result;
+			}
 			void Configuration::setOption(const string &option, const string &value)
 			{
 				this->options[option] = value;
@@ -83,9 +207,98 @@ namespace nebu
 				}
 			}
 
-			void Configuration::fromArguments(vector<string> &args)
+			static string trim(const string &str)
+			{
+				const char *whitespace = " \t\r\n";
+				string::size_type begin = str.find_first_not_of(whitespace);
+				if (begin == string::npos) {
+					return "";
+				}
+				string::size_type end = str.find_last_not_of(whitespace);
+				return str.substr(begin, end - begin + 1);
+			}
+
+			bool Configuration::loadFile(const string &filename)
+			{
+				ifstream input(filename.c_str());
+				if (!input.is_open()) {
+					LOG4CXX_WARN(logger, "Could not open configuration file '" << filename << "'");
+					return false;
+				}
+
+				string section;
+				string line;
+				unsigned int lineNumber = 0;
+				while (getline(input, line)) {
+					lineNumber++;
+					line = trim(line);
+					if (line.empty() || line[0] == '#' || line[0] == ';') {
+						continue;
+					}
+
+					if (line[0] == '[' && line[line.size() - 1] == ']') {
+						section = trim(line.substr(1, line.size() - 2));
+						continue;
+					}
+
+					string::size_type separator = line.find('=');
+					if (separator == string::npos) {
+						LOG4CXX_WARN(logger, "Ignoring malformed line " << lineNumber << " in configuration file '" <<
+								filename << "'");
+						continue;
+					}
+
+					string key = trim(line.substr(0, separator));
+					string value = trim(line.substr(separator + 1));
+					if (!section.empty()) {
+						key = section + "." + key;
+					}
+					this->setOption(key, value);
+				}
+				return true;
+			}
+
+			shared_ptr<Configuration> Configuration::createLayered(bool &fileLoaded)
 			{
 				shared_ptr<Configuration> cfg = make_shared<Configuration>();
+
+				string filename = cfg->getOption(CONFIG_APP_CONFIG);
+				if (Configuration::commandLineValues.count(CONFIG_APP_CONFIG) > 0) {
+					filename = Configuration::commandLineValues.at(CONFIG_APP_CONFIG);
+				}
+				fileLoaded = filename.empty() || cfg->loadFile(filename);
+
+				for (map<string, string>::const_iterator it = Configuration::commandLineValues.begin();
+					it != Configuration::commandLineValues.end();
+					it++)
+				{
+					cfg->setOption(it->first, it->second);
+				}
+				for (map<string, string>::const_iterator it = Configuration::updatedValues.begin();
+					it != Configuration::updatedValues.end();
+					it++)
+				{
+					cfg->setOption(it->first, it->second);
+				}
+				return cfg;
+			}
+
+			bool Configuration::reload()
+			{
+				lock_guard<mutex> lock(writerMutex);
+				bool fileLoaded;
+				shared_ptr<Configuration> cfg = Configuration::createLayered(fileLoaded);
+				if (!fileLoaded) {
+					LOG4CXX_WARN(logger, "Keeping the current configuration");
+					return false;
+				}
+				publishSnapshot(cfg);
+				return true;
+			}
+
+			void Configuration::fromArguments(vector<string> &args)
+			{
+				map<string, string> values;
 				unsigned int index = 0;
 				while (index < args.size()) {
 					string arg = args[index];
@@ -95,7 +308,7 @@ namespace nebu
 						if (index + 1 < args.size()) {
 							value = args[index + 1];
 						}
-						cfg->setOption(option, value);
+						values[option] = value;
 
 						if (index + 1 < args.size()) {
 							args.erase(args.begin() + index, args.begin() + index + 2);
@@ -106,16 +319,23 @@ namespace nebu
 						index++;
 					}
 				}
-				Configuration::setGlobalConfiguration(cfg);
+
+				lock_guard<mutex> lock(writerMutex);
+				Configuration::commandLineValues = values;
+				Configuration::updatedValues.clear();
+				bool fileLoaded;
+				publishSnapshot(Configuration::createLayered(fileLoaded));
 			}
 
 			void Configuration::addCommandLineOption(const string &cmd, const string &optionName)
 			{
+				lock_guard<mutex> lock(writerMutex);
 				Configuration::commandLineOptions[cmd] = optionName;
 			}
 
 			void Configuration::addDefaultValue(const string &optionName, const string &defaultValue)
 			{
+				lock_guard<mutex> lock(writerMutex);
 				Configuration::defaultValues[optionName] = defaultValue;
 			}
 
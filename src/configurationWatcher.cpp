@@ -0,0 +1,131 @@
+
+#include "nebu-app-framework/configurationWatcher.h"
+#include "nebu-app-framework/configuration.h"
+
+#include "log4cxx/logger.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::string;
+using std::thread;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.ConfigurationWatcher"));
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			ConfigurationWatcher::ConfigurationWatcher(const string &filename) :
+					inotifyFd(-1), stopFd(-1), watcher()
+			{
+				string::size_type separator = filename.find_last_of('/');
+				if (separator == string::npos) {
+					this->directory = ".";
+					this->basename = filename;
+				} else {
+					this->directory = (separator == 0) ? "/" : filename.substr(0, separator);
+					this->basename = filename.substr(separator + 1);
+				}
+			}
+
+			ConfigurationWatcher::~ConfigurationWatcher()
+			{
+				this->stop();
+			}
+
+			bool ConfigurationWatcher::start()
+			{
+				if (this->isRunning()) {
+					return true;
+				}
+
+				this->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+				if (this->inotifyFd < 0) {
+					LOG4CXX_WARN(logger, "Could not initialise inotify, configuration will not be reloaded");
+					return false;
+				}
+				if (inotify_add_watch(this->inotifyFd, this->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+					LOG4CXX_WARN(logger, "Could not watch directory '" << this->directory <<
+							"', configuration will not be reloaded");
+					close(this->inotifyFd);
+					this->inotifyFd = -1;
+					return false;
+				}
+				this->stopFd = eventfd(0, EFD_CLOEXEC);
+
+				LOG4CXX_INFO(logger, "Watching '" << this->directory << "/" << this->basename << "' for changes");
+				this->watcher = thread(&ConfigurationWatcher::watchLoop, this);
+				return true;
+			}
+
+			void ConfigurationWatcher::stop()
+			{
+				if (!this->isRunning()) {
+					return;
+				}
+
+				uint64_t value = 1;
+				if (write(this->stopFd, &value, sizeof(value)) != sizeof(value)) {
+					LOG4CXX_WARN(logger, "Could not signal the configuration watcher to stop");
+				}
+				this->watcher.join();
+
+				close(this->inotifyFd);
+				close(this->stopFd);
+				this->inotifyFd = -1;
+				this->stopFd = -1;
+			}
+
+			void ConfigurationWatcher::watchLoop()
+			{
+				char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+				struct pollfd fds[2] = {
+					{ this->inotifyFd, POLLIN, 0 },
+					{ this->stopFd, POLLIN, 0 }
+				};
+
+				while (true) {
+					if (poll(fds, 2, -1) < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						LOG4CXX_WARN(logger, "Could not wait for configuration changes (" << strerror(errno) <<
+								"), configuration will no longer be reloaded");
+						break;
+					}
+					if (fds[1].revents & POLLIN) {
+						break;
+					}
+
+					bool changed = false;
+					ssize_t length;
+					while ((length = read(this->inotifyFd, buffer, sizeof(buffer))) > 0) {
+						for (char *ptr = buffer; ptr < buffer + length; ) {
+							struct inotify_event *event = reinterpret_cast<struct inotify_event *>(ptr);
+							if (event->len > 0 && this->basename == event->name) {
+								changed = true;
+							}
+							ptr += sizeof(struct inotify_event) + event->len;
+						}
+					}
+
+					if (changed) {
+						LOG4CXX_INFO(logger, "Configuration file changed, reloading");
+						Configuration::reload();
+					}
+				}
+			}
+
+		}
+	}
+}
@@ -1,10 +1,12 @@
 
 #include "nebu-app-framework/daemon.h"
+#include "nebu-app-framework/daemonCollection.h"
 
 // Using declarations - standard library
 using std::shared_ptr;
 using std::string;
 using std::stringstream;
+using std::vector;
 // Using declarations - nebu-common
 using nebu::common::VirtualMachine;
 
@@ -15,7 +17,21 @@ namespace nebu
 		namespace framework
 		{
 
-			Daemon::Daemon(shared_ptr<VirtualMachine> hostVM) : launched(false), hostVM(hostVM)
+			Daemon::LaunchState &Daemon::LaunchState::operator=(bool launched)
+			{
+				if (launched != this->launched) {
+					this->launched = launched;
+					for (vector<DaemonCollection *>::const_iterator it = this->collections.begin();
+							it != this->collections.end();
+							it++)
+					{
+						(*it)->launchStateChanged(this->daemon, launched);
+					}
+				}
+				return *this;
+			}
+
+			Daemon::Daemon(shared_ptr<VirtualMachine> hostVM) : launched(this), hostVM(hostVM)
 			{
 				this->discoveryTime = time(NULL);
 			}
@@ -1,11 +1,16 @@
 
 #include "nebu-app-framework/daemonCollection.h"
 
+#include <algorithm>
+
 // Using declarations - standard library
-using std::map;
 using std::set;
 using std::shared_ptr;
-using std::static_pointer_cast;
+using std::string;
+using std::unordered_map;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
 
 namespace nebu
 {
@@ -14,98 +19,275 @@ namespace nebu
 		namespace framework
 		{
 
-			set<shared_ptr<Daemon>> DaemonCollection::getDaemons()
+			namespace
 			{
-				set<shared_ptr<Daemon>> daemons;
-				for (map<int, set<shared_ptr<Daemon>>>::iterator typeSet = this->daemons.begin();
-					 typeSet != this->daemons.end();
-					 typeSet++)
+
+				string getHostUUID(const shared_ptr<Daemon> &daemon)
 				{
-					daemons.insert(typeSet->second.begin(), typeSet->second.end());
+					shared_ptr<VirtualMachine> hostVM = daemon->getHostVM();
+					return hostVM ? hostVM->getUUID() : string();
+				}
+
+				// Removes an element in constant time by moving the last element into its place
+				void swapRemove(vector<shared_ptr<Daemon>> &daemons, size_t position)
+				{
+					if (position + 1 != daemons.size()) {
+						daemons[position].swap(daemons.back());
+					}
+					daemons.pop_back();
 				}
-				return daemons;
+
 			}
 
-			set<shared_ptr<Daemon>> DaemonCollection::getDaemonsForType(DaemonType type)
+			DaemonCollection::~DaemonCollection()
 			{
-				int itype = static_cast<int>(type);
-				if (this->daemons.find(itype) != this->daemons.end()) {
-					return this->daemons[itype];
-				} else {
-					return set<shared_ptr<Daemon>>();
+				for (vector<shared_ptr<Daemon>>::const_iterator daemon = this->daemons.begin();
+						daemon != this->daemons.end();
+						daemon++)
+				{
+					vector<DaemonCollection *> &collections = (*daemon)->launched.collections;
+					collections.erase(std::find(collections.begin(), collections.end(), this));
 				}
 			}
 
+			set<shared_ptr<Daemon>> DaemonCollection::getDaemons()
+			{
+				return set<shared_ptr<Daemon>>(this->daemons.begin(), this->daemons.end());
+			}
+
+			set<shared_ptr<Daemon>> DaemonCollection::getDaemonsForType(DaemonType type)
+			{
+				Range daemons = this->getDaemonRangeForType(type);
+				return set<shared_ptr<Daemon>>(daemons.begin(), daemons.end());
+			}
+
 			set<shared_ptr<Daemon>> DaemonCollection::getUnlaunchedDaemonsForType(DaemonType type)
 			{
-				int itype = static_cast<int>(type);
-				if (this->daemons.find(itype) != this->daemons.end()) {
-					set<shared_ptr<Daemon>> daemons;
-					for (set<shared_ptr<Daemon>>::iterator daemon = this->daemons[itype].begin();
-						 daemon != this->daemons[itype].end();
-						 daemon++)
-					{
-						if (!(*daemon)->hasLaunched()) {
-							daemons.insert(*daemon);
-						}
-					}
-					return daemons;
-				} else {
-					return set<shared_ptr<Daemon>>();
-				}
+				Range daemons = this->getUnlaunchedDaemonRangeForType(type);
+				return set<shared_ptr<Daemon>>(daemons.begin(), daemons.end());
 			}
 
 			set<shared_ptr<Daemon>> DaemonCollection::getLaunchedDaemonsForType(DaemonType type)
 			{
-				int itype = static_cast<int>(type);
-				if (this->daemons.find(itype) != this->daemons.end()) {
-					set<shared_ptr<Daemon>> daemons;
-					for (set<shared_ptr<Daemon>>::iterator daemon = this->daemons[itype].begin();
-						 daemon != this->daemons[itype].end();
-						 daemon++)
-					{
-						if ((*daemon)->hasLaunched()) {
-							daemons.insert(*daemon);
-						}
-					}
-					return daemons;
-				} else {
-					return set<shared_ptr<Daemon>>();
-				}
+				Range daemons = this->getLaunchedDaemonRangeForType(type);
+				return set<shared_ptr<Daemon>>(daemons.begin(), daemons.end());
 			}
 
 			set<shared_ptr<Daemon>> DaemonCollection::getDaemonsFiltered(
-            		bool (*includeInResults)(std::shared_ptr<Daemon>))
+					bool (*includeInResults)(std::shared_ptr<Daemon>))
 			{
-				set<shared_ptr<Daemon>> daemons;
-				for (map<int, set<shared_ptr<Daemon>>>::iterator typeSet = this->daemons.begin();
-						typeSet != this->daemons.end();
-				     	typeSet++)
-				{
-					for (set<shared_ptr<Daemon>>::iterator daemon = typeSet->second.begin();
-							daemon != typeSet->second.end();
-							daemon++)
-					{
-						if (includeInResults(*daemon)) {
-							daemons.insert(*daemon);
-						}
-					}
+				return this->query().where(includeInResults).toSet();
+			}
+
+			DaemonCollection::Range DaemonCollection::getDaemonRangeForType(DaemonType type) const
+			{
+				const TypeIndex *index = this->findType(type);
+				if (!index) {
+					return Range(this->daemons.end(), this->daemons.end());
+				}
+				return Range(index->daemons.begin(), index->daemons.end());
+			}
+
+			DaemonCollection::Range DaemonCollection::getLaunchedDaemonRangeForType(DaemonType type) const
+			{
+				const TypeIndex *index = this->findType(type);
+				if (!index) {
+					return Range(this->daemons.end(), this->daemons.end());
+				}
+				return Range(index->daemons.begin(), index->daemons.begin() + index->launchedCount);
+			}
+
+			DaemonCollection::Range DaemonCollection::getUnlaunchedDaemonRangeForType(DaemonType type) const
+			{
+				const TypeIndex *index = this->findType(type);
+				if (!index) {
+					return Range(this->daemons.end(), this->daemons.end());
+				}
+				return Range(index->daemons.begin() + index->launchedCount, index->daemons.end());
+			}
+
+			DaemonCollection::Range DaemonCollection::getDaemonRangeForVM(const string &uuid) const
+			{
+				unordered_map<string, vector<shared_ptr<Daemon>>>::const_iterator daemons = this->vms.find(uuid);
+				if (daemons == this->vms.end()) {
+					return Range(this->daemons.end(), this->daemons.end());
 				}
-				return daemons;
+				return Range(daemons->second.begin(), daemons->second.end());
+			}
+
+			size_t DaemonCollection::getDaemonCountForType(DaemonType type) const
+			{
+				const TypeIndex *index = this->findType(type);
+				return index ? index->daemons.size() : 0;
+			}
+
+			size_t DaemonCollection::getLaunchedDaemonCountForType(DaemonType type) const
+			{
+				const TypeIndex *index = this->findType(type);
+				return index ? index->launchedCount : 0;
+			}
+
+			size_t DaemonCollection::getUnlaunchedDaemonCountForType(DaemonType type) const
+			{
+				const TypeIndex *index = this->findType(type);
+				return index ? index->daemons.size() - index->launchedCount : 0;
+			}
+
+			size_t DaemonCollection::getDaemonCountForVM(const string &uuid) const
+			{
+				unordered_map<string, vector<shared_ptr<Daemon>>>::const_iterator daemons = this->vms.find(uuid);
+				return (daemons != this->vms.end()) ? daemons->second.size() : 0;
 			}
 
 			void DaemonCollection::addDaemon(shared_ptr<Daemon> daemon)
 			{
-				DaemonType type = daemon->getType();
-				int itype = static_cast<int>(type);
-				if (this->daemons.find(itype) == this->daemons.end()) {
-					this->daemons[itype] = set<shared_ptr<Daemon>>();
+				if (this->entries.find(daemon.get()) != this->entries.end()) {
+					return;
 				}
 
-				this->daemons[itype].insert(daemon);
+				TypeIndex &index = this->types[daemon->getType()];
+				string vmUUID = getHostUUID(daemon);
+				vector<shared_ptr<Daemon>> &vmDaemons = this->vms[vmUUID];
+				Entry entry = { daemon->getType(), vmUUID, this->daemons.size(), index.daemons.size(),
+						vmDaemons.size() };
+				this->daemons.push_back(daemon);
+				index.daemons.push_back(daemon);
+				vmDaemons.push_back(daemon);
+				this->entries[daemon.get()] = entry;
+				daemon->launched.collections.push_back(this);
+
+				if (daemon->hasLaunched()) {
+					this->setLaunched(entry, true);
+				}
 			}
 
+			bool DaemonCollection::removeDaemon(shared_ptr<Daemon> daemon)
+			{
+				if (this->entries.find(daemon.get()) == this->entries.end()) {
+					return false;
+				}
+				this->eraseDaemon(daemon);
+				return true;
+			}
+
+			size_t DaemonCollection::removeDaemonsForVM(const string &uuid)
+			{
+				// Every Daemon removal shrinks the vector of the VM, which is erased along with its last Daemon
+				size_t removed = 0;
+				unordered_map<string, vector<shared_ptr<Daemon>>>::iterator daemons;
+				while ((daemons = this->vms.find(uuid)) != this->vms.end()) {
+					this->eraseDaemon(daemons->second.back());
+					removed++;
+				}
+				return removed;
+			}
+
+			size_t DaemonCollection::removeDaemonsForType(DaemonType type)
+			{
+				size_t removed = 0;
+				unordered_map<DaemonType, TypeIndex>::iterator index;
+				while ((index = this->types.find(type)) != this->types.end()) {
+					this->eraseDaemon(index->second.daemons.back());
+					removed++;
+				}
+				return removed;
+			}
+
+			void DaemonCollection::newVMAdded(shared_ptr<VirtualMachine>)
+			{
+
+			}
+
+			void DaemonCollection::existingVMChanged(shared_ptr<VirtualMachine>, const VMEvent)
+			{
+
+			}
+
+			void DaemonCollection::oldVMRemoved(const VirtualMachine &vm)
+			{
+				this->removeDaemonsForVM(vm.getUUID());
+			}
+
+			const DaemonCollection::TypeIndex *DaemonCollection::findType(DaemonType type) const
+			{
+				unordered_map<DaemonType, TypeIndex>::const_iterator index = this->types.find(type);
+				return (index != this->types.end()) ? &index->second : NULL;
+			}
+
+			void DaemonCollection::launchStateChanged(const Daemon *daemon, bool launched)
+			{
+				unordered_map<const Daemon *, Entry>::const_iterator entry = this->entries.find(daemon);
+				if (entry != this->entries.end()) {
+					this->setLaunched(entry->second, launched);
+				}
+			}
+
+			void DaemonCollection::setLaunched(const Entry &entry, bool launched)
+			{
+				TypeIndex &index = this->types[entry.type];
+				bool indexedAsLaunched = entry.typePosition < index.launchedCount;
+				if (launched == indexedAsLaunched) {
+					return;
+				}
+
+				// Moving a Daemon across the partition swaps it with the first unlaunched or last launched Daemon
+				if (launched) {
+					this->swapInType(index, entry.typePosition, index.launchedCount);
+					index.launchedCount++;
+				} else {
+					this->swapInType(index, entry.typePosition, index.launchedCount - 1);
+					index.launchedCount--;
+				}
+			}
+
+			void DaemonCollection::swapInType(TypeIndex &index, size_t first, size_t second)
+			{
+				if (first != second) {
+					index.daemons[first].swap(index.daemons[second]);
+					this->entries[index.daemons[first].get()].typePosition = first;
+					this->entries[index.daemons[second].get()].typePosition = second;
+				}
+			}
+
+			void DaemonCollection::eraseDaemon(shared_ptr<Daemon> daemon)
+			{
+				Entry entry = this->entries[daemon.get()];
+
+				// A launched Daemon first moves to the end of the launched partition, so removing it keeps the
+				// partition intact
+				TypeIndex &index = this->types[entry.type];
+				size_t typePosition = entry.typePosition;
+				if (typePosition < index.launchedCount) {
+					index.launchedCount--;
+					this->swapInType(index, typePosition, index.launchedCount);
+					typePosition = index.launchedCount;
+				}
+				this->swapInType(index, typePosition, index.daemons.size() - 1);
+				index.daemons.pop_back();
+				if (index.daemons.empty()) {
+					this->types.erase(entry.type);
+				}
+
+				swapRemove(this->daemons, entry.position);
+				if (entry.position < this->daemons.size()) {
+					this->entries[this->daemons[entry.position].get()].position = entry.position;
+				}
+
+				vector<shared_ptr<Daemon>> &vmDaemons = this->vms[entry.vmUUID];
+				swapRemove(vmDaemons, entry.vmPosition);
+				if (entry.vmPosition < vmDaemons.size()) {
+					this->entries[vmDaemons[entry.vmPosition].get()].vmPosition = entry.vmPosition;
+				}
+				if (vmDaemons.empty()) {
+					this->vms.erase(entry.vmUUID);
+				}
+
+				this->entries.erase(daemon.get());
+				vector<DaemonCollection *> &collections = daemon->launched.collections;
+				collections.erase(std::find(collections.begin(), collections.end(), this));
+			}
+
+
 		}
 	}
 }
-
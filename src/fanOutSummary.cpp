@@ -0,0 +1,58 @@
+
+#include "nebu-app-framework/fanOutSummary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// Using declarations - standard library
+using std::string;
+using std::stringstream;
+using std::vector;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			void FanOutSummary::addResult(const string &hostname, const CommandResult &result, unsigned int latency)
+			{
+				this->latencies.push_back(latency);
+				if (result.hasTimedOut()) {
+					this->stragglerHosts.push_back(hostname);
+				} else if (result.succeeded()) {
+					this->successes++;
+				} else {
+					this->failedHosts.push_back(hostname);
+				}
+			}
+
+			unsigned int FanOutSummary::getLatencyPercentile(double percentile) const
+			{
+				if (this->latencies.empty()) {
+					return 0;
+				}
+
+				vector<unsigned int> sorted(this->latencies);
+				std::sort(sorted.begin(), sorted.end());
+				double rank = std::ceil(percentile / 100.0 * sorted.size());
+				unsigned int index = (rank < 1) ? 0 : static_cast<unsigned int>(rank) - 1;
+				return sorted[std::min<size_t>(index, sorted.size() - 1)];
+			}
+
+			string FanOutSummary::toString() const
+			{
+				stringstream str;
+				str << this->getTotal() << " hosts: " << this->getSuccesses() << " succeeded, " <<
+						this->getFailures() << " failed, " << this->getStragglers() << " timed out; latency " <<
+						"p50 " << this->getLatencyPercentile(50) << " ms, p90 " << this->getLatencyPercentile(90) <<
+						" ms, p99 " << this->getLatencyPercentile(99) << " ms, max " <<
+						this->getLatencyPercentile(100) << " ms";
+				return str.str();
+			}
+
+		}
+	}
+}
@@ -0,0 +1,318 @@
+
+#include "nebu-app-framework/hedgingAppVirtRequest.h"
+
+#include "log4cxx/logger.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+// Using declarations - standard library
+using std::condition_variable;
+using std::deque;
+using std::exception_ptr;
+using std::function;
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::shared_ptr;
+using std::string;
+using std::stringstream;
+using std::thread;
+using std::unique_lock;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+// Using declarations - nebu-common
+using nebu::common::AppVirtRequest;
+using nebu::common::NebuClient;
+using nebu::common::VirtualMachine;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.HedgingAppVirtRequest"));
+
+/** Number of recent latencies used to determine the hedge delay. */
+#define HEDGINGAPPVIRTREQUEST_WINDOW 512
+/** Number of latencies required before requests are hedged. */
+#define HEDGINGAPPVIRTREQUEST_MIN_SAMPLES 20
+/** Maximum number of hedge requests that can be saved up in the token bucket. */
+#define HEDGINGAPPVIRTREQUEST_MAX_TOKENS 10.0
+/** Maximum number of worker threads making requests that may be hedged, including abandoned ones. */
+#define HEDGINGAPPVIRTREQUEST_WORKERS 8
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** The requests made for a single call to getVirtualMachine, shared with the requesting threads. */
+			struct HedgingAppVirtRequest::Race
+			{
+				Race() : raceMutex(), finished(), pending(0), completed(false), vm(), error(), hedgeWon(false) { }
+
+				mutex raceMutex;
+				condition_variable finished;
+				unsigned int pending;
+				bool completed;
+				shared_ptr<VirtualMachine> vm;
+				exception_ptr error;
+				bool hedgeWon;
+			};
+
+			/** The persistent threads making requests, shared with the threads as they can outlive the HedgingAppVirtRequest. */
+			struct HedgingAppVirtRequest::Workers
+			{
+				Workers() : workersMutex(), available(), tasks(), threads(0), idle(0), stopping(false) { }
+
+				/** Queues a task for an idle worker, starting a worker if none is idle; returns false if all are busy. */
+				static bool submit(const shared_ptr<Workers> &workers, const function<void()> &task)
+				{
+					lock_guard<mutex> lock(workers->workersMutex);
+					if (workers->tasks.size() >= workers->idle) {
+						if (workers->threads >= HEDGINGAPPVIRTREQUEST_WORKERS) {
+							return false;
+						}
+						try {
+							thread(&Workers::work, workers).detach();
+						} catch (std::system_error &ex) {
+							LOG4CXX_WARN(logger, "Could not start a thread for requests: " << ex.what());
+							return false;
+						}
+						workers->threads++;
+						workers->idle++;
+					}
+					workers->tasks.push_back(task);
+					workers->available.notify_one();
+					return true;
+				}
+
+				static void work(shared_ptr<Workers> workers)
+				{
+					unique_lock<mutex> lock(workers->workersMutex);
+					while (true) {
+						workers->available.wait(lock, [&workers]() { return workers->stopping || !workers->tasks.empty(); });
+						if (workers->stopping) {
+							workers->threads--;
+							return;
+						}
+						function<void()> task = workers->tasks.front();
+						workers->tasks.pop_front();
+						workers->idle--;
+						lock.unlock();
+						task();
+						// Do not keep the captured request alive while idle
+						task = function<void()>();
+						lock.lock();
+						workers->idle++;
+					}
+				}
+
+				mutex workersMutex;
+				condition_variable available;
+				deque<function<void()> > tasks;
+				unsigned int threads;
+				unsigned int idle;
+				bool stopping;
+			};
+
+			HedgingAppVirtRequest::HedgingAppVirtRequest(shared_ptr<AppVirtRequest> appVirtRequest,
+					double percentile, double maxRate, unsigned int minDelay) :
+					AppVirtRequest(shared_ptr<NebuClient>(), ""), appVirtRequest(appVirtRequest),
+					percentile(percentile), maxRate(maxRate), minDelay(minDelay), hedgeMutex(), tokens(0),
+					latencies(HEDGINGAPPVIRTREQUEST_WINDOW),
+					primaryLatencies(make_shared<LatencyWindow>(HEDGINGAPPVIRTREQUEST_WINDOW)),
+					workers(make_shared<Workers>()), statistics(), lastSummary(steady_clock::now())
+			{
+				this->statistics.requests = 0;
+				this->statistics.hedged = 0;
+				this->statistics.hedgeWins = 0;
+				this->statistics.throttled = 0;
+			}
+
+			HedgingAppVirtRequest::~HedgingAppVirtRequest()
+			{
+				lock_guard<mutex> lock(this->workers->workersMutex);
+				this->workers->stopping = true;
+				this->workers->available.notify_all();
+			}
+
+			vector<string> HedgingAppVirtRequest::getVirtualMachineIDs()
+			{
+				return this->appVirtRequest->getVirtualMachineIDs();
+			}
+
+			VirtualMachine HedgingAppVirtRequest::getVirtualMachine(const string &uuid)
+			{
+				steady_clock::time_point start = steady_clock::now();
+				{
+					lock_guard<mutex> lock(this->hedgeMutex);
+					this->statistics.requests++;
+					this->tokens = std::min(this->tokens + this->maxRate / 100.0, HEDGINGAPPVIRTREQUEST_MAX_TOKENS);
+				}
+
+				unsigned int delay = this->getHedgeDelay();
+				bool throttled = delay > 0 && !this->hasHedgeToken();
+				shared_ptr<Race> race = make_shared<Race>();
+				unique_lock<mutex> lock(race->raceMutex);
+				if (delay == 0 || throttled || !this->launch(race, uuid, false)) {
+					// The request can not be hedged, so it is made on the calling thread
+					lock.unlock();
+					try {
+						VirtualMachine vm = this->appVirtRequest->getVirtualMachine(uuid);
+						unsigned int latency = duration_cast<microseconds>(steady_clock::now() - start).count();
+						this->primaryLatencies->add(latency);
+						this->latencies.add(latency);
+						if (throttled && latency > delay) {
+							lock_guard<mutex> statisticsLock(this->hedgeMutex);
+							this->statistics.throttled++;
+						}
+						return vm;
+					} catch (...) {
+						this->latencies.add(duration_cast<microseconds>(steady_clock::now() - start).count());
+						throw;
+					}
+				}
+
+				if (!race->finished.wait_for(lock, microseconds(delay),
+						[&race]() { return race->completed || race->pending == 0; })) {
+					if (this->acquireHedgeToken()) {
+						LOG4CXX_DEBUG(logger, "Hedging request for VM " << uuid << " after " << delay << " us");
+						if (!this->launch(race, uuid, true)) {
+							this->releaseHedgeToken();
+						}
+					}
+				}
+				race->finished.wait(lock, [&race]() { return race->completed || race->pending == 0; });
+
+				if (race->hedgeWon) {
+					lock_guard<mutex> statisticsLock(this->hedgeMutex);
+					this->statistics.hedgeWins++;
+				}
+				this->latencies.add(duration_cast<microseconds>(steady_clock::now() - start).count());
+				if (!race->completed) {
+					std::rethrow_exception(race->error);
+				}
+				return *race->vm;
+			}
+
+			bool HedgingAppVirtRequest::launch(shared_ptr<Race> race, const string &uuid, bool hedge)
+			{
+				// Captures shared pointers only, as an abandoned request may outlive this object
+				shared_ptr<AppVirtRequest> appVirtRequest = this->appVirtRequest;
+				shared_ptr<LatencyWindow> primaryLatencies = this->primaryLatencies;
+				race->pending++;
+				bool submitted = Workers::submit(this->workers, [race, uuid, hedge, appVirtRequest, primaryLatencies]() mutable {
+					steady_clock::time_point start = steady_clock::now();
+					shared_ptr<VirtualMachine> vm;
+					exception_ptr error;
+					try {
+						vm = make_shared<VirtualMachine>(appVirtRequest->getVirtualMachine(uuid));
+					} catch (...) {
+						error = std::current_exception();
+					}
+					// Do not keep the decorated request alive after the caller has been answered
+					appVirtRequest.reset();
+					if (!hedge && vm) {
+						primaryLatencies->add(duration_cast<microseconds>(steady_clock::now() - start).count());
+					}
+
+					lock_guard<mutex> lock(race->raceMutex);
+					race->pending--;
+					if (race->completed) {
+						return;
+					}
+					if (vm) {
+						race->completed = true;
+						race->vm = vm;
+						race->hedgeWon = hedge;
+					} else {
+						race->error = error;
+					}
+					race->finished.notify_all();
+				});
+				if (!submitted) {
+					LOG4CXX_DEBUG(logger, "All workers are busy, not hedging the request for VM " << uuid);
+					race->pending--;
+				}
+				return submitted;
+			}
+
+			bool HedgingAppVirtRequest::hasHedgeToken() const
+			{
+				lock_guard<mutex> lock(this->hedgeMutex);
+				return this->tokens >= 1;
+			}
+
+			bool HedgingAppVirtRequest::acquireHedgeToken()
+			{
+				lock_guard<mutex> lock(this->hedgeMutex);
+				if (this->tokens < 1) {
+					this->statistics.throttled++;
+					return false;
+				}
+				this->tokens -= 1;
+				this->statistics.hedged++;
+				return true;
+			}
+
+			void HedgingAppVirtRequest::releaseHedgeToken()
+			{
+				lock_guard<mutex> lock(this->hedgeMutex);
+				this->tokens += 1;
+				this->statistics.hedged--;
+			}
+
+			unsigned int HedgingAppVirtRequest::getHedgeDelay() const
+			{
+				if (this->primaryLatencies->size() < HEDGINGAPPVIRTREQUEST_MIN_SAMPLES) {
+					return 0;
+				}
+				return std::max(this->primaryLatencies->getPercentile(this->percentile), this->minDelay * 1000);
+			}
+
+			HedgingAppVirtRequest::Statistics HedgingAppVirtRequest::getStatistics() const
+			{
+				lock_guard<mutex> lock(this->hedgeMutex);
+				return this->statistics;
+			}
+
+			string HedgingAppVirtRequest::toString() const
+			{
+				Statistics statistics = this->getStatistics();
+				stringstream str;
+				str << statistics.requests << " requests, " << statistics.hedged << " hedged (" <<
+						statistics.hedgeWins << " won), " << statistics.throttled << " throttled; p99 " <<
+						(this->getLatencyPercentile(99) / 1000.0) << " ms (" <<
+						(this->getPrimaryLatencyPercentile(99) / 1000.0) << " ms without hedging), p99.9 " <<
+						(this->getLatencyPercentile(99.9) / 1000.0) << " ms (" <<
+						(this->getPrimaryLatencyPercentile(99.9) / 1000.0) << " ms without hedging)";
+				return str.str();
+			}
+
+			void HedgingAppVirtRequest::logSummaryIfDue(unsigned int interval)
+			{
+				if (interval == 0) {
+					return;
+				}
+
+				{
+					lock_guard<mutex> lock(this->hedgeMutex);
+					steady_clock::time_point now = steady_clock::now();
+					if (now - this->lastSummary < std::chrono::seconds(interval)) {
+						return;
+					}
+					this->lastSummary = now;
+				}
+				LOG4CXX_INFO(logger, "Hedged VM requests: " << this->toString());
+			}
+
+		}
+	}
+}
@@ -0,0 +1,61 @@
+
+#include "nebu-app-framework/latencyWindow.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Using declarations - standard library
+using std::lock_guard;
+using std::mutex;
+using std::vector;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			LatencyWindow::LatencyWindow(size_t capacity) :
+					capacity(std::max<size_t>(capacity, 1)), windowMutex(), latencies(), next(0)
+			{
+				this->latencies.reserve(this->capacity);
+			}
+
+			void LatencyWindow::add(unsigned int latency)
+			{
+				lock_guard<mutex> lock(this->windowMutex);
+				if (this->latencies.size() < this->capacity) {
+					this->latencies.push_back(latency);
+				} else {
+					this->latencies[this->next] = latency;
+					this->next = (this->next + 1) % this->capacity;
+				}
+			}
+
+			unsigned int LatencyWindow::getPercentile(double percentile) const
+			{
+				vector<unsigned int> sorted;
+				{
+					lock_guard<mutex> lock(this->windowMutex);
+					sorted = this->latencies;
+				}
+				if (sorted.empty()) {
+					return 0;
+				}
+
+				double rank = std::ceil(percentile / 100.0 * sorted.size());
+				size_t index = (rank < 1) ? 0 : std::min<size_t>(static_cast<size_t>(rank) - 1, sorted.size() - 1);
+				std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+				return sorted[index];
+			}
+
+			size_t LatencyWindow::size() const
+			{
+				lock_guard<mutex> lock(this->windowMutex);
+				return this->latencies.size();
+			}
+
+		}
+	}
+}
@@ -2,6 +2,7 @@
 #include "nebu-app-framework/application.h"
 #include "nebu-app-framework/applicationHooks.h"
 #include "nebu-app-framework/configuration.h"
+#include "nebu-app-framework/configurationWatcher.h"
 
 #include <string>
 #include <vector>
@@ -32,6 +33,12 @@ namespace nebu
 
 				applicationHooks->prepareLogging();
 
+				shared_ptr<ConfigurationWatcher> configurationWatcher;
+				if (!CONFIG_GET(CONFIG_APP_CONFIG).empty()) {
+					configurationWatcher = make_shared<ConfigurationWatcher>(CONFIG_GET(CONFIG_APP_CONFIG));
+					configurationWatcher->start();
+				}
+
 				applicationHooks->initialise(argv[0], arguments);
 
 				shared_ptr<Application> application = make_shared<Application>(
@@ -0,0 +1,110 @@
+
+#include "nebu-app-framework/mappedFile.h"
+
+#include "log4cxx/logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::string;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.MappedFile"));
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			MappedFile::~MappedFile()
+			{
+				this->close();
+			}
+
+			bool MappedFile::open(const string &filename)
+			{
+				this->close();
+
+				int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+				if (fd < 0) {
+					LOG4CXX_DEBUG(logger, "Could not open " << filename << ": " << strerror(errno));
+					return false;
+				}
+
+				struct stat status;
+				if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+					::close(fd);
+					return false;
+				}
+
+				void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				::close(fd);
+				if (mapping == MAP_FAILED) {
+					LOG4CXX_WARN(logger, "Could not map " << filename << ": " << strerror(errno));
+					return false;
+				}
+
+				this->data = static_cast<const char *>(mapping);
+				this->size = status.st_size;
+				return true;
+			}
+
+			void MappedFile::close()
+			{
+				if (this->data) {
+					munmap(const_cast<char *>(this->data), this->size);
+					this->data = NULL;
+					this->size = 0;
+				}
+			}
+
+			bool writeFileAtomically(const string &filename, const char *data, size_t size)
+			{
+				string temporary = filename + ".XXXXXX";
+				int fd = mkstemp(&temporary[0]);
+				if (fd < 0) {
+					LOG4CXX_WARN(logger, "Could not create a temporary file for " << filename << ": " << strerror(errno));
+					return false;
+				}
+
+				bool success = true;
+				size_t written = 0;
+				while (success && written < size) {
+					ssize_t length = write(fd, data + written, size - written);
+					if (length > 0) {
+						written += length;
+					} else if (length < 0 && errno != EINTR) {
+						success = false;
+					}
+				}
+				success = success && fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0 && fsync(fd) == 0;
+				success = (::close(fd) == 0) && success;
+
+				if (!success || rename(temporary.c_str(), filename.c_str()) != 0) {
+					LOG4CXX_WARN(logger, "Could not write " << filename << ": " << strerror(errno));
+					unlink(temporary.c_str());
+					return false;
+				}
+				return true;
+			}
+
+			uint64_t hashContents(const char *data, size_t size)
+			{
+				uint64_t hash = 14695981039346656037ULL;
+				for (size_t i = 0; i < size; i++) {
+					hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+				}
+				return hash;
+			}
+
+		}
+	}
+}
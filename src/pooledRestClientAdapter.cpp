@@ -0,0 +1,506 @@
+
+#include "nebu-app-framework/pooledRestClientAdapter.h"
+
+#include "log4cxx/logger.h"
+
+#include <chrono>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::lock_guard;
+using std::map;
+using std::mutex;
+using std::string;
+using std::unique_lock;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+#define POOLEDRESTCLIENTADAPTER_READ_SIZE 16384
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.PooledRestClientAdapter"));
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Outcome of sending a request and reading its response; only READ_CLOSED may be retried. */
+			enum ReadOutcome { READ_COMPLETE, READ_CLOSED, READ_FAILED };
+
+			static bool parseUrl(const string &url, string &host, string &port, string &target)
+			{
+				const string scheme = "http://";
+				if (url.compare(0, scheme.size(), scheme) != 0) {
+					return false;
+				}
+
+				string::size_type hostStart = scheme.size();
+				string::size_type pathStart = url.find('/', hostStart);
+				string authority = url.substr(hostStart, (pathStart == string::npos) ? string::npos : pathStart - hostStart);
+				target = (pathStart == string::npos) ? "/" : url.substr(pathStart);
+
+				// IPv6 addresses are enclosed in brackets, e.g. http://[::1]:8080/
+				string::size_type colon;
+				if (!authority.empty() && authority[0] == '[') {
+					string::size_type bracket = authority.find(']');
+					if (bracket == string::npos) {
+						return false;
+					}
+					host = authority.substr(1, bracket - 1);
+					colon = (bracket + 1 < authority.size() && authority[bracket + 1] == ':') ? bracket + 1 : string::npos;
+					if (colon == string::npos && bracket + 1 != authority.size()) {
+						return false;
+					}
+				} else {
+					colon = authority.rfind(':');
+					host = authority.substr(0, colon);
+				}
+				port = (colon == string::npos) ? "80" : authority.substr(colon + 1);
+				return !host.empty() && !port.empty();
+			}
+
+			/** Checks whether a request may be sent again when a reused connection was closed before answering. */
+			static bool isIdempotent(const string &method)
+			{
+				return method == "GET" || method == "HEAD" || method == "DELETE";
+			}
+
+			/** Waits until a non-blocking socket is ready; returns 0, or ETIMEDOUT if the deadline passed first. */
+			static int waitUntil(int fd, short events, steady_clock::time_point deadline)
+			{
+				while (true) {
+					long remaining = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+					if (remaining <= 0) {
+						return ETIMEDOUT;
+					}
+					struct pollfd pfd = { fd, events, 0 };
+					int ready = poll(&pfd, 1, static_cast<int>(remaining));
+					if (ready > 0) {
+						return 0;
+					} else if (ready < 0 && errno != EINTR) {
+						return errno;
+					}
+				}
+			}
+
+			/** Sends data over a connection; returns 0, or the error that stopped the send. */
+			static int sendAll(int fd, const string &data, steady_clock::time_point deadline)
+			{
+				size_t sent = 0;
+				while (sent < data.size()) {
+					ssize_t length = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+					if (length > 0) {
+						sent += length;
+					} else if (length < 0 && errno == EINTR) {
+						continue;
+					} else if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+						int error = waitUntil(fd, POLLOUT, deadline);
+						if (error != 0) {
+							return error;
+						}
+					} else {
+						return (length < 0) ? errno : EPIPE;
+					}
+				}
+				return 0;
+			}
+
+			/** Reads more data from a connection into a buffer; returns false on end-of-file or error.
+			 *  The error is set to 0 on end-of-file, to ETIMEDOUT if the deadline passed, and to the errno of
+			 *  recv otherwise.
+			 */
+			static bool receiveMore(int fd, string &buffer, steady_clock::time_point deadline, int &error)
+			{
+				char data[POOLEDRESTCLIENTADAPTER_READ_SIZE];
+				while (true) {
+					ssize_t length = recv(fd, data, sizeof(data), 0);
+					if (length > 0) {
+						buffer.append(data, length);
+						return true;
+					} else if (length < 0 && errno == EINTR) {
+						continue;
+					} else if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+						error = waitUntil(fd, POLLIN, deadline);
+						if (error == 0) {
+							continue;
+						}
+						return false;
+					}
+					error = (length < 0) ? errno : 0;
+					return false;
+				}
+			}
+
+			/** Checks whether an idle connection has been closed by the server, without blocking. */
+			static bool isClosed(int fd)
+			{
+				struct pollfd pfd = { fd, POLLIN | POLLRDHUP, 0 };
+				// An idle connection has nothing to read, so any event means it was closed or is unusable
+				return poll(&pfd, 1, 0) != 0;
+			}
+
+			static string trim(const string &str)
+			{
+				string::size_type start = str.find_first_not_of(" \t");
+				if (start == string::npos) {
+					return "";
+				}
+				return str.substr(start, str.find_last_not_of(" \t") - start + 1);
+			}
+
+			static ReadOutcome readResponse(int fd, const string &method, steady_clock::time_point deadline,
+					RestClient::response &response, bool &reusable)
+			{
+				string buffer;
+				string::size_type headerEnd;
+				string::size_type lineEnd;
+				int error = 0;
+				while (true) {
+					while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+						if (!receiveMore(fd, buffer, deadline, error)) {
+							// Only a connection closed before any response is known not to have been answered
+							return (buffer.empty() && (error == 0 || error == ECONNRESET)) ? READ_CLOSED : READ_FAILED;
+						}
+					}
+
+					// Status line
+					lineEnd = buffer.find("\r\n");
+					string statusLine = buffer.substr(0, lineEnd);
+					string::size_type space = statusLine.find(' ');
+					if (statusLine.compare(0, 5, "HTTP/") != 0 || space == string::npos) {
+						return READ_FAILED;
+					}
+					response.code = atoi(statusLine.c_str() + space + 1);
+					reusable = statusLine.compare(0, 8, "HTTP/1.1") == 0;
+					if (response.code / 100 != 1) {
+						break;
+					} else if (response.code == 101) {
+						// The connection no longer speaks HTTP after switching protocols
+						return READ_FAILED;
+					}
+					// Interim responses, such as 100 Continue, precede the final response to the request
+					buffer.erase(0, headerEnd + 4);
+				}
+
+				// Headers
+				bool chunked = false;
+				long contentLength = -1;
+				while (lineEnd < headerEnd) {
+					string::size_type next = buffer.find("\r\n", lineEnd + 2);
+					string line = buffer.substr(lineEnd + 2, next - lineEnd - 2);
+					lineEnd = next;
+					string::size_type colon = line.find(':');
+					if (colon == string::npos) {
+						continue;
+					}
+					string name = trim(line.substr(0, colon));
+					string value = trim(line.substr(colon + 1));
+					response.headers[name] = value;
+					if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+						contentLength = atol(value.c_str());
+					} else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+						chunked = strcasecmp(value.c_str(), "identity") != 0;
+					} else if (strcasecmp(name.c_str(), "Connection") == 0) {
+						reusable = strcasecmp(value.c_str(), "close") != 0 &&
+								(reusable || strcasecmp(value.c_str(), "keep-alive") == 0);
+					}
+				}
+
+				// Body
+				string::size_type position = headerEnd + 4;
+				response.body.clear();
+				if (method == "HEAD" || response.code == 204 || response.code == 304) {
+					return READ_COMPLETE;
+				}
+
+				if (chunked) {
+					while (true) {
+						while ((lineEnd = buffer.find("\r\n", position)) == string::npos) {
+							if (!receiveMore(fd, buffer, deadline, error)) {
+								return READ_FAILED;
+							}
+						}
+						size_t chunkSize = strtoul(buffer.c_str() + position, NULL, 16);
+						position = lineEnd + 2;
+						if (chunkSize == 0) {
+							// Skip any trailers, up to the empty line ending the message
+							while (true) {
+								while ((lineEnd = buffer.find("\r\n", position)) == string::npos) {
+									if (!receiveMore(fd, buffer, deadline, error)) {
+										return READ_FAILED;
+									}
+								}
+								bool emptyLine = lineEnd == position;
+								position = lineEnd + 2;
+								if (emptyLine) {
+									return READ_COMPLETE;
+								}
+							}
+						}
+						while (buffer.size() < position + chunkSize + 2) {
+							if (!receiveMore(fd, buffer, deadline, error)) {
+								return READ_FAILED;
+							}
+						}
+						response.body.append(buffer, position, chunkSize);
+						position += chunkSize + 2;
+					}
+				} else if (contentLength >= 0) {
+					while (buffer.size() < position + contentLength) {
+						if (!receiveMore(fd, buffer, deadline, error)) {
+							return READ_FAILED;
+						}
+					}
+					response.body.assign(buffer, position, contentLength);
+				} else {
+					// The body ends when the server closes the connection
+					while (receiveMore(fd, buffer, deadline, error)) {
+					}
+					if (error != 0) {
+						return READ_FAILED;
+					}
+					response.body.assign(buffer, position, string::npos);
+					reusable = false;
+				}
+				return READ_COMPLETE;
+			}
+
+			PooledRestClientAdapter::PooledRestClientAdapter(unsigned int poolSize, unsigned int timeout) :
+					RestClientAdapter(), poolSize(poolSize > 0 ? poolSize : 1), timeout(timeout), keepAlive(true),
+					poolMutex(), available(), idle(), openConnections(0), statistics()
+			{
+				this->statistics.requests = 0;
+				this->statistics.connectionsOpened = 0;
+				this->statistics.connectionsReused = 0;
+			}
+
+			PooledRestClientAdapter::~PooledRestClientAdapter()
+			{
+				for (map<string, vector<int> >::iterator it = this->idle.begin(); it != this->idle.end(); it++) {
+					for (vector<int>::iterator fd = it->second.begin(); fd != it->second.end(); fd++) {
+						close(*fd);
+					}
+				}
+			}
+
+			RestClient::response PooledRestClientAdapter::get(const string &url)
+			{
+				return this->request("GET", url, "", "");
+			}
+
+			RestClient::response PooledRestClientAdapter::post(const string &url, const string &contentType,
+					const string &data)
+			{
+				return this->request("POST", url, contentType, data);
+			}
+
+			RestClient::response PooledRestClientAdapter::put(const string &url, const string &contentType,
+					const string &data)
+			{
+				return this->request("PUT", url, contentType, data);
+			}
+
+			RestClient::response PooledRestClientAdapter::del(const string &url)
+			{
+				return this->request("DELETE", url, "", "");
+			}
+
+			RestClient::response PooledRestClientAdapter::request(const string &method, const string &url,
+					const string &contentType, const string &data)
+			{
+				string host, port, target;
+				if (!parseUrl(url, host, port, target)) {
+					LOG4CXX_DEBUG(logger, "Not pooling request to " << url);
+					if (method == "GET") {
+						return RestClientAdapter::get(url);
+					} else if (method == "POST") {
+						return RestClientAdapter::post(url, contentType, data);
+					} else if (method == "PUT") {
+						return RestClientAdapter::put(url, contentType, data);
+					}
+					return RestClientAdapter::del(url);
+				}
+
+				string hostHeader = (host.find(':') != string::npos) ? "[" + host + "]" : host;
+				string request = method + " " + target + " HTTP/1.1\r\nHost: " + hostHeader + ":" + port + "\r\n";
+				request += this->keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+				if (!contentType.empty()) {
+					request += "Content-Type: " + contentType + "\r\n";
+				}
+				if (!data.empty() || method == "POST" || method == "PUT") {
+					request += "Content-Length: " + std::to_string(data.size()) + "\r\n";
+				}
+				request += "\r\n" + data;
+
+				// The timeout bounds the whole request, including waiting for a connection and a retry
+				steady_clock::time_point deadline = steady_clock::now() + milliseconds(this->timeout);
+				RestClient::response response;
+				for (int attempt = 0; attempt < 2; attempt++) {
+					bool reused = false;
+					int fd = this->acquireConnection(host, port, deadline, reused);
+					if (fd < 0) {
+						break;
+					}
+
+					response = RestClient::response();
+					bool reusable = false;
+					ReadOutcome outcome = READ_FAILED;
+					int error = sendAll(fd, request, deadline);
+					if (error == 0) {
+						outcome = readResponse(fd, method, deadline, response, reusable);
+					} else if (error == EPIPE || error == ECONNRESET) {
+						outcome = READ_CLOSED;
+					}
+					this->releaseConnection(host, port, fd, outcome == READ_COMPLETE && reusable);
+					if (outcome == READ_COMPLETE) {
+						return response;
+					} else if (outcome == READ_FAILED || !reused || !isIdempotent(method)) {
+						// Timeouts are never retried, as the server may still be processing the request
+						break;
+					}
+					LOG4CXX_DEBUG(logger, "Reused connection to " << host << ":" << port << " was closed, retrying");
+				}
+
+				LOG4CXX_DEBUG(logger, method << " " << url << " failed");
+				response = RestClient::response();
+				response.code = -1;
+				response.body = "Failed to query.";
+				return response;
+			}
+
+			PooledRestClientAdapter::Statistics PooledRestClientAdapter::getStatistics() const
+			{
+				lock_guard<mutex> lock(this->poolMutex);
+				return this->statistics;
+			}
+
+			int PooledRestClientAdapter::acquireConnection(const string &host, const string &port,
+					steady_clock::time_point deadline, bool &reused)
+			{
+				string key = host + ":" + port;
+				{
+					unique_lock<mutex> lock(this->poolMutex);
+					while (true) {
+						vector<int> &connections = this->idle[key];
+						while (!connections.empty() && isClosed(connections.back())) {
+							close(connections.back());
+							connections.pop_back();
+							this->openConnections--;
+						}
+						if (!connections.empty()) {
+							int fd = connections.back();
+							connections.pop_back();
+							this->statistics.requests++;
+							this->statistics.connectionsReused++;
+							reused = true;
+							return fd;
+						}
+						if (this->openConnections < this->poolSize) {
+							this->openConnections++;
+							this->statistics.requests++;
+							this->statistics.connectionsOpened++;
+							break;
+						}
+
+						// Make room by closing an idle connection to another server, or wait for one to be released
+						bool closed = false;
+						for (map<string, vector<int> >::iterator it = this->idle.begin(); it != this->idle.end() && !closed; it++) {
+							if (!it->second.empty()) {
+								close(it->second.back());
+								it->second.pop_back();
+								this->openConnections--;
+								closed = true;
+							}
+						}
+						if (!closed && this->available.wait_until(lock, deadline) == std::cv_status::timeout) {
+							LOG4CXX_WARN(logger, "Timed out waiting for a connection to " << key);
+							return -1;
+						}
+					}
+				}
+
+				reused = false;
+				int fd = this->connectTo(host, port, deadline);
+				if (fd < 0) {
+					lock_guard<mutex> lock(this->poolMutex);
+					this->openConnections--;
+					this->available.notify_one();
+				}
+				return fd;
+			}
+
+			void PooledRestClientAdapter::releaseConnection(const string &host, const string &port, int fd, bool reusable)
+			{
+				lock_guard<mutex> lock(this->poolMutex);
+				if (reusable && this->keepAlive) {
+					this->idle[host + ":" + port].push_back(fd);
+				} else {
+					close(fd);
+					this->openConnections--;
+				}
+				this->available.notify_one();
+			}
+
+			int PooledRestClientAdapter::connectTo(const string &host, const string &port,
+					steady_clock::time_point deadline) const
+			{
+				struct addrinfo hints;
+				memset(&hints, 0, sizeof(hints));
+				hints.ai_family = AF_UNSPEC;
+				hints.ai_socktype = SOCK_STREAM;
+				struct addrinfo *addresses;
+				int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+				if (error != 0) {
+					LOG4CXX_WARN(logger, "Could not resolve " << host << ": " << gai_strerror(error));
+					return -1;
+				}
+
+				int fd = -1;
+				for (struct addrinfo *address = addresses; address != NULL && fd < 0; address = address->ai_next) {
+					fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK,
+							address->ai_protocol);
+					if (fd < 0) {
+						continue;
+					}
+
+					// Connect without blocking, so the connection attempt can time out
+					if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+						int connectError = errno;
+						socklen_t length = sizeof(connectError);
+						if (connectError != EINPROGRESS || waitUntil(fd, POLLOUT, deadline) != 0 ||
+								getsockopt(fd, SOL_SOCKET, SO_ERROR, &connectError, &length) != 0 || connectError != 0) {
+							close(fd);
+							fd = -1;
+							continue;
+						}
+					}
+				}
+				freeaddrinfo(addresses);
+				if (fd < 0) {
+					LOG4CXX_WARN(logger, "Could not connect to " << host << ":" << port);
+					return -1;
+				}
+
+				// The socket stays non-blocking, so every request can wait for it up to its own deadline
+				int flags = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flags, sizeof(flags));
+				return fd;
+			}
+
+		}
+	}
+}
@@ -0,0 +1,260 @@
+
+#include "nebu-app-framework/shellWorkerPool.h"
+#include "nebu-app-framework/childProcess.h"
+
+#include "log4cxx/logger.h"
+
+#include <atomic>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::stringstream;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+/** Prefix of the lines marking the end of a command on the output of a worker. */
+#define SHELLWORKER_MARKER_PREFIX "__NEBU_WORKER_"
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.ShellWorkerPool"));
+
+static atomic<uint64_t> workerCounter(0);
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			/** Writes all data to a pipe, reporting a closed pipe as an error instead of raising SIGPIPE. */
+			static bool writeAll(int fd, const string &data)
+			{
+				sigset_t pipeSignal, previousMask, pending;
+				sigemptyset(&pipeSignal);
+				sigaddset(&pipeSignal, SIGPIPE);
+				pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousMask);
+				sigpending(&pending);
+				bool wasPending = sigismember(&pending, SIGPIPE);
+
+				size_t written = 0;
+				bool success = true;
+				while (written < data.size()) {
+					ssize_t length = write(fd, data.data() + written, data.size() - written);
+					if (length >= 0) {
+						written += length;
+					} else if (errno != EINTR) {
+						success = false;
+						break;
+					}
+				}
+
+				if (!success && errno == EPIPE && !wasPending) {
+					struct timespec zero = { 0, 0 };
+					sigtimedwait(&pipeSignal, NULL, &zero);
+				}
+				pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+				return success;
+			}
+
+			/** Finds a complete marker line in a buffer, advancing the search position past data that cannot contain it. */
+			static string::size_type findMarker(const string &buffer, const string &marker, string::size_type &from)
+			{
+				string::size_type position = buffer.find(marker, from);
+				if (position == string::npos) {
+					if (buffer.size() > marker.size() && buffer.size() - marker.size() > from) {
+						from = buffer.size() - marker.size();
+					}
+					return string::npos;
+				}
+				from = position;
+				return (buffer.find('\n', position + 1) == string::npos) ? string::npos : position;
+			}
+
+			class ShellWorkerPool::Worker
+			{
+			public:
+				enum Outcome { COMPLETED, NOT_SENT, DIED };
+
+				Worker() : process(), marker()
+				{
+					stringstream markerStream;
+					markerStream << SHELLWORKER_MARKER_PREFIX << getpid() << "_" << workerCounter++;
+					this->marker = markerStream.str();
+				}
+
+				~Worker()
+				{
+					this->process.closeInput();
+					CommandResult result;
+					this->process.wait(result);
+				}
+
+				int start()
+				{
+					Command shell(vector<string> { "/bin/sh" });
+					shell.setPipeInput(true);
+					return this->process.spawn(shell);
+				}
+
+				Outcome execute(const string &commandLine, CommandResult &result)
+				{
+					stringstream request;
+					request << "( eval " << Command::quote(commandLine) << "\n) </dev/null\n" <<
+							"printf '\\n%s %d\\n' '" << this->marker << "' $?\n" <<
+							"printf '\\n%s\\n' '" << this->marker << "' >&2\n";
+					if (!writeAll(this->process.getInputFd(), request.str())) {
+						return NOT_SENT;
+					}
+
+					string outputMarker = "\n" + this->marker + " ";
+					string errorMarker = "\n" + this->marker + "\n";
+					string::size_type outputEnd = string::npos;
+					string::size_type errorEnd = string::npos;
+					string::size_type outputSearch = 0;
+					string::size_type errorSearch = 0;
+					while (true) {
+						bool open = this->process.readOutput(result);
+						if (outputEnd == string::npos) {
+							outputEnd = findMarker(result.getOutput(), outputMarker, outputSearch);
+						}
+						if (errorEnd == string::npos) {
+							errorEnd = findMarker(result.getError(), errorMarker, errorSearch);
+						}
+						if (outputEnd != string::npos && errorEnd != string::npos) {
+							break;
+						}
+						if (!open) {
+							this->process.signal(SIGKILL);
+							this->process.wait(result);
+							return DIED;
+						}
+
+						struct pollfd fds[2] = {
+							{ this->process.getOutputFd(), POLLIN, 0 },
+							{ this->process.getErrorFd(), POLLIN, 0 }
+						};
+						poll(fds, 2, -1);
+					}
+
+					int exitCode = atoi(result.getOutput().c_str() + outputEnd + outputMarker.size());
+					result.setWaitStatus((exitCode & 0xff) << 8);
+					result.getOutputBuffer().resize(outputEnd);
+					result.getErrorBuffer().resize(errorEnd);
+					return COMPLETED;
+				}
+
+			private:
+				ChildProcess process;
+				string marker;
+			};
+
+			ShellWorkerPool::ShellWorkerPool(unsigned int size) :
+					size(size > 0 ? size : 1), poolMutex(), available(), idle(), busy(0), statistics()
+			{
+				this->statistics.executed = 0;
+				this->statistics.workersStarted = 0;
+				this->statistics.fallbacks = 0;
+			}
+
+			ShellWorkerPool::~ShellWorkerPool()
+			{
+			}
+
+			bool ShellWorkerPool::canExecute(const Command &command) const
+			{
+				return command.getTimeout() == 0 && !command.hasCustomEnvironment() && !command.pipesInput() &&
+						command.capturesOutput();
+			}
+
+			void ShellWorkerPool::execute(const Command &command, CommandResult &result)
+			{
+				result.clear();
+				unique_ptr<Worker> worker = this->acquire();
+				Worker::Outcome outcome = Worker::NOT_SENT;
+				if (worker) {
+					outcome = worker->execute(command.toShellCommandLine(), result);
+				}
+				if (outcome != Worker::COMPLETED) {
+					LOG4CXX_DEBUG(logger, "Shell worker " << ((outcome == Worker::DIED) ? "died" : "unavailable") <<
+							" executing '" << command.toString() << "'");
+					worker.reset();
+				}
+				{
+					lock_guard<mutex> lock(this->poolMutex);
+					if (outcome == Worker::NOT_SENT) {
+						this->statistics.fallbacks++;
+					} else {
+						this->statistics.executed++;
+					}
+				}
+				this->release(std::move(worker));
+
+				if (outcome == Worker::NOT_SENT) {
+					// The command never reached a worker, so it can safely be spawned instead
+					result.clear();
+					ChildProcess process;
+					int error = process.spawn(command);
+					if (error != 0) {
+						LOG4CXX_WARN(logger, "Could not start command '" << command.toString() << "': " << strerror(error));
+						result.setSpawnError(error);
+					} else {
+						process.run(result);
+					}
+				}
+			}
+
+			ShellWorkerPool::Statistics ShellWorkerPool::getStatistics() const
+			{
+				lock_guard<mutex> lock(this->poolMutex);
+				return this->statistics;
+			}
+
+			unique_ptr<ShellWorkerPool::Worker> ShellWorkerPool::acquire()
+			{
+				{
+					unique_lock<mutex> lock(this->poolMutex);
+					this->available.wait(lock, [this]() { return this->busy < this->size; });
+					this->busy++;
+					if (!this->idle.empty()) {
+						unique_ptr<Worker> worker = std::move(this->idle.back());
+						this->idle.pop_back();
+						return worker;
+					}
+					this->statistics.workersStarted++;
+				}
+
+				unique_ptr<Worker> worker(new Worker());
+				int error = worker->start();
+				if (error != 0) {
+					LOG4CXX_WARN(logger, "Could not start shell worker: " << strerror(error));
+					return unique_ptr<Worker>();
+				}
+				return worker;
+			}
+
+			void ShellWorkerPool::release(unique_ptr<Worker> worker)
+			{
+				lock_guard<mutex> lock(this->poolMutex);
+				this->busy--;
+				if (worker) {
+					this->idle.push_back(std::move(worker));
+				}
+				this->available.notify_one();
+			}
+
+		}
+	}
+}
@@ -0,0 +1,385 @@
+
+#include "nebu-app-framework/stateSnapshot.h"
+#include "nebu-app-framework/daemonCollection.h"
+#include "nebu-app-framework/mappedFile.h"
+#include "nebu-app-framework/topologyManager.h"
+#include "nebu-app-framework/vmManager.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/logger.h"
+
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::Traits;
+using nebu::common::VirtualMachine;
+using nebu::common::VMStatus;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.StateSnapshot"));
+
+#define SNAPSHOT_MAGIC       "NEBUSNAP"
+#define SNAPSHOT_MAGICSIZE   8
+// Magic, version, reserved, payload size and checksum
+#define SNAPSHOT_HEADERSIZE  32
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			const uint32_t StateSnapshot::VERSION = 1;
+
+			namespace
+			{
+
+				// Status codes are fixed in the file format, independent of the VMStatus enumeration
+				uint8_t encodeStatus(VMStatus status)
+				{
+					switch (status)
+					{
+					case VMStatus::ON:
+						return 1;
+					case VMStatus::OFF:
+						return 2;
+					default:
+						return 0;
+					}
+				}
+
+				VMStatus decodeStatus(uint8_t status)
+				{
+					switch (status)
+					{
+					case 1:
+						return VMStatus::ON;
+					case 2:
+						return VMStatus::OFF;
+					default:
+						return VMStatus::UNKNOWN;
+					}
+				}
+
+				class SnapshotWriter
+				{
+				public:
+					SnapshotWriter(string &buffer) : buffer(buffer) { }
+
+					template<class T> void put(T value)
+					{
+						this->buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+					}
+
+					void putString(const string &value)
+					{
+						this->put<uint32_t>(value.size());
+						this->buffer.append(value);
+					}
+
+				private:
+					string &buffer;
+				};
+
+				// Reads from a mapped snapshot, failing without reading past its end
+				class SnapshotReader
+				{
+				public:
+					SnapshotReader(const char *data, size_t size) : position(data), end(data + size), valid(true) { }
+
+					template<class T> T get()
+					{
+						T value = T();
+						if (this->require(sizeof(value))) {
+							memcpy(&value, this->position, sizeof(value));
+							this->position += sizeof(value);
+						}
+						return value;
+					}
+
+					string getString()
+					{
+						uint32_t length = this->get<uint32_t>();
+						if (!this->require(length)) {
+							return string();
+						}
+						string value(this->position, length);
+						this->position += length;
+						return value;
+					}
+
+					// Counts are checked against the remaining size, so corrupt counts cannot cause huge allocations
+					uint32_t getCount(size_t minimumRecordSize)
+					{
+						uint32_t count = this->get<uint32_t>();
+						if (!this->require(static_cast<size_t>(count) * minimumRecordSize)) {
+							return 0;
+						}
+						return count;
+					}
+
+					bool isValid() const
+					{
+						return this->valid;
+					}
+
+					bool atEnd() const
+					{
+						return this->position == this->end;
+					}
+
+				private:
+					bool require(size_t size)
+					{
+						if (!this->valid || static_cast<size_t>(this->end - this->position) < size) {
+							this->valid = false;
+						}
+						return this->valid;
+					}
+
+					const char *position;
+					const char *end;
+					bool valid;
+				};
+
+				bool compareVMRecords(const StateSnapshot::VMRecord &a, const StateSnapshot::VMRecord &b)
+				{
+					return a.vm->getUUID() < b.vm->getUUID();
+				}
+
+			}
+
+			void StateSnapshot::capture(const VMManager &vmManager, const TopologyManager &topologyManager,
+					DaemonCollection &daemonCollection)
+			{
+				this->clear();
+
+				// Unchanged refreshes beyond the stability threshold do not affect a restored VM, but would make
+				// every snapshot differ from the previous one
+				unsigned int stablePolls = std::max(vmManager.getStablePolls(), 1U);
+				vector<shared_ptr<VirtualMachine>> vms = vmManager.getVMs();
+				for (vector<shared_ptr<VirtualMachine>>::iterator it = vms.begin(); it != vms.end(); it++) {
+					VMRecord record;
+					record.vm = make_shared<VirtualMachine>(**it);
+					record.unchangedPolls = std::min(vmManager.getRefreshState((*it)->getUUID()).unchangedPolls,
+							stablePolls);
+					this->vms.push_back(record);
+				}
+				std::sort(this->vms.begin(), this->vms.end(), compareVMRecords);
+
+				this->topology = topologyManager.getRoot();
+
+				set<shared_ptr<Daemon>> daemons = daemonCollection.getDaemons();
+				for (set<shared_ptr<Daemon>>::iterator it = daemons.begin(); it != daemons.end(); it++) {
+					DaemonRecord record;
+					record.vmUUID = (*it)->getHostVM()->getUUID();
+					record.type = (*it)->getType();
+					record.launched = (*it)->hasLaunched();
+					this->daemons.push_back(record);
+				}
+			}
+
+			bool StateSnapshot::save(const string &filename) const
+			{
+				string payload = this->serialise();
+				return this->write(filename, payload, hashContents(payload.data(), payload.size()));
+			}
+
+			bool StateSnapshot::saveIfChanged(const string &filename, uint64_t &lastChecksum) const
+			{
+				string payload = this->serialise();
+				uint64_t payloadChecksum = hashContents(payload.data(), payload.size());
+				if (payloadChecksum == lastChecksum && access(filename.c_str(), F_OK) == 0) {
+					LOG4CXX_TRACE(logger, "Snapshot in " << filename << " is unchanged");
+					return true;
+				}
+				if (!this->write(filename, payload, payloadChecksum)) {
+					return false;
+				}
+				lastChecksum = payloadChecksum;
+				return true;
+			}
+
+			bool StateSnapshot::write(const string &filename, const string &payload, uint64_t payloadChecksum) const
+			{
+				string file;
+				file.reserve(SNAPSHOT_HEADERSIZE + payload.size());
+				file.append(SNAPSHOT_MAGIC, SNAPSHOT_MAGICSIZE);
+				SnapshotWriter writer(file);
+				writer.put<uint32_t>(StateSnapshot::VERSION);
+				writer.put<uint32_t>(0);
+				writer.put<uint64_t>(payload.size());
+				writer.put<uint64_t>(payloadChecksum);
+				file.append(payload);
+
+				if (!writeFileAtomically(filename, file.data(), file.size())) {
+					return false;
+				}
+				LOG4CXX_DEBUG(logger, "Saved snapshot of " << this->vms.size() << " VMs and " << this->daemons.size() <<
+						" daemons to " << filename << " (" << file.size() << " bytes)");
+				return true;
+			}
+
+			bool StateSnapshot::load(const string &filename)
+			{
+				this->clear();
+
+				MappedFile file;
+				if (!file.open(filename)) {
+					LOG4CXX_INFO(logger, "No snapshot found at " << filename);
+					return false;
+				}
+
+				SnapshotReader header(file.getData(), file.getSize());
+				if (file.getSize() < SNAPSHOT_HEADERSIZE || memcmp(file.getData(), SNAPSHOT_MAGIC, SNAPSHOT_MAGICSIZE) != 0) {
+					LOG4CXX_WARN(logger, "Ignoring " << filename << ": not a snapshot");
+					return false;
+				}
+				header.get<uint64_t>();
+				uint32_t version = header.get<uint32_t>();
+				header.get<uint32_t>();
+				uint64_t payloadSize = header.get<uint64_t>();
+				uint64_t payloadChecksum = header.get<uint64_t>();
+
+				const char *payload = file.getData() + SNAPSHOT_HEADERSIZE;
+				if (version != StateSnapshot::VERSION) {
+					LOG4CXX_WARN(logger, "Ignoring " << filename << ": snapshot version " << version << " is not supported");
+					return false;
+				} else if (payloadSize != file.getSize() - SNAPSHOT_HEADERSIZE ||
+						hashContents(payload, payloadSize) != payloadChecksum ||
+						!this->deserialise(payload, payloadSize)) {
+					LOG4CXX_WARN(logger, "Ignoring " << filename << ": snapshot is truncated or corrupt");
+					this->clear();
+					return false;
+				}
+
+				LOG4CXX_INFO(logger, "Loaded snapshot of " << this->vms.size() << " VMs and " << this->daemons.size() <<
+						" daemons from " << filename);
+				return true;
+			}
+
+			string StateSnapshot::serialise() const
+			{
+				string buffer;
+				SnapshotWriter writer(buffer);
+
+				writer.put<uint32_t>(this->vms.size());
+				for (vector<VMRecord>::const_iterator it = this->vms.begin(); it != this->vms.end(); it++) {
+					writer.putString(it->vm->getUUID());
+					writer.putString(it->vm->getHostname());
+					writer.put<uint8_t>(encodeStatus(it->vm->getStatus()));
+					writer.putString(it->vm->getPhysicalHostID());
+					writer.putString(it->vm->getPhysicalStoreID());
+					writer.put<uint32_t>(it->unchangedPolls);
+				}
+
+				writer.put<uint8_t>(this->topology ? 1 : 0);
+				if (this->topology) {
+					writer.putString(this->topology->getUUID());
+					writer.put<uint32_t>(this->topology->getDataCenters().size());
+					for (Traits<PhysicalDataCenter>::Map::const_iterator dc = this->topology->getDataCenters().begin();
+							dc != this->topology->getDataCenters().end();
+							dc++)
+					{
+						writer.putString(dc->first);
+						writer.put<uint32_t>(dc->second->getRacks().size());
+						for (Traits<PhysicalRack>::Map::const_iterator rack = dc->second->getRacks().begin();
+								rack != dc->second->getRacks().end();
+								rack++)
+						{
+							writer.putString(rack->first);
+							writer.put<uint32_t>(rack->second->getHosts().size());
+							for (Traits<PhysicalHost>::Map::const_iterator host = rack->second->getHosts().begin();
+									host != rack->second->getHosts().end();
+									host++)
+							{
+								writer.putString(host->first);
+							}
+						}
+					}
+				}
+
+				writer.put<uint32_t>(this->daemons.size());
+				for (vector<DaemonRecord>::const_iterator it = this->daemons.begin(); it != this->daemons.end(); it++) {
+					writer.putString(it->vmUUID);
+					writer.put<uint32_t>(it->type);
+					writer.put<uint8_t>(it->launched ? 1 : 0);
+				}
+				return buffer;
+			}
+
+			bool StateSnapshot::deserialise(const char *data, size_t size)
+			{
+				SnapshotReader reader(data, size);
+
+				uint32_t vmCount = reader.getCount(4 + 4 + 1 + 4 + 4 + 4);
+				for (uint32_t i = 0; i < vmCount && reader.isValid(); i++) {
+					VMRecord record;
+					record.vm = make_shared<VirtualMachine>(reader.getString());
+					record.vm->setHostname(reader.getString());
+					record.vm->setStatus(decodeStatus(reader.get<uint8_t>()));
+					record.vm->setPhysicalHostID(reader.getString());
+					record.vm->setPhysicalStoreID(reader.getString());
+					record.unchangedPolls = reader.get<uint32_t>();
+					this->vms.push_back(record);
+				}
+
+				if (reader.get<uint8_t>() != 0) {
+					this->topology = make_shared<PhysicalRoot>(reader.getString());
+					uint32_t dcCount = reader.getCount(4 + 4);
+					for (uint32_t i = 0; i < dcCount && reader.isValid(); i++) {
+						shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>(reader.getString());
+						this->topology->addDataCenter(dc);
+						dc->setParent(this->topology.get());
+						uint32_t rackCount = reader.getCount(4 + 4);
+						for (uint32_t j = 0; j < rackCount && reader.isValid(); j++) {
+							shared_ptr<PhysicalRack> rack = make_shared<PhysicalRack>(reader.getString());
+							dc->addRack(rack);
+							rack->setParent(dc.get());
+							uint32_t hostCount = reader.getCount(4);
+							for (uint32_t k = 0; k < hostCount && reader.isValid(); k++) {
+								shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>(reader.getString());
+								rack->addHost(host);
+								host->setParent(rack.get());
+							}
+						}
+					}
+				}
+
+				uint32_t daemonCount = reader.getCount(4 + 4 + 1);
+				for (uint32_t i = 0; i < daemonCount && reader.isValid(); i++) {
+					DaemonRecord record;
+					record.vmUUID = reader.getString();
+					record.type = reader.get<uint32_t>();
+					record.launched = reader.get<uint8_t>() != 0;
+					this->daemons.push_back(record);
+				}
+
+				return reader.isValid() && reader.atEnd();
+			}
+
+			void StateSnapshot::clear()
+			{
+				this->vms.clear();
+				this->topology.reset();
+				this->daemons.clear();
+			}
+
+		}
+	}
+}
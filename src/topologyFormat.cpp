@@ -0,0 +1,145 @@
+
+#include "nebu-app-framework/topologyFormat.h"
+#include "nebu-app-framework/topologyImage.h"
+
+#include <stdio.h>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			namespace
+			{
+
+				void appendJsonString(string &output, const string &value)
+				{
+					output += '"';
+					for (string::const_iterator it = value.begin(); it != value.end(); it++) {
+						unsigned char c = static_cast<unsigned char>(*it);
+						if (c == '"' || c == '\\') {
+							output += '\\';
+							output += c;
+						} else if (c < 0x20) {
+							char escaped[8];
+							snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+							output += escaped;
+						} else {
+							output += c;
+						}
+					}
+					output += '"';
+				}
+
+			}
+
+			void TextTopologyFormat::begin(shared_ptr<PhysicalRoot>, string &)
+			{
+
+			}
+
+			void TextTopologyFormat::addVM(const shared_ptr<VirtualMachine> &vm, const Location &location,
+					string &output)
+			{
+				output += vm->getHostname();
+				output += '\t';
+				output += location.path;
+				output += '\n';
+			}
+
+			void TextTopologyFormat::end(string &)
+			{
+
+			}
+
+			void HadoopTableTopologyFormat::begin(shared_ptr<PhysicalRoot>, string &)
+			{
+
+			}
+
+			void HadoopTableTopologyFormat::addVM(const shared_ptr<VirtualMachine> &vm, const Location &location,
+					string &output)
+			{
+				output += vm->getHostname();
+				output += ' ';
+				output += location.path;
+				output += '\n';
+				if (this->addressResolver) {
+					vector<string> addresses = this->addressResolver(*vm);
+					for (vector<string>::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+						output += *it;
+						output += ' ';
+						output += location.path;
+						output += '\n';
+					}
+				}
+			}
+
+			void HadoopTableTopologyFormat::end(string &)
+			{
+
+			}
+
+			void JsonTopologyFormat::begin(shared_ptr<PhysicalRoot>, string &output)
+			{
+				output += "{\"vms\":[";
+				this->first = true;
+			}
+
+			void JsonTopologyFormat::addVM(const shared_ptr<VirtualMachine> &vm, const Location &location,
+					string &output)
+			{
+				output += this->first ? "\n{\"hostname\":" : ",\n{\"hostname\":";
+				appendJsonString(output, vm->getHostname());
+				output += ",\"uuid\":";
+				appendJsonString(output, vm->getUUID());
+				output += ",\"dataCenter\":";
+				appendJsonString(output, location.dataCenter);
+				output += ",\"rack\":";
+				appendJsonString(output, location.rack);
+				output += ",\"host\":";
+				appendJsonString(output, location.host);
+				output += '}';
+				this->first = false;
+			}
+
+			void JsonTopologyFormat::end(string &output)
+			{
+				output += "\n]}\n";
+			}
+
+			void BinaryTopologyFormat::begin(shared_ptr<PhysicalRoot> topology, string &)
+			{
+				this->topology = topology;
+				this->vms.clear();
+			}
+
+			void BinaryTopologyFormat::addVM(const shared_ptr<VirtualMachine> &vm, const Location &, string &)
+			{
+				this->vms.push_back(vm);
+			}
+
+			void BinaryTopologyFormat::end(string &output)
+			{
+				if (!this->topology) {
+					this->topology = make_shared<PhysicalRoot>("");
+				}
+				output += TopologyImage::build(this->topology, this->vms);
+				this->topology.reset();
+				this->vms.clear();
+			}
+
+		}
+	}
+}
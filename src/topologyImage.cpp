@@ -0,0 +1,415 @@
+
+#include "nebu-app-framework/topologyImage.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/logger.h"
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <unordered_map>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::map;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+using nebu::common::VMStatus;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.TopologyImage"));
+
+#define TOPOLOGYIMAGE_MAGIC "NEBUTOPO"
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			const uint32_t TopologyImage::VERSION = 1;
+			const uint32_t TopologyImage::NO_HOST = 0xFFFFFFFF;
+
+			namespace
+			{
+
+				// Collects strings for the string table, storing each distinct string once
+				class StringTable
+				{
+				public:
+					StringTable() : table(1, '\0'), offsets() { }
+
+					uint32_t add(const string &value)
+					{
+						unordered_map<string, uint32_t>::iterator it = this->offsets.find(value);
+						if (it != this->offsets.end()) {
+							return it->second;
+						} else if (value.empty()) {
+							return 0;
+						}
+						uint32_t offset = this->table.size();
+						this->table.append(value.c_str(), value.size() + 1);
+						this->offsets[value] = offset;
+						return offset;
+					}
+
+					const string &getTable() const
+					{
+						return this->table;
+					}
+
+				private:
+					string table;
+					unordered_map<string, uint32_t> offsets;
+				};
+
+				template<class T> void append(string &image, const vector<T> &records)
+				{
+					if (!records.empty()) {
+						image.append(reinterpret_cast<const char *>(&records[0]), records.size() * sizeof(T));
+					}
+				}
+
+				bool compareByHostname(const shared_ptr<VirtualMachine> &a, const shared_ptr<VirtualMachine> &b)
+				{
+					return a->getHostname() < b->getHostname();
+				}
+
+				uint32_t encodeStatus(VMStatus status)
+				{
+					switch (status)
+					{
+					case VMStatus::ON:
+						return 1;
+					case VMStatus::OFF:
+						return 2;
+					default:
+						return 0;
+					}
+				}
+
+				bool inBounds(uint64_t offset, uint64_t count, uint64_t recordSize, uint64_t size)
+				{
+					return offset % 4 == 0 && offset <= size && count * recordSize <= size - offset;
+				}
+
+			}
+
+			string TopologyImage::build(shared_ptr<PhysicalRoot> topology, const vector<shared_ptr<VirtualMachine>> &vms)
+			{
+				StringTable strings;
+				vector<TopologyImageDataCenter> dataCenters;
+				vector<TopologyImageRack> racks;
+				vector<TopologyImageHost> hosts;
+				unordered_map<string, uint32_t> hostIndices;
+
+				// Nodes are stored in ID order, with the children of a node stored consecutively
+				map<string, shared_ptr<PhysicalDataCenter>> sortedDataCenters(
+						topology->getDataCenters().begin(), topology->getDataCenters().end());
+				for (map<string, shared_ptr<PhysicalDataCenter>>::iterator dc = sortedDataCenters.begin();
+						dc != sortedDataCenters.end();
+						dc++)
+				{
+					TopologyImageDataCenter dataCenter = { strings.add(dc->first), static_cast<uint32_t>(racks.size()),
+							static_cast<uint32_t>(dc->second->getRacks().size()) };
+					map<string, shared_ptr<PhysicalRack>> sortedRacks(
+							dc->second->getRacks().begin(), dc->second->getRacks().end());
+					for (map<string, shared_ptr<PhysicalRack>>::iterator rk = sortedRacks.begin(); rk != sortedRacks.end(); rk++) {
+						TopologyImageRack rack = { strings.add(rk->first), static_cast<uint32_t>(dataCenters.size()),
+								static_cast<uint32_t>(hosts.size()), static_cast<uint32_t>(rk->second->getHosts().size()) };
+						map<string, shared_ptr<PhysicalHost>> sortedHosts(
+								rk->second->getHosts().begin(), rk->second->getHosts().end());
+						for (map<string, shared_ptr<PhysicalHost>>::iterator hs = sortedHosts.begin(); hs != sortedHosts.end(); hs++) {
+							TopologyImageHost host = { strings.add(hs->first), static_cast<uint32_t>(racks.size()) };
+							hostIndices[hs->first] = hosts.size();
+							hosts.push_back(host);
+						}
+						racks.push_back(rack);
+					}
+					dataCenters.push_back(dataCenter);
+				}
+
+				vector<uint32_t> hostIndex;
+				for (uint32_t i = 0; i < hosts.size(); i++) {
+					hostIndex.push_back(i);
+				}
+				std::sort(hostIndex.begin(), hostIndex.end(), [&strings, &hosts](uint32_t a, uint32_t b) {
+					return strcmp(strings.getTable().c_str() + hosts[a].id, strings.getTable().c_str() + hosts[b].id) < 0;
+				});
+
+				vector<shared_ptr<VirtualMachine>> sortedVMs(vms);
+				std::stable_sort(sortedVMs.begin(), sortedVMs.end(), compareByHostname);
+				vector<TopologyImageVM> vmRecords;
+				vmRecords.reserve(sortedVMs.size());
+				for (vector<shared_ptr<VirtualMachine>>::iterator it = sortedVMs.begin(); it != sortedVMs.end(); it++) {
+					unordered_map<string, uint32_t>::iterator host = hostIndices.find((*it)->getPhysicalHostID());
+					TopologyImageVM vm = { strings.add((*it)->getUUID()), strings.add((*it)->getHostname()),
+							host != hostIndices.end() ? host->second : TopologyImage::NO_HOST,
+							encodeStatus((*it)->getStatus()) };
+					vmRecords.push_back(vm);
+				}
+
+				TopologyImageHeader header;
+				memset(&header, 0, sizeof(header));
+				memcpy(header.magic, TOPOLOGYIMAGE_MAGIC, sizeof(header.magic));
+				header.version = TopologyImage::VERSION;
+				header.headerSize = sizeof(header);
+				header.rootID = strings.add(topology->getUUID());
+				header.dataCenterCount = dataCenters.size();
+				header.rackCount = racks.size();
+				header.hostCount = hosts.size();
+				header.vmCount = vmRecords.size();
+				header.dataCenterOffset = sizeof(header);
+				header.rackOffset = header.dataCenterOffset + dataCenters.size() * sizeof(TopologyImageDataCenter);
+				header.hostOffset = header.rackOffset + racks.size() * sizeof(TopologyImageRack);
+				header.hostIndexOffset = header.hostOffset + hosts.size() * sizeof(TopologyImageHost);
+				header.vmOffset = header.hostIndexOffset + hostIndex.size() * sizeof(uint32_t);
+				header.stringOffset = header.vmOffset + vmRecords.size() * sizeof(TopologyImageVM);
+				header.stringSize = strings.getTable().size();
+
+				string image;
+				image.reserve(header.stringOffset + header.stringSize);
+				image.append(reinterpret_cast<const char *>(&header), sizeof(header));
+				append(image, dataCenters);
+				append(image, racks);
+				append(image, hosts);
+				append(image, hostIndex);
+				append(image, vmRecords);
+				image.append(strings.getTable());
+				return image;
+			}
+
+			bool TopologyImage::open(const char *data, size_t size)
+			{
+				this->close();
+				return this->attach(data, size);
+			}
+
+			bool TopologyImage::attach(const char *data, size_t size)
+			{
+				this->data = data;
+				this->size = size;
+				if (!this->validate()) {
+					this->data = NULL;
+					this->size = 0;
+					return false;
+				}
+				return true;
+			}
+
+			bool TopologyImage::load(const string &filename)
+			{
+				this->close();
+				if (!this->file.open(filename)) {
+					return false;
+				} else if (!this->attach(this->file.getData(), this->file.getSize())) {
+					LOG4CXX_WARN(logger, "Ignoring " << filename << ": not a valid topology image");
+					this->file.close();
+					return false;
+				}
+				return true;
+			}
+
+			void TopologyImage::close()
+			{
+				this->data = NULL;
+				this->size = 0;
+				this->file.close();
+			}
+
+			// Checks the header and the topology nodes; VMs and the host index are checked when they are used,
+			// so opening an image does not depend on the number of VMs
+			bool TopologyImage::validate() const
+			{
+				const TopologyImageHeader *header = this->getHeader();
+				if (this->size < sizeof(TopologyImageHeader) || reinterpret_cast<uintptr_t>(this->data) % 4 != 0 ||
+						memcmp(header->magic, TOPOLOGYIMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+						header->version != TopologyImage::VERSION || header->headerSize < sizeof(TopologyImageHeader)) {
+					return false;
+				}
+
+				if (!inBounds(header->dataCenterOffset, header->dataCenterCount, sizeof(TopologyImageDataCenter), this->size) ||
+						!inBounds(header->rackOffset, header->rackCount, sizeof(TopologyImageRack), this->size) ||
+						!inBounds(header->hostOffset, header->hostCount, sizeof(TopologyImageHost), this->size) ||
+						!inBounds(header->hostIndexOffset, header->hostCount, sizeof(uint32_t), this->size) ||
+						!inBounds(header->vmOffset, header->vmCount, sizeof(TopologyImageVM), this->size) ||
+						!inBounds(header->stringOffset, header->stringSize, 1, this->size) ||
+						header->stringSize == 0 || this->data[header->stringOffset + header->stringSize - 1] != '\0') {
+					return false;
+				}
+
+				const TopologyImageDataCenter *dataCenters = this->getArray<TopologyImageDataCenter>(header->dataCenterOffset);
+				for (uint32_t i = 0; i < header->dataCenterCount; i++) {
+					if (static_cast<uint64_t>(dataCenters[i].firstRack) + dataCenters[i].rackCount > header->rackCount) {
+						return false;
+					}
+				}
+				const TopologyImageRack *racks = this->getArray<TopologyImageRack>(header->rackOffset);
+				for (uint32_t i = 0; i < header->rackCount; i++) {
+					if (racks[i].dataCenter >= header->dataCenterCount ||
+							static_cast<uint64_t>(racks[i].firstHost) + racks[i].hostCount > header->hostCount) {
+						return false;
+					}
+				}
+				const TopologyImageHost *hosts = this->getArray<TopologyImageHost>(header->hostOffset);
+				for (uint32_t i = 0; i < header->hostCount; i++) {
+					if (hosts[i].rack >= header->rackCount) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			const TopologyImageHeader *TopologyImage::getHeader() const
+			{
+				return reinterpret_cast<const TopologyImageHeader *>(this->data);
+			}
+
+			const char *TopologyImage::getString(uint32_t offset) const
+			{
+				const TopologyImageHeader *header = this->getHeader();
+				return this->data + header->stringOffset + (offset < header->stringSize ? offset : 0);
+			}
+
+			template<class T> const T *TopologyImage::getArray(uint32_t offset) const
+			{
+				return reinterpret_cast<const T *>(this->data + offset);
+			}
+
+			void TopologyImage::getLocation(uint32_t host, Location &location) const
+			{
+				const TopologyImageHeader *header = this->getHeader();
+				const TopologyImageHost &imageHost = this->getArray<TopologyImageHost>(header->hostOffset)[host];
+				const TopologyImageRack &rack = this->getArray<TopologyImageRack>(header->rackOffset)[imageHost.rack];
+				const TopologyImageDataCenter &dc =
+						this->getArray<TopologyImageDataCenter>(header->dataCenterOffset)[rack.dataCenter];
+				location.dataCenter = this->getString(dc.id);
+				location.rack = this->getString(rack.id);
+				location.host = this->getString(imageHost.id);
+			}
+
+			const char *TopologyImage::getRootID() const
+			{
+				return this->isOpen() ? this->getString(this->getHeader()->rootID) : "";
+			}
+
+			uint32_t TopologyImage::getDataCenterCount() const
+			{
+				return this->isOpen() ? this->getHeader()->dataCenterCount : 0;
+			}
+
+			uint32_t TopologyImage::getRackCount() const
+			{
+				return this->isOpen() ? this->getHeader()->rackCount : 0;
+			}
+
+			uint32_t TopologyImage::getHostCount() const
+			{
+				return this->isOpen() ? this->getHeader()->hostCount : 0;
+			}
+
+			uint32_t TopologyImage::getVMCount() const
+			{
+				return this->isOpen() ? this->getHeader()->vmCount : 0;
+			}
+
+			bool TopologyImage::findHost(const string &hostID, Location &location) const
+			{
+				if (!this->isOpen()) {
+					return false;
+				}
+				const TopologyImageHeader *header = this->getHeader();
+				const uint32_t *hostIndex = this->getArray<uint32_t>(header->hostIndexOffset);
+				const TopologyImageHost *hosts = this->getArray<TopologyImageHost>(header->hostOffset);
+
+				uint32_t low = 0;
+				uint32_t high = header->hostCount;
+				while (low < high) {
+					uint32_t middle = low + (high - low) / 2;
+					if (hostIndex[middle] >= header->hostCount) {
+						return false;
+					}
+					int comparison = strcmp(this->getString(hosts[hostIndex[middle]].id), hostID.c_str());
+					if (comparison == 0) {
+						this->getLocation(hostIndex[middle], location);
+						return true;
+					} else if (comparison < 0) {
+						low = middle + 1;
+					} else {
+						high = middle;
+					}
+				}
+				return false;
+			}
+
+			bool TopologyImage::findVM(const string &hostname, Location &location) const
+			{
+				if (!this->isOpen()) {
+					return false;
+				}
+				const TopologyImageHeader *header = this->getHeader();
+				const TopologyImageVM *vms = this->getArray<TopologyImageVM>(header->vmOffset);
+
+				uint32_t low = 0;
+				uint32_t high = header->vmCount;
+				while (low < high) {
+					uint32_t middle = low + (high - low) / 2;
+					int comparison = strcmp(this->getString(vms[middle].hostname), hostname.c_str());
+					if (comparison == 0) {
+						if (vms[middle].host >= header->hostCount) {
+							return false;
+						}
+						this->getLocation(vms[middle].host, location);
+						return true;
+					} else if (comparison < 0) {
+						low = middle + 1;
+					} else {
+						high = middle;
+					}
+				}
+				return false;
+			}
+
+			shared_ptr<PhysicalRoot> TopologyImage::toTopology() const
+			{
+				if (!this->isOpen()) {
+					return shared_ptr<PhysicalRoot>();
+				}
+				const TopologyImageHeader *header = this->getHeader();
+				const TopologyImageDataCenter *dataCenters = this->getArray<TopologyImageDataCenter>(header->dataCenterOffset);
+				const TopologyImageRack *racks = this->getArray<TopologyImageRack>(header->rackOffset);
+				const TopologyImageHost *hosts = this->getArray<TopologyImageHost>(header->hostOffset);
+
+				shared_ptr<PhysicalRoot> root = make_shared<PhysicalRoot>(this->getString(header->rootID));
+				for (uint32_t i = 0; i < header->dataCenterCount; i++) {
+					shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>(this->getString(dataCenters[i].id));
+					root->addDataCenter(dc);
+					dc->setParent(root.get());
+					for (uint32_t j = dataCenters[i].firstRack; j < dataCenters[i].firstRack + dataCenters[i].rackCount; j++) {
+						shared_ptr<PhysicalRack> rack = make_shared<PhysicalRack>(this->getString(racks[j].id));
+						dc->addRack(rack);
+						rack->setParent(dc.get());
+						for (uint32_t k = racks[j].firstHost; k < racks[j].firstHost + racks[j].hostCount; k++) {
+							shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>(this->getString(hosts[k].id));
+							rack->addHost(host);
+							host->setParent(rack.get());
+						}
+					}
+				}
+				return root;
+			}
+
+		}
+	}
+}
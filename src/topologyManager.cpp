@@ -1,5 +1,7 @@
 
 #include "nebu-app-framework/topologyManager.h"
+#include "nebu-app-framework/mappedFile.h"
+#include "nebu-app-framework/topologyImage.h"
 
 #include "log4cxx/logger.h"
 
@@ -9,10 +11,13 @@
 #include "nebu/topology/physicalRoot.h"
 #include "nebu/util/exceptions.h"
 
+#include <unistd.h>
+
 // Using declarations - standard library
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 // Using declarations - nebu-common
 using nebu::common::AppPhysRequest;
 using nebu::common::NebuServerException;
@@ -21,6 +26,7 @@ using nebu::common::PhysicalHost;
 using nebu::common::PhysicalRack;
 using nebu::common::PhysicalRoot;
 using nebu::common::Traits;
+using nebu::common::VirtualMachine;
 
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.TopologyManager"));
 
@@ -34,7 +40,8 @@ namespace nebu
 			const std::string TopologyManager::ID_UNKNOWN = "";
 
 			TopologyManager::TopologyManager(shared_ptr<AppPhysRequest> appPhysRequest) :
-					appPhysRequest(appPhysRequest), physicalRoot(make_shared<PhysicalRoot>(TopologyManager::ID_UNKNOWN))
+					appPhysRequest(appPhysRequest), physicalRoot(make_shared<PhysicalRoot>(TopologyManager::ID_UNKNOWN)),
+					lastImageFilename(), lastImageHash(0)
 			{
 
 			}
@@ -58,6 +65,44 @@ namespace nebu
 				}
 			}
 
+			void TopologyManager::restoreTopology(shared_ptr<PhysicalRoot> physicalRoot)
+			{
+				if (physicalRoot) {
+					this->physicalRoot = physicalRoot;
+				}
+			}
+
+			bool TopologyManager::writeImage(const string &filename, const vector<shared_ptr<VirtualMachine>> &vms) const
+			{
+				string image = TopologyImage::build(this->physicalRoot, vms);
+				uint64_t hash = hashContents(image.data(), image.size());
+				if (filename == this->lastImageFilename && hash == this->lastImageHash &&
+						access(filename.c_str(), F_OK) == 0) {
+					LOG4CXX_TRACE(logger, "Topology image in " << filename << " is up to date");
+					return true;
+				}
+				if (!writeFileAtomically(filename, image.data(), image.size())) {
+					this->lastImageFilename.clear();
+					return false;
+				}
+				this->lastImageFilename = filename;
+				this->lastImageHash = hash;
+				LOG4CXX_DEBUG(logger, "Wrote topology image of " << vms.size() << " VMs to " << filename <<
+						" (" << image.size() << " bytes)");
+				return true;
+			}
+
+			bool TopologyManager::loadImage(const string &filename)
+			{
+				TopologyImage image;
+				if (!image.load(filename)) {
+					return false;
+				}
+				this->physicalRoot = image.toTopology();
+				LOG4CXX_INFO(logger, "Loaded topology of " << image.getHostCount() << " hosts from " << filename);
+				return true;
+			}
+
 			shared_ptr<PhysicalRoot> TopologyManager::getRoot() const
 			{
 				return this->physicalRoot;
@@ -0,0 +1,684 @@
+
+#include "nebu-app-framework/topologyServer.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/logger.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::deque;
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::unique_lock;
+using std::unordered_map;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::Traits;
+using nebu::common::VirtualMachine;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.TopologyServer"));
+
+#define TOPOLOGYSERVER_BACKLOG        128
+#define TOPOLOGYSERVER_EVENTS         64
+#define TOPOLOGYSERVER_READSIZE       65536
+#define TOPOLOGYSERVER_MAXPENDING     (4 << 20)
+#define TOPOLOGYSERVER_RETRYDELAY     1000
+#define TOPOLOGYSERVER_MAXRETRYDELAY  300000
+
+typedef std::chrono::steady_clock Clock;
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			namespace
+			{
+
+				bool setSocketPath(struct sockaddr_un &address, const string &socketPath)
+				{
+					memset(&address, 0, sizeof(address));
+					address.sun_family = AF_UNIX;
+					if (socketPath.size() >= sizeof(address.sun_path)) {
+						return false;
+					}
+					memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+					return true;
+				}
+
+				void appendUint32(string &buffer, uint32_t value)
+				{
+					value = htonl(value);
+					buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+				}
+
+				void appendString(string &buffer, const char *value, size_t length)
+				{
+					uint16_t networkLength = htons(static_cast<uint16_t>(length));
+					buffer.append(reinterpret_cast<const char *>(&networkLength), sizeof(networkLength));
+					buffer.append(value, length);
+				}
+
+				uint32_t readUint32(const char *data)
+				{
+					uint32_t value;
+					memcpy(&value, data, sizeof(value));
+					return ntohl(value);
+				}
+
+				uint16_t readUint16(const char *data)
+				{
+					uint16_t value;
+					memcpy(&value, data, sizeof(value));
+					return ntohs(value);
+				}
+
+				vector<string> lookupAddresses(const string &hostname)
+				{
+					vector<string> result;
+					struct addrinfo hints;
+					memset(&hints, 0, sizeof(hints));
+					hints.ai_family = AF_UNSPEC;
+					hints.ai_socktype = SOCK_STREAM;
+					struct addrinfo *addresses;
+					if (getaddrinfo(hostname.c_str(), NULL, &hints, &addresses) != 0) {
+						LOG4CXX_DEBUG(logger, "Could not resolve the addresses of " << hostname);
+						return result;
+					}
+					for (struct addrinfo *address = addresses; address != NULL; address = address->ai_next) {
+						char host[NI_MAXHOST];
+						if (getnameinfo(address->ai_addr, address->ai_addrlen, host, sizeof(host), NULL, 0,
+								NI_NUMERICHOST) == 0 && hostname != host) {
+							result.push_back(host);
+						}
+					}
+					freeaddrinfo(addresses);
+					return result;
+				}
+
+			}
+
+			/*  The state of a client connection. Requests are buffered until a complete frame has arrived, and
+			 *  responses are buffered while the client is not reading them, up to TOPOLOGYSERVER_MAXPENDING
+			 *  bytes, after which further requests are left in the socket.
+			 */
+			struct TopologyServer::Connection
+			{
+				string input;
+				string output;
+				size_t written;
+				uint32_t events;
+
+				Connection() : input(), output(), written(0), events(EPOLLIN) { }
+
+				size_t getPending() const
+				{
+					return this->output.size() - this->written;
+				}
+			};
+
+			const uint32_t TopologyServer::MAX_FRAME_SIZE = 1 << 20;
+
+			TopologyServer::TopologyServer(const string &socketPath) :
+					socketPath(socketPath), resolveAddresses(false), listenFd(-1), epollFd(-1), stopFd(-1), server(),
+					indexMutex(), index(make_shared<Index>()), queries(0), updateMutex(), resolverCondition(),
+					resolver(), resolverStopping(false), addressLookup(lookupAddresses), addresses(), pending()
+			{
+
+			}
+
+			TopologyServer::~TopologyServer()
+			{
+				this->stop();
+				this->stopResolver();
+			}
+
+			bool TopologyServer::start()
+			{
+				if (this->isRunning()) {
+					return true;
+				}
+
+				struct sockaddr_un address;
+				if (!setSocketPath(address, this->socketPath)) {
+					LOG4CXX_WARN(logger, "Socket path '" << this->socketPath << "' is too long");
+					return false;
+				}
+				unlink(this->socketPath.c_str());
+				this->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+				if (this->listenFd < 0 ||
+						bind(this->listenFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+						listen(this->listenFd, TOPOLOGYSERVER_BACKLOG) != 0) {
+					LOG4CXX_WARN(logger, "Could not listen on '" << this->socketPath << "': " << strerror(errno));
+					if (this->listenFd >= 0) {
+						close(this->listenFd);
+						this->listenFd = -1;
+					}
+					return false;
+				}
+
+				this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+				this->stopFd = eventfd(0, EFD_CLOEXEC);
+				struct epoll_event event;
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.fd = this->listenFd;
+				epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->listenFd, &event);
+				event.data.fd = this->stopFd;
+				epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->stopFd, &event);
+
+				LOG4CXX_INFO(logger, "Serving topology queries on '" << this->socketPath << "'");
+				this->server = thread(&TopologyServer::serveLoop, this);
+				return true;
+			}
+
+			void TopologyServer::stop()
+			{
+				if (!this->isRunning()) {
+					return;
+				}
+
+				uint64_t value = 1;
+				if (write(this->stopFd, &value, sizeof(value)) != sizeof(value)) {
+					LOG4CXX_WARN(logger, "Could not signal the topology server to stop");
+				}
+				this->server.join();
+
+				close(this->listenFd);
+				close(this->epollFd);
+				close(this->stopFd);
+				this->listenFd = -1;
+				this->epollFd = -1;
+				this->stopFd = -1;
+				unlink(this->socketPath.c_str());
+			}
+
+			void TopologyServer::update(shared_ptr<PhysicalRoot> topology, const vector<shared_ptr<VirtualMachine>> &vms)
+			{
+				unordered_map<string, string> hosts;
+				if (topology) {
+					for (Traits<PhysicalDataCenter>::Map::const_iterator dc = topology->getDataCenters().begin();
+							dc != topology->getDataCenters().end();
+							dc++)
+					{
+						for (Traits<PhysicalRack>::Map::const_iterator rack = dc->second->getRacks().begin();
+								rack != dc->second->getRacks().end();
+								rack++)
+						{
+							for (Traits<PhysicalHost>::Map::const_iterator host = rack->second->getHosts().begin();
+									host != rack->second->getHosts().end();
+									host++)
+							{
+								hosts[host->first] = "/" + dc->first + "/" + rack->first + "/" + host->first;
+							}
+						}
+					}
+				}
+
+				shared_ptr<Index> newIndex = make_shared<Index>();
+				newIndex->reserve(this->resolveAddresses ? 2 * vms.size() : vms.size());
+				unordered_map<string, Addresses> newAddresses;
+				bool queued = false;
+				Clock::time_point now = Clock::now();
+				lock_guard<mutex> lock(this->updateMutex);
+				for (vector<shared_ptr<VirtualMachine>>::const_iterator vm = vms.begin(); vm != vms.end(); vm++) {
+					string hostname = (*vm)->getHostname();
+					unordered_map<string, string>::const_iterator host = hosts.find((*vm)->getPhysicalHostID());
+					if (hostname.empty() || host == hosts.end()) {
+						continue;
+					}
+					(*newIndex)[hostname] = host->second;
+
+					if (this->resolveAddresses) {
+						// Addresses are kept for as long as the hostname exists, so only new VMs are looked up
+						unordered_map<string, Addresses>::iterator cached = this->addresses.find(hostname);
+						Addresses &vmAddresses = newAddresses[hostname];
+						if (cached != this->addresses.end()) {
+							vmAddresses = std::move(cached->second);
+						}
+						if (vmAddresses.values.empty() && !vmAddresses.queued && vmAddresses.retry <= now) {
+							vmAddresses.queued = true;
+							this->pending.push_back(hostname);
+							queued = true;
+						}
+						for (vector<string>::const_iterator it = vmAddresses.values.begin();
+								it != vmAddresses.values.end();
+								it++)
+						{
+							newIndex->insert(Index::value_type(*it, host->second));
+						}
+					}
+				}
+				this->addresses.swap(newAddresses);
+
+				if (queued) {
+					if (!this->resolver.joinable()) {
+						this->resolver = thread(&TopologyServer::resolveLoop, this);
+					}
+					this->resolverCondition.notify_one();
+				}
+
+				LOG4CXX_DEBUG(logger, "Serving the locations of " << newIndex->size() << " names");
+				lock_guard<mutex> indexLock(this->indexMutex);
+				this->index = newIndex;
+			}
+
+			void TopologyServer::resolveLoop()
+			{
+				unique_lock<mutex> lock(this->updateMutex);
+				while (true) {
+					while (!this->resolverStopping && this->pending.empty()) {
+						this->resolverCondition.wait(lock);
+					}
+					if (this->resolverStopping) {
+						return;
+					}
+
+					// Lookups may take seconds, so they run without blocking updates
+					deque<string> hostnames;
+					hostnames.swap(this->pending);
+					lock.unlock();
+					vector<pair<string, vector<string>>> results;
+					for (deque<string>::const_iterator it = hostnames.begin(); it != hostnames.end(); it++) {
+						results.push_back(pair<string, vector<string>>(*it, this->addressLookup(*it)));
+					}
+					lock.lock();
+
+					// The index is only copied if a lookup found addresses for a hostname it still holds
+					shared_ptr<Index> newIndex;
+					Clock::time_point now = Clock::now();
+					for (vector<pair<string, vector<string>>>::iterator result = results.begin();
+							result != results.end();
+							result++)
+					{
+						unordered_map<string, Addresses>::iterator vmAddresses = this->addresses.find(result->first);
+						if (vmAddresses == this->addresses.end()) {
+							continue;
+						}
+						vmAddresses->second.queued = false;
+						if (result->second.empty()) {
+							unsigned int shift = std::min(vmAddresses->second.failures++, 16U);
+							long delay = std::min(static_cast<long>(TOPOLOGYSERVER_RETRYDELAY) << shift,
+									static_cast<long>(TOPOLOGYSERVER_MAXRETRYDELAY));
+							vmAddresses->second.retry = now + std::chrono::milliseconds(delay);
+							LOG4CXX_DEBUG(logger, "Retrying to resolve the addresses of " << result->first << " in " <<
+									delay << " ms");
+							continue;
+						}
+						vmAddresses->second.failures = 0;
+						vmAddresses->second.values.swap(result->second);
+
+						if (!newIndex) {
+							newIndex = make_shared<Index>(*this->getIndex());
+						}
+						Index::const_iterator path = newIndex->find(result->first);
+						if (path != newIndex->end()) {
+							string location = path->second;
+							for (vector<string>::const_iterator it = vmAddresses->second.values.begin();
+									it != vmAddresses->second.values.end();
+									it++)
+							{
+								newIndex->insert(Index::value_type(*it, location));
+							}
+						}
+					}
+					if (newIndex) {
+						lock_guard<mutex> indexLock(this->indexMutex);
+						this->index = newIndex;
+					}
+				}
+			}
+
+			void TopologyServer::stopResolver()
+			{
+				{
+					lock_guard<mutex> lock(this->updateMutex);
+					this->resolverStopping = true;
+				}
+				this->resolverCondition.notify_one();
+				if (this->resolver.joinable()) {
+					this->resolver.join();
+				}
+			}
+
+			bool TopologyServer::resolve(const string &name, string &path) const
+			{
+				shared_ptr<const Index> index = this->getIndex();
+				Index::const_iterator it = index->find(name);
+				if (it == index->end()) {
+					return false;
+				}
+				path = it->second;
+				return true;
+			}
+
+			size_t TopologyServer::getIndexSize() const
+			{
+				return this->getIndex()->size();
+			}
+
+			shared_ptr<const TopologyServer::Index> TopologyServer::getIndex() const
+			{
+				lock_guard<mutex> lock(this->indexMutex);
+				return this->index;
+			}
+
+			void TopologyServer::serveLoop()
+			{
+				unordered_map<int, Connection> connections;
+				struct epoll_event events[TOPOLOGYSERVER_EVENTS];
+				bool running = true;
+
+				while (running) {
+					int count = epoll_wait(this->epollFd, events, TOPOLOGYSERVER_EVENTS, -1);
+					for (int i = 0; i < count; i++) {
+						int fd = events[i].data.fd;
+						if (fd == this->stopFd) {
+							running = false;
+						} else if (fd == this->listenFd) {
+							this->acceptConnections(connections);
+						} else {
+							unordered_map<int, Connection>::iterator connection = connections.find(fd);
+							if (connection == connections.end()) {
+								continue;
+							}
+							bool open = true;
+							if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+								open = this->receive(fd, connection->second);
+							}
+							if (open && (events[i].events & EPOLLOUT)) {
+								open = this->send(fd, connection->second);
+							}
+							if (!open) {
+								close(fd);
+								connections.erase(connection);
+							}
+						}
+					}
+				}
+
+				for (unordered_map<int, Connection>::iterator it = connections.begin(); it != connections.end(); it++) {
+					close(it->first);
+				}
+			}
+
+			void TopologyServer::acceptConnections(unordered_map<int, Connection> &connections)
+			{
+				int fd;
+				while ((fd = accept4(this->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+					struct epoll_event event;
+					memset(&event, 0, sizeof(event));
+					event.events = EPOLLIN;
+					event.data.fd = fd;
+					if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+						close(fd);
+						continue;
+					}
+					connections[fd] = Connection();
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					LOG4CXX_WARN(logger, "Could not accept topology client: " << strerror(errno));
+				}
+			}
+
+			bool TopologyServer::receive(int fd, Connection &connection)
+			{
+				char buffer[TOPOLOGYSERVER_READSIZE];
+				bool closed = false;
+				while (true) {
+					// Every complete frame is answered, even if the client has closed its end of the connection
+					if (!this->answerFrames(connection)) {
+						return false;
+					}
+					if (closed || connection.getPending() >= TOPOLOGYSERVER_MAXPENDING) {
+						break;
+					}
+					ssize_t length = read(fd, buffer, sizeof(buffer));
+					if (length < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						if (errno == EAGAIN || errno == EWOULDBLOCK) {
+							break;
+						}
+						closed = true;
+					} else if (length == 0) {
+						closed = true;
+					} else {
+						connection.input.append(buffer, length);
+					}
+				}
+
+				return this->send(fd, connection) && !closed;
+			}
+
+			bool TopologyServer::answerFrames(Connection &connection)
+			{
+				string key;
+				size_t offset = 0;
+				while (connection.input.size() - offset >= sizeof(uint32_t)) {
+					uint32_t size = readUint32(connection.input.data() + offset);
+					if (size > TopologyServer::MAX_FRAME_SIZE) {
+						LOG4CXX_DEBUG(logger, "Disconnecting topology client sending a frame of " << size << " bytes");
+						return false;
+					}
+					if (connection.input.size() - offset - sizeof(uint32_t) < size) {
+						break;
+					}
+					if (!this->answer(connection.input.data() + offset + sizeof(uint32_t), size, connection.output,
+							key)) {
+						LOG4CXX_DEBUG(logger, "Disconnecting topology client sending a malformed frame");
+						return false;
+					}
+					offset += sizeof(uint32_t) + size;
+				}
+				connection.input.erase(0, offset);
+				return true;
+			}
+
+			bool TopologyServer::send(int fd, Connection &connection)
+			{
+				while (connection.written < connection.output.size()) {
+					ssize_t length = ::send(fd, connection.output.data() + connection.written,
+							connection.output.size() - connection.written, MSG_NOSIGNAL);
+					if (length < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						if (errno != EAGAIN && errno != EWOULDBLOCK) {
+							return false;
+						}
+						break;
+					}
+					connection.written += length;
+				}
+				if (connection.written == connection.output.size()) {
+					connection.output.clear();
+					connection.written = 0;
+				} else if (connection.written > connection.output.size() / 2) {
+					connection.output.erase(0, connection.written);
+					connection.written = 0;
+				}
+
+				// Writability is only watched while responses are pending, to avoid waking up for idle clients,
+				// and readability while few enough are pending, so that clients not reading cannot grow the buffer
+				uint32_t events = 0;
+				if (connection.getPending() < TOPOLOGYSERVER_MAXPENDING) {
+					events |= EPOLLIN;
+				}
+				if (!connection.output.empty()) {
+					events |= EPOLLOUT;
+				}
+				if (events != connection.events) {
+					struct epoll_event event;
+					memset(&event, 0, sizeof(event));
+					event.events = events;
+					event.data.fd = fd;
+					epoll_ctl(this->epollFd, EPOLL_CTL_MOD, fd, &event);
+					connection.events = events;
+				}
+				return true;
+			}
+
+			bool TopologyServer::answer(const char *request, uint32_t size, string &response, string &key)
+			{
+				shared_ptr<const Index> index = this->getIndex();
+				size_t header = response.size();
+				appendUint32(response, 0);
+
+				uint64_t answered = 0;
+				for (uint32_t offset = 0; offset < size; ) {
+					if (size - offset < sizeof(uint16_t)) {
+						return false;
+					}
+					uint16_t length = readUint16(request + offset);
+					offset += sizeof(uint16_t);
+					if (size - offset < length) {
+						return false;
+					}
+					key.assign(request + offset, length);
+					offset += length;
+
+					Index::const_iterator it = index->find(key);
+					if (it != index->end()) {
+						appendString(response, it->second.data(), it->second.size());
+					} else {
+						appendString(response, "", 0);
+					}
+					answered++;
+				}
+
+				uint32_t frameSize = htonl(static_cast<uint32_t>(response.size() - header - sizeof(uint32_t)));
+				memcpy(&response[header], &frameSize, sizeof(frameSize));
+				this->queries += answered;
+				return true;
+			}
+
+			TopologyClient::TopologyClient(const string &socketPath) :
+					socketPath(socketPath), fd(-1), buffer()
+			{
+
+			}
+
+			TopologyClient::~TopologyClient()
+			{
+				this->close();
+			}
+
+			bool TopologyClient::connect()
+			{
+				struct sockaddr_un address;
+				if (!setSocketPath(address, this->socketPath)) {
+					return false;
+				}
+				this->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+				if (this->fd < 0) {
+					return false;
+				}
+				if (::connect(this->fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+					this->close();
+					return false;
+				}
+				return true;
+			}
+
+			void TopologyClient::close()
+			{
+				if (this->fd >= 0) {
+					::close(this->fd);
+					this->fd = -1;
+				}
+			}
+
+			bool TopologyClient::resolve(const vector<string> &names, vector<string> &paths)
+			{
+				paths.clear();
+				this->buffer.clear();
+				appendUint32(this->buffer, 0);
+				for (vector<string>::const_iterator it = names.begin(); it != names.end(); it++) {
+					if (it->size() > UINT16_MAX) {
+						return false;
+					}
+					appendString(this->buffer, it->data(), it->size());
+				}
+				uint32_t frameSize = htonl(static_cast<uint32_t>(this->buffer.size() - sizeof(uint32_t)));
+				memcpy(&this->buffer[0], &frameSize, sizeof(frameSize));
+				if (this->buffer.size() - sizeof(uint32_t) > TopologyServer::MAX_FRAME_SIZE) {
+					return false;
+				}
+
+				if (this->fd < 0 && !this->connect()) {
+					return false;
+				}
+				for (size_t written = 0; written < this->buffer.size(); ) {
+					ssize_t length = ::send(this->fd, this->buffer.data() + written, this->buffer.size() - written,
+							MSG_NOSIGNAL);
+					if (length < 0 && errno == EINTR) {
+						continue;
+					}
+					if (length <= 0) {
+						this->close();
+						return false;
+					}
+					written += length;
+				}
+
+				// The response header is read first, then the frame it announces
+				this->buffer.resize(sizeof(uint32_t));
+				for (size_t received = 0, size = sizeof(uint32_t); received < size; ) {
+					ssize_t length = read(this->fd, &this->buffer[received], size - received);
+					if (length < 0 && errno == EINTR) {
+						continue;
+					}
+					if (length <= 0) {
+						this->close();
+						return false;
+					}
+					received += length;
+					if (received == sizeof(uint32_t) && size == sizeof(uint32_t)) {
+						size += readUint32(this->buffer.data());
+						this->buffer.resize(size);
+					}
+				}
+
+				paths.reserve(names.size());
+				for (size_t offset = sizeof(uint32_t); offset + sizeof(uint16_t) <= this->buffer.size(); ) {
+					uint16_t length = readUint16(this->buffer.data() + offset);
+					offset += sizeof(uint16_t);
+					paths.push_back(this->buffer.substr(offset, length));
+					offset += length;
+				}
+				if (paths.size() != names.size()) {
+					this->close();
+					return false;
+				}
+				return true;
+			}
+
+		}
+	}
+}
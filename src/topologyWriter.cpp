@@ -1,15 +1,17 @@
 
 #include "nebu-app-framework/topologyWriter.h"
+#include "nebu-app-framework/mappedFile.h"
 
 #include "nebu/topology/physicalDataCenter.h"
 #include "nebu/topology/physicalHost.h"
 #include "nebu/topology/physicalRack.h"
 
-#include <fstream>
+#include "log4cxx/logger.h"
+
+#include <unistd.h>
 
 // Using declarations - standard library
-using std::endl;
-using std::ofstream;
+using std::make_shared;
 using std::shared_ptr;
 using std::string;
 using std::unordered_map;
@@ -19,8 +21,11 @@ using nebu::common::PhysicalDataCenter;
 using nebu::common::PhysicalHost;
 using nebu::common::PhysicalRack;
 using nebu::common::PhysicalRoot;
+using nebu::common::Traits;
 using nebu::common::VirtualMachine;
 
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.TopologyWriter"));
+
 namespace nebu
 {
 	namespace app
@@ -28,44 +33,117 @@ namespace nebu
 		namespace framework
 		{
 
-			unordered_map<string, shared_ptr<PhysicalHost>> createHostMap(shared_ptr<PhysicalRoot> topology)
+			TopologyWriter::TopologyWriter() :
+					filename(), outputs(), hostLocations()
+			{
+				this->addOutput("", make_shared<TextTopologyFormat>());
+			}
+
+			void TopologyWriter::write(shared_ptr<PhysicalRoot> topology, vector<shared_ptr<VirtualMachine>> vms)
 			{
-				unordered_map<string, shared_ptr<PhysicalHost>> map;
-				for (unordered_map<string, shared_ptr<PhysicalDataCenter>>::const_iterator dc = topology->getDataCenters().begin();
+				// Subclasses may have set the filename directly
+				Output &text = this->outputs.front();
+				if (this->filename != text.filename) {
+					text.filename = this->filename;
+					text.written = false;
+				}
+				if (!this->isIndexed(topology)) {
+					this->indexHosts(topology);
+				}
+
+				vector<Output *> active;
+				for (vector<Output>::iterator it = this->outputs.begin(); it != this->outputs.end(); it++) {
+					if (!it->filename.empty()) {
+						it->buffer.clear();
+						it->format->begin(topology, it->buffer);
+						active.push_back(&*it);
+					}
+				}
+
+				for (vector<shared_ptr<VirtualMachine>>::const_iterator vm = vms.begin(); vm != vms.end(); vm++) {
+					unordered_map<string, TopologyFormat::Location>::const_iterator location =
+							this->hostLocations.find((*vm)->getPhysicalHostID());
+					if (location != this->hostLocations.end()) {
+						for (vector<Output *>::iterator it = active.begin(); it != active.end(); it++) {
+							(*it)->format->addVM(*vm, location->second, (*it)->buffer);
+						}
+					}
+				}
+
+				for (vector<Output *>::iterator it = active.begin(); it != active.end(); it++) {
+					Output &output = **it;
+					output.format->end(output.buffer);
+					uint64_t hash = hashContents(output.buffer.data(), output.buffer.size());
+					// The file may have been removed by someone else since it was last written
+					if (output.written && hash == output.contentHash && access(output.filename.c_str(), F_OK) == 0) {
+						LOG4CXX_DEBUG(logger, "Topology unchanged, not rewriting " << output.filename);
+						continue;
+					}
+					if (writeFileAtomically(output.filename, output.buffer.data(), output.buffer.size())) {
+						output.contentHash = hash;
+						output.written = true;
+					}
+				}
+			}
+
+			// Comparing the topology with the index only reads it, which is much cheaper than rebuilding the index
+			bool TopologyWriter::isIndexed(shared_ptr<PhysicalRoot> topology) const
+			{
+				if (!topology) {
+					return this->hostLocations.empty();
+				}
+				size_t hosts = 0;
+				for (Traits<PhysicalDataCenter>::Map::const_iterator dc = topology->getDataCenters().begin();
 						dc != topology->getDataCenters().end();
 						dc++)
 				{
-					for (unordered_map<string, shared_ptr<PhysicalRack>>::const_iterator rack = dc->second->getRacks().begin();
+					for (Traits<PhysicalRack>::Map::const_iterator rack = dc->second->getRacks().begin();
 							rack != dc->second->getRacks().end();
 							rack++)
 					{
-						for (unordered_map<string, shared_ptr<PhysicalHost>>::const_iterator host = rack->second->getHosts().begin();
+						for (Traits<PhysicalHost>::Map::const_iterator host = rack->second->getHosts().begin();
 								host != rack->second->getHosts().end();
 								host++)
 						{
-							map[host->first] = host->second;
+							unordered_map<string, TopologyFormat::Location>::const_iterator location =
+									this->hostLocations.find(host->first);
+							if (location == this->hostLocations.end() || location->second.dataCenter != dc->first ||
+									location->second.rack != rack->first || location->second.host != host->first) {
+								return false;
+							}
+							hosts++;
 						}
 					}
 				}
-				return map;
+				return hosts == this->hostLocations.size();
 			}
 
-			void TopologyWriter::write(shared_ptr<PhysicalRoot> topology, vector<shared_ptr<VirtualMachine>> vms)
+			void TopologyWriter::indexHosts(shared_ptr<PhysicalRoot> topology)
 			{
-				unordered_map<string, shared_ptr<PhysicalHost>> hostMap = createHostMap(topology);
-
-				ofstream output(this->filename, ofstream::trunc);
-				if (output.is_open()) {
-					for (vector<shared_ptr<VirtualMachine>>::iterator vm = vms.begin(); vm != vms.end(); vm++) {
-						if (hostMap.find((*vm)->getPhysicalHostID()) != hostMap.end()) {
-							PhysicalHost *host = hostMap[(*vm)->getPhysicalHostID()].get();
-							PhysicalRack *rack = host->getParent();
-							PhysicalDataCenter *dc = rack->getParent();
-							output << (*vm)->getHostname() << "\t/" << dc->getUUID() << "/" << rack->getUUID() << "/" << host->getUUID() << endl;
+				this->hostLocations.clear();
+				if (!topology) {
+					return;
+				}
+				for (Traits<PhysicalDataCenter>::Map::const_iterator dc = topology->getDataCenters().begin();
+						dc != topology->getDataCenters().end();
+						dc++)
+				{
+					for (Traits<PhysicalRack>::Map::const_iterator rack = dc->second->getRacks().begin();
+							rack != dc->second->getRacks().end();
+							rack++)
+					{
+						for (Traits<PhysicalHost>::Map::const_iterator host = rack->second->getHosts().begin();
+								host != rack->second->getHosts().end();
+								host++)
+						{
+							TopologyFormat::Location &location = this->hostLocations[host->first];
+							location.dataCenter = dc->first;
+							location.rack = rack->first;
+							location.host = host->first;
+							location.path = "/" + location.dataCenter + "/" + location.rack + "/" + location.host;
 						}
 					}
 				}
-				output.close();
 			}
 
 			void TopologyWriter::setFilename(const string &filename)
@@ -73,6 +151,12 @@ namespace nebu
 				this->filename = filename;
 			}
 
+			void TopologyWriter::addOutput(const string &filename, shared_ptr<TopologyFormat> format)
+			{
+				Output output = { filename, format, string(), 0, false };
+				this->outputs.push_back(output);
+			}
+
 		}
 	}
 }
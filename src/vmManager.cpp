@@ -1,10 +1,12 @@
 
 #include "nebu-app-framework/vmManager.h"
+#include "nebu-app-framework/circuitBreaker.h"
 
 #include "nebu/util/exceptions.h"
 
 #include "log4cxx/logger.h"
 
+#include <algorithm>
 #include <set>
 
 // Using declarations - standard library
@@ -15,6 +17,7 @@ using std::shared_ptr;
 using std::string;
 using std::unordered_map;
 using std::vector;
+using std::chrono::steady_clock;
 // Using declarations - nebu-common
 using nebu::common::NebuServerException;
 using nebu::common::VirtualMachine;
@@ -36,9 +39,14 @@ namespace nebu
 
 			bool VMManager::refreshVMList()
 			{
+				this->lastRefresh = RefreshStatistics();
 				vector<string> vmIDs;
 				try {
 					vmIDs = this->appVirtRequest->getVirtualMachineIDs();
+				} catch (CircuitOpenException &ex) {
+					LOG4CXX_WARN(logger, "Could not refresh VM list\n" + ex.what());
+					this->lastRefresh.circuitOpen = true;
+					return false;
 				} catch (NebuServerException &ex) {
 					LOG4CXX_WARN(logger, "Could not refresh VM list\n" + ex.what());
 					return false;
@@ -51,6 +59,11 @@ namespace nebu
 				succes &= this->updateVMs(vmIDsFiltered);
 				this->removeVMs(vmIDs);
 
+				this->lastRefresh.listed = true;
+				this->lastRefresh.quarantined = this->getQuarantinedVMs().size();
+				LOG4CXX_DEBUG(logger, "Refreshed VMs: " << this->lastRefresh.succeeded << " of " <<
+						this->lastRefresh.requested << " requests succeeded, " << this->lastRefresh.skipped <<
+						" VMs backing off, " << this->lastRefresh.quarantined << " quarantined");
 				return succes;
 			}
 
@@ -62,21 +75,32 @@ namespace nebu
 					 )
 				{
 					if (this->vmList.find(*it) == this->vmList.end()) {
+						if (this->isBackingOff(*it)) {
+							it = retrievedVMIds.erase(it);
+							continue;
+						}
 						try {
+							this->lastRefresh.requested++;
 							shared_ptr<VirtualMachine> newVM = make_shared<VirtualMachine>(
 									this->appVirtRequest->getVirtualMachine(*it));
+							this->lastRefresh.succeeded++;
+							this->recordSuccess(*it);
 							LOG4CXX_INFO(logger, "Detected new VM with hostname '" + newVM->getHostname() +
 									"' (id: " + newVM->getUUID() + ")");
 							LOG4CXX_DEBUG(logger, "\tHost: " << newVM->getPhysicalHostID() <<
 									", store: " << newVM->getPhysicalStoreID() << ", status: " <<
 									static_cast<unsigned int>(newVM->getStatus()));
 							this->addVM(newVM);
+							this->lastRefresh.added++;
+						} catch (CircuitOpenException &ex) {
+							this->endRefreshOnOpenCircuit(ex.what());
+							return false;
 						} catch (NebuServerException &ex) {
 							LOG4CXX_WARN(logger, "Missing information on a new vm\n" + ex.what());
-							succes = false;
+							succes &= this->recordFailure(*it, ex.what());
 						}
 
-						retrievedVMIds.erase(it);
+						it = retrievedVMIds.erase(it);
 					} else {
 						it++;
 					}
@@ -86,42 +110,171 @@ namespace nebu
 
 			bool VMManager::updateVMs(vector<string> &filteredVMIds)
 			{
+				if (this->lastRefresh.circuitOpen) {
+					return false;
+				}
+
 				bool succes = true;
-				for (vector<string>::iterator it = filteredVMIds.begin();
-					 it != filteredVMIds.end();
+				vector<string> selectedVMIds = this->selectVMsToRefresh(filteredVMIds);
+				for (vector<string>::iterator it = selectedVMIds.begin();
+					 it != selectedVMIds.end();
 					 it++)
 				{
 					shared_ptr<VirtualMachine> vm = this->vmList[*it];
 					try {
+						this->lastRefresh.requested++;
 						VirtualMachine updatedVM = this->appVirtRequest->getVirtualMachine(*it);
+						this->lastRefresh.succeeded++;
+						this->recordSuccess(*it);
+						RefreshState &state = this->refreshStates[*it];
+						state.status = updatedVM.getStatus();
 						if (vm->getStatus() != updatedVM.getStatus()) {
+							state.lastChange = steady_clock::now();
+							state.unchangedPolls = 0;
 							LOG4CXX_INFO(logger, "Detected change in VM with hostname '" << vm->getHostname() <<
 									"' (id: " << vm->getUUID() << ")");
 							LOG4CXX_DEBUG(logger, "\tStatus from " << static_cast<unsigned int>(vm->getStatus()) <<
 									" to " << static_cast<unsigned int>(updatedVM.getStatus()));
 
 							this->updateVM(vm, updatedVM);
+							this->lastRefresh.changed++;
+						} else {
+							state.unchangedPolls++;
 						}
+					} catch (CircuitOpenException &ex) {
+						this->endRefreshOnOpenCircuit(ex.what());
+						return false;
 					} catch (NebuServerException &ex) {
 						// TODO: Decide: should the VM status be set to UNKNOWN?
 						LOG4CXX_WARN(logger, "Missing information for a VM update\n" + ex.what());
-						succes = false;
+						succes &= this->recordFailure(*it, ex.what());
 					}
 				}
 				return succes;
 			}
 
+			void VMManager::endRefreshOnOpenCircuit(const string &error)
+			{
+				// The request was never made, so it is neither counted nor recorded as a failure of the VM
+				LOG4CXX_WARN(logger, "Ending the refresh of the VMs early\n" + error);
+				this->lastRefresh.requested--;
+				this->lastRefresh.circuitOpen = true;
+			}
+
+			bool VMManager::isBackingOff(const string &uuid)
+			{
+				unordered_map<string, FailureState>::iterator failure = this->failures.find(uuid);
+				if (failure == this->failures.end() || failure->second.skipRefreshes == 0) {
+					return false;
+				}
+				failure->second.skipRefreshes--;
+				this->lastRefresh.skipped++;
+				return true;
+			}
+
+			void VMManager::recordSuccess(const string &uuid)
+			{
+				unordered_map<string, FailureState>::iterator failure = this->failures.find(uuid);
+				if (failure != this->failures.end()) {
+					if (failure->second.quarantined) {
+						LOG4CXX_INFO(logger, "VM " << uuid << " recovered after " <<
+								failure->second.consecutiveFailures << " failed requests, leaving quarantine");
+					}
+					this->failures.erase(failure);
+				}
+			}
+
+			bool VMManager::recordFailure(const string &uuid, const string &error)
+			{
+				this->lastRefresh.failed++;
+				FailureState &failure = this->failures[uuid];
+				bool wasQuarantined = failure.quarantined;
+				failure.consecutiveFailures++;
+				failure.lastError = error;
+				if (this->quarantineThreshold == 0) {
+					return false;
+				}
+
+				// Skip 1, 2, 4, ... refreshes after consecutive failures, up to the maximum backoff
+				unsigned int exponent = std::min(failure.consecutiveFailures - 1, 31U);
+				failure.skipRefreshes = std::min<uint64_t>(static_cast<uint64_t>(1) << exponent, this->maxBackoff);
+				if (failure.consecutiveFailures >= this->quarantineThreshold) {
+					failure.quarantined = true;
+					failure.skipRefreshes = this->maxBackoff;
+					if (!wasQuarantined) {
+						LOG4CXX_WARN(logger, "Quarantined VM " << uuid << " after " << failure.consecutiveFailures <<
+								" failed requests, retrying every " << (this->maxBackoff + 1) << " refreshes");
+					}
+				}
+				// Failures of quarantined VMs are expected, and do not fail the refresh
+				return wasQuarantined;
+			}
+
+			bool VMManager::isStable(const RefreshState &state) const
+			{
+				switch (state.status)
+				{
+				case VMStatus::ON:
+					return state.unchangedPolls >= this->stablePolls;
+				case VMStatus::OFF:
+					return state.unchangedPolls >= 1;
+				case VMStatus::UNKNOWN:
+					return false;
+				}
+				return false;
+			}
+
+			vector<string> VMManager::selectVMsToRefresh(const vector<string> &vmIDs)
+			{
+				vector<string> selected;
+				vector<string> stable;
+				for (vector<string>::const_iterator it = vmIDs.begin(); it != vmIDs.end(); it++) {
+					// VMs backing off are skipped before the sweep, so they do not use up its budget
+					if (this->isBackingOff(*it)) {
+						continue;
+					}
+					unordered_map<string, RefreshState>::const_iterator state = this->refreshStates.find(*it);
+					if (this->stablePolls > 0 && state != this->refreshStates.end() && this->isStable(state->second)) {
+						stable.push_back(*it);
+					} else {
+						selected.push_back(*it);
+					}
+				}
+
+				// Sweep the stable VMs in order of their IDs, continuing after the last VM swept in the previous call
+				std::sort(stable.begin(), stable.end());
+				size_t start = std::upper_bound(stable.begin(), stable.end(), this->sweepCursor) - stable.begin();
+				size_t sweep = std::min<size_t>(this->sweepBudget, stable.size());
+				for (size_t i = 0; i < sweep; i++) {
+					this->sweepCursor = stable[(start + i) % stable.size()];
+					selected.push_back(this->sweepCursor);
+				}
+
+				LOG4CXX_DEBUG(logger, "Refreshing " << (selected.size() - sweep) << " changing VMs and " << sweep <<
+						" of " << stable.size() << " stable VMs");
+				return selected;
+			}
+
 			void VMManager::removeVMs(vector<string> &retrievedVMIds)
 			{
 				vector<shared_ptr<VirtualMachine>> knownVMs = this->getVMs();
 				set<string> vmIDSet(retrievedVMIds.begin(), retrievedVMIds.end());
 
+				for (unordered_map<string, FailureState>::iterator it = this->failures.begin(); it != this->failures.end(); ) {
+					if (vmIDSet.find(it->first) == vmIDSet.end()) {
+						it = this->failures.erase(it);
+					} else {
+						it++;
+					}
+				}
+
 				for (vector<shared_ptr<VirtualMachine>>::iterator it = knownVMs.begin();
 					 it != knownVMs.end();
 					 it++)
 				{
 					if (vmIDSet.find((*it)->getUUID()) == vmIDSet.end()) {
 						this->removeVM(*it);
+						this->lastRefresh.removed++;
 					}
 				}
 			}
@@ -150,11 +303,38 @@ namespace nebu
 			void VMManager::addVM(shared_ptr<VirtualMachine> vm)
 			{
 				this->vmList[vm->getUUID()] = vm;
+				RefreshState &state = this->refreshStates[vm->getUUID()];
+				state.lastChange = steady_clock::now();
+				state.status = vm->getStatus();
+				state.unchangedPolls = 0;
+
+				FOREACH_EVENTHANDLER(ev)
+				{
+					ev->get()->newVMAdded(vm);
+				}
+			}
+
+			void VMManager::restoreVM(shared_ptr<VirtualMachine> vm, unsigned int unchangedPolls)
+			{
+				this->vmList[vm->getUUID()] = vm;
+				RefreshState &state = this->refreshStates[vm->getUUID()];
+				state.lastChange = steady_clock::now();
+				state.status = vm->getStatus();
+				state.unchangedPolls = unchangedPolls;
+			}
+
+			bool VMManager::notifyVMAdded(const string &uuid)
+			{
+				shared_ptr<VirtualMachine> vm = this->getVM(uuid);
+				if (!vm) {
+					return false;
+				}
 
 				FOREACH_EVENTHANDLER(ev)
 				{
 					ev->get()->newVMAdded(vm);
 				}
+				return true;
 			}
 
 			void VMManager::updateVM(shared_ptr<VirtualMachine> vm, const VirtualMachine &updated)
@@ -186,6 +366,7 @@ namespace nebu
 			void VMManager::removeVM(shared_ptr<VirtualMachine> vm)
 			{
 				this->vmList.erase(vm->getUUID());
+				this->refreshStates.erase(vm->getUUID());
 
 				FOREACH_EVENTHANDLER(ev)
 				{
@@ -203,6 +384,44 @@ namespace nebu
 				this->vmEventHandlers.push_back(eventHandler);
 			}
 
+			void VMManager::setRefreshPolicy(unsigned int stablePolls, unsigned int sweepBudget)
+			{
+				this->stablePolls = stablePolls;
+				this->sweepBudget = std::max(sweepBudget, 1U);
+			}
+
+			void VMManager::setFailurePolicy(unsigned int quarantineThreshold, unsigned int maxBackoff)
+			{
+				this->quarantineThreshold = quarantineThreshold;
+				this->maxBackoff = std::max(maxBackoff, 1U);
+			}
+
+			vector<string> VMManager::getQuarantinedVMs() const
+			{
+				vector<string> quarantined;
+				for (unordered_map<string, FailureState>::const_iterator it = this->failures.begin();
+						it != this->failures.end();
+						it++)
+				{
+					if (it->second.quarantined) {
+						quarantined.push_back(it->first);
+					}
+				}
+				std::sort(quarantined.begin(), quarantined.end());
+				return quarantined;
+			}
+
+			VMManager::FailureState VMManager::getFailureState(const string &uuid) const
+			{
+				unordered_map<string, FailureState>::const_iterator failure = this->failures.find(uuid);
+				return (failure == this->failures.end()) ? FailureState() : failure->second;
+			}
+
+			VMManager::RefreshState VMManager::getRefreshState(const string &uuid) const
+			{
+				return this->refreshStates.at(uuid);
+			}
+
 		}
 	}
 }
@@ -0,0 +1,291 @@
+
+#include "nebu-app-framework/worldStatePublisher.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/logger.h"
+
+#include <errno.h>
+#include <new>
+#include <unordered_map>
+
+// Using declarations - standard library
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::Traits;
+using nebu::common::VirtualMachine;
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("nebu.app.framework.WorldStatePublisher"));
+
+#define WORLDSTATE_MINBUCKETS 16
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+
+			namespace
+			{
+
+				struct HostLocation
+				{
+					uint32_t dataCenter;
+					uint32_t rack;
+					uint32_t host;
+				};
+
+				class StringTable
+				{
+				public:
+					StringTable(string &table) : table(table), offsets()
+					{
+						this->table.assign(1, '\0');
+					}
+
+					// Topology IDs are shared by many VMs and stored once
+					uint32_t addShared(const string &value)
+					{
+						unordered_map<string, uint32_t>::iterator it = this->offsets.find(value);
+						if (it != this->offsets.end()) {
+							return it->second;
+						}
+						uint32_t offset = this->add(value);
+						this->offsets[value] = offset;
+						return offset;
+					}
+
+					uint32_t add(const string &value)
+					{
+						if (value.empty()) {
+							return 0;
+						}
+						uint32_t offset = this->table.size();
+						this->table.append(value.c_str(), value.size() + 1);
+						return offset;
+					}
+
+				private:
+					string &table;
+					unordered_map<string, uint32_t> offsets;
+				};
+
+				// Sequence increments are ordered with the copies they protect, as in a seqcount latch
+				void advance(WorldStateControl *control)
+				{
+					std::atomic_thread_fence(std::memory_order_release);
+					control->sequence.store(control->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_release);
+				}
+
+				// Readers attached to a segment left by an earlier publisher would keep reading its last state
+				void retireSegment(const string &name)
+				{
+					int fd = shm_open(name.c_str(), O_RDWR, 0);
+					if (fd < 0) {
+						return;
+					}
+					struct stat status;
+					void *mapping = MAP_FAILED;
+					if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(WorldStateControl)) {
+						mapping = mmap(NULL, sizeof(WorldStateControl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+					}
+					close(fd);
+					if (mapping != MAP_FAILED) {
+						WorldStateControl *control = static_cast<WorldStateControl *>(mapping);
+						if (memcmp(control->magic, "NEBUWRLD", sizeof(control->magic)) == 0) {
+							control->retired.store(1, std::memory_order_release);
+						}
+						munmap(mapping, sizeof(WorldStateControl));
+					}
+				}
+
+			}
+
+			WorldStatePublisher::WorldStatePublisher(const string &name, size_t bufferSize) :
+					name(name), bufferSize((bufferSize + 7) & ~static_cast<size_t>(7)), segment(NULL), segmentSize(0),
+					generation(0), image()
+			{
+
+			}
+
+			WorldStatePublisher::~WorldStatePublisher()
+			{
+				if (this->segment) {
+					// A segment retired by another publisher has been replaced, and the name is no longer ours
+					bool replaced = reinterpret_cast<WorldStateControl *>(this->segment)->retired.exchange(1) != 0;
+					munmap(this->segment, this->segmentSize);
+					if (!replaced) {
+						shm_unlink(this->name.c_str());
+					}
+				}
+			}
+
+			bool WorldStatePublisher::open()
+			{
+				if (this->segment) {
+					return true;
+				}
+				retireSegment(this->name);
+				shm_unlink(this->name.c_str());
+				int fd = shm_open(this->name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+				if (fd < 0) {
+					LOG4CXX_WARN(logger, "Could not create shared memory segment " << this->name << ": " << strerror(errno));
+					return false;
+				}
+
+				size_t size = sizeof(WorldStateControl) + 2 * this->bufferSize;
+				void *mapping = MAP_FAILED;
+				if (ftruncate(fd, size) == 0) {
+					mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				}
+				int error = errno;
+				close(fd);
+				if (mapping == MAP_FAILED) {
+					LOG4CXX_WARN(logger, "Could not map shared memory segment " << this->name << ": " << strerror(error));
+					shm_unlink(this->name.c_str());
+					return false;
+				}
+				this->segment = static_cast<char *>(mapping);
+				this->segmentSize = size;
+
+				// Both copies start as an empty generation 0, before the segment is marked valid
+				this->render(shared_ptr<PhysicalRoot>(), vector<shared_ptr<VirtualMachine>>());
+				memcpy(this->segment + sizeof(WorldStateControl), this->image.data(), this->image.size());
+				memcpy(this->segment + sizeof(WorldStateControl) + this->bufferSize, this->image.data(), this->image.size());
+
+				WorldStateControl *control = new (this->segment) WorldStateControl();
+				control->version = WORLDSTATE_VERSION;
+				control->bufferSize = this->bufferSize;
+				control->retired.store(0, std::memory_order_relaxed);
+				control->sequence.store(0, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				memcpy(control->magic, "NEBUWRLD", sizeof(control->magic));
+
+				LOG4CXX_INFO(logger, "Publishing world state in shared memory segment " << this->name);
+				return true;
+			}
+
+			bool WorldStatePublisher::publish(shared_ptr<PhysicalRoot> topology, const vector<shared_ptr<VirtualMachine>> &vms)
+			{
+				if (!this->segment) {
+					return false;
+				}
+
+				this->generation++;
+				this->render(topology, vms);
+				if (this->image.size() > this->bufferSize) {
+					LOG4CXX_WARN(logger, "World state of " << vms.size() << " VMs needs " << this->image.size() <<
+							" bytes, more than the " << this->bufferSize << " bytes available; not publishing");
+					this->generation--;
+					return false;
+				}
+
+				WorldStateControl *control = reinterpret_cast<WorldStateControl *>(this->segment);
+				char *copies = this->segment + sizeof(WorldStateControl);
+				advance(control);
+				memcpy(copies, this->image.data(), this->image.size());
+				advance(control);
+				memcpy(copies + this->bufferSize, this->image.data(), this->image.size());
+
+				LOG4CXX_DEBUG(logger, "Published world state generation " << this->generation << " (" <<
+						reinterpret_cast<const WorldStateBuffer *>(this->image.data())->entryCount << " VMs, " <<
+						this->image.size() << " bytes)");
+				return true;
+			}
+
+			void WorldStatePublisher::render(shared_ptr<PhysicalRoot> topology, const vector<shared_ptr<VirtualMachine>> &vms)
+			{
+				string strings;
+				StringTable table(strings);
+
+				unordered_map<string, HostLocation> hosts;
+				if (topology) {
+					for (Traits<PhysicalDataCenter>::Map::const_iterator dc = topology->getDataCenters().begin();
+							dc != topology->getDataCenters().end();
+							dc++)
+					{
+						for (Traits<PhysicalRack>::Map::const_iterator rack = dc->second->getRacks().begin();
+								rack != dc->second->getRacks().end();
+								rack++)
+						{
+							for (Traits<PhysicalHost>::Map::const_iterator host = rack->second->getHosts().begin();
+									host != rack->second->getHosts().end();
+									host++)
+							{
+								HostLocation location = { table.addShared(dc->first), table.addShared(rack->first),
+										table.addShared(host->first) };
+								hosts[host->first] = location;
+							}
+						}
+					}
+				}
+
+				// At most half of the buckets are used, which keeps probe sequences short
+				uint32_t bucketCount = WORLDSTATE_MINBUCKETS;
+				while (bucketCount < 2 * vms.size()) {
+					bucketCount *= 2;
+				}
+				vector<WorldStateEntry> buckets(bucketCount);
+				memset(&buckets[0], 0, bucketCount * sizeof(WorldStateEntry));
+
+				uint32_t entryCount = 0;
+				for (vector<shared_ptr<VirtualMachine>>::const_iterator vm = vms.begin(); vm != vms.end(); vm++) {
+					string hostname = (*vm)->getHostname();
+					unordered_map<string, HostLocation>::iterator host = hosts.find((*vm)->getPhysicalHostID());
+					if (hostname.empty() || host == hosts.end()) {
+						continue;
+					}
+
+					uint32_t hash = worldStateHash(hostname.data(), hostname.size());
+					uint32_t bucket = hash & (bucketCount - 1);
+					bool duplicate = false;
+					while (buckets[bucket].hostname != 0 && !duplicate) {
+						duplicate = buckets[bucket].hash == hash && strings.compare(buckets[bucket].hostname,
+								hostname.size() + 1, hostname.c_str(), hostname.size() + 1) == 0;
+						bucket = (bucket + 1) & (bucketCount - 1);
+					}
+					if (duplicate) {
+						LOG4CXX_DEBUG(logger, "Not publishing duplicate hostname " << hostname);
+						continue;
+					}
+
+					WorldStateEntry &entry = buckets[bucket];
+					entry.hash = hash;
+					entry.hostname = table.add(hostname);
+					entry.uuid = table.add((*vm)->getUUID());
+					entry.dataCenter = host->second.dataCenter;
+					entry.rack = host->second.rack;
+					entry.host = host->second.host;
+					entryCount++;
+				}
+
+				WorldStateBuffer header;
+				memset(&header, 0, sizeof(header));
+				header.generation = this->generation;
+				header.entryCount = entryCount;
+				header.bucketCount = bucketCount;
+				header.bucketOffset = sizeof(header);
+				header.stringOffset = header.bucketOffset + bucketCount * sizeof(WorldStateEntry);
+				header.stringSize = strings.size();
+
+				this->image.clear();
+				this->image.reserve(header.stringOffset + header.stringSize);
+				this->image.append(reinterpret_cast<const char *>(&header), sizeof(header));
+				this->image.append(reinterpret_cast<const char *>(&buckets[0]), bucketCount * sizeof(WorldStateEntry));
+				this->image.append(strings);
+			}
+
+		}
+	}
+}
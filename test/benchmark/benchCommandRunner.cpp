@@ -0,0 +1,61 @@
+
+#include "nebu-app-framework/commandRunner.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+
+// Using declarations - standard library
+using std::cout;
+using std::endl;
+using std::function;
+using std::string;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandResult;
+using nebu::app::framework::CommandRunner;
+using nebu::app::framework::ShellWorkerPool;
+
+typedef std::chrono::steady_clock Clock;
+
+void benchmark(const string &name, unsigned int iterations, function<void()> body) {
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		body();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	cout << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed <<
+			std::setprecision(1) << (iterations / seconds) << " commands/s" << endl;
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+
+	unsigned int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+	CommandRunner runner;
+	CommandResult result;
+	Command trueCommand(vector<string> { "true" });
+	Command echoCommand(vector<string> { "echo", "hello" });
+	Command shellCommand = Command::shell("echo hello");
+
+	benchmark("system(\"true\")", iterations, [&]() { if (system("true") != 0) abort(); });
+	benchmark("runCommand(\"true\")", iterations, [&]() { runner.runCommand("true"); });
+	benchmark("execute({\"true\"})", iterations, [&]() { runner.execute(trueCommand, result); });
+	benchmark("system(\"echo hello >/dev/null\")", iterations, [&]() { if (system("echo hello >/dev/null") != 0) abort(); });
+	benchmark("execute({\"echo\", \"hello\"}), captured", iterations, [&]() { runner.execute(echoCommand, result); });
+	benchmark("execute(shell(\"echo hello\")), captured", iterations, [&]() { runner.execute(shellCommand, result); });
+
+	CommandRunner pooledRunner;
+	pooledRunner.setShellWorkerPool(std::make_shared<ShellWorkerPool>(1));
+	benchmark("execute({\"true\"}), worker", iterations, [&]() { pooledRunner.execute(trueCommand, result); });
+	benchmark("execute(shell(\"echo hello\")), worker", iterations, [&]() { pooledRunner.execute(shellCommand, result); });
+	benchmark("execute(shell(\"kill -0 1\")), worker", iterations, [&]() { pooledRunner.execute(Command::shell("kill -0 1"), result); });
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include "nebu-app-framework/daemonCollection.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+
+// Using declarations - standard library
+using std::cout;
+using std::endl;
+using std::function;
+using std::make_shared;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Daemon;
+using nebu::app::framework::DaemonCollection;
+using nebu::app::framework::DaemonType;
+
+typedef std::chrono::steady_clock Clock;
+
+class BenchDaemon : public Daemon
+{
+public:
+	BenchDaemon(shared_ptr<VirtualMachine> vm, DaemonType type, bool launched) : Daemon(vm), type(type)
+	{
+		this->launched = launched;
+	}
+	virtual ~BenchDaemon() { }
+
+	virtual bool launch() { return true; }
+	virtual DaemonType getType() const { return this->type; }
+
+private:
+	DaemonType type;
+};
+
+// Keeps the optimizer from discarding query results
+volatile size_t sink;
+
+void benchmark(const string &name, unsigned int iterations, function<void()> body) {
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		body();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	cout << std::left << std::setw(48) << name << std::right << std::setw(12) << std::fixed <<
+			std::setprecision(3) << (seconds * 1e6 / iterations) << " us/query" << endl;
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+
+	unsigned int maxDaemons = (argc > 1) ? atoi(argv[1]) : 100000;
+	for (unsigned int count = 1000; count <= maxDaemons; count *= 10) {
+		DaemonCollection collection;
+		for (unsigned int i = 0; i < count; i++) {
+			shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>("vm" + to_string(i / 4));
+			collection.addDaemon(make_shared<BenchDaemon>(vm, i % 4, i % 10 != 1));
+		}
+		unsigned int iterations = std::max(10U, 10000000 / count);
+
+		cout << count << " daemons of 4 types, 10% unlaunched" << endl;
+		benchmark("  getDaemons()", iterations / 10, [&]() {
+			sink = collection.getDaemons().size();
+		});
+		benchmark("  getDaemonRange()", iterations, [&]() {
+			sink = collection.getDaemonRange().size();
+		});
+		benchmark("  getDaemonsForType(1)", iterations / 10, [&]() {
+			sink = collection.getDaemonsForType(1).size();
+		});
+		benchmark("  getDaemonRangeForType(1)", iterations, [&]() {
+			sink = collection.getDaemonRangeForType(1).size();
+		});
+		benchmark("  getUnlaunchedDaemonsForType(1)", iterations / 10, [&]() {
+			sink = collection.getUnlaunchedDaemonsForType(1).size();
+		});
+		benchmark("  getUnlaunchedDaemonRangeForType(1), iterated", iterations, [&]() {
+			size_t hosts = 0;
+			DaemonCollection::Range daemons = collection.getUnlaunchedDaemonRangeForType(1);
+			for (DaemonCollection::Range::const_iterator it = daemons.begin(); it != daemons.end(); it++) {
+				hosts += (*it)->getHostVM() ? 1 : 0;
+			}
+			sink = hosts;
+		});
+		benchmark("  getDaemonsFiltered(onFirstVM)", iterations / 10, [&]() {
+			sink = collection.getDaemonsFiltered([](shared_ptr<Daemon> daemon) {
+				return daemon->getHostVM()->getUUID() == "vm0";
+			}).size();
+		});
+		benchmark("  queryForVM(\"vm0\").first()", iterations, [&]() {
+			sink = collection.queryForVM("vm0").first() ? 1 : 0;
+		});
+		benchmark("  query(1, false).where(hostname).count()", iterations / 10, [&]() {
+			sink = collection.query(1, false).where([&](const shared_ptr<Daemon> &daemon) {
+				return daemon->getHostVM()->getHostname().empty();
+			}).count();
+		});
+		benchmark("  getLaunchedDaemonsForType(1).size()", iterations / 10, [&]() {
+			sink = collection.getLaunchedDaemonsForType(1).size();
+		});
+		benchmark("  getLaunchedDaemonCountForType(1)", iterations, [&]() {
+			sink = collection.getLaunchedDaemonCountForType(1);
+		});
+
+		// Removes the Daemons of every VM, one VM per query
+		unsigned int vmCount = count / 4;
+		unsigned int removedVMs = 0;
+		benchmark("  removeDaemonsForVM(uuid)", vmCount, [&]() {
+			sink = collection.removeDaemonsForVM("vm" + to_string(removedVMs++));
+		});
+	}
+
+	return 0;
+}
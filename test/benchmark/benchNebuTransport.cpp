@@ -0,0 +1,69 @@
+
+#include "nebu-app-framework/pooledRestClientAdapter.h"
+
+#include "mocks/localHttpServer.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Using declarations - standard library
+using std::cout;
+using std::endl;
+using std::function;
+using std::string;
+using std::thread;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::RestClientAdapter;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::PooledRestClientAdapter;
+using nebu::app::framework::test::LocalHttpServer;
+
+typedef std::chrono::steady_clock Clock;
+
+void benchmark(const string &name, unsigned int threads, unsigned int iterations, function<void()> body) {
+	Clock::time_point start = Clock::now();
+	vector<thread> workers;
+	for (unsigned int t = 0; t < threads; t++) {
+		workers.push_back(thread([iterations, &body]() {
+			for (unsigned int i = 0; i < iterations; i++) {
+				body();
+			}
+		}));
+	}
+	for (vector<thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	cout << std::left << std::setw(48) << name << std::right << std::setw(10) << std::fixed <<
+			std::setprecision(1) << (threads * iterations / seconds) << " requests/s" << endl;
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+
+	unsigned int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+	LocalHttpServer server;
+	string url = server.getUrl() + "/virt/app/vm";
+
+	PooledRestClientAdapter pooled(4, 5000);
+	PooledRestClientAdapter unpooled(4, 5000);
+	unpooled.setKeepAlive(false);
+	RestClientAdapter plain;
+
+	benchmark("RestClientAdapter (restclient-cpp)", 1, iterations, [&]() { plain.get(url); });
+	benchmark("new connection per request, 1 thread", 1, iterations, [&]() { unpooled.get(url); });
+	benchmark("keep-alive pool, 1 thread", 1, iterations, [&]() { pooled.get(url); });
+	benchmark("new connection per request, 4 threads", 4, iterations, [&]() { unpooled.get(url); });
+	benchmark("keep-alive pool of 4, 4 threads", 4, iterations, [&]() { pooled.get(url); });
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "nebu-app-framework/topologyServer.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Using declarations - standard library
+using std::cout;
+using std::endl;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::TopologyClient;
+using nebu::app::framework::TopologyServer;
+
+typedef std::chrono::steady_clock Clock;
+
+shared_ptr<PhysicalRoot> createTopology(unsigned int racks, unsigned int hostsPerRack) {
+	shared_ptr<PhysicalRoot> root = make_shared<PhysicalRoot>("root");
+	shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>("dc");
+	root->addDataCenter(dc); dc->setParent(root.get());
+	for (unsigned int r = 0; r < racks; r++) {
+		shared_ptr<PhysicalRack> rack = make_shared<PhysicalRack>("rack" + to_string(r));
+		dc->addRack(rack); rack->setParent(dc.get());
+		for (unsigned int h = 0; h < hostsPerRack; h++) {
+			shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>("host" + to_string(r * hostsPerRack + h));
+			rack->addHost(host); host->setParent(rack.get());
+		}
+	}
+	return root;
+}
+
+// Runs clients sending batches of queries for a fixed time, and reports throughput and batch latencies
+void loadTest(const string &socketPath, unsigned int clients, unsigned int batchSize, unsigned int vmCount,
+		double duration) {
+	vector<vector<double>> latencies(clients);
+	vector<thread> workers;
+	Clock::time_point start = Clock::now();
+	Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(duration));
+	for (unsigned int c = 0; c < clients; c++) {
+		workers.push_back(thread([c, batchSize, vmCount, end, &socketPath, &latencies]() {
+			TopologyClient client(socketPath);
+			vector<string> names(batchSize);
+			vector<string> paths;
+			unsigned int next = c * 7919;
+			while (Clock::now() < end) {
+				for (unsigned int i = 0; i < batchSize; i++) {
+					names[i] = "vm" + to_string(next++ % vmCount);
+				}
+				Clock::time_point sent = Clock::now();
+				if (!client.resolve(names, paths)) {
+					abort();
+				}
+				latencies[c].push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+			}
+		}));
+	}
+	for (vector<thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	vector<double> all;
+	for (vector<vector<double>>::const_iterator it = latencies.begin(); it != latencies.end(); it++) {
+		all.insert(all.end(), it->begin(), it->end());
+	}
+	std::sort(all.begin(), all.end());
+	if (all.empty()) {
+		return;
+	}
+	const double percentiles[] = { 50, 90, 99, 99.9 };
+	cout << std::left << std::setw(8) << clients << std::setw(8) << batchSize << std::right << std::fixed <<
+			std::setprecision(0) << std::setw(12) << (all.size() * batchSize / seconds) << std::setw(12) <<
+			(all.size() / seconds) << std::setprecision(1);
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+		size_t rank = static_cast<size_t>(percentiles[i] / 100 * (all.size() - 1));
+		cout << std::setw(10) << all[rank];
+	}
+	cout << std::setw(10) << all.back() << endl;
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+
+	double duration = (argc > 1) ? atof(argv[1]) : 2.0;
+	unsigned int vmCount = (argc > 2) ? atoi(argv[2]) : 100000;
+	string socketPath = "/tmp/nebu-bench-topology-" + to_string(getpid()) + ".sock";
+
+	vector<shared_ptr<VirtualMachine>> vms;
+	for (unsigned int i = 0; i < vmCount; i++) {
+		shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>("uuid" + to_string(i));
+		vm->setHostname("vm" + to_string(i));
+		vm->setPhysicalHostID("host" + to_string(i % 1000));
+		vms.push_back(vm);
+	}
+	TopologyServer server(socketPath);
+	if (!server.start()) {
+		return 1;
+	}
+	server.update(createTopology(50, 20), vms);
+
+	cout << "Batch latencies in microseconds, " << vmCount << " VMs" << endl;
+	cout << std::left << std::setw(8) << "clients" << std::setw(8) << "batch" << std::right << std::setw(12) <<
+			"queries/s" << std::setw(12) << "batches/s" << std::setw(10) << "p50" << std::setw(10) << "p90" <<
+			std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << endl;
+	const unsigned int clients[] = { 1, 8, 64 };
+	const unsigned int batchSizes[] = { 1, 32, 512 };
+	for (size_t c = 0; c < sizeof(clients) / sizeof(clients[0]); c++) {
+		for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++) {
+			loadTest(socketPath, clients[c], batchSizes[b], vmCount, duration);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include "nebu-app-framework/topologyWriter.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// Using declarations - standard library
+using std::cout;
+using std::endl;
+using std::function;
+using std::make_shared;
+using std::ofstream;
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::unordered_map;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::Traits;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::TopologyWriter;
+
+typedef std::chrono::steady_clock Clock;
+
+void benchmark(const string &name, unsigned int vmCount, unsigned int iterations, function<void()> body) {
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		body();
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	cout << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed <<
+			std::setprecision(2) << (seconds * 1000 / iterations) << " ms/write" << std::setw(12) <<
+			std::setprecision(0) << (vmCount * iterations / seconds) << " VMs/s" << endl;
+}
+
+// The writer as it was before the host index: host map per call, two lookups and a flush per VM
+void legacyWrite(const string &filename, shared_ptr<PhysicalRoot> topology, vector<shared_ptr<VirtualMachine>> vms) {
+	unordered_map<string, shared_ptr<PhysicalHost>> hostMap;
+	for (Traits<PhysicalDataCenter>::Map::const_iterator dc = topology->getDataCenters().begin();
+			dc != topology->getDataCenters().end(); dc++) {
+		for (Traits<PhysicalRack>::Map::const_iterator rack = dc->second->getRacks().begin();
+				rack != dc->second->getRacks().end(); rack++) {
+			for (Traits<PhysicalHost>::Map::const_iterator host = rack->second->getHosts().begin();
+					host != rack->second->getHosts().end(); host++) {
+				hostMap[host->first] = host->second;
+			}
+		}
+	}
+	ofstream output(filename, ofstream::trunc);
+	for (vector<shared_ptr<VirtualMachine>>::iterator vm = vms.begin(); vm != vms.end(); vm++) {
+		if (hostMap.find((*vm)->getPhysicalHostID()) != hostMap.end()) {
+			PhysicalHost *host = hostMap[(*vm)->getPhysicalHostID()].get();
+			PhysicalRack *rack = host->getParent();
+			PhysicalDataCenter *dc = rack->getParent();
+			output << (*vm)->getHostname() << "\t/" << dc->getUUID() << "/" << rack->getUUID() << "/" <<
+					host->getUUID() << endl;
+		}
+	}
+}
+
+// 4 data centers of 50 racks of 40 hosts
+shared_ptr<PhysicalRoot> createTopology() {
+	shared_ptr<PhysicalRoot> topology = make_shared<PhysicalRoot>("root");
+	for (unsigned int d = 0; d < 4; d++) {
+		shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>("dc" + to_string(d));
+		topology->addDataCenter(dc); dc->setParent(topology.get());
+		for (unsigned int r = 0; r < 50; r++) {
+			shared_ptr<PhysicalRack> rack = make_shared<PhysicalRack>("dc" + to_string(d) + "-rack" + to_string(r));
+			dc->addRack(rack); rack->setParent(dc.get());
+			for (unsigned int h = 0; h < 40; h++) {
+				shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>("host" + to_string((d * 50 + r) * 40 + h));
+				rack->addHost(host); host->setParent(rack.get());
+			}
+		}
+	}
+	return topology;
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+
+	unsigned int maxVMs = (argc > 1) ? atoi(argv[1]) : 1000000;
+	string filename = "/tmp/nebu-bench-topology-" + to_string(getpid());
+
+	shared_ptr<PhysicalRoot> topology = createTopology();
+	// TopologyManager builds a new topology object on every refresh, usually with the same contents
+	shared_ptr<PhysicalRoot> refreshed[] = { createTopology(), createTopology() };
+
+	for (unsigned int vmCount = 10000; vmCount <= maxVMs; vmCount *= 10) {
+		vector<shared_ptr<VirtualMachine>> vms;
+		for (unsigned int i = 0; i < vmCount; i++) {
+			shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>("uuid" + to_string(i));
+			vm->setHostname("vm" + to_string(i) + ".cluster.example.com");
+			vm->setPhysicalHostID("host" + to_string(i % 8000));
+			vms.push_back(vm);
+		}
+		unsigned int iterations = std::max(1U, 1000000 / vmCount);
+
+		cout << vmCount << " VMs" << endl;
+		benchmark("  legacy ofstream with endl", vmCount, iterations, [&]() {
+			legacyWrite(filename, topology, vms);
+		});
+		TopologyWriter writer;
+		writer.setFilename(filename);
+		unsigned int moves = 0;
+		benchmark("  TopologyWriter, changed", vmCount, iterations, [&]() {
+			// Moving one VM forces a write of the full file
+			vms[0]->setPhysicalHostID("host" + to_string(moves++ % 8000));
+			writer.write(topology, vms);
+		});
+		benchmark("  TopologyWriter, unchanged", vmCount, iterations, [&]() {
+			writer.write(topology, vms);
+		});
+		unsigned int refreshes = 0;
+		benchmark("  TopologyWriter, equal new topology", vmCount, iterations, [&]() {
+			writer.write(refreshed[refreshes++ % 2], vms);
+		});
+	}
+
+	unlink(filename.c_str());
+	return 0;
+}
@@ -0,0 +1,138 @@
+
+#include "nebu-app-framework/commandBatch.h"
+#include "nebu-app-framework/commandMetrics.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <errno.h>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandBatch;
+using nebu::app::framework::CommandMetrics;
+using nebu::app::framework::CommandResult;
+// Using declarations - gtest/gmock
+using testing::ElementsAre;
+using testing::Eq;
+using testing::HasSubstr;
+
+static vector<string> invokedHosts;
+
+static Command recordingInvoker(const string &host, const string &script)
+{
+	invokedHosts.push_back(host);
+	return CommandBatch::localInvoker(host, script);
+}
+
+static Command truncatingInvoker(const string &, const string &script)
+{
+	// Drops the exit code from the markers on stdout
+	return Command::shell("(" + script + ") | sed 's/^\\(__NEBU_BATCH_[0-9_]* [0-9]*\\) [0-9]*$/\\1/'");
+}
+
+TEST(CommandBatchTest, testSeparatesResults) {
+	CommandBatch batch;
+	batch.add("host1", "echo first");
+	batch.add("host1", "printf 'no newline'; exit 3");
+	batch.add("host1", "echo error >&2");
+
+	vector<CommandResult> results = batch.flush();
+	ASSERT_THAT(results.size(), Eq(3U));
+	EXPECT_THAT(results[0].getOutput(), Eq("first\n"));
+	EXPECT_THAT(results[0].getExitCode(), Eq(0));
+	EXPECT_THAT(results[1].getOutput(), Eq("no newline"));
+	EXPECT_THAT(results[1].getExitCode(), Eq(3));
+	EXPECT_THAT(results[2].getOutput(), Eq(""));
+	EXPECT_THAT(results[2].getError(), Eq("error\n"));
+	EXPECT_THAT(batch.getPendingCommands(), Eq(0U));
+}
+
+TEST(CommandBatchTest, testOneInvocationPerHost) {
+	invokedHosts.clear();
+	shared_ptr<CommandMetrics> metrics = make_shared<CommandMetrics>();
+	CommandMetrics::setInstance(metrics);
+
+	CommandBatch batch(&recordingInvoker);
+	size_t a = batch.add("host1", "echo a");
+	size_t b = batch.add("host2", "echo b");
+	size_t c = batch.add("host1", "echo c");
+	size_t d = batch.add("host2", Command(vector<string> { "echo", "it's $HOME" }));
+
+	vector<CommandResult> results = batch.flush();
+	EXPECT_THAT(invokedHosts, ElementsAre("host1", "host2"));
+	EXPECT_THAT(results[a].getOutput(), Eq("a\n"));
+	EXPECT_THAT(results[b].getOutput(), Eq("b\n"));
+	EXPECT_THAT(results[c].getOutput(), Eq("c\n"));
+	EXPECT_THAT(results[d].getOutput(), Eq("it's $HOME\n"));
+
+	CommandMetrics::BatchStatistics statistics = metrics->getBatchStatistics();
+	EXPECT_THAT(statistics.batches, Eq(1U));
+	EXPECT_THAT(statistics.commands, Eq(4U));
+	EXPECT_THAT(statistics.invocations, Eq(2U));
+	EXPECT_THAT(metrics->toString(), HasSubstr("4 batched commands in 2 processes"));
+}
+
+TEST(CommandBatchTest, testCommandExitDoesNotStopBatch) {
+	CommandBatch batch;
+	batch.add("host", "exit 1");
+	batch.add("host", "echo still running");
+
+	vector<CommandResult> results = batch.flush();
+	EXPECT_THAT(results[0].getExitCode(), Eq(1));
+	EXPECT_THAT(results[1].getOutput(), Eq("still running\n"));
+	EXPECT_THAT(results[1].succeeded(), Eq(true));
+}
+
+TEST(CommandBatchTest, testMalformedMarkerFails) {
+	CommandBatch batch(&truncatingInvoker);
+	batch.add("host", "echo first");
+	batch.add("host", "echo second");
+
+	vector<CommandResult> results = batch.flush();
+	ASSERT_THAT(results.size(), Eq(2U));
+	EXPECT_THAT(results[0].getOutput(), Eq("first\n"));
+	EXPECT_THAT(results[0].getSpawnError(), Eq(EPROTO));
+	EXPECT_THAT(results[0].succeeded(), Eq(false));
+	EXPECT_THAT(results[1].getOutput(), Eq("second\n"));
+	EXPECT_THAT(results[1].getSpawnError(), Eq(EPROTO));
+}
+
+TEST(CommandBatchTest, testStopOnFailure) {
+	CommandBatch batch;
+	batch.setStopOnFailure(true);
+	batch.add("host", "true");
+	batch.add("host", "false");
+	batch.add("host", "echo skipped");
+
+	vector<CommandResult> results = batch.flush();
+	EXPECT_THAT(results[0].succeeded(), Eq(true));
+	EXPECT_THAT(results[1].getExitCode(), Eq(1));
+	EXPECT_THAT(results[2].getSpawnError(), Eq(ECANCELED));
+	EXPECT_THAT(results[2].getOutput(), Eq(""));
+}
+
+TEST(CommandBatchTest, testTimeout) {
+	CommandBatch batch;
+	batch.setTimeout(200);
+	batch.add("host", "echo done");
+	batch.add("host", "sleep 10");
+
+	vector<CommandResult> results = batch.flush();
+	EXPECT_THAT(results[0].succeeded(), Eq(true));
+	EXPECT_THAT(results[1].hasTimedOut(), Eq(true));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
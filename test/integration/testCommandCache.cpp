@@ -0,0 +1,161 @@
+
+#include "nebu-app-framework/commandCache.h"
+#include "nebu-app-framework/commandMetrics.h"
+#include "nebu-app-framework/commandRunner.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <errno.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandCache;
+using nebu::app::framework::CommandMetrics;
+using nebu::app::framework::CommandResult;
+using nebu::app::framework::CommandRunner;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+TEST(CommandCacheTest, testServesRepeatsWithinTTL) {
+	shared_ptr<CommandMetrics> metrics = make_shared<CommandMetrics>();
+	CommandMetrics::setInstance(metrics);
+	CommandCache cache(10000);
+	unsigned int executions = 0;
+	CommandCache::Runner runner = [&executions](const Command &, CommandResult &result) {
+		executions++;
+		result.getOutputBuffer() = "output";
+	};
+
+	CommandResult first, second;
+	cache.execute(Command::shell("status"), first, runner);
+	cache.execute(Command::shell("status"), second, runner);
+
+	EXPECT_THAT(executions, Eq(1U));
+	EXPECT_THAT(second.getOutput(), Eq("output"));
+	EXPECT_THAT(cache.getStatistics().hits, Eq(1U));
+	EXPECT_THAT(cache.getStatistics().misses, Eq(1U));
+	EXPECT_THAT(metrics->getStatistics()["shell"].cacheHits, Eq(1U));
+}
+
+TEST(CommandCacheTest, testDistinguishesCommands) {
+	CommandCache cache(10000);
+	unsigned int executions = 0;
+	CommandCache::Runner runner = [&executions](const Command &, CommandResult &) { executions++; };
+
+	CommandResult result;
+	Command uncaptured = Command::shell("status");
+	uncaptured.setCaptureOutput(false);
+	cache.execute(Command::shell("status"), result, runner);
+	cache.execute(Command::shell("status other"), result, runner);
+	cache.execute(Command(vector<string> { "/bin/sh", "-c", "status" }), result, runner);
+	cache.execute(uncaptured, result, runner);
+
+	EXPECT_THAT(executions, Eq(3U));
+}
+
+TEST(CommandCacheTest, testExpiry) {
+	CommandCache cache(50);
+	unsigned int executions = 0;
+	CommandCache::Runner runner = [&executions](const Command &, CommandResult &) { executions++; };
+
+	CommandResult result;
+	cache.execute(Command::shell("status"), result, runner);
+	usleep(100000);
+	cache.execute(Command::shell("status"), result, runner);
+	EXPECT_THAT(executions, Eq(2U));
+
+	cache.clear();
+	cache.execute(Command::shell("status"), result, runner);
+	EXPECT_THAT(executions, Eq(3U));
+}
+
+TEST(CommandCacheTest, testFailuresToStartAreNotKept) {
+	CommandCache cache(10000);
+	unsigned int executions = 0;
+	CommandCache::Runner runner = [&executions](const Command &, CommandResult &result) {
+		executions++;
+		result.setSpawnError(ENOENT);
+	};
+
+	CommandResult result;
+	cache.execute(Command::shell("status"), result, runner);
+	cache.execute(Command::shell("status"), result, runner);
+	EXPECT_THAT(executions, Eq(2U));
+}
+
+TEST(CommandCacheTest, testCoalescesConcurrentCommands) {
+	shared_ptr<CommandMetrics> metrics = make_shared<CommandMetrics>();
+	CommandMetrics::setInstance(metrics);
+	CommandCache cache(0);
+	atomic<unsigned int> executions(0);
+	CommandCache::Runner runner = [&executions](const Command &, CommandResult &result) {
+		executions++;
+		usleep(200000);
+		result.getOutputBuffer() = "shared";
+	};
+
+	vector<thread> threads;
+	vector<string> outputs(8);
+	for (unsigned int i = 0; i < outputs.size(); i++) {
+		threads.push_back(thread([&cache, &runner, &outputs, i]() {
+			CommandResult result;
+			cache.execute(Command::shell("status"), result, runner);
+			outputs[i] = result.getOutput();
+		}));
+	}
+	for (vector<thread>::iterator it = threads.begin(); it != threads.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(executions.load(), Eq(1U));
+	EXPECT_THAT(outputs, Eq(vector<string>(8, "shared")));
+	EXPECT_THAT(cache.getStatistics().coalesced, Eq(7U));
+	EXPECT_THAT(metrics->getStatistics()["shell"].coalesced, Eq(7U));
+
+	CommandResult result;
+	cache.execute(Command::shell("status"), result, runner);
+	EXPECT_THAT(executions.load(), Eq(2U));
+}
+
+TEST(CommandCacheTest, testCommandRunnerOptIn) {
+	char directory[] = "/tmp/nebuCommandCacheXXXXXX";
+	ASSERT_THAT(mkdtemp(directory) != NULL, Eq(true));
+	string counter = string(directory) + "/counter";
+
+	CommandRunner runner;
+	runner.setCommandCache(make_shared<CommandCache>(10000));
+	Command append = Command::shell("echo x >> " + counter + "; wc -l < " + counter);
+	EXPECT_THAT(runner.execute(append).getOutput(), Eq("1\n"));
+	EXPECT_THAT(runner.execute(append).getOutput(), Eq("2\n"));
+	runner.runCommand("echo x >> " + counter);
+	runner.runCommand("echo x >> " + counter);
+	EXPECT_THAT(runner.execute(append).getOutput(), Eq("5\n"));
+
+	append.setCacheable(true);
+	EXPECT_THAT(runner.execute(append).getOutput(), Eq("6\n"));
+	EXPECT_THAT(runner.execute(append).getOutput(), Eq("6\n"));
+
+	unlink(counter.c_str());
+	rmdir(directory);
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
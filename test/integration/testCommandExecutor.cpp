@@ -0,0 +1,189 @@
+
+#include "nebu-app-framework/commandExecutor.h"
+#include "nebu-app-framework/commandRunner.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <signal.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::future;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandExecutor;
+using nebu::app::framework::CommandResult;
+using nebu::app::framework::CommandRunner;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::Ge;
+using testing::Lt;
+using testing::Le;
+
+long long elapsedSince(steady_clock::time_point start) {
+	return duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+TEST(CommandExecutorTest, testSubmitFuture) {
+	CommandExecutor executor(4);
+
+	future<CommandResult> result = executor.submit(Command::shell("echo hello; exit 2"));
+	CommandResult commandResult = result.get();
+	EXPECT_THAT(commandResult.getExitCode(), Eq(2));
+	EXPECT_THAT(commandResult.getOutput(), Eq("hello\n"));
+}
+
+TEST(CommandExecutorTest, testSubmitCallbackAndWaitAll) {
+	CommandExecutor executor(4);
+	atomic<int> succeeded(0);
+
+	for (int i = 0; i < 20; i++) {
+		executor.submit(Command(vector<string> { "true" }), [&succeeded](const CommandResult &result) {
+			if (result.succeeded()) {
+				succeeded++;
+			}
+		});
+	}
+	executor.waitAll();
+
+	EXPECT_THAT(succeeded.load(), Eq(20));
+	EXPECT_THAT(executor.getRunningChildren(), Eq(0u));
+	EXPECT_THAT(executor.getQueuedCommands(), Eq(0u));
+}
+
+TEST(CommandExecutorTest, testConcurrencyLimit) {
+	CommandExecutor executor(2);
+	atomic<unsigned int> maxRunning(0);
+
+	steady_clock::time_point start = steady_clock::now();
+	for (int i = 0; i < 6; i++) {
+		executor.submit(Command::shell("sleep 0.2"), [&executor, &maxRunning](const CommandResult &) {
+			unsigned int running = executor.getRunningChildren();
+			if (running > maxRunning) {
+				maxRunning = running;
+			}
+		});
+	}
+	EXPECT_THAT(executor.getRunningChildren() + executor.getQueuedCommands(), Le(6u));
+	executor.waitAll();
+
+	EXPECT_THAT(elapsedSince(start), Ge(550));
+	EXPECT_THAT(maxRunning.load(), Le(2u));
+}
+
+TEST(CommandExecutorTest, testManyConcurrentCommands) {
+	CommandExecutor executor(100);
+	atomic<int> succeeded(0);
+
+	steady_clock::time_point start = steady_clock::now();
+	for (int i = 0; i < 100; i++) {
+		executor.submit(Command::shell("sleep 0.3"), [&succeeded](const CommandResult &result) {
+			if (result.succeeded()) {
+				succeeded++;
+			}
+		});
+	}
+	executor.waitAll();
+
+	EXPECT_THAT(succeeded.load(), Eq(100));
+	EXPECT_THAT(elapsedSince(start), Lt(3000));
+}
+
+TEST(CommandExecutorTest, testTimeout) {
+	CommandExecutor executor(4);
+	Command command = Command::shell("sleep 10");
+	command.setTimeout(200);
+
+	steady_clock::time_point start = steady_clock::now();
+	CommandResult result = executor.submit(command).get();
+
+	EXPECT_THAT(elapsedSince(start), Lt(2000));
+	EXPECT_THAT(result.hasTimedOut(), Eq(true));
+	EXPECT_THAT(result.getSignal(), Eq(SIGTERM));
+}
+
+TEST(CommandExecutorTest, testTimeoutKillEscalation) {
+	CommandExecutor executor(4);
+	Command command = Command::shell("trap '' TERM; while true; do sleep 0.05; done");
+	command.setTimeout(100);
+	command.setKillGracePeriod(200);
+
+	CommandResult result = executor.submit(command).get();
+
+	EXPECT_THAT(result.hasTimedOut(), Eq(true));
+	EXPECT_THAT(result.getSignal(), Eq(SIGKILL));
+}
+
+TEST(CommandExecutorTest, testBackgroundChildDoesNotDelayCompletion) {
+	CommandExecutor executor(4);
+
+	steady_clock::time_point start = steady_clock::now();
+	CommandResult result = executor.submit(Command::shell("sleep 3 & echo started")).get();
+
+	EXPECT_THAT(elapsedSince(start), Lt(2000));
+	EXPECT_THAT(result.getOutput(), Eq("started\n"));
+}
+
+TEST(CommandExecutorTest, testSpawnError) {
+	CommandExecutor executor(4);
+
+	CommandResult result = executor.submit(Command(vector<string> { "/nonexistent/program" })).get();
+	EXPECT_THAT(result.getSpawnError(), Eq(ENOENT));
+}
+
+TEST(CommandExecutorTest, testDestructorCancelsCommands) {
+	atomic<int> cancelled(0);
+	atomic<int> killed(0);
+	steady_clock::time_point start = steady_clock::now();
+	{
+		CommandExecutor executor(1);
+		for (int i = 0; i < 3; i++) {
+			executor.submit(Command::shell("sleep 10"), [&cancelled, &killed](const CommandResult &result) {
+				if (result.getSpawnError() == ECANCELED) {
+					cancelled++;
+				} else if (result.wasSignaled()) {
+					killed++;
+				}
+			});
+		}
+		while (executor.getRunningChildren() == 0) {
+			usleep(1000);
+		}
+	}
+
+	EXPECT_THAT(elapsedSince(start), Lt(2000));
+	EXPECT_THAT(killed.load(), Eq(1));
+	EXPECT_THAT(cancelled.load(), Eq(2));
+}
+
+TEST(CommandExecutorTest, testCommandRunnerExecuteAsync) {
+	shared_ptr<CommandRunner> cmdRunner = make_shared<CommandRunner>();
+	atomic<int> completed(0);
+
+	future<CommandResult> result = cmdRunner->executeAsync(Command::shell("echo async"));
+	cmdRunner->executeAsync(Command::shell("true"), [&completed](const CommandResult &) { completed++; });
+	cmdRunner->waitAll();
+
+	EXPECT_THAT(result.get().getOutput(), Eq("async\n"));
+	EXPECT_THAT(completed.load(), Eq(1));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
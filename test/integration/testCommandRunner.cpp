@@ -1,20 +1,65 @@
 
+#include "nebu-app-framework/commandMetrics.h"
 #include "nebu-app-framework/commandRunner.h"
+#include "nebu-app-framework/daemon.h"
 
 #include "log4cxx/basicconfigurator.h"
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
+#include <algorithm>
+#include <errno.h>
+#include <signal.h>
+#include <set>
+#include <stdexcept>
+#include <stdlib.h>
+
 // Using declarations - standard library
 using std::make_shared;
+using std::runtime_error;
+using std::set;
 using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
 // Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandMetrics;
+using nebu::app::framework::CommandResult;
 using nebu::app::framework::CommandRunner;
+using nebu::app::framework::CommandTemplate;
+using nebu::app::framework::Daemon;
+using nebu::app::framework::DaemonType;
+using nebu::app::framework::FanOutSummary;
 // Using declarations - gtest/gmock
+using testing::ElementsAre;
 using testing::Eq;
+using testing::Ge;
 using testing::NotNull;
 
+static vector<shared_ptr<VirtualMachine> > createVMs(const vector<string> &hostnames)
+{
+	vector<shared_ptr<VirtualMachine> > vms;
+	for (vector<string>::const_iterator it = hostnames.begin(); it != hostnames.end(); it++) {
+		shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>("uuid-" + *it);
+		vm->setHostname(*it);
+		vms.push_back(vm);
+	}
+	return vms;
+}
+
+class StubDaemon : public Daemon
+{
+public:
+	StubDaemon(shared_ptr<VirtualMachine> vm) : Daemon(vm) { }
+	virtual ~StubDaemon() { }
+
+	virtual bool launch() { return false; }
+	virtual DaemonType getType() const { return 0; }
+};
+
 TEST(CommandRunnerTest, testGetDefaultInstance) {
 	EXPECT_THAT(CommandRunner::getInstance(), NotNull());
 }
@@ -49,6 +94,201 @@ TEST(CommandRunnerTest, testExitCommandWithStatusCode) {
 	EXPECT_THAT(WEXITSTATUS(result), Eq(123));
 }
 
+TEST(CommandRunnerTest, testExecuteArgumentsWithoutShell) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+
+	CommandResult result = cmdRunner->execute(Command(vector<string> { "echo", "$HOME", "a  b" }));
+	EXPECT_THAT(result.succeeded(), Eq(true));
+	EXPECT_THAT(result.getOutput(), Eq("$HOME a  b\n"));
+}
+
+TEST(CommandRunnerTest, testExecuteCapturesOutputAndError) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+
+	CommandResult result = cmdRunner->execute(Command::shell("echo out; echo err >&2; exit 3"));
+	EXPECT_THAT(result.hasExited(), Eq(true));
+	EXPECT_THAT(result.getExitCode(), Eq(3));
+	EXPECT_THAT(result.succeeded(), Eq(false));
+	EXPECT_THAT(result.getOutput(), Eq("out\n"));
+	EXPECT_THAT(result.getError(), Eq("err\n"));
+}
+
+TEST(CommandRunnerTest, testExecuteLargeOutput) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+
+	CommandResult result = cmdRunner->execute(Command::shell("head -c 1000000 /dev/zero; head -c 300000 /dev/zero >&2"));
+	EXPECT_THAT(result.getOutput().size(), Eq(1000000u));
+	EXPECT_THAT(result.getError().size(), Eq(300000u));
+}
+
+TEST(CommandRunnerTest, testExecuteReusesResult) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+	CommandResult result;
+
+	cmdRunner->execute(Command::shell("echo first; exit 1"), result);
+	cmdRunner->execute(Command::shell("echo second"), result);
+	EXPECT_THAT(result.getExitCode(), Eq(0));
+	EXPECT_THAT(result.getOutput(), Eq("second\n"));
+}
+
+TEST(CommandRunnerTest, testExecuteSignal) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+
+	CommandResult result = cmdRunner->execute(Command::shell("kill -TERM $$"));
+	EXPECT_THAT(result.hasExited(), Eq(false));
+	EXPECT_THAT(result.wasSignaled(), Eq(true));
+	EXPECT_THAT(result.getSignal(), Eq(SIGTERM));
+	EXPECT_THAT(result.getExitCode(), Eq(-1));
+}
+
+TEST(CommandRunnerTest, testExecuteMissingProgram) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+
+	CommandResult result = cmdRunner->execute(Command(vector<string> { "/nonexistent/program" }));
+	EXPECT_THAT(result.getSpawnError(), Eq(ENOENT));
+	EXPECT_THAT(result.getExitCode(), Eq(127));
+}
+
+TEST(CommandRunnerTest, testExecuteEnvironment) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+	setenv("NEBU_TEST_INHERITED", "inherited", 1);
+	setenv("NEBU_TEST_REMOVED", "removed", 1);
+
+	Command command = Command::shell("echo \"$NEBU_TEST_INHERITED,$NEBU_TEST_REMOVED,$NEBU_TEST_ADDED\"");
+	command.setEnvironment("NEBU_TEST_ADDED", "added");
+	command.unsetEnvironment("NEBU_TEST_REMOVED");
+	EXPECT_THAT(cmdRunner->execute(command).getOutput(), Eq("inherited,,added\n"));
+
+	command.setInheritEnvironment(false);
+	EXPECT_THAT(cmdRunner->execute(command).getOutput(), Eq(",,added\n"));
+}
+
+TEST(CommandRunnerTest, testExecuteTimeout) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+	Command command = Command::shell("echo before; sleep 10");
+	command.setTimeout(200);
+
+	CommandResult result = cmdRunner->execute(command);
+	EXPECT_THAT(result.hasTimedOut(), Eq(true));
+	EXPECT_THAT(result.getSignal(), Eq(SIGTERM));
+	EXPECT_THAT(result.getOutput(), Eq("before\n"));
+}
+
+TEST(CommandRunnerTest, testCommandToString) {
+	EXPECT_THAT(Command(vector<string> { "ssh", "host", "true" }).toString(), Eq("ssh host true"));
+	EXPECT_THAT(Command::shell("echo a | wc -c").toString(), Eq("echo a | wc -c"));
+	EXPECT_THAT(Command::shell("true").usesShell(), Eq(true));
+}
+
+TEST(CommandRunnerTest, testCommandToShellCommandLine) {
+	EXPECT_THAT(Command::quote("it's"), Eq("'it'\\''s'"));
+	EXPECT_THAT(Command(vector<string> { "echo", "a b", "$HOME" }).toShellCommandLine(), Eq("'echo' 'a b' '$HOME'"));
+	EXPECT_THAT(Command::shell("echo $HOME").toShellCommandLine(), Eq("echo $HOME"));
+}
+
+TEST(CommandRunnerTest, testExecuteRecordsMetrics) {
+	shared_ptr<CommandMetrics> metrics = make_shared<CommandMetrics>();
+	CommandMetrics::setInstance(metrics);
+	Command command = Command::shell("exit 2");
+	command.setLabel("probe");
+
+	CommandRunner::getInstance()->execute(command);
+	CommandRunner::getInstance()->executeAsync(command).get();
+
+	CommandMetrics::LabelStatistics probe = metrics->getStatistics()["probe"];
+	EXPECT_THAT(probe.count, Eq(2U));
+	EXPECT_THAT(probe.spawns, Eq(2U));
+	EXPECT_THAT(probe.exitCodes[2], Eq(2U));
+	EXPECT_THAT(metrics->getRunningCommands(), Eq(0U));
+	CommandMetrics::setInstance(shared_ptr<CommandMetrics>());
+}
+
+TEST(CommandRunnerTest, testCommandTemplateInstantiate) {
+	VirtualMachine vm("vm-1");
+	vm.setHostname("node1");
+	Command prototype(vector<string> { "ssh", "{hostname}", "echo {uuid} {hostname}" });
+	prototype.setTimeout(500);
+
+	Command command = CommandTemplate(prototype).instantiate(vm);
+	EXPECT_THAT(command.getArguments(), ElementsAre("ssh", "node1", "echo vm-1 node1"));
+	EXPECT_THAT(command.getTimeout(), Eq(500U));
+}
+
+TEST(CommandRunnerTest, testFanOut) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+	Command prototype = Command::shell("case {hostname} in fail*) exit 1;; slow*) sleep 10;; esac; echo {hostname}");
+	prototype.setTimeout(300);
+	vector<shared_ptr<VirtualMachine> > vms = createVMs(vector<string> { "ok1", "fail1", "ok2", "slow1", "ok3" });
+
+	vector<string> outputs;
+	FanOutSummary summary = cmdRunner->fanOut(CommandTemplate(prototype), vms, 2,
+			[&outputs](const shared_ptr<VirtualMachine> &, const CommandResult &result) {
+		outputs.push_back(result.getOutput());
+	});
+
+	EXPECT_THAT(summary.getTotal(), Eq(5U));
+	EXPECT_THAT(summary.getSuccesses(), Eq(3U));
+	EXPECT_THAT(summary.getFailedHosts(), ElementsAre("fail1"));
+	EXPECT_THAT(summary.getStragglerHosts(), ElementsAre("slow1"));
+	EXPECT_THAT(summary.getLatencyPercentile(100), Ge(300U));
+	std::sort(outputs.begin(), outputs.end());
+	EXPECT_THAT(outputs, ElementsAre("", "", "ok1\n", "ok2\n", "ok3\n"));
+}
+
+TEST(CommandRunnerTest, testFanOutEmpty) {
+	FanOutSummary summary = CommandRunner::getInstance()->fanOut(CommandTemplate(Command::shell("true")),
+			vector<shared_ptr<VirtualMachine> >(), 4);
+	EXPECT_THAT(summary.getTotal(), Eq(0U));
+	EXPECT_THAT(summary.getLatencyPercentile(50), Eq(0U));
+}
+
+TEST(CommandRunnerTest, testFanOutCallbackThrows) {
+	shared_ptr<CommandRunner> cmdRunner = CommandRunner::getInstance();
+	Command prototype = Command::shell("case {hostname} in slow*) sleep 0.2;; esac; echo {hostname}");
+	vector<shared_ptr<VirtualMachine> > vms = createVMs(vector<string> { "fast1", "slow1", "slow2", "slow3" });
+
+	EXPECT_THROW(cmdRunner->fanOut(CommandTemplate(prototype), vms, 4,
+			[](const shared_ptr<VirtualMachine> &, const CommandResult &) {
+		throw runtime_error("callback failed");
+	}), runtime_error);
+
+	// The Commands still in flight complete after fanOut has returned
+	cmdRunner->waitAll();
+}
+
+TEST(CommandRunnerTest, testFanOutDaemonsSkipsDaemonsWithoutHost) {
+	vector<shared_ptr<VirtualMachine> > vms = createVMs(vector<string> { "host1", "host2" });
+	set<shared_ptr<Daemon> > daemons;
+	daemons.insert(make_shared<StubDaemon>(vms[0]));
+	daemons.insert(make_shared<StubDaemon>(vms[0]));
+	daemons.insert(make_shared<StubDaemon>(vms[1]));
+	daemons.insert(make_shared<StubDaemon>(shared_ptr<VirtualMachine>()));
+
+	vector<string> outputs;
+	FanOutSummary summary = CommandRunner::getInstance()->fanOut(
+			CommandTemplate(Command::shell("echo {hostname}")), daemons, 4,
+			[&outputs](const shared_ptr<VirtualMachine> &, const CommandResult &result) {
+		outputs.push_back(result.getOutput());
+	});
+
+	EXPECT_THAT(summary.getTotal(), Eq(2U));
+	EXPECT_THAT(summary.getSuccesses(), Eq(2U));
+	std::sort(outputs.begin(), outputs.end());
+	EXPECT_THAT(outputs, ElementsAre("host1\n", "host2\n"));
+}
+
+TEST(CommandRunnerTest, testFanOutSummaryPercentiles) {
+	FanOutSummary summary;
+	CommandResult success;
+	for (unsigned int latency = 1; latency <= 100; latency++) {
+		summary.addResult("host", success, latency);
+	}
+	EXPECT_THAT(summary.getLatencyPercentile(50), Eq(50U));
+	EXPECT_THAT(summary.getLatencyPercentile(99), Eq(99U));
+	EXPECT_THAT(summary.getLatencyPercentile(100), Eq(100U));
+	EXPECT_THAT(summary.getSuccesses(), Eq(100U));
+}
+
 int main(int argc, char **argv) {
 	log4cxx::BasicConfigurator::configure();
 	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
@@ -0,0 +1,94 @@
+
+#include "nebu-app-framework/configuration.h"
+#include "nebu-app-framework/configurationWatcher.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::ofstream;
+using std::string;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Configuration;
+using nebu::app::framework::ConfigurationWatcher;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+string createConfigurationFile(const string &contents) {
+	char filename[] = "/tmp/nebu-configuration-XXXXXX";
+	int fd = mkstemp(filename);
+	close(fd);
+	ofstream output(filename);
+	output << contents;
+	return filename;
+}
+
+bool waitForInterval(int expected) {
+	for (int i = 0; i < 500; i++) {
+		if (CONFIG_GETINT(CONFIG_APP_INTERVAL) == expected) {
+			return true;
+		}
+		usleep(10000);
+	}
+	return false;
+}
+
+TEST(ConfigurationWatcherTest, testStartStop) {
+	ConfigurationWatcher watcher("/tmp/nebu-does-not-matter.conf");
+
+	EXPECT_THAT(watcher.start(), Eq(true));
+	EXPECT_THAT(watcher.isRunning(), Eq(true));
+	watcher.stop();
+	EXPECT_THAT(watcher.isRunning(), Eq(false));
+}
+
+TEST(ConfigurationWatcherTest, testStartOnMissingDirectory) {
+	ConfigurationWatcher watcher("/nonexistent/nebu.conf");
+
+	EXPECT_THAT(watcher.start(), Eq(false));
+	EXPECT_THAT(watcher.isRunning(), Eq(false));
+}
+
+TEST(ConfigurationWatcherTest, testReloadOnWrite) {
+	string filename = createConfigurationFile("app.interval = 15\n");
+	vector<string> args { "--config", filename };
+	Configuration::fromArguments(args);
+	ConfigurationWatcher watcher(filename);
+	watcher.start();
+
+	ofstream(filename.c_str()) << "app.interval = 30\n";
+
+	EXPECT_THAT(waitForInterval(30), Eq(true));
+	watcher.stop();
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationWatcherTest, testReloadOnRename) {
+	string filename = createConfigurationFile("app.interval = 15\n");
+	vector<string> args { "--config", filename };
+	Configuration::fromArguments(args);
+	ConfigurationWatcher watcher(filename);
+	watcher.start();
+
+	string replacement = createConfigurationFile("app.interval = 45\n");
+	rename(replacement.c_str(), filename.c_str());
+
+	EXPECT_THAT(waitForInterval(45), Eq(true));
+	watcher.stop();
+	unlink(filename.c_str());
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
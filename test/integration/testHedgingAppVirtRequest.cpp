@@ -0,0 +1,139 @@
+
+#include "nebu-app-framework/hedgingAppVirtRequest.h"
+#include "nebu/mocks/mockAppVirtRequest.h"
+
+#include "nebu/util/exceptions.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// Using declarations - standard library
+using std::atomic;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+// Using declarations - nebu-common
+using nebu::common::NebuServerException;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::HedgingAppVirtRequest;
+// Using declarations - mocks
+using nebu::test::MockAppVirtRequest;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::Gt;
+using testing::Invoke;
+using testing::Le;
+using testing::Lt;
+using testing::Throw;
+using testing::_;
+
+typedef std::chrono::steady_clock Clock;
+
+void sleepFor(unsigned int milliseconds) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+void warmUp(HedgingAppVirtRequest &request, unsigned int requests) {
+	for (unsigned int i = 0; i < requests; i++) {
+		request.getVirtualMachine("vm" + std::to_string(i));
+	}
+}
+
+/** Responds after 1 ms, except for the first request for "slow", which takes 300 ms. */
+VirtualMachine respond(atomic<unsigned int> *slowRequests, const string &uuid) {
+	if (uuid == "slow" && (*slowRequests)++ == 0) {
+		sleepFor(300);
+	} else {
+		sleepFor(1);
+	}
+	return VirtualMachine(uuid);
+}
+
+TEST(HedgingAppVirtRequestTest, testHedgesSlowRequest) {
+	atomic<unsigned int> slowRequests(0);
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).WillRepeatedly(Invoke([&slowRequests](const string &uuid) {
+		return respond(&slowRequests, uuid);
+	}));
+	HedgingAppVirtRequest request(mockRequest, 90, 100, 5);
+
+	EXPECT_THAT(request.getHedgeDelay(), Eq(0U));
+	warmUp(request, 30);
+	EXPECT_THAT(request.getHedgeDelay(), Eq(5000U));
+
+	Clock::time_point start = Clock::now();
+	EXPECT_THAT(request.getVirtualMachine("slow").getUUID(), Eq("slow"));
+	EXPECT_THAT(Clock::now() - start, Lt(std::chrono::milliseconds(200)));
+
+	HedgingAppVirtRequest::Statistics statistics = request.getStatistics();
+	EXPECT_THAT(statistics.requests, Eq(31U));
+	EXPECT_THAT(statistics.hedged, Eq(1U));
+	EXPECT_THAT(statistics.hedgeWins, Eq(1U));
+	EXPECT_THAT(slowRequests.load(), Eq(2U));
+
+	// The abandoned request still completes, and is recorded as a primary latency
+	sleepFor(400);
+	EXPECT_THAT(request.getPrimaryLatencyPercentile(100), Gt(request.getLatencyPercentile(100)));
+}
+
+TEST(HedgingAppVirtRequestTest, testLimitsHedgeRate) {
+	atomic<unsigned int> slowRequests(0);
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).WillRepeatedly(Invoke([&slowRequests](const string &uuid) {
+		return respond(&slowRequests, uuid);
+	}));
+	// 20 requests at 1% do not earn a single hedge request
+	HedgingAppVirtRequest request(mockRequest, 90, 1, 5);
+	warmUp(request, 20);
+
+	EXPECT_THAT(request.getVirtualMachine("slow").getUUID(), Eq("slow"));
+	HedgingAppVirtRequest::Statistics statistics = request.getStatistics();
+	EXPECT_THAT(statistics.hedged, Eq(0U));
+	EXPECT_THAT(statistics.throttled, Eq(1U));
+}
+
+TEST(HedgingAppVirtRequestTest, testUsesCallingThreadOrPersistentWorkers) {
+	std::mutex threadsMutex;
+	std::set<std::thread::id> threads;
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).WillRepeatedly(Invoke([&threadsMutex, &threads](const string &uuid) {
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		threads.insert(std::this_thread::get_id());
+		return VirtualMachine(uuid);
+	}));
+	HedgingAppVirtRequest request(mockRequest, 90, 100, 5);
+
+	// Requests that can not be hedged yet are made on the calling thread
+	warmUp(request, 20);
+	EXPECT_THAT(threads, Eq(std::set<std::thread::id>{ std::this_thread::get_id() }));
+
+	// Requests that may be hedged reuse a bounded number of worker threads
+	warmUp(request, 200);
+	EXPECT_THAT(threads.size(), Gt(1U));
+	EXPECT_THAT(threads.size(), Le(9U));
+	EXPECT_THAT(request.getStatistics().requests, Eq(220U));
+}
+
+TEST(HedgingAppVirtRequestTest, testFailure) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Throw(NebuServerException("")));
+	HedgingAppVirtRequest request(mockRequest, 90, 100, 5);
+
+	EXPECT_THROW(request.getVirtualMachine("vmA"), NebuServerException);
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
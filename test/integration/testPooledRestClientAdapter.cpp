@@ -0,0 +1,182 @@
+
+#include "nebu-app-framework/pooledRestClientAdapter.h"
+
+#include "mocks/localHttpServer.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <chrono>
+#include <thread>
+
+// Using declarations - standard library
+using std::string;
+using std::thread;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::PooledRestClientAdapter;
+using nebu::app::framework::test::LocalHttpServer;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::Le;
+using testing::Lt;
+
+TEST(PooledRestClientAdapterTest, testRequests) {
+	LocalHttpServer server;
+	PooledRestClientAdapter adapter(2, 5000);
+
+	RestClient::response response = adapter.get(server.getUrl() + "/virt/app/vm1");
+	EXPECT_THAT(response.code, Eq(200));
+	EXPECT_THAT(response.body, Eq("GET /virt/app/vm1 "));
+	EXPECT_THAT(response.headers["Content-Type"], Eq("text/plain"));
+
+	EXPECT_THAT(adapter.post(server.getUrl() + "/p", "text/plain", "data").body, Eq("POST /p data"));
+	EXPECT_THAT(adapter.put(server.getUrl() + "/p", "text/plain", "").body, Eq("PUT /p "));
+	EXPECT_THAT(adapter.del(server.getUrl()).body, Eq("DELETE / "));
+}
+
+TEST(PooledRestClientAdapterTest, testReusesConnections) {
+	LocalHttpServer server;
+	PooledRestClientAdapter adapter(2, 5000);
+	for (int i = 0; i < 10; i++) {
+		EXPECT_THAT(adapter.get(server.getUrl() + "/vm").code, Eq(200));
+	}
+
+	EXPECT_THAT(server.getConnections(), Eq(1U));
+	EXPECT_THAT(adapter.getStatistics().requests, Eq(10U));
+	EXPECT_THAT(adapter.getStatistics().connectionsReused, Eq(9U));
+}
+
+TEST(PooledRestClientAdapterTest, testWithoutKeepAlive) {
+	LocalHttpServer server;
+	PooledRestClientAdapter adapter(2, 5000);
+	adapter.setKeepAlive(false);
+	for (int i = 0; i < 3; i++) {
+		EXPECT_THAT(adapter.get(server.getUrl() + "/vm").code, Eq(200));
+	}
+	EXPECT_THAT(server.getConnections(), Eq(3U));
+}
+
+TEST(PooledRestClientAdapterTest, testChunkedResponse) {
+	LocalHttpServer server;
+	server.setChunked(true);
+	PooledRestClientAdapter adapter(1, 5000);
+
+	EXPECT_THAT(adapter.get(server.getUrl() + "/chunked").body, Eq("GET /chunked "));
+	EXPECT_THAT(adapter.get(server.getUrl() + "/again").body, Eq("GET /again "));
+	EXPECT_THAT(server.getConnections(), Eq(1U));
+}
+
+TEST(PooledRestClientAdapterTest, testRetriesClosedConnection) {
+	LocalHttpServer server;
+	server.setCloseAfterResponse(true);
+	PooledRestClientAdapter adapter(1, 5000);
+
+	EXPECT_THAT(adapter.get(server.getUrl() + "/a").body, Eq("GET /a "));
+	usleep(50000);
+	EXPECT_THAT(adapter.get(server.getUrl() + "/b").body, Eq("GET /b "));
+	EXPECT_THAT(server.getConnections(), Eq(2U));
+}
+
+TEST(PooledRestClientAdapterTest, testDoesNotResendAfterTimeout) {
+	LocalHttpServer server;
+	PooledRestClientAdapter adapter(1, 200);
+	EXPECT_THAT(adapter.get(server.getUrl() + "/a").code, Eq(200));
+
+	server.setResponseDelay(500);
+	steady_clock::time_point start = steady_clock::now();
+	EXPECT_THAT(adapter.get(server.getUrl() + "/slow").code, Eq(-1));
+	EXPECT_THAT(duration_cast<milliseconds>(steady_clock::now() - start).count(), Lt(400));
+	EXPECT_THAT(adapter.post(server.getUrl() + "/slow", "text/plain", "data").code, Eq(-1));
+	usleep(100000);
+	EXPECT_THAT(server.getRequests(), Eq(3U));
+}
+
+TEST(PooledRestClientAdapterTest, testTimeoutCoversWholeRequest) {
+	LocalHttpServer server;
+	PooledRestClientAdapter adapter(1, 300);
+	server.setByteDelay(20);
+
+	// Every byte arrives well within the timeout, but the response as a whole does not
+	steady_clock::time_point start = steady_clock::now();
+	EXPECT_THAT(adapter.get(server.getUrl() + "/trickle").code, Eq(-1));
+	EXPECT_THAT(duration_cast<milliseconds>(steady_clock::now() - start).count(), Lt(600));
+}
+
+TEST(PooledRestClientAdapterTest, testSkipsInterimResponses) {
+	LocalHttpServer server;
+	server.setInterimResponses(true);
+	PooledRestClientAdapter adapter(1, 5000);
+
+	RestClient::response response = adapter.post(server.getUrl() + "/p", "text/plain", "data");
+	EXPECT_THAT(response.code, Eq(200));
+	EXPECT_THAT(response.body, Eq("POST /p data"));
+	response = adapter.get(server.getUrl() + "/q");
+	EXPECT_THAT(response.code, Eq(200));
+	EXPECT_THAT(response.body, Eq("GET /q "));
+	EXPECT_THAT(server.getConnections(), Eq(1U));
+}
+
+TEST(PooledRestClientAdapterTest, testDoesNotResendPost) {
+	LocalHttpServer server;
+	server.setCloseAfterResponse(true);
+	PooledRestClientAdapter adapter(1, 5000);
+
+	// A connection closed while idle is discarded before sending, so the post is not affected
+	EXPECT_THAT(adapter.post(server.getUrl() + "/a", "text/plain", "1").body, Eq("POST /a 1"));
+	usleep(50000);
+	EXPECT_THAT(adapter.post(server.getUrl() + "/b", "text/plain", "2").body, Eq("POST /b 2"));
+	EXPECT_THAT(server.getConnections(), Eq(2U));
+	EXPECT_THAT(server.getRequests(), Eq(2U));
+}
+
+TEST(PooledRestClientAdapterTest, testIPv6Host) {
+	LocalHttpServer server(true);
+	PooledRestClientAdapter adapter(1, 5000);
+
+	EXPECT_THAT(adapter.get(server.getUrl() + "/vm").body, Eq("GET /vm "));
+	EXPECT_THAT(adapter.get(server.getUrl()).body, Eq("GET / "));
+	EXPECT_THAT(server.getConnections(), Eq(1U));
+}
+
+TEST(PooledRestClientAdapterTest, testConnectionFailure) {
+	PooledRestClientAdapter adapter(1, 1000);
+	RestClient::response response = adapter.get("http://127.0.0.1:1/unreachable");
+	EXPECT_THAT(response.code, Eq(-1));
+}
+
+TEST(PooledRestClientAdapterTest, testPoolSizeLimitsConnections) {
+	LocalHttpServer server;
+	PooledRestClientAdapter adapter(2, 5000);
+	vector<thread> threads;
+	vector<unsigned int> failures(6, 0);
+	for (unsigned int t = 0; t < failures.size(); t++) {
+		threads.push_back(thread([&adapter, &server, &failures, t]() {
+			for (int i = 0; i < 50; i++) {
+				string path = "/t" + std::to_string(t) + "/" + std::to_string(i);
+				if (adapter.get(server.getUrl() + path).body != "GET " + path + " ") {
+					failures[t]++;
+				}
+			}
+		}));
+	}
+	for (vector<thread>::iterator it = threads.begin(); it != threads.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(failures, Eq(vector<unsigned int>(6, 0)));
+	EXPECT_THAT(server.getConnections(), Le(2U));
+	EXPECT_THAT(server.getRequests(), Eq(300U));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+
+#include "nebu-app-framework/commandRunner.h"
+#include "nebu-app-framework/shellWorkerPool.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <signal.h>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::stringstream;
+using std::thread;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandResult;
+using nebu::app::framework::CommandRunner;
+using nebu::app::framework::ShellWorkerPool;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+TEST(ShellWorkerPoolTest, testExecute) {
+	ShellWorkerPool pool(1);
+	CommandResult result;
+	pool.execute(Command::shell("echo out; echo err >&2; exit 4"), result);
+
+	EXPECT_THAT(result.getOutput(), Eq("out\n"));
+	EXPECT_THAT(result.getError(), Eq("err\n"));
+	EXPECT_THAT(result.getExitCode(), Eq(4));
+}
+
+TEST(ShellWorkerPoolTest, testExitCodeMatchesSpawn) {
+	Command command = Command::shell("exit 130");
+	ShellWorkerPool pool(1);
+	CommandResult pooled;
+	pool.execute(command, pooled);
+	CommandRunner runner;
+	CommandResult spawned = runner.execute(command);
+
+	EXPECT_THAT(pooled.wasSignaled(), Eq(false));
+	EXPECT_THAT(pooled.getExitCode(), Eq(130));
+	EXPECT_THAT(pooled.getWaitStatus(), Eq(spawned.getWaitStatus()));
+	EXPECT_THAT(pool.getStatistics().executed, Eq(1U));
+}
+
+TEST(ShellWorkerPoolTest, testSignaledCommandReportsShellExitCode) {
+	ShellWorkerPool pool(1);
+	CommandResult result;
+	pool.execute(Command(vector<string> { "sh", "-c", "kill -TERM $$" }), result);
+
+	EXPECT_THAT(result.wasSignaled(), Eq(false));
+	EXPECT_THAT(result.getExitCode(), Eq(128 + SIGTERM));
+	EXPECT_THAT(pool.getStatistics().workersStarted, Eq(1U));
+}
+
+TEST(ShellWorkerPoolTest, testReusesWorker) {
+	ShellWorkerPool pool(1);
+	CommandResult result;
+	pool.execute(Command::shell("exit 1"), result);
+	pool.execute(Command::shell("cd /; FOO=bar"), result);
+	pool.execute(Command::shell("echo \"$PWD-$FOO\""), result);
+	pool.execute(Command(vector<string> { "printf", "%s", "it's" }), result);
+
+	EXPECT_THAT(result.getOutput(), Eq("it's"));
+	EXPECT_THAT(pool.getStatistics().executed, Eq(4U));
+	EXPECT_THAT(pool.getStatistics().workersStarted, Eq(1U));
+}
+
+TEST(ShellWorkerPoolTest, testCommandsAreIsolated) {
+	ShellWorkerPool pool(1);
+	CommandResult result;
+	pool.execute(Command::shell("cd /; FOO=bar"), result);
+	pool.execute(Command::shell("echo \"'unbalanced"), result);
+	EXPECT_THAT(result.succeeded(), Eq(false));
+
+	char cwd[4096];
+	ASSERT_THAT(getcwd(cwd, sizeof(cwd)) != NULL, Eq(true));
+	pool.execute(Command::shell("echo \"$PWD-$FOO\""), result);
+	EXPECT_THAT(result.getOutput(), Eq(string(cwd) + "-\n"));
+	EXPECT_THAT(pool.getStatistics().workersStarted, Eq(1U));
+}
+
+TEST(ShellWorkerPoolTest, testWorkerDiesDuringCommand) {
+	ShellWorkerPool pool(1);
+	CommandResult result;
+	pool.execute(Command::shell("kill -9 $$"), result);
+	EXPECT_THAT(result.succeeded(), Eq(false));
+
+	pool.execute(Command::shell("echo replaced"), result);
+	EXPECT_THAT(result.getOutput(), Eq("replaced\n"));
+	EXPECT_THAT(pool.getStatistics().workersStarted, Eq(2U));
+}
+
+TEST(ShellWorkerPoolTest, testFallbackWhenWorkerDiedIdle) {
+	ShellWorkerPool pool(1);
+	CommandResult result;
+	pool.execute(Command::shell("(sleep 0.1; kill -9 $$) >/dev/null 2>&1 &"), result);
+	usleep(300000);
+
+	pool.execute(Command::shell("echo spawned"), result);
+	EXPECT_THAT(result.getOutput(), Eq("spawned\n"));
+	EXPECT_THAT(pool.getStatistics().fallbacks, Eq(1U));
+}
+
+TEST(ShellWorkerPoolTest, testConcurrentUse) {
+	ShellWorkerPool pool(2);
+	vector<thread> threads;
+	vector<unsigned int> failures(4, 0);
+	for (unsigned int t = 0; t < failures.size(); t++) {
+		threads.push_back(thread([&pool, &failures, t]() {
+			CommandResult result;
+			for (unsigned int i = 0; i < 20; i++) {
+				stringstream expected;
+				expected << t << "-" << i;
+				pool.execute(Command(vector<string> { "echo", expected.str() }), result);
+				if (result.getOutput() != expected.str() + "\n") {
+					failures[t]++;
+				}
+			}
+		}));
+	}
+	for (vector<thread>::iterator it = threads.begin(); it != threads.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(failures, Eq(vector<unsigned int>(4, 0)));
+	EXPECT_THAT(pool.getStatistics().workersStarted, Eq(2U));
+}
+
+TEST(ShellWorkerPoolTest, testCanExecute) {
+	ShellWorkerPool pool(1);
+	Command command = Command::shell("true");
+	EXPECT_THAT(pool.canExecute(command), Eq(true));
+	command.setTimeout(100);
+	EXPECT_THAT(pool.canExecute(command), Eq(false));
+	command = Command::shell("true");
+	command.setEnvironment("FOO", "bar");
+	EXPECT_THAT(pool.canExecute(command), Eq(false));
+	command = Command::shell("true");
+	command.setCaptureOutput(false);
+	EXPECT_THAT(pool.canExecute(command), Eq(false));
+}
+
+TEST(ShellWorkerPoolTest, testCommandRunnerUsesPool) {
+	CommandRunner runner;
+	shared_ptr<ShellWorkerPool> pool = make_shared<ShellWorkerPool>(1);
+	runner.setShellWorkerPool(pool);
+
+	EXPECT_THAT(runner.execute(Command::shell("echo pooled")).getOutput(), Eq("pooled\n"));
+	EXPECT_THAT(runner.execute(Command::shell("exit 2")).getExitCode(), Eq(2));
+	Command timed = Command::shell("echo spawned");
+	timed.setTimeout(1000);
+	EXPECT_THAT(runner.execute(timed).getOutput(), Eq("spawned\n"));
+	// Uncaptured commands stream their output, so they are spawned
+	EXPECT_THAT(runner.runCommand("exit 3"), Eq(3 << 8));
+	EXPECT_THAT(pool->getStatistics().executed, Eq(2U));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
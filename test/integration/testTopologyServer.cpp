@@ -0,0 +1,317 @@
+#include "nebu-app-framework/topologyServer.h"
+#include "mocks/topologyFixtures.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::TopologyClient;
+using nebu::app::framework::TopologyServer;
+// Using declarations - mocks
+using nebu::app::framework::test::createTopology;
+using nebu::app::framework::test::createVMs;
+// Using declarations - gtest/gmock
+using testing::ElementsAre;
+using testing::Eq;
+
+string socketPath() {
+	return "/tmp/nebu-test-topology-" + to_string(getpid()) + ".sock";
+}
+
+// Waits for a name to appear in the index, as addresses are looked up in the background
+bool waitForName(const TopologyServer &server, const string &name, string &path, int timeout = 5000) {
+	for (int waited = 0; !server.resolve(name, path); waited += 10) {
+		if (waited >= timeout) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return true;
+}
+
+int connectRaw() {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath().c_str());
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+TEST(TopologyServerTest, testResolveBatch) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+	vector<shared_ptr<VirtualMachine>> vms = createVMs(10, 2);
+	vms.push_back(make_shared<VirtualMachine>("unplaced"));
+	vms.back()->setHostname("unplaced");
+	vms.back()->setPhysicalHostID("unknown");
+	server.update(createTopology(2), vms);
+	EXPECT_THAT(server.getIndexSize(), Eq(10U));
+
+	TopologyClient client(socketPath());
+	vector<string> paths;
+	ASSERT_THAT(client.resolve({ "vm0", "vm3", "unplaced", "missing", "" }, paths), Eq(true));
+	EXPECT_THAT(paths, ElementsAre("/dc/rack/host0", "/dc/rack/host1", "", "", ""));
+	ASSERT_THAT(client.resolve({}, paths), Eq(true));
+	EXPECT_THAT(paths.size(), Eq(0U));
+	EXPECT_THAT(server.getQueryCount(), Eq(5U));
+
+	string path;
+	EXPECT_THAT(server.resolve("vm9", path), Eq(true));
+	EXPECT_THAT(path, Eq("/dc/rack/host1"));
+}
+
+TEST(TopologyServerTest, testUpdateReplacesIndex) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+	TopologyClient client(socketPath());
+	vector<string> paths;
+
+	ASSERT_THAT(client.resolve({ "vm0" }, paths), Eq(true));
+	EXPECT_THAT(paths, ElementsAre(""));
+
+	server.update(createTopology(1), createVMs(1, 1));
+	ASSERT_THAT(client.resolve({ "vm0" }, paths), Eq(true));
+	EXPECT_THAT(paths, ElementsAre("/dc/rack/host0"));
+
+	server.update(createTopology(1), vector<shared_ptr<VirtualMachine>>());
+	ASSERT_THAT(client.resolve({ "vm0" }, paths), Eq(true));
+	EXPECT_THAT(paths, ElementsAre(""));
+}
+
+TEST(TopologyServerTest, testResolveAddresses) {
+	TopologyServer server(socketPath());
+	server.setResolveAddresses(true);
+	vector<shared_ptr<VirtualMachine>> vms = createVMs(1, 1);
+	vms[0]->setHostname("localhost");
+	server.update(createTopology(1), vms);
+
+	string path;
+	EXPECT_THAT(server.resolve("localhost", path), Eq(true));
+	EXPECT_THAT(waitForName(server, "127.0.0.1", path), Eq(true));
+	EXPECT_THAT(path, Eq("/dc/rack/host0"));
+}
+
+TEST(TopologyServerTest, testRetriesFailedAddressLookups) {
+	TopologyServer server(socketPath());
+	server.setResolveAddresses(true);
+	atomic<int> lookups(0);
+	server.setAddressLookup([&lookups](const string &hostname) -> vector<string> {
+		return (lookups++ == 0) ? vector<string>() : vector<string> { "10.0.0." + hostname.substr(2) };
+	});
+	vector<shared_ptr<VirtualMachine>> vms = createVMs(1, 1);
+	server.update(createTopology(1), vms);
+
+	// The lookup runs in the background, and its failure is not kept
+	string path;
+	EXPECT_THAT(server.resolve("vm0", path), Eq(true));
+	EXPECT_THAT(waitForName(server, "10.0.0.0", path, 200), Eq(false));
+	EXPECT_THAT(lookups.load(), Eq(1));
+
+	// Updates before the retry delay do not look up the hostname again
+	server.update(createTopology(1), vms);
+	EXPECT_THAT(lookups.load(), Eq(1));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	server.update(createTopology(1), vms);
+	EXPECT_THAT(waitForName(server, "10.0.0.0", path), Eq(true));
+	EXPECT_THAT(path, Eq("/dc/rack/host0"));
+	EXPECT_THAT(lookups.load(), Eq(2));
+
+	// Found addresses are kept, and only new hostnames are looked up
+	server.update(createTopology(1), createVMs(2, 1));
+	EXPECT_THAT(waitForName(server, "10.0.0.1", path), Eq(true));
+	EXPECT_THAT(server.resolve("10.0.0.0", path), Eq(true));
+	EXPECT_THAT(lookups.load(), Eq(3));
+}
+
+TEST(TopologyServerTest, testPipelinedFramesAndPartialWrites) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+	server.update(createTopology(1), createVMs(2, 1));
+
+	int fd = connectRaw();
+	ASSERT_THAT(fd >= 0, Eq(true));
+	// Two frames, each with a single query, sent one byte at a time
+	const char request[] = { 0, 0, 0, 5, 0, 3, 'v', 'm', '0', 0, 0, 0, 5, 0, 3, 'v', 'm', '1' };
+	for (size_t i = 0; i < sizeof(request); i++) {
+		ASSERT_THAT(write(fd, request + i, 1), Eq(1));
+	}
+
+	const char expected[] = { 0, 0, 0, 16, 0, 14, '/', 'd', 'c', '/', 'r', 'a', 'c', 'k', '/', 'h', 'o', 's', 't', '0' };
+	char response[2 * sizeof(expected)];
+	size_t received = 0;
+	while (received < sizeof(response)) {
+		ssize_t length = read(fd, response + received, sizeof(response) - received);
+		ASSERT_THAT(length > 0, Eq(true));
+		received += length;
+	}
+	close(fd);
+	EXPECT_THAT(memcmp(response, expected, sizeof(expected)), Eq(0));
+	EXPECT_THAT(memcmp(response + sizeof(expected), expected, sizeof(expected) - 1), Eq(0));
+	EXPECT_THAT(response[sizeof(response) - 1], Eq('0'));
+}
+
+TEST(TopologyServerTest, testStopsReadingFromClientNotReadingResponses) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+	server.update(createTopology(1), createVMs(1, 1));
+
+	// Frames of 10000 queries for vm0, each answered with 160004 bytes
+	const size_t queries = 10000;
+	string frame;
+	uint32_t frameSize = htonl(queries * 5);
+	frame.append(reinterpret_cast<const char *>(&frameSize), sizeof(frameSize));
+	for (size_t i = 0; i < queries; i++) {
+		frame.append("\0\3vm0", 5);
+	}
+	const size_t responseSize = sizeof(uint32_t) + queries * (sizeof(uint16_t) + strlen("/dc/rack/host0"));
+
+	// Without reading responses, the client can only send until the server stops reading its requests
+	int fd = connectRaw();
+	ASSERT_THAT(fd >= 0, Eq(true));
+	ASSERT_THAT(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK), Eq(0));
+	size_t sent = 0;
+	for (int blocked = 0; blocked < 20 && sent < (64U << 20); ) {
+		ssize_t length = write(fd, frame.data() + sent % frame.size(), frame.size() - sent % frame.size());
+		if (length > 0) {
+			sent += length;
+			blocked = 0;
+		} else {
+			ASSERT_THAT(errno, Eq(EAGAIN));
+			blocked++;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+	EXPECT_THAT(sent < (8U << 20), Eq(true));
+
+	// Once the client reads, every frame sent is answered
+	size_t frames = (sent + frame.size() - 1) / frame.size();
+	ASSERT_THAT(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK), Eq(0));
+	thread writer([fd, &frame, sent]() {
+		size_t offset = sent % frame.size();
+		while (offset > 0 && offset < frame.size()) {
+			ssize_t length = write(fd, frame.data() + offset, frame.size() - offset);
+			if (length <= 0) {
+				break;
+			}
+			offset += length;
+		}
+	});
+	vector<char> response(responseSize);
+	size_t received = 0;
+	bool answered = true;
+	for (size_t i = 0; i < frames && answered; i++) {
+		for (size_t offset = 0; offset < responseSize && answered; ) {
+			ssize_t length = read(fd, &response[offset], responseSize - offset);
+			answered = length > 0;
+			offset += answered ? length : 0;
+		}
+		received += answered ? 1 : 0;
+	}
+	writer.join();
+	close(fd);
+	EXPECT_THAT(received, Eq(frames));
+	EXPECT_THAT(server.getQueryCount(), Eq(frames * queries));
+}
+
+TEST(TopologyServerTest, testMalformedFrameDisconnects) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+
+	int fd = connectRaw();
+	ASSERT_THAT(fd >= 0, Eq(true));
+	// The query claims 16 bytes in a frame of 3
+	const char request[] = { 0, 0, 0, 3, 0, 16, 'x' };
+	ASSERT_THAT(write(fd, request, sizeof(request)), Eq(static_cast<ssize_t>(sizeof(request))));
+	char response[4];
+	EXPECT_THAT(read(fd, response, sizeof(response)), Eq(0));
+	close(fd);
+
+	TopologyClient client(socketPath());
+	vector<string> paths;
+	EXPECT_THAT(client.resolve({ "vm0" }, paths), Eq(true));
+}
+
+TEST(TopologyServerTest, testConcurrentClients) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+	server.update(createTopology(10), createVMs(1000, 10));
+
+	vector<thread> clients;
+	vector<int> failures(8, 0);
+	for (int c = 0; c < 8; c++) {
+		clients.push_back(thread([c, &failures]() {
+			TopologyClient client(socketPath());
+			vector<string> names;
+			vector<string> paths;
+			for (int batch = 0; batch < 100; batch++) {
+				names.clear();
+				for (int i = 0; i < 50; i++) {
+					names.push_back("vm" + to_string((c * 100 + batch * 50 + i) % 1000));
+				}
+				if (!client.resolve(names, paths)) {
+					failures[c]++;
+					continue;
+				}
+				for (size_t i = 0; i < names.size(); i++) {
+					int vm = atoi(names[i].c_str() + 2);
+					if (paths[i] != "/dc/rack/host" + to_string(vm % 10)) {
+						failures[c]++;
+					}
+				}
+			}
+		}));
+	}
+	for (vector<thread>::iterator it = clients.begin(); it != clients.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(failures, Eq(vector<int>(8, 0)));
+	EXPECT_THAT(server.getQueryCount(), Eq(8U * 100 * 50));
+}
+
+TEST(TopologyServerTest, testStopRemovesSocket) {
+	TopologyServer server(socketPath());
+	ASSERT_THAT(server.start(), Eq(true));
+	EXPECT_THAT(access(socketPath().c_str(), F_OK), Eq(0));
+	server.stop();
+	EXPECT_THAT(server.isRunning(), Eq(false));
+	EXPECT_THAT(access(socketPath().c_str(), F_OK), Eq(-1));
+
+	TopologyClient client(socketPath());
+	vector<string> paths;
+	EXPECT_THAT(client.resolve({ "vm0" }, paths), Eq(false));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
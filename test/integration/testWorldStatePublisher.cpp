@@ -0,0 +1,189 @@
+#include "nebu-app-framework/worldStatePublisher.h"
+#include "nebu-app-framework/worldStateReader.h"
+#include "mocks/topologyFixtures.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <memory>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::WorldStatePublisher;
+using nebu::app::framework::WorldStateReader;
+// Using declarations - mocks
+using nebu::app::framework::test::createTopology;
+using nebu::app::framework::test::createVMs;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::StrEq;
+
+string segmentName() {
+	return "/nebu-test-world-" + to_string(getpid());
+}
+
+// Creates a topology with a single rack, named after the given generation
+shared_ptr<PhysicalRoot> createTopology(int hosts, int generation) {
+	return createTopology(hosts, "dc" + to_string(generation), "rack" + to_string(generation));
+}
+
+TEST(WorldStatePublisherTest, testReaderWithoutSegment) {
+	WorldStateReader reader;
+	WorldStateReader::Location location;
+
+	EXPECT_THAT(reader.open(segmentName()), Eq(false));
+	EXPECT_THAT(reader.lookup("vm0", location), Eq(false));
+	EXPECT_THAT(reader.getGeneration(), Eq(0U));
+}
+
+TEST(WorldStatePublisherTest, testPublishAndLookup) {
+	WorldStatePublisher publisher(segmentName(), 1 << 20);
+	ASSERT_THAT(publisher.open(), Eq(true));
+	WorldStateReader reader;
+	ASSERT_THAT(reader.open(segmentName()), Eq(true));
+	EXPECT_THAT(reader.getGeneration(), Eq(0U));
+
+	vector<shared_ptr<VirtualMachine>> vms = createVMs(100, 1);
+	vms.push_back(make_shared<VirtualMachine>("unplaced"));
+	vms.back()->setHostname("unplaced");
+	vms.back()->setPhysicalHostID("unknown");
+	ASSERT_THAT(publisher.publish(createTopology(1, 1), vms), Eq(true));
+
+	WorldStateReader::Location location;
+	ASSERT_THAT(reader.lookup("vm42", location), Eq(true));
+	EXPECT_THAT(location.generation, Eq(1U));
+	EXPECT_THAT(location.uuid, Eq("uuid42"));
+	EXPECT_THAT(location.dataCenter, Eq("dc1"));
+	EXPECT_THAT(location.rack, Eq("rack1"));
+	EXPECT_THAT(location.host, Eq("host0"));
+	EXPECT_THAT(reader.lookup("unplaced", location), Eq(false));
+	EXPECT_THAT(reader.lookup("vm100", location), Eq(false));
+
+	char path[64];
+	EXPECT_THAT(reader.resolve("vm7", path, sizeof(path)), Eq(strlen("/dc1/rack1/host0")));
+	EXPECT_THAT(path, StrEq("/dc1/rack1/host0"));
+	EXPECT_THAT(reader.resolve("vm7", path, 8), Eq(0U));
+	EXPECT_THAT(reader.resolve("missing", path, sizeof(path)), Eq(0U));
+}
+
+TEST(WorldStatePublisherTest, testPublishTooLarge) {
+	WorldStatePublisher publisher(segmentName(), 4096);
+	ASSERT_THAT(publisher.open(), Eq(true));
+	WorldStateReader reader;
+	ASSERT_THAT(reader.open(segmentName()), Eq(true));
+
+	EXPECT_THAT(publisher.publish(createTopology(1, 1), createVMs(10000, 1)), Eq(false));
+	EXPECT_THAT(publisher.getGeneration(), Eq(0U));
+	EXPECT_THAT(reader.getGeneration(), Eq(0U));
+}
+
+TEST(WorldStatePublisherTest, testReaderFollowsRestartedPublisher) {
+	WorldStateReader reader;
+	WorldStateReader::Location location;
+	{
+		unique_ptr<WorldStatePublisher> publisher(new WorldStatePublisher(segmentName(), 1 << 20));
+		ASSERT_THAT(publisher->open(), Eq(true));
+		ASSERT_THAT(publisher->publish(createTopology(1, 1), createVMs(10, 1)), Eq(true));
+		ASSERT_THAT(reader.open(segmentName()), Eq(true));
+		ASSERT_THAT(reader.lookup("vm3", location), Eq(true));
+
+		// A restarted publisher replaces the segment while the old one is still attached
+		WorldStatePublisher restarted(segmentName(), 1 << 20);
+		ASSERT_THAT(restarted.open(), Eq(true));
+		ASSERT_THAT(restarted.publish(createTopology(1, 2), createVMs(10, 1)), Eq(true));
+		EXPECT_THAT(reader.isOpen(), Eq(false));
+		ASSERT_THAT(reader.lookup("vm3", location), Eq(true));
+		EXPECT_THAT(location.dataCenter, Eq("dc2"));
+		EXPECT_THAT(reader.isOpen(), Eq(true));
+
+		// Destroying the replaced publisher leaves the segment of its successor in place
+		publisher.reset();
+		ASSERT_THAT(restarted.publish(createTopology(1, 3), createVMs(10, 1)), Eq(true));
+		ASSERT_THAT(reader.lookup("vm3", location), Eq(true));
+		EXPECT_THAT(location.dataCenter, Eq("dc3"));
+	}
+
+	// Once the publisher is gone, its last state is no longer served
+	EXPECT_THAT(reader.lookup("vm3", location), Eq(false));
+	EXPECT_THAT(reader.getGeneration(), Eq(0U));
+	EXPECT_THAT(reader.isOpen(), Eq(false));
+}
+
+TEST(WorldStatePublisherTest, testReaderInOtherProcess) {
+	WorldStatePublisher publisher(segmentName(), 1 << 20);
+	ASSERT_THAT(publisher.open(), Eq(true));
+	ASSERT_THAT(publisher.publish(createTopology(4, 3), createVMs(1000, 4)), Eq(true));
+
+	string name = segmentName();
+	pid_t child = fork();
+	if (child == 0) {
+		WorldStateReader reader;
+		char path[64];
+		bool found = reader.open(name) && reader.resolve("vm999", path, sizeof(path)) > 0;
+		_exit(found && strcmp(path, "/dc3/rack3/host3") == 0 ? 0 : 1);
+	}
+	int status;
+	ASSERT_THAT(waitpid(child, &status, 0), Eq(child));
+	EXPECT_THAT(WIFEXITED(status) && WEXITSTATUS(status) == 0, Eq(true));
+}
+
+TEST(WorldStatePublisherTest, testReadersSeeConsistentGenerations) {
+	WorldStatePublisher publisher(segmentName(), 1 << 20);
+	ASSERT_THAT(publisher.open(), Eq(true));
+	ASSERT_THAT(publisher.publish(createTopology(8, 1), createVMs(2000, 8)), Eq(true));
+
+	atomic<bool> stop(false);
+	atomic<int> inconsistent(0);
+	atomic<int> lookups(0);
+	vector<thread> readers;
+	for (int i = 0; i < 2; i++) {
+		readers.push_back(thread([&stop, &inconsistent, &lookups]() {
+			WorldStateReader reader;
+			reader.open(segmentName());
+			WorldStateReader::Location location;
+			for (int j = 0; !stop; j = (j + 1) % 2000) {
+				string hostname = "vm" + to_string(j);
+				if (!reader.lookup(hostname, location) || location.dataCenter != "dc" + to_string(location.generation) ||
+						location.rack != "rack" + to_string(location.generation)) {
+					inconsistent++;
+				}
+				lookups++;
+			}
+		}));
+	}
+
+	for (int generation = 2; generation <= 50; generation++) {
+		ASSERT_THAT(publisher.publish(createTopology(8, generation), createVMs(2000, 8)), Eq(true));
+	}
+	stop = true;
+	for (vector<thread>::iterator it = readers.begin(); it != readers.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(inconsistent.load(), Eq(0));
+	EXPECT_THAT(lookups.load() > 0, Eq(true));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
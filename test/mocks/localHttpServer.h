@@ -0,0 +1,249 @@
+#ifndef NEBUAPPFRAMEWORK_TEST_LOCALHTTPSERVER_H_
+#define NEBUAPPFRAMEWORK_TEST_LOCALHTTPSERVER_H_
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <mutex>
+#include <netinet/in.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+			namespace test
+			{
+
+				/** Minimal HTTP/1.1 server on the loopback interface, standing in for the Nebu server.
+				 *  Every request is answered with a body echoing its method, path and body. Connections are
+				 *  kept alive unless the client asks otherwise; with closeAfterResponse, the server closes every
+				 *  connection after a response without announcing it, like a server dropping idle connections.
+				 *  With a response delay, requests are counted when they are received but answered late, like a
+				 *  slow server. With a byte delay, responses are sent one byte at a time. Interim responses
+				 *  (100 Continue) can be sent ahead of every response.
+				 */
+				class LocalHttpServer
+				{
+				public:
+					explicit LocalHttpServer(bool ipv6 = false) : listenFd(-1), port(0), ipv6(ipv6), stopping(false),
+							chunked(false), closeAfterResponse(false), interimResponses(false), responseDelay(0), byteDelay(0),
+							connections(0), requests(0),
+							threadsMutex(), threads(), clientFds()
+					{
+						this->listenFd = socket(ipv6 ? AF_INET6 : AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+						int reuse = 1;
+						setsockopt(this->listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+						struct sockaddr_storage address;
+						memset(&address, 0, sizeof(address));
+						socklen_t length;
+						if (ipv6) {
+							struct sockaddr_in6 *address6 = (struct sockaddr_in6 *) &address;
+							address6->sin6_family = AF_INET6;
+							address6->sin6_addr = in6addr_loopback;
+							length = sizeof(*address6);
+						} else {
+							struct sockaddr_in *address4 = (struct sockaddr_in *) &address;
+							address4->sin_family = AF_INET;
+							address4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+							length = sizeof(*address4);
+						}
+						if (bind(this->listenFd, (struct sockaddr *) &address, length) != 0 ||
+								listen(this->listenFd, 128) != 0 ||
+								getsockname(this->listenFd, (struct sockaddr *) &address, &length) != 0) {
+							abort();
+						}
+						this->port = ntohs(ipv6 ? ((struct sockaddr_in6 *) &address)->sin6_port :
+								((struct sockaddr_in *) &address)->sin_port);
+						this->acceptor = std::thread(&LocalHttpServer::acceptLoop, this);
+					}
+
+					~LocalHttpServer()
+					{
+						this->stopping = true;
+						shutdown(this->listenFd, SHUT_RDWR);
+						this->acceptor.join();
+						close(this->listenFd);
+						{
+							std::lock_guard<std::mutex> lock(this->threadsMutex);
+							for (std::set<int>::iterator it = this->clientFds.begin(); it != this->clientFds.end(); it++) {
+								shutdown(*it, SHUT_RDWR);
+							}
+						}
+						for (std::vector<std::thread>::iterator it = this->threads.begin(); it != this->threads.end(); it++) {
+							it->join();
+						}
+					}
+
+					std::string getUrl() const
+					{
+						return (this->ipv6 ? "http://[::1]:" : "http://127.0.0.1:") + std::to_string(this->port);
+					}
+
+					void setChunked(bool chunked)
+					{
+						this->chunked = chunked;
+					}
+
+					void setCloseAfterResponse(bool closeAfterResponse)
+					{
+						this->closeAfterResponse = closeAfterResponse;
+					}
+
+					void setInterimResponses(bool interimResponses)
+					{
+						this->interimResponses = interimResponses;
+					}
+
+					void setResponseDelay(unsigned int milliseconds)
+					{
+						this->responseDelay = milliseconds;
+					}
+
+					void setByteDelay(unsigned int milliseconds)
+					{
+						this->byteDelay = milliseconds;
+					}
+
+					unsigned int getConnections() const
+					{
+						return this->connections;
+					}
+
+					unsigned int getRequests() const
+					{
+						return this->requests;
+					}
+
+				private:
+					void acceptLoop()
+					{
+						while (!this->stopping) {
+							int fd = accept4(this->listenFd, NULL, NULL, SOCK_CLOEXEC);
+							if (fd < 0) {
+								continue;
+							}
+							this->connections++;
+							std::lock_guard<std::mutex> lock(this->threadsMutex);
+							this->clientFds.insert(fd);
+							this->threads.push_back(std::thread(&LocalHttpServer::serve, this, fd));
+						}
+					}
+
+					void serve(int fd)
+					{
+						std::string buffer;
+						char data[16384];
+						bool open = true;
+						while (open) {
+							std::string::size_type headerEnd;
+							while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+								ssize_t length = recv(fd, data, sizeof(data), 0);
+								if (length <= 0) {
+									open = false;
+									break;
+								}
+								buffer.append(data, length);
+							}
+							if (!open) {
+								break;
+							}
+
+							std::string headers = buffer.substr(0, headerEnd);
+							size_t contentLength = 0;
+							const char *lengthHeader = strcasestr(headers.c_str(), "\r\nContent-Length:");
+							if (lengthHeader != NULL) {
+								contentLength = atol(lengthHeader + 17);
+							}
+							while (buffer.size() < headerEnd + 4 + contentLength) {
+								ssize_t length = recv(fd, data, sizeof(data), 0);
+								if (length <= 0) {
+									open = false;
+									break;
+								}
+								buffer.append(data, length);
+							}
+							if (!open) {
+								break;
+							}
+
+							std::string::size_type firstSpace = headers.find(' ');
+							std::string method = headers.substr(0, firstSpace);
+							std::string path = headers.substr(firstSpace + 1, headers.find(' ', firstSpace + 1) - firstSpace - 1);
+							std::string body = method + " " + path + " " + buffer.substr(headerEnd + 4, contentLength);
+							buffer.erase(0, headerEnd + 4 + contentLength);
+							bool clientClose = strcasestr(headers.c_str(), "Connection: close") != NULL;
+							bool close = clientClose || this->closeAfterResponse;
+							this->requests++;
+
+							std::string response = this->interimResponses ? "HTTP/1.1 100 Continue\r\n\r\n" : "";
+							response += "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n";
+							if (this->chunked) {
+								std::string half = body.substr(0, body.size() / 2);
+								response += "Transfer-Encoding: chunked\r\n\r\n";
+								char size[16];
+								snprintf(size, sizeof(size), "%zx", half.size());
+								response += std::string(size) + "\r\n" + half + "\r\n";
+								snprintf(size, sizeof(size), "%zx", body.size() - half.size());
+								response += std::string(size) + "\r\n" + body.substr(half.size()) + "\r\n0\r\n\r\n";
+							} else {
+								response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+								response += clientClose ? "Connection: close\r\n\r\n" : "\r\n";
+								response += body;
+							}
+							if (this->responseDelay > 0) {
+								usleep(this->responseDelay * 1000);
+							}
+							if (this->byteDelay > 0) {
+								bool sent = true;
+								for (std::string::size_type i = 0; i < response.size() && sent && !this->stopping; i++) {
+									usleep(this->byteDelay * 1000);
+									sent = send(fd, response.data() + i, 1, MSG_NOSIGNAL) == 1;
+								}
+								if (!sent) {
+									break;
+								}
+							} else if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) != (ssize_t) response.size()) {
+								break;
+							}
+							open = !close;
+						}
+
+						std::lock_guard<std::mutex> lock(this->threadsMutex);
+						this->clientFds.erase(fd);
+						::close(fd);
+					}
+
+					int listenFd;
+					unsigned short port;
+					bool ipv6;
+					std::atomic<bool> stopping;
+					std::atomic<bool> chunked;
+					std::atomic<bool> closeAfterResponse;
+					std::atomic<bool> interimResponses;
+					std::atomic<unsigned int> responseDelay;
+					std::atomic<unsigned int> byteDelay;
+					std::atomic<unsigned int> connections;
+					std::atomic<unsigned int> requests;
+					std::mutex threadsMutex;
+					std::vector<std::thread> threads;
+					std::set<int> clientFds;
+					std::thread acceptor;
+				};
+
+			}
+		}
+	}
+}
+
+#endif
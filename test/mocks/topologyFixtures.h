@@ -0,0 +1,118 @@
+
+#ifndef NEBUAPPFRAMEWORK_TEST_TOPOLOGYFIXTURES_H_
+#define NEBUAPPFRAMEWORK_TEST_TOPOLOGYFIXTURES_H_
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+#include "nebu/topology/physicalRoot.h"
+#include "nebu/virtualMachine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nebu
+{
+	namespace app
+	{
+		namespace framework
+		{
+			namespace test
+			{
+
+				/** Creates a topology with a single data center holding a single rack.
+				 *  @param[in] hosts the number of hosts in the rack, named "host0", "host1", etc.
+				 *  @param[in] dataCenter the ID of the data center.
+				 *  @param[in] rack the ID of the rack.
+				 *  @return the topology.
+				 */
+				inline std::shared_ptr<nebu::common::PhysicalRoot> createTopology(int hosts,
+						const std::string &dataCenter = "dc", const std::string &rack = "rack")
+				{
+					std::shared_ptr<nebu::common::PhysicalRoot> root =
+							std::make_shared<nebu::common::PhysicalRoot>("root");
+					std::shared_ptr<nebu::common::PhysicalDataCenter> dc =
+							std::make_shared<nebu::common::PhysicalDataCenter>(dataCenter);
+					root->addDataCenter(dc); dc->setParent(root.get());
+					std::shared_ptr<nebu::common::PhysicalRack> physicalRack =
+							std::make_shared<nebu::common::PhysicalRack>(rack);
+					dc->addRack(physicalRack); physicalRack->setParent(dc.get());
+					for (int i = 0; i < hosts; i++) {
+						std::shared_ptr<nebu::common::PhysicalHost> host =
+								std::make_shared<nebu::common::PhysicalHost>("host" + std::to_string(i));
+						physicalRack->addHost(host); host->setParent(physicalRack.get());
+					}
+					return root;
+				}
+
+				/** Creates a topology with several data centers of equal size. Racks are named after their data
+				 *  center, e.g. "dcA-rack0", and hosts after their rack, e.g. "dcA-rack0-host0".
+				 *  @param[in] dataCenters the IDs of the data centers.
+				 *  @param[in] racks the number of racks in each data center.
+				 *  @param[in] hosts the number of hosts in each rack.
+				 *  @return the topology.
+				 */
+				inline std::shared_ptr<nebu::common::PhysicalRoot> createTopology(
+						const std::vector<std::string> &dataCenters, int racks, int hosts)
+				{
+					std::shared_ptr<nebu::common::PhysicalRoot> root =
+							std::make_shared<nebu::common::PhysicalRoot>("root");
+					for (std::vector<std::string>::const_iterator it = dataCenters.begin(); it != dataCenters.end();
+							it++) {
+						std::shared_ptr<nebu::common::PhysicalDataCenter> dc =
+								std::make_shared<nebu::common::PhysicalDataCenter>(*it);
+						root->addDataCenter(dc); dc->setParent(root.get());
+						for (int j = 0; j < racks; j++) {
+							std::shared_ptr<nebu::common::PhysicalRack> rack =
+									std::make_shared<nebu::common::PhysicalRack>(*it + "-rack" + std::to_string(j));
+							dc->addRack(rack); rack->setParent(dc.get());
+							for (int k = 0; k < hosts; k++) {
+								std::shared_ptr<nebu::common::PhysicalHost> host =
+										std::make_shared<nebu::common::PhysicalHost>(
+										rack->getUUID() + "-host" + std::to_string(k));
+								rack->addHost(host); host->setParent(rack.get());
+							}
+						}
+					}
+					return root;
+				}
+
+				/** Creates a VM placed on a physical host.
+				 *  @param[in] uuid the UUID of the VM.
+				 *  @param[in] hostname the hostname of the VM.
+				 *  @param[in] hostID the ID of the physical host of the VM.
+				 *  @return the VM.
+				 */
+				inline std::shared_ptr<nebu::common::VirtualMachine> createVM(const std::string &uuid,
+						const std::string &hostname, const std::string &hostID)
+				{
+					std::shared_ptr<nebu::common::VirtualMachine> vm =
+							std::make_shared<nebu::common::VirtualMachine>(uuid);
+					vm->setHostname(hostname);
+					vm->setPhysicalHostID(hostID);
+					return vm;
+				}
+
+				/** Creates VMs spread over the hosts of a topology made by createTopology(int).
+				 *  VM i has UUID "uuid<i>", hostname "vm<i>" and runs on host "host<i % hosts>".
+				 *  @param[in] count the number of VMs.
+				 *  @param[in] hosts the number of hosts.
+				 *  @return the VMs.
+				 */
+				inline std::vector<std::shared_ptr<nebu::common::VirtualMachine>> createVMs(int count, int hosts)
+				{
+					std::vector<std::shared_ptr<nebu::common::VirtualMachine>> vms;
+					for (int i = 0; i < count; i++) {
+						vms.push_back(createVM("uuid" + std::to_string(i), "vm" + std::to_string(i),
+								"host" + std::to_string(i % hosts)));
+					}
+					return vms;
+				}
+
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,259 @@
+
+#include "nebu-app-framework/application.h"
+#include "nebu-app-framework/applicationHooks.h"
+#include "nebu-app-framework/configuration.h"
+#include "nebu-app-framework/daemonCollection.h"
+#include "nebu-app-framework/daemonManager.h"
+#include "nebu-app-framework/topologyManager.h"
+#include "nebu-app-framework/vmManager.h"
+#include "nebu/mocks/mockAppPhysRequest.h"
+#include "nebu/mocks/mockAppVirtRequest.h"
+#include "mocks/topologyFixtures.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <set>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
+using nebu::common::VMStatus;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Application;
+using nebu::app::framework::ApplicationHooks;
+using nebu::app::framework::Configuration;
+using nebu::app::framework::Daemon;
+using nebu::app::framework::DaemonCollection;
+using nebu::app::framework::DaemonManager;
+using nebu::app::framework::DaemonType;
+using nebu::app::framework::TopologyManager;
+using nebu::app::framework::VMEvent;
+using nebu::app::framework::VMManager;
+using nebu::app::framework::test::createTopology;
+// Using declarations - mocks
+using nebu::test::MockAppPhysRequest;
+using nebu::test::MockAppVirtRequest;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::Return;
+
+#define TEST_DAEMONTYPE 1
+
+static unsigned int launches = 0;
+
+class TestDaemon : public Daemon
+{
+public:
+	TestDaemon(shared_ptr<VirtualMachine> vm) : Daemon(vm) { }
+	virtual ~TestDaemon() { }
+
+	virtual bool launch()
+	{
+		launches++;
+		this->launched = true;
+		return true;
+	}
+	virtual DaemonType getType() const { return TEST_DAEMONTYPE; }
+
+	/** Marks a Daemon restored from a snapshot as launched, without launching it again. */
+	void setLaunched(bool launched) { this->launched = launched; }
+};
+
+/** Creates a Daemon for every new VM, and launches the Daemons that have not launched yet. */
+class TestDaemonManager : public DaemonManager
+{
+public:
+	TestDaemonManager(shared_ptr<DaemonCollection> daemonCollection) : daemonCollection(daemonCollection), added() { }
+	virtual ~TestDaemonManager() { }
+
+	virtual void refreshDaemons() { }
+	virtual void deployDaemons()
+	{
+		set<shared_ptr<Daemon> > daemons = this->daemonCollection->getUnlaunchedDaemonsForType(TEST_DAEMONTYPE);
+		for (set<shared_ptr<Daemon> >::iterator it = daemons.begin(); it != daemons.end(); it++) {
+			(*it)->launch();
+		}
+	}
+
+	virtual void newVMAdded(shared_ptr<VirtualMachine> vm)
+	{
+		this->added.insert(vm->getUUID());
+		this->daemonCollection->addDaemon(make_shared<TestDaemon>(vm));
+	}
+	virtual void existingVMChanged(shared_ptr<VirtualMachine>, const VMEvent) { }
+	virtual void oldVMRemoved(const VirtualMachine &) { }
+
+	shared_ptr<DaemonCollection> daemonCollection;
+	set<string> added;
+};
+
+/** Runs a number of iterations of the main loop, optionally restoring the Daemons of a snapshot. */
+class TestApplicationHooks : public ApplicationHooks
+{
+public:
+	TestApplicationHooks(bool restoreDaemons, unsigned int iterations) :
+			restoreDaemons(restoreDaemons), iterations(iterations), daemonManager(), snapshotInodes(), filename(),
+			removeSnapshot(false)
+	{
+		this->daemonManager = make_shared<TestDaemonManager>(this->getDaemonCollection());
+	}
+	virtual ~TestApplicationHooks() { }
+
+	virtual void prepareLogging() { }
+
+	virtual shared_ptr<DaemonManager> getDaemonManager()
+	{
+		return this->daemonManager;
+	}
+
+	/** Reference implementation: recreates the Daemon of the application on its restored host VM, keeping
+	 *  its launch state, so the DaemonManager neither hears of the VM again nor relaunches the Daemon.
+	 */
+	virtual shared_ptr<Daemon> restoreDaemon(shared_ptr<VirtualMachine> hostVM, DaemonType type, bool launched)
+	{
+		if (!this->restoreDaemons || type != TEST_DAEMONTYPE) {
+			return shared_ptr<Daemon>();
+		}
+		shared_ptr<TestDaemon> daemon = make_shared<TestDaemon>(hostVM);
+		daemon->setLaunched(launched);
+		return daemon;
+	}
+
+	virtual void preLoop()
+	{
+		struct stat status;
+		if (stat(this->filename.c_str(), &status) == 0) {
+			this->snapshotInodes.push_back(status.st_ino);
+			if (this->removeSnapshot) {
+				unlink(this->filename.c_str());
+			}
+		}
+	}
+
+	virtual void postLoop()
+	{
+		if (--this->iterations == 0) {
+			this->application->shutdown();
+		}
+	}
+
+	bool restoreDaemons;
+	unsigned int iterations;
+	shared_ptr<TestDaemonManager> daemonManager;
+	vector<ino_t> snapshotInodes;
+	string filename;
+	bool removeSnapshot;
+};
+
+class ApplicationTest : public testing::Test
+{
+protected:
+	ApplicationTest() : mockVirtRequest(make_shared<MockAppVirtRequest>()),
+			mockPhysRequest(make_shared<MockAppPhysRequest>())
+	{
+		char name[] = "/tmp/nebu-application-XXXXXX";
+		close(mkstemp(name));
+		unlink(name);
+		this->filename = name;
+	}
+
+	virtual ~ApplicationTest()
+	{
+		unlink(this->filename.c_str());
+	}
+
+	virtual void SetUp()
+	{
+		launches = 0;
+		string filename = this->filename;
+		Configuration::updateGlobalConfiguration([filename](Configuration &configuration) {
+			configuration.setOption(CONFIG_APP_SNAPSHOT, filename);
+			configuration.setOption(CONFIG_APP_INTERVAL, "0");
+		});
+
+		VirtualMachine vmA("vmA");
+		vmA.setStatus(VMStatus::ON);
+		vmA.setPhysicalHostID("host0");
+		VirtualMachine vmB("vmB");
+		vmB.setStatus(VMStatus::ON);
+		vmB.setPhysicalHostID("host0");
+		EXPECT_CALL(*this->mockVirtRequest, getVirtualMachineIDs()).WillRepeatedly(
+				Return(vector<string> { "vmA", "vmB" }));
+		EXPECT_CALL(*this->mockVirtRequest, getVirtualMachine("vmA")).WillRepeatedly(Return(vmA));
+		EXPECT_CALL(*this->mockVirtRequest, getVirtualMachine("vmB")).WillRepeatedly(Return(vmB));
+		EXPECT_CALL(*this->mockPhysRequest, getPhysicalTopology()).WillRepeatedly(Return(createTopology(1)));
+	}
+
+	shared_ptr<TestApplicationHooks> run(bool restoreDaemons, unsigned int iterations = 1, bool removeSnapshot = false)
+	{
+		shared_ptr<TestApplicationHooks> hooks = make_shared<TestApplicationHooks>(restoreDaemons, iterations);
+		hooks->filename = this->filename;
+		hooks->removeSnapshot = removeSnapshot;
+		shared_ptr<Application> application = make_shared<Application>(hooks->getDaemonManager(),
+				make_shared<TopologyManager>(this->mockPhysRequest), make_shared<VMManager>(this->mockVirtRequest));
+		application->setApplicationHooks(hooks);
+		hooks->setApplication(application);
+		application->mainLoop();
+		hooks->setApplication(shared_ptr<Application>());
+		return hooks;
+	}
+
+	string filename;
+	shared_ptr<MockAppVirtRequest> mockVirtRequest;
+	shared_ptr<MockAppPhysRequest> mockPhysRequest;
+};
+
+TEST_F(ApplicationTest, testWarmStartRestoresDaemons) {
+	shared_ptr<TestApplicationHooks> cold = this->run(true);
+	EXPECT_THAT(cold->daemonManager->added, Eq(set<string> { "vmA", "vmB" }));
+	EXPECT_THAT(cold->getDaemonCollection()->getLaunchedDaemonCountForType(TEST_DAEMONTYPE), Eq(2U));
+	EXPECT_THAT(launches, Eq(2U));
+
+	shared_ptr<TestApplicationHooks> warm = this->run(true);
+	EXPECT_THAT(warm->daemonManager->added.empty(), Eq(true));
+	EXPECT_THAT(warm->getDaemonCollection()->getLaunchedDaemonCountForType(TEST_DAEMONTYPE), Eq(2U));
+	EXPECT_THAT(launches, Eq(2U));
+}
+
+TEST_F(ApplicationTest, testWarmStartWithoutRestoreDaemonIsColdStart) {
+	this->run(true);
+
+	shared_ptr<TestApplicationHooks> warm = this->run(false);
+	EXPECT_THAT(warm->daemonManager->added, Eq(set<string> { "vmA", "vmB" }));
+	EXPECT_THAT(launches, Eq(4U));
+}
+
+TEST_F(ApplicationTest, testUnchangedSnapshotIsNotRewritten) {
+	// The first refresh of the new VMs still changes the snapshot, the following ones do not
+	shared_ptr<TestApplicationHooks> hooks = this->run(true, 4);
+	ASSERT_THAT(hooks->snapshotInodes.size(), Eq(3U));
+	EXPECT_THAT(hooks->snapshotInodes[2], Eq(hooks->snapshotInodes[1]));
+
+	struct stat status;
+	ASSERT_THAT(stat(this->filename.c_str(), &status), Eq(0));
+	EXPECT_THAT(status.st_ino, Eq(hooks->snapshotInodes[1]));
+
+	// A snapshot removed by someone else is written again, although its contents did not change
+	unlink(this->filename.c_str());
+	hooks = this->run(true, 2, true);
+	EXPECT_THAT(hooks->snapshotInodes.size(), Eq(1U));
+	EXPECT_THAT(access(this->filename.c_str(), F_OK), Eq(0));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
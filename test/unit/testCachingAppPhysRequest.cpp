@@ -0,0 +1,64 @@
+#include "nebu-app-framework/cachingAppPhysRequest.h"
+#include "nebu/mocks/mockAppPhysRequest.h"
+
+#include "nebu/util/exceptions.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+// Using declarations - nebu-common
+using nebu::common::NebuServerException;
+using nebu::common::PhysicalRoot;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::CachingAppPhysRequest;
+// Using declarations - mocks
+using nebu::test::MockAppPhysRequest;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::IsNull;
+using testing::Return;
+using testing::Throw;
+
+TEST(CachingAppPhysRequestTest, testCachesTopology) {
+	shared_ptr<PhysicalRoot> root = make_shared<PhysicalRoot>("root");
+	shared_ptr<MockAppPhysRequest> mockRequest = make_shared<MockAppPhysRequest>();
+	EXPECT_CALL(*mockRequest, getPhysicalTopology()).WillOnce(Return(root));
+	CachingAppPhysRequest request(mockRequest, 1000, 1000);
+
+	EXPECT_THAT(request.getPhysicalTopology(), Eq(root));
+	EXPECT_THAT(request.getPhysicalTopology(), Eq(root));
+	EXPECT_THAT(request.getStatistics().hits, Eq(1U));
+	EXPECT_THAT(request.getStatistics().misses, Eq(1U));
+}
+
+TEST(CachingAppPhysRequestTest, testDoesNotCacheInvalidTree) {
+	shared_ptr<MockAppPhysRequest> mockRequest = make_shared<MockAppPhysRequest>();
+	EXPECT_CALL(*mockRequest, getPhysicalTopology()).Times(2).WillRepeatedly(Return(shared_ptr<PhysicalRoot>()));
+	CachingAppPhysRequest request(mockRequest, 1000, 1000);
+
+	EXPECT_THAT(request.getPhysicalTopology(), IsNull());
+	EXPECT_THAT(request.getPhysicalTopology(), IsNull());
+}
+
+TEST(CachingAppPhysRequestTest, testCachesFailures) {
+	shared_ptr<MockAppPhysRequest> mockRequest = make_shared<MockAppPhysRequest>();
+	EXPECT_CALL(*mockRequest, getPhysicalTopology()).WillOnce(Throw(NebuServerException("")));
+	CachingAppPhysRequest request(mockRequest, 1000, 1000);
+
+	EXPECT_THROW(request.getPhysicalTopology(), NebuServerException);
+	EXPECT_THROW(request.getPhysicalTopology(), NebuServerException);
+	EXPECT_THAT(request.getStatistics().failures, Eq(1U));
+	EXPECT_THAT(request.getStatistics().negativeHits, Eq(1U));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
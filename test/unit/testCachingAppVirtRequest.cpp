@@ -0,0 +1,85 @@
+#include "nebu-app-framework/cachingAppVirtRequest.h"
+#include "nebu/mocks/mockAppVirtRequest.h"
+
+#include "nebu/util/exceptions.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::NebuServerException;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::CachingAppVirtRequest;
+// Using declarations - mocks
+using nebu::test::MockAppVirtRequest;
+// Using declarations - gtest/gmock
+using testing::ElementsAre;
+using testing::Eq;
+using testing::Return;
+using testing::Throw;
+
+TEST(CachingAppVirtRequestTest, testCachesEndpoints) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vector<string> { "vmA", "vmB" }));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(VirtualMachine("vmA")));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(VirtualMachine("vmB")));
+	CachingAppVirtRequest request(mockRequest, 1000, 1000, 1000);
+
+	for (int i = 0; i < 3; i++) {
+		EXPECT_THAT(request.getVirtualMachineIDs(), ElementsAre("vmA", "vmB"));
+		EXPECT_THAT(request.getVirtualMachine("vmA").getUUID(), Eq("vmA"));
+		EXPECT_THAT(request.getVirtualMachine("vmB").getUUID(), Eq("vmB"));
+	}
+
+	EXPECT_THAT(request.getVirtualMachineIDsStatistics().misses, Eq(1U));
+	EXPECT_THAT(request.getVirtualMachineIDsStatistics().hits, Eq(2U));
+	EXPECT_THAT(request.getVirtualMachineStatistics().misses, Eq(2U));
+	EXPECT_THAT(request.getVirtualMachineStatistics().hits, Eq(4U));
+}
+
+TEST(CachingAppVirtRequestTest, testSeparateTTLs) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).Times(2).WillRepeatedly(Return(vector<string> { "vmA" }));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(VirtualMachine("vmA")));
+	CachingAppVirtRequest request(mockRequest, 0, 1000, 0);
+
+	request.getVirtualMachineIDs();
+	request.getVirtualMachine("vmA");
+	request.getVirtualMachineIDs();
+	request.getVirtualMachine("vmA");
+}
+
+TEST(CachingAppVirtRequestTest, testCachesFailures) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Throw(NebuServerException("")));
+	CachingAppVirtRequest request(mockRequest, 1000, 1000, 1000);
+
+	EXPECT_THROW(request.getVirtualMachine("vmA"), NebuServerException);
+	EXPECT_THROW(request.getVirtualMachine("vmA"), NebuServerException);
+	EXPECT_THAT(request.getVirtualMachineStatistics().negativeHits, Eq(1U));
+}
+
+TEST(CachingAppVirtRequestTest, testClear) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).Times(2).WillRepeatedly(Return(vector<string> { "vmA" }));
+	CachingAppVirtRequest request(mockRequest, 1000, 1000, 1000);
+
+	request.getVirtualMachineIDs();
+	request.clear();
+	request.getVirtualMachineIDs();
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
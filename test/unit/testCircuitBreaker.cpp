@@ -0,0 +1,147 @@
+#include "nebu-app-framework/circuitBreaker.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Using declarations - standard library
+using std::pair;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::CircuitBreaker;
+using nebu::app::framework::CircuitState;
+// Using declarations - gtest/gmock
+using testing::ElementsAre;
+using testing::Eq;
+
+void sleepFor(unsigned int milliseconds) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+TEST(CircuitBreakerTest, testOpensAfterConsecutiveFailures) {
+	CircuitBreaker breaker(3, 1000, 10000);
+
+	for (int i = 0; i < 2; i++) {
+		EXPECT_TRUE(breaker.allowRequest());
+		breaker.recordFailure();
+	}
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordSuccess();
+	for (int i = 0; i < 2; i++) {
+		EXPECT_TRUE(breaker.allowRequest());
+		breaker.recordFailure();
+	}
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::CLOSED));
+
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::OPEN));
+	EXPECT_FALSE(breaker.allowRequest());
+	EXPECT_FALSE(breaker.allowRequest());
+
+	CircuitBreaker::Statistics statistics = breaker.getStatistics();
+	EXPECT_THAT(statistics.failures, Eq(5U));
+	EXPECT_THAT(statistics.successes, Eq(1U));
+	EXPECT_THAT(statistics.rejected, Eq(2U));
+	EXPECT_THAT(statistics.opened, Eq(1U));
+}
+
+TEST(CircuitBreakerTest, testHalfOpenProbe) {
+	CircuitBreaker breaker(1, 20, 1000);
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_FALSE(breaker.allowRequest());
+
+	sleepFor(30);
+	EXPECT_TRUE(breaker.allowRequest());
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::HALF_OPEN));
+	// Only a single probe is allowed at a time
+	EXPECT_FALSE(breaker.allowRequest());
+	breaker.recordSuccess();
+
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::CLOSED));
+	EXPECT_TRUE(breaker.allowRequest());
+	EXPECT_THAT(breaker.getStatistics().probes, Eq(1U));
+}
+
+TEST(CircuitBreakerTest, testIgnoredRequests) {
+	CircuitBreaker breaker(2, 20, 1000);
+	for (int i = 0; i < 5; i++) {
+		EXPECT_TRUE(breaker.allowRequest());
+		breaker.recordIgnored();
+	}
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordIgnored();
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::CLOSED));
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::OPEN));
+
+	// An ignored probe lets the next request probe again
+	sleepFor(30);
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordIgnored();
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::HALF_OPEN));
+	EXPECT_TRUE(breaker.allowRequest());
+	EXPECT_THAT(breaker.getStatistics().probes, Eq(2U));
+	EXPECT_THAT(breaker.getStatistics().ignored, Eq(7U));
+}
+
+TEST(CircuitBreakerTest, testExponentialBackoff) {
+	CircuitBreaker breaker(1, 20, 50);
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_THAT(breaker.getBackoff(), Eq(20U));
+
+	sleepFor(30);
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_THAT(breaker.getState(), Eq(CircuitState::OPEN));
+	EXPECT_THAT(breaker.getBackoff(), Eq(40U));
+
+	// The circuit stays open for the doubled backoff
+	sleepFor(30);
+	EXPECT_FALSE(breaker.allowRequest());
+	sleepFor(20);
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordFailure();
+	EXPECT_THAT(breaker.getBackoff(), Eq(50U));
+
+	sleepFor(60);
+	EXPECT_TRUE(breaker.allowRequest());
+	breaker.recordSuccess();
+	EXPECT_THAT(breaker.getBackoff(), Eq(20U));
+}
+
+TEST(CircuitBreakerTest, testStateListener) {
+	CircuitBreaker breaker(1, 10, 1000);
+	vector<pair<CircuitState, CircuitState> > transitions;
+	breaker.setStateListener([&transitions](CircuitState previous, CircuitState current) {
+		transitions.push_back(pair<CircuitState, CircuitState>(previous, current));
+	});
+
+	breaker.allowRequest();
+	breaker.recordFailure();
+	sleepFor(20);
+	breaker.allowRequest();
+	breaker.recordSuccess();
+
+	EXPECT_THAT(transitions, ElementsAre(
+			pair<CircuitState, CircuitState>(CircuitState::CLOSED, CircuitState::OPEN),
+			pair<CircuitState, CircuitState>(CircuitState::OPEN, CircuitState::HALF_OPEN),
+			pair<CircuitState, CircuitState>(CircuitState::HALF_OPEN, CircuitState::CLOSED)));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,81 @@
+#include "nebu-app-framework/circuitBreakingAppVirtRequest.h"
+#include "nebu/mocks/mockAppVirtRequest.h"
+
+#include "nebu/util/exceptions.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::NebuServerException;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::CircuitBreaker;
+using nebu::app::framework::CircuitBreakingAppVirtRequest;
+using nebu::app::framework::CircuitOpenException;
+using nebu::app::framework::CircuitState;
+// Using declarations - mocks
+using nebu::test::MockAppVirtRequest;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::Return;
+using testing::Throw;
+using testing::_;
+
+TEST(CircuitBreakingAppVirtRequestTest, testShortCircuitsFailingServer) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).Times(2).WillRepeatedly(Throw(NebuServerException("")));
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).Times(0);
+	shared_ptr<CircuitBreaker> breaker = make_shared<CircuitBreaker>(2, 1000, 1000);
+	CircuitBreakingAppVirtRequest request(mockRequest, breaker);
+
+	for (int i = 0; i < 2; i++) {
+		EXPECT_THROW(request.getVirtualMachineIDs(), NebuServerException);
+	}
+	for (int i = 0; i < 4; i++) {
+		EXPECT_THROW(request.getVirtualMachineIDs(), CircuitOpenException);
+		EXPECT_THROW(request.getVirtualMachine("vmA"), CircuitOpenException);
+	}
+	EXPECT_THAT(breaker->getState(), Eq(CircuitState::OPEN));
+	EXPECT_THAT(breaker->getStatistics().rejected, Eq(8U));
+}
+
+TEST(CircuitBreakingAppVirtRequestTest, testVMFailuresDoNotOpenCircuit) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).Times(5).WillRepeatedly(Throw(NebuServerException("")));
+	shared_ptr<CircuitBreaker> breaker = make_shared<CircuitBreaker>(2, 1000, 1000);
+	CircuitBreakingAppVirtRequest request(mockRequest, breaker);
+
+	for (int i = 0; i < 5; i++) {
+		EXPECT_THROW(request.getVirtualMachine("vmA"), NebuServerException);
+	}
+	EXPECT_THAT(breaker->getState(), Eq(CircuitState::CLOSED));
+	EXPECT_THAT(breaker->getStatistics().failures, Eq(0U));
+	EXPECT_THAT(breaker->getStatistics().ignored, Eq(5U));
+}
+
+TEST(CircuitBreakingAppVirtRequestTest, testPassesOnResults) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vector<string> { "vmA" }));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(VirtualMachine("vmA")));
+	shared_ptr<CircuitBreaker> breaker = make_shared<CircuitBreaker>(1, 1000, 1000);
+	CircuitBreakingAppVirtRequest request(mockRequest, breaker);
+
+	EXPECT_THAT(request.getVirtualMachineIDs().size(), Eq(1U));
+	EXPECT_THAT(request.getVirtualMachine("vmA").getUUID(), Eq("vmA"));
+	EXPECT_THAT(breaker->getStatistics().successes, Eq(2U));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
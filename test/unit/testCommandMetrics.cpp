@@ -0,0 +1,141 @@
+
+#include "nebu-app-framework/commandMetrics.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <errno.h>
+#include <signal.h>
+
+// Using declarations - standard library
+using std::map;
+using std::string;
+using std::vector;
+using std::chrono::microseconds;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Command;
+using nebu::app::framework::CommandMetrics;
+using nebu::app::framework::CommandResult;
+// Using declarations - gtest/gmock
+using testing::DoubleEq;
+using testing::Eq;
+using testing::HasSubstr;
+
+static CommandResult createResult(int waitStatus)
+{
+	CommandResult result;
+	result.setWaitStatus(waitStatus);
+	return result;
+}
+
+TEST(CommandMetricsTest, testDefaultLabels) {
+	Command labelled = Command::shell("true");
+	labelled.setLabel("status");
+	EXPECT_THAT(labelled.getLabel(), Eq("status"));
+	EXPECT_THAT(Command::shell("true").getLabel(), Eq("shell"));
+	EXPECT_THAT(Command(vector<string> { "/usr/bin/ssh", "host" }).getLabel(), Eq("ssh"));
+}
+
+TEST(CommandMetricsTest, testCountsOutcomes) {
+	CommandMetrics metrics;
+	Command command = Command::shell("true");
+	command.setLabel("status");
+	CommandResult timedOut = createResult(SIGTERM);
+	timedOut.setTimedOut(true);
+	CommandResult notStarted;
+	notStarted.setSpawnError(ENOENT);
+
+	for (int i = 0; i < 5; i++) {
+		metrics.commandStarted();
+	}
+	metrics.commandCompleted(command, createResult(0), microseconds(500));
+	metrics.commandCompleted(command, createResult(0), microseconds(1500));
+	metrics.commandCompleted(command, createResult(3 << 8), microseconds(3000));
+	metrics.commandCompleted(command, timedOut, microseconds(100000));
+	metrics.commandCompleted(command, notStarted, microseconds(10));
+
+	map<string, CommandMetrics::LabelStatistics> statistics = metrics.getStatistics();
+	const CommandMetrics::LabelStatistics &status = statistics["status"];
+	EXPECT_THAT(status.count, Eq(5U));
+	EXPECT_THAT(status.exitCodes.at(0), Eq(2U));
+	EXPECT_THAT(status.exitCodes.at(3), Eq(1U));
+	EXPECT_THAT(status.signals.at(SIGTERM), Eq(1U));
+	EXPECT_THAT(status.timeouts, Eq(1U));
+	EXPECT_THAT(status.spawnFailures, Eq(1U));
+	EXPECT_THAT(status.maxTime, Eq(100000U));
+	EXPECT_THAT(metrics.getRunningCommands(), Eq(0U));
+	EXPECT_THAT(metrics.getPeakRunningCommands(), Eq(5U));
+}
+
+TEST(CommandMetricsTest, testHistogram) {
+	CommandMetrics metrics;
+	Command command = Command::shell("true");
+	for (int i = 0; i < 100; i++) {
+		metrics.commandStarted();
+		metrics.commandCompleted(command, createResult(0), microseconds(i < 90 ? 1500 : 40000));
+	}
+
+	map<string, CommandMetrics::LabelStatistics> statistics = metrics.getStatistics();
+	const CommandMetrics::LabelStatistics &shell = statistics["shell"];
+	EXPECT_THAT(shell.buckets[1], Eq(90U));
+	EXPECT_THAT(shell.buckets[6], Eq(10U));
+	EXPECT_THAT(shell.getLatencyPercentile(50), DoubleEq(2));
+	EXPECT_THAT(shell.getLatencyPercentile(99), DoubleEq(64));
+	EXPECT_THAT(shell.getMeanLatency(), DoubleEq(5.35));
+}
+
+TEST(CommandMetricsTest, testSpawnTimeAndSummary) {
+	CommandMetrics metrics;
+	Command command(vector<string> { "ssh", "host" });
+	metrics.commandStarted();
+	metrics.recordSpawn(command, microseconds(200));
+	metrics.commandCompleted(command, createResult(0), microseconds(2000));
+	metrics.commandStarted();
+	metrics.recordSpawn(command, microseconds(400));
+	metrics.commandCompleted(command, createResult(255 << 8), microseconds(2000));
+
+	EXPECT_THAT(metrics.getStatistics()["ssh"].getMeanSpawnTime(), DoubleEq(0.3));
+	EXPECT_THAT(metrics.toString(), HasSubstr("ssh: 2 commands, 1 failed, 0 timed out"));
+
+	metrics.reset();
+	EXPECT_THAT(metrics.getStatistics().size(), Eq(0U));
+}
+
+TEST(CommandMetricsTest, testBatches) {
+	CommandMetrics metrics;
+	metrics.recordBatch(5, 2);
+	metrics.recordBatch(3, 1);
+
+	CommandMetrics::BatchStatistics batches = metrics.getBatchStatistics();
+	EXPECT_THAT(batches.batches, Eq(2U));
+	EXPECT_THAT(batches.commands, Eq(8U));
+	EXPECT_THAT(batches.invocations, Eq(3U));
+	EXPECT_THAT(metrics.toString(), HasSubstr("8 batched commands in 3 processes"));
+
+	metrics.reset();
+	EXPECT_THAT(metrics.getBatchStatistics().commands, Eq(0U));
+}
+
+TEST(CommandMetricsTest, testSharedResults) {
+	CommandMetrics metrics;
+	Command command = Command::shell("status");
+	command.setLabel("status");
+	metrics.recordCacheHit(command);
+	metrics.recordCacheHit(command);
+	metrics.recordCoalesced(command);
+
+	map<string, CommandMetrics::LabelStatistics> statistics = metrics.getStatistics();
+	EXPECT_THAT(statistics["status"].cacheHits, Eq(2U));
+	EXPECT_THAT(statistics["status"].coalesced, Eq(1U));
+	EXPECT_THAT(statistics["status"].count, Eq(0U));
+	EXPECT_THAT(metrics.toString(), HasSubstr("2 cached, 1 coalesced"));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
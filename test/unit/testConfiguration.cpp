@@ -0,0 +1,295 @@
+
+#include "nebu-app-framework/configuration.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::atomic;
+using std::make_shared;
+using std::ofstream;
+using std::out_of_range;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Configuration;
+// Using declarations - gtest/gmock
+using testing::DoubleEq;
+using testing::ElementsAre;
+using testing::Eq;
+
+string createConfigurationFile(const string &contents) {
+	char filename[] = "/tmp/nebu-configuration-XXXXXX";
+	int fd = mkstemp(filename);
+	close(fd);
+	ofstream output(filename);
+	output << contents;
+	return filename;
+}
+
+TEST(ConfigurationTest, testDefaultValues) {
+	Configuration cfg;
+
+	EXPECT_THAT(cfg.getOption(CONFIG_APP_INTERVAL), Eq("60"));
+	EXPECT_THAT(cfg.getOptionInt(CONFIG_APP_INTERVAL), Eq(60));
+	EXPECT_THROW(cfg.getOption("does.not.exist"), out_of_range);
+}
+
+TEST(ConfigurationTest, testGetOptionDouble) {
+	Configuration cfg;
+	cfg.setOption(CONFIG_NEBU_HEDGE_PERCENTILE, "99.9");
+
+	EXPECT_THAT(cfg.getOptionDouble(CONFIG_NEBU_HEDGE_PERCENTILE), DoubleEq(99.9));
+	EXPECT_THAT(cfg.getOptionDouble(CONFIG_APP_INTERVAL), DoubleEq(60));
+}
+
+TEST(ConfigurationTest, testLoadFileMissing) {
+	Configuration cfg;
+
+	EXPECT_THAT(cfg.loadFile("/nonexistent/nebu.conf"), Eq(false));
+}
+
+TEST(ConfigurationTest, testLoadFileKeyValue) {
+	string filename = createConfigurationFile(
+			"# comment\n"
+			"app.interval = 15\n"
+			"\n"
+			"; another comment\n"
+			"custom.option=some value  \n"
+			"malformed line\n");
+	Configuration cfg;
+
+	EXPECT_THAT(cfg.loadFile(filename), Eq(true));
+	EXPECT_THAT(cfg.getOptionInt(CONFIG_APP_INTERVAL), Eq(15));
+	EXPECT_THAT(cfg.getOption("custom.option"), Eq("some value"));
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationTest, testLoadFileSections) {
+	string filename = createConfigurationFile(
+			"[nebu]\n"
+			"url = http://nebu:8080\n"
+			"[ app ]\n"
+			"uuid = someApp\n");
+	Configuration cfg;
+
+	EXPECT_THAT(cfg.loadFile(filename), Eq(true));
+	EXPECT_THAT(cfg.getOption(CONFIG_NEBU_URL), Eq("http://nebu:8080"));
+	EXPECT_THAT(cfg.getOption(CONFIG_APP_UUID), Eq("someApp"));
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationTest, testFromArgumentsLayering) {
+	string filename = createConfigurationFile(
+			"app.interval = 15\n"
+			"app.uuid = fromFile\n");
+	vector<string> args { "--config", filename, "--app", "fromArgs", "remaining" };
+
+	Configuration::fromArguments(args);
+
+	EXPECT_THAT(args, ElementsAre("remaining"));
+	EXPECT_THAT(CONFIG_GETINT(CONFIG_APP_INTERVAL), Eq(15));
+	EXPECT_THAT(CONFIG_GET(CONFIG_APP_UUID), Eq("fromArgs"));
+	EXPECT_THAT(CONFIG_GET(CONFIG_NEBU_URL), Eq("http://localhost:8080"));
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationTest, testReloadPublishesNewSnapshot) {
+	string filename = createConfigurationFile("app.interval = 15\n");
+	vector<string> args { "--config", filename };
+	Configuration::fromArguments(args);
+	shared_ptr<const Configuration> before = Configuration::getGlobalConfiguration();
+
+	ofstream(filename.c_str()) << "app.interval = 30\n";
+
+	EXPECT_THAT(Configuration::reload(), Eq(true));
+	EXPECT_THAT(CONFIG_GETINT(CONFIG_APP_INTERVAL), Eq(30));
+	EXPECT_THAT(before->getOptionInt(CONFIG_APP_INTERVAL), Eq(15));
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationTest, testReloadKeepsSnapshotWhenFileIsMissing) {
+	string filename = createConfigurationFile("app.interval = 15\n");
+	vector<string> args { "--config", filename };
+	Configuration::fromArguments(args);
+	shared_ptr<const Configuration> before = Configuration::getGlobalConfiguration();
+
+	unlink(filename.c_str());
+
+	EXPECT_THAT(Configuration::reload(), Eq(false));
+	EXPECT_THAT(Configuration::getGlobalConfiguration(), Eq(before));
+}
+
+TEST(ConfigurationTest, testReloadKeepsUpdatedOptions) {
+	string filename = createConfigurationFile("app.interval = 15\napp.uuid = fromFile\n");
+	vector<string> args { "--config", filename };
+	Configuration::fromArguments(args);
+	Configuration::updateGlobalConfiguration([](Configuration &cfg) { cfg.setOption(CONFIG_APP_UUID, "updated"); });
+
+	ofstream(filename.c_str()) << "app.interval = 30\napp.uuid = changedFile\n";
+
+	EXPECT_THAT(Configuration::reload(), Eq(true));
+	EXPECT_THAT(CONFIG_GETINT(CONFIG_APP_INTERVAL), Eq(30));
+	EXPECT_THAT(CONFIG_GET(CONFIG_APP_UUID), Eq("updated"));
+
+	vector<string> restartArgs { "--config", filename };
+	Configuration::fromArguments(restartArgs);
+	EXPECT_THAT(CONFIG_GET(CONFIG_APP_UUID), Eq("changedFile"));
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationTest, testConcurrentReloadsAndUpdates) {
+	string filename = createConfigurationFile("app.interval = 15\n");
+	vector<string> args { "--config", filename };
+	Configuration::fromArguments(args);
+	Configuration::updateGlobalConfiguration([](Configuration &cfg) { cfg.setOption("test.counter", "0"); });
+
+	atomic<bool> done(false);
+	thread reloader([&done]() {
+		while (!done.load()) {
+			Configuration::reload();
+		}
+	});
+	for (int i = 0; i < 200; i++) {
+		Configuration::updateGlobalConfiguration([](Configuration &cfg) {
+			cfg.setOption("test.counter", to_string(cfg.getOptionInt("test.counter") + 1));
+		});
+	}
+	done = true;
+	reloader.join();
+
+	EXPECT_THAT(CONFIG_GETINT("test.counter"), Eq(200));
+	EXPECT_THAT(CONFIG_GETINT(CONFIG_APP_INTERVAL), Eq(15));
+	unlink(filename.c_str());
+}
+
+TEST(ConfigurationTest, testSetGlobalConfiguration) {
+	shared_ptr<Configuration> cfg = make_shared<Configuration>();
+	cfg->setOption("custom.option", "value");
+
+	Configuration::setGlobalConfiguration(cfg);
+
+	EXPECT_THAT(Configuration::getGlobalConfiguration(), Eq(cfg));
+	EXPECT_THAT(CONFIG_GET("custom.option"), Eq("value"));
+}
+
+TEST(ConfigurationTest, testUpdateGlobalConfigurationCopies) {
+	Configuration::setGlobalConfiguration(make_shared<Configuration>());
+	shared_ptr<const Configuration> before = Configuration::getGlobalConfiguration();
+
+	Configuration::updateGlobalConfiguration([](Configuration &cfg) { cfg.setOption(CONFIG_APP_UUID, "updated"); });
+
+	EXPECT_THAT(CONFIG_GET(CONFIG_APP_UUID), Eq("updated"));
+	EXPECT_THAT(before->getOption(CONFIG_APP_UUID), Eq(""));
+}
+
+TEST(ConfigurationTest, testConcurrentReadsSeeConsistentSnapshots) {
+	const int numReaders = 8;
+	const int numUpdates = 2000;
+	shared_ptr<Configuration> initial = make_shared<Configuration>();
+	initial->setOption("test.first", "0");
+	initial->setOption("test.second", "0");
+	Configuration::setGlobalConfiguration(initial);
+
+	atomic<bool> done(false);
+	atomic<int> inconsistentReads(0);
+	vector<thread> readers;
+	for (int i = 0; i < numReaders; i++) {
+		readers.push_back(thread([&done, &inconsistentReads]() {
+			while (!done.load()) {
+				shared_ptr<const Configuration> cfg = Configuration::getGlobalConfiguration();
+				if (cfg->getOption("test.first") != cfg->getOption("test.second")) {
+					inconsistentReads++;
+				}
+			}
+		}));
+	}
+
+	for (int i = 1; i <= numUpdates; i++) {
+		shared_ptr<Configuration> cfg = make_shared<Configuration>();
+		cfg->setOption("test.first", to_string(i));
+		cfg->setOption("test.second", to_string(i));
+		Configuration::setGlobalConfiguration(cfg);
+	}
+	done = true;
+	for (vector<thread>::iterator it = readers.begin(); it != readers.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(inconsistentReads.load(), Eq(0));
+	EXPECT_THAT(CONFIG_GETINT("test.first"), Eq(numUpdates));
+}
+
+TEST(ConfigurationTest, testSupersededSnapshotsFreedUnderConstantReads) {
+	const int numReaders = 8;
+	atomic<bool> done(false);
+	vector<thread> readers;
+	for (int i = 0; i < numReaders; i++) {
+		readers.push_back(thread([&done]() {
+			while (!done.load()) {
+				Configuration::getGlobalConfiguration();
+			}
+		}));
+	}
+
+	// Every superseded snapshot is released by the global holder before the next update returns
+	int released = 0;
+	for (int i = 0; i < 200; i++) {
+		shared_ptr<Configuration> cfg = make_shared<Configuration>();
+		std::weak_ptr<const Configuration> previous = Configuration::getGlobalConfiguration();
+		Configuration::setGlobalConfiguration(cfg);
+		cfg.reset();
+		for (int waited = 0; !previous.expired() && waited < 1000; waited++) {
+			std::this_thread::yield();
+		}
+		released += previous.expired() ? 1 : 0;
+	}
+	done = true;
+	for (vector<thread>::iterator it = readers.begin(); it != readers.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(released, Eq(200));
+}
+
+TEST(ConfigurationTest, testConcurrentUpdatesAreNotLost) {
+	const int numWriters = 4;
+	const int numUpdates = 500;
+	Configuration::setGlobalConfiguration(make_shared<Configuration>());
+	Configuration::updateGlobalConfiguration([](Configuration &cfg) { cfg.setOption("test.counter", "0"); });
+
+	vector<thread> writers;
+	for (int i = 0; i < numWriters; i++) {
+		writers.push_back(thread([]() {
+			for (int j = 0; j < numUpdates; j++) {
+				Configuration::updateGlobalConfiguration([](Configuration &cfg) {
+					cfg.setOption("test.counter", to_string(cfg.getOptionInt("test.counter") + 1));
+				});
+			}
+		}));
+	}
+	for (vector<thread>::iterator it = writers.begin(); it != writers.end(); it++) {
+		it->join();
+	}
+
+	EXPECT_THAT(CONFIG_GETINT("test.counter"), Eq(numWriters * numUpdates));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
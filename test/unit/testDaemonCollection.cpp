@@ -0,0 +1,295 @@
+#include "nebu-app-framework/daemonCollection.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <initializer_list>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Daemon;
+using nebu::app::framework::DaemonCollection;
+using nebu::app::framework::DaemonType;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+class StubDaemon : public Daemon
+{
+public:
+	StubDaemon(shared_ptr<VirtualMachine> vm, DaemonType type) : Daemon(vm), type(type) { }
+	virtual ~StubDaemon() { }
+
+	virtual bool launch() { this->launched = true; return true; }
+	virtual DaemonType getType() const { return this->type; }
+
+	void clearLaunched() { this->launched = false; }
+
+private:
+	DaemonType type;
+};
+
+set<shared_ptr<Daemon>> toSet(const DaemonCollection::Range &range) {
+	return set<shared_ptr<Daemon>>(range.begin(), range.end());
+}
+
+set<shared_ptr<Daemon>> daemonSet(std::initializer_list<shared_ptr<Daemon>> daemons) {
+	return set<shared_ptr<Daemon>>(daemons);
+}
+
+class DaemonCollectionTest : public testing::Test
+{
+protected:
+	DaemonCollectionTest() : collection(), vm(make_shared<VirtualMachine>("vm")),
+			a1(make_shared<StubDaemon>(vm, 1)), a2(make_shared<StubDaemon>(vm, 1)),
+			a3(make_shared<StubDaemon>(vm, 1)), b1(make_shared<StubDaemon>(vm, 2))
+	{
+		this->a2->launch();
+		this->collection.addDaemon(this->a1);
+		this->collection.addDaemon(this->a2);
+		this->collection.addDaemon(this->a3);
+		this->collection.addDaemon(this->b1);
+	}
+
+	DaemonCollection collection;
+	shared_ptr<VirtualMachine> vm;
+	shared_ptr<StubDaemon> a1;
+	shared_ptr<StubDaemon> a2;
+	shared_ptr<StubDaemon> a3;
+	shared_ptr<StubDaemon> b1;
+};
+
+TEST_F(DaemonCollectionTest, testSets) {
+	EXPECT_THAT(this->collection.getDaemons(), Eq(daemonSet({ a1, a2, a3, b1 })));
+	EXPECT_THAT(this->collection.getDaemonsForType(1), Eq(daemonSet({ a1, a2, a3 })));
+	EXPECT_THAT(this->collection.getLaunchedDaemonsForType(1), Eq(daemonSet({ a2 })));
+	EXPECT_THAT(this->collection.getUnlaunchedDaemonsForType(1), Eq(daemonSet({ a1, a3 })));
+	EXPECT_THAT(this->collection.getDaemonsForType(3).empty(), Eq(true));
+	EXPECT_THAT(this->collection.getDaemonsFiltered([](shared_ptr<Daemon> daemon) {
+		return daemon->getType() == 2;
+	}), Eq(daemonSet({ b1 })));
+}
+
+TEST_F(DaemonCollectionTest, testRangesAndCounts) {
+	EXPECT_THAT(toSet(this->collection.getDaemonRange()), Eq(daemonSet({ a1, a2, a3, b1 })));
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForType(1)), Eq(daemonSet({ a1, a2, a3 })));
+	EXPECT_THAT(toSet(this->collection.getLaunchedDaemonRangeForType(1)), Eq(daemonSet({ a2 })));
+	EXPECT_THAT(toSet(this->collection.getUnlaunchedDaemonRangeForType(1)), Eq(daemonSet({ a1, a3 })));
+	EXPECT_THAT(this->collection.getDaemonRangeForType(3).empty(), Eq(true));
+	EXPECT_THAT(this->collection.getLaunchedDaemonRangeForType(3).size(), Eq(0U));
+
+	EXPECT_THAT(this->collection.getDaemonCount(), Eq(4U));
+	EXPECT_THAT(this->collection.getDaemonCountForType(1), Eq(3U));
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(1), Eq(1U));
+	EXPECT_THAT(this->collection.getUnlaunchedDaemonCountForType(1), Eq(2U));
+	EXPECT_THAT(this->collection.getUnlaunchedDaemonCountForType(2), Eq(1U));
+	EXPECT_THAT(this->collection.getDaemonCountForType(3), Eq(0U));
+}
+
+TEST_F(DaemonCollectionTest, testAddDaemonTwice) {
+	this->collection.addDaemon(this->a1);
+
+	EXPECT_THAT(this->collection.getDaemonCount(), Eq(4U));
+	EXPECT_THAT(this->collection.getDaemonCountForType(1), Eq(3U));
+}
+
+TEST_F(DaemonCollectionTest, testLaunchIsIndexed) {
+	// Daemons are launched directly, as a DaemonManager does during deployment
+	EXPECT_THAT(this->a1->launch(), Eq(true));
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(1), Eq(2U));
+	EXPECT_THAT(this->collection.getUnlaunchedDaemonCountForType(1), Eq(1U));
+	EXPECT_THAT(toSet(this->collection.getLaunchedDaemonRangeForType(1)), Eq(daemonSet({ a1, a2 })));
+	EXPECT_THAT(toSet(this->collection.getUnlaunchedDaemonRangeForType(1)), Eq(daemonSet({ a3 })));
+
+	EXPECT_THAT(this->b1->launch(), Eq(true));
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(2), Eq(1U));
+	EXPECT_THAT(this->collection.getUnlaunchedDaemonCountForType(2), Eq(0U));
+
+	this->a2->clearLaunched();
+	EXPECT_THAT(toSet(this->collection.getLaunchedDaemonRangeForType(1)), Eq(daemonSet({ a1 })));
+	EXPECT_THAT(toSet(this->collection.getUnlaunchedDaemonRangeForType(1)), Eq(daemonSet({ a2, a3 })));
+}
+
+TEST_F(DaemonCollectionTest, testLaunchIsIndexedInEveryCollection) {
+	DaemonCollection other;
+	other.addDaemon(this->a1);
+	{
+		DaemonCollection destroyed;
+		destroyed.addDaemon(this->a1);
+	}
+	this->a1->launch();
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(1), Eq(2U));
+	EXPECT_THAT(other.getLaunchedDaemonCountForType(1), Eq(1U));
+
+	// A removed Daemon no longer reports to the collection
+	other.removeDaemon(this->a1);
+	other.addDaemon(this->a3);
+	this->a1->clearLaunched();
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(1), Eq(1U));
+	EXPECT_THAT(other.getLaunchedDaemonCountForType(1), Eq(0U));
+	EXPECT_THAT(other.getUnlaunchedDaemonCountForType(1), Eq(1U));
+}
+
+TEST(DaemonCollectionIndexTest, testManyLaunchStateChanges) {
+	DaemonCollection collection;
+	shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>("vm");
+	vector<shared_ptr<StubDaemon>> daemons;
+	for (int i = 0; i < 100; i++) {
+		daemons.push_back(make_shared<StubDaemon>(vm, i % 3));
+		collection.addDaemon(daemons.back());
+	}
+
+	for (int round = 0; round < 5; round++) {
+		for (size_t i = 0; i < daemons.size(); i++) {
+			if ((i * 7 + round) % 5 < 2) {
+				daemons[i]->launch();
+			} else {
+				daemons[i]->clearLaunched();
+			}
+		}
+		for (DaemonType type = 0; type < 3; type++) {
+			set<shared_ptr<Daemon>> launched = collection.query(type).where(
+					[](const shared_ptr<Daemon> &daemon) { return daemon->hasLaunched(); }).toSet();
+			EXPECT_THAT(toSet(collection.getLaunchedDaemonRangeForType(type)), Eq(launched));
+			EXPECT_THAT(collection.getUnlaunchedDaemonCountForType(type),
+					Eq(collection.getDaemonCountForType(type) - launched.size()));
+		}
+	}
+}
+
+class DaemonCollectionRemovalTest : public testing::Test
+{
+protected:
+	DaemonCollectionRemovalTest() : collection(), vm1(make_shared<VirtualMachine>("vm1")),
+			vm2(make_shared<VirtualMachine>("vm2")), a1(make_shared<StubDaemon>(vm1, 1)),
+			a2(make_shared<StubDaemon>(vm2, 1)), a3(make_shared<StubDaemon>(vm2, 1)),
+			b1(make_shared<StubDaemon>(vm1, 2)), b2(make_shared<StubDaemon>(vm2, 2))
+	{
+		this->a1->launch();
+		this->a2->launch();
+		this->collection.addDaemon(this->a1);
+		this->collection.addDaemon(this->a2);
+		this->collection.addDaemon(this->a3);
+		this->collection.addDaemon(this->b1);
+		this->collection.addDaemon(this->b2);
+	}
+
+	DaemonCollection collection;
+	shared_ptr<VirtualMachine> vm1;
+	shared_ptr<VirtualMachine> vm2;
+	shared_ptr<StubDaemon> a1;
+	shared_ptr<StubDaemon> a2;
+	shared_ptr<StubDaemon> a3;
+	shared_ptr<StubDaemon> b1;
+	shared_ptr<StubDaemon> b2;
+};
+
+TEST_F(DaemonCollectionRemovalTest, testVMIndex) {
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForVM("vm1")), Eq(daemonSet({ a1, b1 })));
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForVM("vm2")), Eq(daemonSet({ a2, a3, b2 })));
+	EXPECT_THAT(this->collection.getDaemonRangeForVM("vm3").empty(), Eq(true));
+	EXPECT_THAT(this->collection.getDaemonCountForVM("vm2"), Eq(3U));
+	EXPECT_THAT(this->collection.getDaemonCountForVM("vm3"), Eq(0U));
+}
+
+TEST_F(DaemonCollectionRemovalTest, testRemoveDaemon) {
+	EXPECT_THAT(this->collection.removeDaemon(this->a1), Eq(true));
+	EXPECT_THAT(this->collection.removeDaemon(this->a1), Eq(false));
+
+	EXPECT_THAT(this->collection.getDaemons(), Eq(daemonSet({ a2, a3, b1, b2 })));
+	EXPECT_THAT(toSet(this->collection.getLaunchedDaemonRangeForType(1)), Eq(daemonSet({ a2 })));
+	EXPECT_THAT(toSet(this->collection.getUnlaunchedDaemonRangeForType(1)), Eq(daemonSet({ a3 })));
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForVM("vm1")), Eq(daemonSet({ b1 })));
+
+	// The index keeps working for the Daemons that were moved to fill the gap
+	this->a2->clearLaunched();
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(1), Eq(0U));
+	this->collection.addDaemon(this->a1);
+	EXPECT_THAT(toSet(this->collection.getLaunchedDaemonRangeForType(1)), Eq(daemonSet({ a1 })));
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForVM("vm1")), Eq(daemonSet({ a1, b1 })));
+}
+
+TEST_F(DaemonCollectionRemovalTest, testRemoveDaemonsForVM) {
+	EXPECT_THAT(this->collection.removeDaemonsForVM("vm2"), Eq(3U));
+	EXPECT_THAT(this->collection.removeDaemonsForVM("vm2"), Eq(0U));
+
+	EXPECT_THAT(this->collection.getDaemons(), Eq(daemonSet({ a1, b1 })));
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForType(1)), Eq(daemonSet({ a1 })));
+	EXPECT_THAT(this->collection.getLaunchedDaemonCountForType(1), Eq(1U));
+	EXPECT_THAT(this->collection.getDaemonCountForVM("vm2"), Eq(0U));
+}
+
+TEST_F(DaemonCollectionRemovalTest, testRemoveDaemonsForType) {
+	EXPECT_THAT(this->collection.removeDaemonsForType(1), Eq(3U));
+	EXPECT_THAT(this->collection.removeDaemonsForType(1), Eq(0U));
+
+	EXPECT_THAT(this->collection.getDaemons(), Eq(daemonSet({ b1, b2 })));
+	EXPECT_THAT(this->collection.getDaemonCountForType(1), Eq(0U));
+	EXPECT_THAT(toSet(this->collection.getDaemonRangeForVM("vm2")), Eq(daemonSet({ b2 })));
+}
+
+TEST_F(DaemonCollectionRemovalTest, testOldVMRemoved) {
+	this->collection.oldVMRemoved(*this->vm1);
+
+	EXPECT_THAT(this->collection.getDaemons(), Eq(daemonSet({ a2, a3, b2 })));
+	EXPECT_THAT(this->collection.getDaemonCountForVM("vm1"), Eq(0U));
+}
+
+TEST(DaemonCollectionIndexTest, testManyRemovals) {
+	DaemonCollection collection;
+	vector<shared_ptr<VirtualMachine>> vms;
+	for (int i = 0; i < 10; i++) {
+		vms.push_back(make_shared<VirtualMachine>("vm" + std::to_string(i)));
+	}
+	set<shared_ptr<Daemon>> expected;
+	for (int i = 0; i < 200; i++) {
+		shared_ptr<StubDaemon> daemon = make_shared<StubDaemon>(vms[(i * 7) % 10], i % 3);
+		if (i % 4 == 0) {
+			daemon->launch();
+		}
+		collection.addDaemon(daemon);
+		expected.insert(daemon);
+	}
+
+	for (int i = 0; i < 150; i += 3) {
+		shared_ptr<Daemon> daemon = *std::next(expected.begin(), i % expected.size());
+		EXPECT_THAT(collection.removeDaemon(daemon), Eq(true));
+		expected.erase(daemon);
+	}
+	collection.removeDaemonsForVM("vm3");
+	for (set<shared_ptr<Daemon>>::iterator it = expected.begin(); it != expected.end();) {
+		it = ((*it)->getHostVM()->getUUID() == "vm3") ? expected.erase(it) : std::next(it);
+	}
+
+	EXPECT_THAT(collection.getDaemons(), Eq(expected));
+	for (DaemonType type = 0; type < 3; type++) {
+		set<shared_ptr<Daemon>> launched;
+		for (set<shared_ptr<Daemon>>::iterator it = expected.begin(); it != expected.end(); it++) {
+			if ((*it)->getType() == type && (*it)->hasLaunched()) {
+				launched.insert(*it);
+			}
+		}
+		EXPECT_THAT(toSet(collection.getLaunchedDaemonRangeForType(type)), Eq(launched));
+		EXPECT_THAT(collection.getDaemonsForType(type).size(), Eq(collection.getDaemonCountForType(type)));
+	}
+	for (int i = 0; i < 10; i++) {
+		string uuid = "vm" + std::to_string(i);
+		EXPECT_THAT(toSet(collection.getDaemonRangeForVM(uuid)), Eq(collection.query().where(
+				[&](const shared_ptr<Daemon> &daemon) { return daemon->getHostVM()->getUUID() == uuid; }).toSet()));
+	}
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,185 @@
+#include "nebu-app-framework/daemonCollection.h"
+#include "nebu-app-framework/daemonQuery.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <initializer_list>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Daemon;
+using nebu::app::framework::DaemonCollection;
+using nebu::app::framework::DaemonQuery;
+using nebu::app::framework::DaemonType;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+class StubDaemon : public Daemon
+{
+public:
+	StubDaemon(shared_ptr<VirtualMachine> vm, DaemonType type) : Daemon(vm), type(type) { }
+	virtual ~StubDaemon() { }
+
+	virtual bool launch() { this->launched = true; return true; }
+	virtual DaemonType getType() const { return this->type; }
+
+private:
+	DaemonType type;
+};
+
+set<shared_ptr<Daemon>> daemonSet(std::initializer_list<shared_ptr<Daemon>> daemons) {
+	return set<shared_ptr<Daemon>>(daemons);
+}
+
+class DaemonQueryTest : public testing::Test
+{
+protected:
+	DaemonQueryTest() : collection(), vm1(make_shared<VirtualMachine>("vm1")),
+			vm2(make_shared<VirtualMachine>("vm2")), a1(make_shared<StubDaemon>(vm1, 1)),
+			a2(make_shared<StubDaemon>(vm2, 1)), a3(make_shared<StubDaemon>(vm2, 1)),
+			b1(make_shared<StubDaemon>(vm1, 2))
+	{
+		this->a2->launch();
+		this->b1->launch();
+		this->collection.addDaemon(this->a1);
+		this->collection.addDaemon(this->a2);
+		this->collection.addDaemon(this->a3);
+		this->collection.addDaemon(this->b1);
+	}
+
+	DaemonCollection collection;
+	shared_ptr<VirtualMachine> vm1;
+	shared_ptr<VirtualMachine> vm2;
+	shared_ptr<StubDaemon> a1;
+	shared_ptr<StubDaemon> a2;
+	shared_ptr<StubDaemon> a3;
+	shared_ptr<StubDaemon> b1;
+};
+
+TEST_F(DaemonQueryTest, testQueryAll) {
+	EXPECT_THAT(this->collection.query().count(), Eq(4U));
+	EXPECT_THAT(this->collection.query().any(), Eq(true));
+	EXPECT_THAT(this->collection.query().toSet(), Eq(daemonSet({ a1, a2, a3, b1 })));
+}
+
+TEST_F(DaemonQueryTest, testQueryType) {
+	EXPECT_THAT(this->collection.query(1).toSet(), Eq(daemonSet({ a1, a2, a3 })));
+	EXPECT_THAT(this->collection.query(2).first(), Eq(shared_ptr<Daemon>(b1)));
+	EXPECT_THAT(this->collection.query(3).count(), Eq(0U));
+	EXPECT_THAT(this->collection.query(3).any(), Eq(false));
+	EXPECT_THAT(this->collection.query(3).first(), Eq(shared_ptr<Daemon>()));
+}
+
+TEST_F(DaemonQueryTest, testLaunchState) {
+	EXPECT_THAT(this->collection.query(1, true).toSet(), Eq(daemonSet({ a2 })));
+	EXPECT_THAT(this->collection.query(1, false).toSet(), Eq(daemonSet({ a1, a3 })));
+	EXPECT_THAT(this->collection.query(2, false).any(), Eq(false));
+	EXPECT_THAT(this->collection.query(3, true).count(), Eq(0U));
+
+	this->a3->launch();
+	EXPECT_THAT(this->collection.query(1, true).toSet(), Eq(daemonSet({ a2, a3 })));
+	EXPECT_THAT(this->collection.query(1, false).toSet(), Eq(daemonSet({ a1 })));
+}
+
+TEST_F(DaemonQueryTest, testQueryForVM) {
+	EXPECT_THAT(this->collection.queryForVM("vm1").toSet(), Eq(daemonSet({ a1, b1 })));
+	EXPECT_THAT(this->collection.queryForVM("vm2").where([](const shared_ptr<Daemon> &daemon) {
+		return !daemon->hasLaunched();
+	}).toSet(), Eq(daemonSet({ a3 })));
+	EXPECT_THAT(this->collection.queryForVM("vm3").any(), Eq(false));
+}
+
+TEST_F(DaemonQueryTest, testIndexedQueriesOnlyVisitTheirRange) {
+	int calls = 0;
+	auto visit = [&](const shared_ptr<Daemon> &) -> bool {
+		calls++;
+		return true;
+	};
+
+	EXPECT_THAT(this->collection.query(1, false).where(visit).count(), Eq(2U));
+	EXPECT_THAT(calls, Eq(2));
+	calls = 0;
+	EXPECT_THAT(this->collection.queryForVM("vm1").where(visit).count(), Eq(2U));
+	EXPECT_THAT(calls, Eq(2));
+}
+
+TEST_F(DaemonQueryTest, testWhereCapturesContext) {
+	string uuid = "vm2";
+	EXPECT_THAT(this->collection.query().where([&](const shared_ptr<Daemon> &daemon) {
+		return daemon->getHostVM()->getUUID() == uuid;
+	}).toSet(), Eq(daemonSet({ a2, a3 })));
+
+	shared_ptr<Daemon> excluded = this->a2;
+	EXPECT_THAT(this->collection.query(1).where([&](const shared_ptr<Daemon> &daemon) {
+		return daemon->getHostVM()->getUUID() == uuid;
+	}).where([&](const shared_ptr<Daemon> &daemon) {
+		return daemon != excluded;
+	}).toSet(), Eq(daemonSet({ a3 })));
+}
+
+TEST_F(DaemonQueryTest, testEarlyTermination) {
+	int calls = 0;
+	auto counted = this->collection.query().where([&](const shared_ptr<Daemon> &) -> bool {
+		calls++;
+		return true;
+	});
+
+	EXPECT_THAT(counted.any(), Eq(true));
+	EXPECT_THAT(calls, Eq(1));
+	calls = 0;
+	EXPECT_THAT(counted.first() != shared_ptr<Daemon>(), Eq(true));
+	EXPECT_THAT(calls, Eq(1));
+	calls = 0;
+	EXPECT_THAT(counted.count(), Eq(4U));
+	EXPECT_THAT(calls, Eq(4));
+}
+
+TEST_F(DaemonQueryTest, testFiltersShortCircuit) {
+	int calls = 0;
+	this->collection.query().where([](const shared_ptr<Daemon> &daemon) {
+		return daemon->getHostVM()->getUUID() == "vm1";
+	}).where([&](const shared_ptr<Daemon> &) -> bool {
+		calls++;
+		return true;
+	}).count();
+
+	EXPECT_THAT(calls, Eq(2));
+}
+
+TEST_F(DaemonQueryTest, testForEach) {
+	set<shared_ptr<Daemon>> visited;
+	this->collection.query(1, false).forEach([&](const shared_ptr<Daemon> &daemon) {
+		visited.insert(daemon);
+	});
+
+	EXPECT_THAT(visited, Eq(daemonSet({ a1, a3 })));
+}
+
+TEST(DaemonQueryVectorTest, testQueryOverVector) {
+	shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>("vm");
+	vector<shared_ptr<Daemon>> daemons;
+	daemons.push_back(make_shared<StubDaemon>(vm, 1));
+	daemons.push_back(make_shared<StubDaemon>(vm, 2));
+
+	DaemonQuery<> query(daemons.begin(), daemons.end());
+	EXPECT_THAT(query.where([](const shared_ptr<Daemon> &daemon) {
+		return daemon->getType() == 2;
+	}).first(), Eq(daemons[1]));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
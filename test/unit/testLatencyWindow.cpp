@@ -0,0 +1,43 @@
+#include "nebu-app-framework/latencyWindow.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+// Using declarations - nebu-app-framework
+using nebu::app::framework::LatencyWindow;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+TEST(LatencyWindowTest, testPercentiles) {
+	LatencyWindow window(100);
+	EXPECT_THAT(window.getPercentile(50), Eq(0U));
+
+	for (unsigned int i = 100; i > 0; i--) {
+		window.add(i);
+	}
+	EXPECT_THAT(window.size(), Eq(100U));
+	EXPECT_THAT(window.getPercentile(0), Eq(1U));
+	EXPECT_THAT(window.getPercentile(50), Eq(50U));
+	EXPECT_THAT(window.getPercentile(99), Eq(99U));
+	EXPECT_THAT(window.getPercentile(100), Eq(100U));
+}
+
+TEST(LatencyWindowTest, testReplacesOldest) {
+	LatencyWindow window(3);
+	window.add(1000);
+	window.add(1);
+	window.add(2);
+	window.add(3);
+
+	EXPECT_THAT(window.size(), Eq(3U));
+	EXPECT_THAT(window.getPercentile(100), Eq(3U));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,118 @@
+#include "nebu-app-framework/responseCache.h"
+
+#include "nebu/util/exceptions.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <thread>
+
+// Using declarations - standard library
+using std::string;
+// Using declarations - nebu-common
+using nebu::common::NebuServerException;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::CircuitOpenException;
+using nebu::app::framework::ResponseCache;
+// Using declarations - gtest/gmock
+using testing::Eq;
+
+TEST(ResponseCacheTest, testHitsWithinTTL) {
+	ResponseCache<string> cache(1000, 1000);
+	int fetches = 0;
+	ResponseCache<string>::Fetcher fetch = [&fetches]() { return "response" + std::to_string(++fetches); };
+
+	EXPECT_THAT(cache.get("a", fetch), Eq("response1"));
+	EXPECT_THAT(cache.get("a", fetch), Eq("response1"));
+	EXPECT_THAT(cache.get("b", fetch), Eq("response2"));
+	EXPECT_THAT(fetches, Eq(2));
+
+	ResponseCache<string>::Statistics statistics = cache.getStatistics();
+	EXPECT_THAT(statistics.misses, Eq(2U));
+	EXPECT_THAT(statistics.hits, Eq(1U));
+
+	cache.invalidate("a");
+	EXPECT_THAT(cache.get("a", fetch), Eq("response3"));
+	cache.clear();
+	EXPECT_THAT(cache.get("b", fetch), Eq("response4"));
+}
+
+TEST(ResponseCacheTest, testExpires) {
+	ResponseCache<string> cache(20, 0);
+	int fetches = 0;
+	ResponseCache<string>::Fetcher fetch = [&fetches]() { return std::to_string(++fetches); };
+
+	EXPECT_THAT(cache.get("a", fetch), Eq("1"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	EXPECT_THAT(cache.get("a", fetch), Eq("2"));
+}
+
+TEST(ResponseCacheTest, testWithoutTTL) {
+	ResponseCache<string> cache(0, 0);
+	int fetches = 0;
+	ResponseCache<string>::Fetcher fetch = [&fetches]() { return std::to_string(++fetches); };
+
+	EXPECT_THAT(cache.get("a", fetch), Eq("1"));
+	EXPECT_THAT(cache.get("a", fetch), Eq("2"));
+	EXPECT_THAT(cache.getStatistics().hits, Eq(0U));
+}
+
+TEST(ResponseCacheTest, testNegativeCaching) {
+	ResponseCache<string> cache(1000, 1000);
+	int fetches = 0;
+	ResponseCache<string>::Fetcher fail = [&fetches]() -> string {
+		fetches++;
+		throw NebuServerException("unavailable");
+	};
+
+	EXPECT_THROW(cache.get("a", fail), NebuServerException);
+	try {
+		cache.get("a", fail);
+		FAIL();
+	} catch (NebuServerException &ex) {
+		EXPECT_THAT(ex.what(), Eq("unavailable"));
+	}
+	EXPECT_THAT(fetches, Eq(1));
+
+	ResponseCache<string>::Statistics statistics = cache.getStatistics();
+	EXPECT_THAT(statistics.misses, Eq(1U));
+	EXPECT_THAT(statistics.failures, Eq(1U));
+	EXPECT_THAT(statistics.negativeHits, Eq(1U));
+}
+
+TEST(ResponseCacheTest, testWithoutNegativeCaching) {
+	ResponseCache<string> cache(1000, 0);
+	int fetches = 0;
+	ResponseCache<string>::Fetcher fail = [&fetches]() -> string {
+		fetches++;
+		throw NebuServerException("unavailable");
+	};
+
+	EXPECT_THROW(cache.get("a", fail), NebuServerException);
+	EXPECT_THROW(cache.get("a", fail), NebuServerException);
+	EXPECT_THAT(fetches, Eq(2));
+	EXPECT_THAT(cache.getStatistics().negativeHits, Eq(0U));
+}
+
+TEST(ResponseCacheTest, testDoesNotKeepRejections) {
+	ResponseCache<string> cache(1000, 1000);
+	int fetches = 0;
+	ResponseCache<string>::Fetcher reject = [&fetches]() -> string {
+		fetches++;
+		throw CircuitOpenException("circuit open");
+	};
+
+	EXPECT_THROW(cache.get("a", reject), CircuitOpenException);
+	EXPECT_THROW(cache.get("a", reject), CircuitOpenException);
+	EXPECT_THAT(fetches, Eq(2));
+	EXPECT_THAT(cache.getStatistics().negativeHits, Eq(0U));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,224 @@
+#include "nebu-app-framework/daemonCollection.h"
+#include "nebu-app-framework/stateSnapshot.h"
+#include "nebu-app-framework/topologyManager.h"
+#include "nebu-app-framework/vmManager.h"
+#include "nebu/mocks/mockAppPhysRequest.h"
+#include "nebu/mocks/mockAppVirtRequest.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <fstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::fstream;
+using std::ios;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+using nebu::common::VMStatus;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::Daemon;
+using nebu::app::framework::DaemonCollection;
+using nebu::app::framework::DaemonType;
+using nebu::app::framework::StateSnapshot;
+using nebu::app::framework::TopologyManager;
+using nebu::app::framework::VMManager;
+// Using declarations - mocks
+using nebu::test::MockAppPhysRequest;
+using nebu::test::MockAppVirtRequest;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::IsNull;
+using testing::Ne;
+using testing::NotNull;
+
+class StubDaemon : public Daemon
+{
+public:
+	StubDaemon(shared_ptr<VirtualMachine> vm, DaemonType type, bool launched) : Daemon(vm), type(type)
+	{
+		this->launched = launched;
+	}
+	virtual ~StubDaemon() { }
+
+	virtual bool launch() { return false; }
+	virtual DaemonType getType() const { return this->type; }
+
+private:
+	DaemonType type;
+};
+
+class StateSnapshotTest : public testing::Test
+{
+protected:
+	StateSnapshotTest() : vmManager(make_shared<MockAppVirtRequest>()),
+			topologyManager(make_shared<MockAppPhysRequest>()), daemonCollection()
+	{
+		char name[] = "/tmp/nebu-snapshot-XXXXXX";
+		close(mkstemp(name));
+		this->filename = name;
+	}
+
+	virtual ~StateSnapshotTest()
+	{
+		unlink(this->filename.c_str());
+	}
+
+	virtual void SetUp()
+	{
+		shared_ptr<PhysicalRoot> root = make_shared<PhysicalRoot>("root");
+		shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>("dc");
+		shared_ptr<PhysicalRack> rack = make_shared<PhysicalRack>("rack");
+		shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>("host");
+		root->addDataCenter(dc); dc->setParent(root.get());
+		dc->addRack(rack); rack->setParent(dc.get());
+		rack->addHost(host); host->setParent(rack.get());
+		this->topologyManager.restoreTopology(root);
+
+		shared_ptr<VirtualMachine> vmA = make_shared<VirtualMachine>("vmA");
+		vmA->setHostname("hostA");
+		vmA->setStatus(VMStatus::ON);
+		vmA->setPhysicalHostID("host");
+		vmA->setPhysicalStoreID("store");
+		shared_ptr<VirtualMachine> vmB = make_shared<VirtualMachine>("vmB");
+		vmB->setStatus(VMStatus::OFF);
+		this->vmManager.setRefreshPolicy(10, 1);
+		this->vmManager.restoreVM(vmB, 0);
+		this->vmManager.restoreVM(vmA, 7);
+
+		this->daemonCollection.addDaemon(make_shared<StubDaemon>(vmA, 3, true));
+	}
+
+	void overwrite(size_t offset, char value)
+	{
+		fstream file(this->filename, ios::in | ios::out | ios::binary);
+		file.seekp(offset);
+		file.put(value);
+	}
+
+	string filename;
+	VMManager vmManager;
+	TopologyManager topologyManager;
+	DaemonCollection daemonCollection;
+};
+
+TEST_F(StateSnapshotTest, testSaveAndLoad) {
+	StateSnapshot saved;
+	saved.capture(this->vmManager, this->topologyManager, this->daemonCollection);
+	EXPECT_THAT(saved.save(this->filename), Eq(true));
+
+	StateSnapshot loaded;
+	EXPECT_THAT(loaded.load(this->filename), Eq(true));
+
+	const vector<StateSnapshot::VMRecord> &vms = loaded.getVMs();
+	ASSERT_THAT(vms.size(), Eq(2U));
+	EXPECT_THAT(vms[0].vm->getUUID(), Eq("vmA"));
+	EXPECT_THAT(vms[0].vm->getHostname(), Eq("hostA"));
+	EXPECT_THAT(vms[0].vm->getStatus(), Eq(VMStatus::ON));
+	EXPECT_THAT(vms[0].vm->getPhysicalHostID(), Eq("host"));
+	EXPECT_THAT(vms[0].vm->getPhysicalStoreID(), Eq("store"));
+	EXPECT_THAT(vms[0].unchangedPolls, Eq(7U));
+	EXPECT_THAT(vms[1].vm->getUUID(), Eq("vmB"));
+	EXPECT_THAT(vms[1].vm->getStatus(), Eq(VMStatus::OFF));
+
+	shared_ptr<PhysicalRoot> topology = loaded.getTopology();
+	ASSERT_THAT(topology, NotNull());
+	EXPECT_THAT(topology->getUUID(), Eq("root"));
+	shared_ptr<PhysicalRack> rack = topology->getDataCenters().at("dc")->getRacks().at("rack");
+	EXPECT_THAT(rack->getParent()->getUUID(), Eq("dc"));
+	EXPECT_THAT(rack->getHosts().at("host")->getParent(), Eq(rack.get()));
+
+	ASSERT_THAT(loaded.getDaemons().size(), Eq(1U));
+	EXPECT_THAT(loaded.getDaemons()[0].vmUUID, Eq("vmA"));
+	EXPECT_THAT(loaded.getDaemons()[0].type, Eq(3U));
+	EXPECT_THAT(loaded.getDaemons()[0].launched, Eq(true));
+}
+
+TEST_F(StateSnapshotTest, testCaptureLimitsUnchangedPolls) {
+	this->vmManager.setRefreshPolicy(3, 1);
+	StateSnapshot snapshot;
+	snapshot.capture(this->vmManager, this->topologyManager, this->daemonCollection);
+	EXPECT_THAT(snapshot.getVMs()[0].unchangedPolls, Eq(3U));
+	EXPECT_THAT(snapshot.getVMs()[1].unchangedPolls, Eq(0U));
+}
+
+TEST_F(StateSnapshotTest, testSaveIfChanged) {
+	StateSnapshot snapshot;
+	snapshot.capture(this->vmManager, this->topologyManager, this->daemonCollection);
+	uint64_t checksum = 0;
+	EXPECT_THAT(snapshot.saveIfChanged(this->filename, checksum), Eq(true));
+	EXPECT_THAT(checksum, Ne(0U));
+	struct stat saved;
+	ASSERT_THAT(stat(this->filename.c_str(), &saved), Eq(0));
+
+	EXPECT_THAT(snapshot.saveIfChanged(this->filename, checksum), Eq(true));
+	struct stat unchanged;
+	ASSERT_THAT(stat(this->filename.c_str(), &unchanged), Eq(0));
+	EXPECT_THAT(unchanged.st_ino, Eq(saved.st_ino));
+
+	unlink(this->filename.c_str());
+	EXPECT_THAT(snapshot.saveIfChanged(this->filename, checksum), Eq(true));
+	StateSnapshot loaded;
+	EXPECT_THAT(loaded.load(this->filename), Eq(true));
+}
+
+TEST_F(StateSnapshotTest, testLoadMissingFile) {
+	unlink(this->filename.c_str());
+	StateSnapshot snapshot;
+
+	EXPECT_THAT(snapshot.load(this->filename), Eq(false));
+	EXPECT_THAT(snapshot.getVMs().empty(), Eq(true));
+	EXPECT_THAT(snapshot.getTopology(), IsNull());
+}
+
+TEST_F(StateSnapshotTest, testLoadRejectsCorruptFile) {
+	StateSnapshot saved;
+	saved.capture(this->vmManager, this->topologyManager, this->daemonCollection);
+	saved.save(this->filename);
+	this->overwrite(40, 'X');
+
+	StateSnapshot loaded;
+	EXPECT_THAT(loaded.load(this->filename), Eq(false));
+	EXPECT_THAT(loaded.getVMs().empty(), Eq(true));
+	EXPECT_THAT(loaded.getDaemons().empty(), Eq(true));
+}
+
+TEST_F(StateSnapshotTest, testLoadRejectsTruncatedFile) {
+	StateSnapshot saved;
+	saved.capture(this->vmManager, this->topologyManager, this->daemonCollection);
+	saved.save(this->filename);
+	ASSERT_THAT(truncate(this->filename.c_str(), 50), Eq(0));
+
+	StateSnapshot loaded;
+	EXPECT_THAT(loaded.load(this->filename), Eq(false));
+}
+
+TEST_F(StateSnapshotTest, testLoadRejectsOtherVersion) {
+	StateSnapshot saved;
+	saved.capture(this->vmManager, this->topologyManager, this->daemonCollection);
+	saved.save(this->filename);
+	this->overwrite(8, static_cast<char>(StateSnapshot::VERSION + 1));
+
+	StateSnapshot loaded;
+	EXPECT_THAT(loaded.load(this->filename), Eq(false));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,171 @@
+#include "nebu-app-framework/topologyImage.h"
+#include "nebu-app-framework/topologyManager.h"
+#include "nebu/mocks/mockAppPhysRequest.h"
+#include "mocks/topologyFixtures.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::TopologyImage;
+using nebu::app::framework::TopologyManager;
+// Using declarations - mocks
+using nebu::app::framework::test::createTopology;
+using nebu::app::framework::test::createVM;
+using nebu::test::MockAppPhysRequest;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::IsNull;
+using testing::Ne;
+using testing::NotNull;
+using testing::StrEq;
+
+shared_ptr<PhysicalRoot> createTopology() {
+	return createTopology(vector<string> { "dcB", "dcA" }, 3, 4);
+}
+
+vector<shared_ptr<VirtualMachine>> createVMs() {
+	return vector<shared_ptr<VirtualMachine>> {
+		createVM("vm1", "worker-2", "dcA-rack1-host3"),
+		createVM("vm2", "worker-1", "dcB-rack0-host0"),
+		createVM("vm3", "orphan", "unknown-host")
+	};
+}
+
+TEST(TopologyImageTest, testBuildAndOpen) {
+	string data = TopologyImage::build(createTopology(), createVMs());
+	TopologyImage image;
+
+	ASSERT_THAT(image.open(data.data(), data.size()), Eq(true));
+	EXPECT_THAT(image.getRootID(), StrEq("root"));
+	EXPECT_THAT(image.getDataCenterCount(), Eq(2U));
+	EXPECT_THAT(image.getRackCount(), Eq(6U));
+	EXPECT_THAT(image.getHostCount(), Eq(24U));
+	EXPECT_THAT(image.getVMCount(), Eq(3U));
+}
+
+TEST(TopologyImageTest, testFindHost) {
+	string data = TopologyImage::build(createTopology(), createVMs());
+	TopologyImage image;
+	image.open(data.data(), data.size());
+
+	TopologyImage::Location location;
+	ASSERT_THAT(image.findHost("dcB-rack2-host1", location), Eq(true));
+	EXPECT_THAT(location.dataCenter, StrEq("dcB"));
+	EXPECT_THAT(location.rack, StrEq("dcB-rack2"));
+	EXPECT_THAT(location.host, StrEq("dcB-rack2-host1"));
+	EXPECT_THAT(image.findHost("dcC-rack0-host0", location), Eq(false));
+}
+
+TEST(TopologyImageTest, testFindVM) {
+	string data = TopologyImage::build(createTopology(), createVMs());
+	TopologyImage image;
+	image.open(data.data(), data.size());
+
+	TopologyImage::Location location;
+	ASSERT_THAT(image.findVM("worker-2", location), Eq(true));
+	EXPECT_THAT(location.dataCenter, StrEq("dcA"));
+	EXPECT_THAT(location.rack, StrEq("dcA-rack1"));
+	EXPECT_THAT(location.host, StrEq("dcA-rack1-host3"));
+	ASSERT_THAT(image.findVM("worker-1", location), Eq(true));
+	EXPECT_THAT(location.host, StrEq("dcB-rack0-host0"));
+	EXPECT_THAT(image.findVM("orphan", location), Eq(false));
+	EXPECT_THAT(image.findVM("missing", location), Eq(false));
+}
+
+TEST(TopologyImageTest, testToTopology) {
+	string data = TopologyImage::build(createTopology(), createVMs());
+	TopologyImage image;
+	image.open(data.data(), data.size());
+
+	shared_ptr<PhysicalRoot> root = image.toTopology();
+	ASSERT_THAT(root, NotNull());
+	EXPECT_THAT(root->getDataCenters().size(), Eq(2U));
+	shared_ptr<PhysicalRack> rack = root->getDataCenters().at("dcA")->getRacks().at("dcA-rack2");
+	EXPECT_THAT(rack->getHosts().size(), Eq(4U));
+	EXPECT_THAT(rack->getHosts().at("dcA-rack2-host0")->getParent(), Eq(rack.get()));
+	EXPECT_THAT(rack->getParent()->getParent(), Eq(root.get()));
+}
+
+TEST(TopologyImageTest, testOpenRejectsInvalidImages) {
+	string data = TopologyImage::build(createTopology(), createVMs());
+	TopologyImage image;
+
+	EXPECT_THAT(image.open(data.data(), 16), Eq(false));
+	EXPECT_THAT(image.open(data.data(), data.size() - 1), Eq(false));
+	string corrupt(data);
+	corrupt[0] = 'X';
+	EXPECT_THAT(image.open(corrupt.data(), corrupt.size()), Eq(false));
+	EXPECT_THAT(image.isOpen(), Eq(false));
+	EXPECT_THAT(image.toTopology(), IsNull());
+}
+
+TEST(TopologyImageTest, testTopologyManagerWriteAndLoadImage) {
+	char filename[] = "/tmp/nebu-topology-XXXXXX";
+	close(mkstemp(filename));
+	TopologyManager writer(make_shared<MockAppPhysRequest>());
+	writer.restoreTopology(createTopology());
+	ASSERT_THAT(writer.writeImage(filename, createVMs()), Eq(true));
+
+	TopologyImage image;
+	ASSERT_THAT(image.load(filename), Eq(true));
+	EXPECT_THAT(image.getVMCount(), Eq(3U));
+
+	TopologyManager reader(make_shared<MockAppPhysRequest>());
+	ASSERT_THAT(reader.loadImage(filename), Eq(true));
+	EXPECT_THAT(reader.getRackIDForHost("dcB-rack1-host2"), Eq("dcB-rack1"));
+	EXPECT_THAT(reader.getDataCenterIDForHost("dcB-rack1-host2"), Eq("dcB"));
+	unlink(filename);
+
+	EXPECT_THAT(reader.loadImage(filename), Eq(false));
+}
+
+TEST(TopologyImageTest, testTopologyManagerSkipsUnchangedImage) {
+	char filename[] = "/tmp/nebu-topology-XXXXXX";
+	close(mkstemp(filename));
+	TopologyManager writer(make_shared<MockAppPhysRequest>());
+	writer.restoreTopology(createTopology());
+	vector<shared_ptr<VirtualMachine>> vms = createVMs();
+	struct stat first, second;
+	ASSERT_THAT(writer.writeImage(filename, vms), Eq(true));
+	ASSERT_THAT(stat(filename, &first), Eq(0));
+
+	// An identical image is not written again, as the file is replaced by a new inode on every write
+	ASSERT_THAT(writer.writeImage(filename, vms), Eq(true));
+	ASSERT_THAT(stat(filename, &second), Eq(0));
+	EXPECT_THAT(second.st_ino, Eq(first.st_ino));
+
+	vms.pop_back();
+	ASSERT_THAT(writer.writeImage(filename, vms), Eq(true));
+	ASSERT_THAT(stat(filename, &second), Eq(0));
+	EXPECT_THAT(second.st_ino, Ne(first.st_ino));
+
+	unlink(filename);
+	ASSERT_THAT(writer.writeImage(filename, vms), Eq(true));
+	TopologyImage image;
+	ASSERT_THAT(image.load(filename), Eq(true));
+	EXPECT_THAT(image.getVMCount(), Eq(2U));
+	unlink(filename);
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
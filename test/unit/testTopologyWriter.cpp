@@ -0,0 +1,336 @@
+#include "nebu-app-framework/topologyImage.h"
+#include "nebu-app-framework/topologyWriter.h"
+
+#include "nebu/topology/physicalDataCenter.h"
+#include "nebu/topology/physicalHost.h"
+#include "nebu/topology/physicalRack.h"
+
+#include "log4cxx/basicconfigurator.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Using declarations - standard library
+using std::ifstream;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::stringstream;
+using std::vector;
+// Using declarations - nebu-common
+using nebu::common::PhysicalDataCenter;
+using nebu::common::PhysicalHost;
+using nebu::common::PhysicalRack;
+using nebu::common::PhysicalRoot;
+using nebu::common::VirtualMachine;
+// Using declarations - nebu-app-framework
+using nebu::app::framework::BinaryTopologyFormat;
+using nebu::app::framework::HadoopTableTopologyFormat;
+using nebu::app::framework::JsonTopologyFormat;
+using nebu::app::framework::TopologyFormat;
+using nebu::app::framework::TopologyImage;
+using nebu::app::framework::TopologyWriter;
+// Using declarations - gtest/gmock
+using testing::Eq;
+using testing::Ne;
+
+class CountingTopologyFormat : public TopologyFormat
+{
+public:
+	CountingTopologyFormat() : begins(0), vms(0), ends(0) { }
+	virtual ~CountingTopologyFormat() { }
+
+	virtual void begin(shared_ptr<PhysicalRoot>, string &) { this->begins++; }
+	virtual void addVM(const shared_ptr<VirtualMachine> &vm, const Location &location, string &output)
+	{
+		this->vms++;
+		output += vm->getUUID() + " " + location.host + "\n";
+	}
+	virtual void end(string &) { this->ends++; }
+
+	int begins;
+	int vms;
+	int ends;
+};
+
+// A subclass written against the original TopologyWriter interface
+class RenamingTopologyWriter : public TopologyWriter
+{
+public:
+	RenamingTopologyWriter(const string &suffix) : suffix(suffix), writes(0) { }
+	virtual ~RenamingTopologyWriter() { }
+
+	virtual void write(shared_ptr<PhysicalRoot> topology, vector<shared_ptr<VirtualMachine>> vms)
+	{
+		this->writes++;
+		this->filename += this->suffix;
+		TopologyWriter::write(topology, vms);
+	}
+
+	string suffix;
+	int writes;
+};
+
+class TopologyWriterTest : public testing::Test
+{
+protected:
+	TopologyWriterTest() : topology(), vms(), directory(), filename()
+	{
+		char name[] = "/tmp/nebu-writer-XXXXXX";
+		this->directory = mkdtemp(name);
+		this->filename = this->directory + "/topology";
+	}
+
+	virtual ~TopologyWriterTest()
+	{
+		unlink(this->filename.c_str());
+		rmdir(this->directory.c_str());
+	}
+
+	virtual void SetUp()
+	{
+		this->topology = make_shared<PhysicalRoot>("root");
+		shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>("dc");
+		this->topology->addDataCenter(dc); dc->setParent(this->topology.get());
+		shared_ptr<PhysicalRack> rack = make_shared<PhysicalRack>("rack");
+		dc->addRack(rack); rack->setParent(dc.get());
+		shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>("host");
+		rack->addHost(host); host->setParent(rack.get());
+
+		this->addVM("uuid1", "vm1", "host");
+		this->addVM("uuid2", "vm2", "unknown");
+	}
+
+	void addVM(const string &uuid, const string &hostname, const string &host)
+	{
+		shared_ptr<VirtualMachine> vm = make_shared<VirtualMachine>(uuid);
+		vm->setHostname(hostname);
+		vm->setPhysicalHostID(host);
+		this->vms.push_back(vm);
+	}
+
+	string readFile() const
+	{
+		return this->readFile(this->filename);
+	}
+
+	string readFile(const string &filename) const
+	{
+		ifstream input(filename.c_str());
+		stringstream contents;
+		contents << input.rdbuf();
+		return contents.str();
+	}
+
+	ino_t getInode() const
+	{
+		struct stat status;
+		return (stat(this->filename.c_str(), &status) == 0) ? status.st_ino : 0;
+	}
+
+	unsigned int countFiles() const
+	{
+		unsigned int count = 0;
+		DIR *dir = opendir(this->directory.c_str());
+		for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+			if (entry->d_name[0] != '.') {
+				count++;
+			}
+		}
+		closedir(dir);
+		return count;
+	}
+
+	shared_ptr<PhysicalRoot> topology;
+	vector<shared_ptr<VirtualMachine>> vms;
+	string directory;
+	string filename;
+};
+
+TEST_F(TopologyWriterTest, testWrite) {
+	TopologyWriter writer;
+	writer.setFilename(this->filename);
+	writer.write(this->topology, this->vms);
+
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\n"));
+	EXPECT_THAT(this->countFiles(), Eq(1U));
+}
+
+TEST_F(TopologyWriterTest, testUnchangedContentsAreNotRewritten) {
+	TopologyWriter writer;
+	writer.setFilename(this->filename);
+	writer.write(this->topology, this->vms);
+	ino_t inode = this->getInode();
+
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->getInode(), Eq(inode));
+
+	this->addVM("uuid3", "vm3", "host");
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->getInode(), Ne(inode));
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\nvm3\t/dc/rack/host\n"));
+	EXPECT_THAT(this->countFiles(), Eq(1U));
+}
+
+TEST_F(TopologyWriterTest, testRemovedFileIsRewritten) {
+	TopologyWriter writer;
+	writer.setFilename(this->filename);
+	writer.write(this->topology, this->vms);
+	unlink(this->filename.c_str());
+
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\n"));
+}
+
+TEST_F(TopologyWriterTest, testNewFilenameIsWritten) {
+	TopologyWriter writer;
+	writer.setFilename(this->filename + ".old");
+	writer.write(this->topology, this->vms);
+	unlink((this->filename + ".old").c_str());
+
+	writer.setFilename(this->filename);
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\n"));
+}
+
+TEST_F(TopologyWriterTest, testSubclassOverridesWriteAndFilename) {
+	RenamingTopologyWriter renaming(".1");
+	TopologyWriter &writer = renaming;
+	writer.setFilename(this->filename);
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(renaming.writes, Eq(1));
+	EXPECT_THAT(this->readFile(this->filename + ".1"), Eq("vm1\t/dc/rack/host\n"));
+	unlink((this->filename + ".1").c_str());
+
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->readFile(this->filename + ".1.1"), Eq("vm1\t/dc/rack/host\n"));
+	unlink((this->filename + ".1.1").c_str());
+}
+
+TEST_F(TopologyWriterTest, testFailedWriteIsRetried) {
+	TopologyWriter writer;
+	writer.setFilename(this->directory + "/missing/topology");
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->countFiles(), Eq(0U));
+
+	mkdir((this->directory + "/missing").c_str(), S_IRWXU);
+	writer.write(this->topology, this->vms);
+	string written = this->directory + "/missing/topology";
+	EXPECT_THAT(access(written.c_str(), F_OK), Eq(0));
+	unlink(written.c_str());
+	rmdir((this->directory + "/missing").c_str());
+}
+
+TEST_F(TopologyWriterTest, testHostIndexFollowsTopology) {
+	TopologyWriter writer;
+	writer.setFilename(this->filename);
+	writer.write(this->topology, this->vms);
+
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\n"));
+
+	// Hosts added to the same topology object are picked up
+	shared_ptr<PhysicalRack> rack = this->topology->getDataCenters().at("dc")->getRacks().at("rack");
+	shared_ptr<PhysicalHost> host = make_shared<PhysicalHost>("unknown");
+	rack->addHost(host); host->setParent(rack.get());
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\nvm2\t/dc/rack/unknown\n"));
+
+	shared_ptr<PhysicalRoot> moved = make_shared<PhysicalRoot>("root");
+	shared_ptr<PhysicalDataCenter> dc = make_shared<PhysicalDataCenter>("dc2");
+	moved->addDataCenter(dc); dc->setParent(moved.get());
+	rack = make_shared<PhysicalRack>("rack2");
+	dc->addRack(rack); rack->setParent(dc.get());
+	host = make_shared<PhysicalHost>("host");
+	rack->addHost(host); host->setParent(rack.get());
+	writer.write(moved, this->vms);
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc2/rack2/host\n"));
+}
+
+TEST_F(TopologyWriterTest, testEmptyTopology) {
+	TopologyWriter writer;
+	writer.setFilename(this->filename);
+	writer.write(shared_ptr<PhysicalRoot>(), this->vms);
+
+	EXPECT_THAT(this->readFile(), Eq(""));
+	EXPECT_THAT(this->countFiles(), Eq(1U));
+}
+
+TEST_F(TopologyWriterTest, testFormatsRenderedInOnePass) {
+	shared_ptr<CountingTopologyFormat> counting = make_shared<CountingTopologyFormat>();
+	TopologyWriter writer;
+	writer.setFilename(this->filename);
+	writer.addOutput(this->filename + ".count", counting);
+	writer.addOutput(this->filename + ".json", make_shared<JsonTopologyFormat>());
+	writer.addOutput(this->filename + ".table", make_shared<HadoopTableTopologyFormat>());
+	writer.addOutput(this->filename + ".bin", make_shared<BinaryTopologyFormat>());
+	writer.addOutput("", make_shared<CountingTopologyFormat>());
+	this->addVM("uuid3", "vm3", "host");
+	writer.write(this->topology, this->vms);
+
+	EXPECT_THAT(counting->begins, Eq(1));
+	EXPECT_THAT(counting->vms, Eq(2));
+	EXPECT_THAT(counting->ends, Eq(1));
+	EXPECT_THAT(this->readFile(), Eq("vm1\t/dc/rack/host\nvm3\t/dc/rack/host\n"));
+	EXPECT_THAT(this->readFile(this->filename + ".count"), Eq("uuid1 host\nuuid3 host\n"));
+	EXPECT_THAT(this->readFile(this->filename + ".json"), Eq("{\"vms\":[\n"
+			"{\"hostname\":\"vm1\",\"uuid\":\"uuid1\",\"dataCenter\":\"dc\",\"rack\":\"rack\",\"host\":\"host\"},\n"
+			"{\"hostname\":\"vm3\",\"uuid\":\"uuid3\",\"dataCenter\":\"dc\",\"rack\":\"rack\",\"host\":\"host\"}\n"
+			"]}\n"));
+	EXPECT_THAT(this->readFile(this->filename + ".table"), Eq("vm1 /dc/rack/host\nvm3 /dc/rack/host\n"));
+
+	TopologyImage image;
+	ASSERT_THAT(image.load(this->filename + ".bin"), Eq(true));
+	TopologyImage::Location location;
+	EXPECT_THAT(image.getVMCount(), Eq(2U));
+	ASSERT_THAT(image.findVM("vm3", location), Eq(true));
+	EXPECT_THAT(string(location.rack), Eq("rack"));
+	image.close();
+
+	EXPECT_THAT(this->countFiles(), Eq(5U));
+	unlink((this->filename + ".count").c_str());
+	unlink((this->filename + ".json").c_str());
+	unlink((this->filename + ".table").c_str());
+	unlink((this->filename + ".bin").c_str());
+}
+
+TEST_F(TopologyWriterTest, testJsonEscaping) {
+	TopologyWriter writer;
+	writer.addOutput(this->filename, make_shared<JsonTopologyFormat>());
+	this->vms.clear();
+	this->addVM("uu\"id", "vm\\1\n", "host");
+	writer.write(this->topology, this->vms);
+
+	EXPECT_THAT(this->readFile(), Eq("{\"vms\":[\n"
+			"{\"hostname\":\"vm\\\\1\\u000a\",\"uuid\":\"uu\\\"id\",\"dataCenter\":\"dc\",\"rack\":\"rack\",\"host\":\"host\"}\n"
+			"]}\n"));
+
+	this->vms.clear();
+	writer.write(this->topology, this->vms);
+	EXPECT_THAT(this->readFile(), Eq("{\"vms\":[\n]}\n"));
+}
+
+TEST_F(TopologyWriterTest, testHadoopTableWithAddresses) {
+	shared_ptr<HadoopTableTopologyFormat> format = make_shared<HadoopTableTopologyFormat>();
+	format->setAddressResolver([](const VirtualMachine &vm) {
+		return vector<string> { "10.0.0." + vm.getUUID().substr(4) };
+	});
+	TopologyWriter writer;
+	writer.addOutput(this->filename, format);
+	writer.write(this->topology, this->vms);
+
+	EXPECT_THAT(this->readFile(), Eq("vm1 /dc/rack/host\n10.0.0.1 /dc/rack/host\n"));
+}
+
+int main(int argc, char **argv) {
+	log4cxx::BasicConfigurator::configure();
+	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());
+	testing::InitGoogleMock(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -1,4 +1,5 @@
 
+#include "nebu-app-framework/circuitBreakingAppVirtRequest.h"
 #include "nebu-app-framework/vmManager.h"
 #include "nebu/mocks/mockAppVirtRequest.h"
 #include "nebu/util/exceptions.h"
@@ -15,6 +16,9 @@ using std::shared_ptr;
 using std::string;
 using std::vector;
 // Using declarations - nebu-app-framework
+using nebu::app::framework::CircuitBreaker;
+using nebu::app::framework::CircuitBreakingAppVirtRequest;
+using nebu::app::framework::CircuitState;
 using nebu::app::framework::VMEvent;
 using nebu::app::framework::VMManager;
 // Using declarations - nebu-common
@@ -27,7 +31,9 @@ using nebu::test::MockAppVirtRequest;
 // Using declarations - gtest/gmock
 using testing::AtLeast;
 using testing::Eq;
+using testing::Invoke;
 using testing::IsNull;
+using testing::Mock;
 using testing::Pointee;
 using testing::Return;
 using testing::Throw;
@@ -521,6 +527,313 @@ TEST(VMManagerTest, testNotifyMultipleRemoveVM) {
 	vmManager.refreshVMList();
 }
 
+/** Expects a refresh in which only the given VMs are requested, all unchanged since rigSucces. */
+void rigRefreshOnly(shared_ptr<MockAppVirtRequest> mockRequest, const vector<string> &refreshed) {
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).Times(0);
+	for (vector<string>::const_iterator it = refreshed.begin(); it != refreshed.end(); it++) {
+		const VirtualMachine &vm = (*it == "vmA") ? vmAOff : ((*it == "vmB") ? vmBOn : vmCOff);
+		EXPECT_CALL(*mockRequest, getVirtualMachine(*it)).WillOnce(Return(vm));
+	}
+}
+
+TEST(VMManagerTest, testTieredRefreshSweepsStableVMs) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	VMManager vmManager(mockRequest);
+	vmManager.setRefreshPolicy(2, 1);
+
+	rigSucces(mockRequest);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// No VM is stable yet
+	rigRefreshOnly(mockRequest, vector<string> { "vmA", "vmB", "vmC" });
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// The OFF VMs A and C are stable, the ON VM B is not
+	rigRefreshOnly(mockRequest, vector<string> { "vmB", "vmA" });
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// All VMs are stable and swept one at a time
+	rigRefreshOnly(mockRequest, vector<string> { "vmB" });
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	rigRefreshOnly(mockRequest, vector<string> { "vmC" });
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	rigRefreshOnly(mockRequest, vector<string> { "vmA" });
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+}
+
+TEST(VMManagerTest, testTieredRefreshChangedVMIsRefreshedEveryTime) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	VMManager vmManager(mockRequest);
+	vmManager.setRefreshPolicy(2, 1);
+
+	rigSucces(mockRequest);
+	vmManager.refreshVMList();
+	rigRefreshOnly(mockRequest, vector<string> { "vmA", "vmB", "vmC" });
+	vmManager.refreshVMList();
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// A is swept and found powered on, so it is refreshed every time until it is stable again
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).Times(0);
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(vmAOn));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	vmManager.refreshVMList();
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	VMManager::RefreshState state = vmManager.getRefreshState("vmA");
+	EXPECT_THAT(state.status, Eq(VMStatus::ON));
+	EXPECT_THAT(state.unchangedPolls, Eq(0U));
+	EXPECT_THAT(vmManager.getRefreshState("vmB").unchangedPolls, Eq(2U));
+
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).Times(0);
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(vmAOn));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	vmManager.refreshVMList();
+}
+
+TEST(VMManagerTest, testTieredRefreshRemovesStableVMsImmediately) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	VMManager vmManager(mockRequest);
+	vmManager.setRefreshPolicy(1, 1);
+
+	rigSucces(mockRequest);
+	vmManager.refreshVMList();
+	rigRefreshOnly(mockRequest, vector<string> { "vmA", "vmB", "vmC" });
+	vmManager.refreshVMList();
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vector<string> { "vmB" }));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	vmManager.refreshVMList();
+
+	EXPECT_THAT(vmManager.getVMs().size(), Eq(1));
+	EXPECT_THROW(vmManager.getRefreshState("vmA"), std::out_of_range);
+}
+
+void rigFailureRound(shared_ptr<MockAppVirtRequest> mockRequest, bool requestB, bool failB) {
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(vmAOff));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmC")).WillOnce(Return(vmCOff));
+	if (!requestB) {
+		EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).Times(0);
+	} else if (failB) {
+		EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Throw(NebuServerException("down")));
+	} else {
+		EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	}
+}
+
+TEST(VMManagerTest, testFailedVMBacksOffAndIsQuarantined) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	VMManager vmManager(mockRequest);
+	vmManager.setFailurePolicy(2, 2);
+
+	rigFailureRound(mockRequest, true, true);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(false));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+	EXPECT_THAT(vmManager.getFailureState("vmB").consecutiveFailures, Eq(1U));
+	EXPECT_THAT(vmManager.getFailureState("vmB").lastError, Eq("down"));
+
+	// B skips one refresh after its first failure
+	rigFailureRound(mockRequest, false, false);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+	EXPECT_THAT(vmManager.getLastRefreshStatistics().skipped, Eq(1U));
+
+	// The second failure quarantines B
+	rigFailureRound(mockRequest, true, true);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(false));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+	EXPECT_THAT(vmManager.getQuarantinedVMs(), Eq(vector<string> { "vmB" }));
+
+	for (int i = 0; i < 2; i++) {
+		rigFailureRound(mockRequest, false, false);
+		EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+		Mock::VerifyAndClearExpectations(mockRequest.get());
+	}
+
+	// Failures of a quarantined VM do not fail the refresh
+	rigFailureRound(mockRequest, true, true);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+	EXPECT_THAT(vmManager.getLastRefreshStatistics().quarantined, Eq(1U));
+
+	for (int i = 0; i < 2; i++) {
+		rigFailureRound(mockRequest, false, false);
+		vmManager.refreshVMList();
+		Mock::VerifyAndClearExpectations(mockRequest.get());
+	}
+
+	// B recovers and is added
+	rigFailureRound(mockRequest, true, false);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	EXPECT_THAT(vmManager.getVMs().size(), Eq(3));
+	EXPECT_THAT(vmManager.getQuarantinedVMs().empty(), Eq(true));
+	EXPECT_THAT(vmManager.getFailureState("vmB").consecutiveFailures, Eq(0U));
+}
+
+TEST(VMManagerTest, testBackingOffVMsDoNotUseSweepBudget) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	VMManager vmManager(mockRequest);
+	vmManager.setRefreshPolicy(1, 2);
+	vmManager.setFailurePolicy(3, 4);
+
+	rigSucces(mockRequest);
+	vmManager.refreshVMList();
+	rigRefreshOnly(mockRequest, vector<string> { "vmA", "vmB", "vmC" });
+	vmManager.refreshVMList();
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// All VMs are stable; A fails when it is swept and backs off
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).Times(0);
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Throw(NebuServerException("down")));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	vmManager.refreshVMList();
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// The sweep would wrap around to A, but its slot goes to another stable VM
+	rigRefreshOnly(mockRequest, vector<string> { "vmB", "vmC" });
+	vmManager.refreshVMList();
+	EXPECT_THAT(vmManager.getLastRefreshStatistics().requested, Eq(2U));
+	EXPECT_THAT(vmManager.getLastRefreshStatistics().skipped, Eq(1U));
+}
+
+TEST(VMManagerTest, testOpenCircuitEndsRefreshWithoutFailingVMs) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	shared_ptr<CircuitBreaker> circuitBreaker = make_shared<CircuitBreaker>(1, 60000, 60000);
+	VMManager vmManager(make_shared<CircuitBreakingAppVirtRequest>(mockRequest, circuitBreaker));
+	vmManager.setFailurePolicy(1, 4);
+
+	rigSucces(mockRequest);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	// The server goes down while A is requested: a topology request sharing the circuit fails and opens it, so
+	// B and C are rejected without being requested
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine(_)).Times(0);
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Invoke([circuitBreaker](const string &) -> VirtualMachine {
+		circuitBreaker->allowRequest();
+		circuitBreaker->recordFailure();
+		throw NebuServerException("down");
+	}));
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(false));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+	EXPECT_THAT(circuitBreaker->getState(), Eq(CircuitState::OPEN));
+
+	VMManager::RefreshStatistics statistics = vmManager.getLastRefreshStatistics();
+	EXPECT_THAT(statistics.circuitOpen, Eq(true));
+	EXPECT_THAT(statistics.requested, Eq(1U));
+	EXPECT_THAT(statistics.failed, Eq(1U));
+	EXPECT_THAT(vmManager.getFailureState("vmB").consecutiveFailures, Eq(0U));
+	EXPECT_THAT(vmManager.getFailureState("vmC").consecutiveFailures, Eq(0U));
+	EXPECT_THAT(vmManager.getQuarantinedVMs(), Eq(vector<string> { "vmA" }));
+
+	// While the circuit is open, not even the list of VMs is requested
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).Times(0);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(false));
+	EXPECT_THAT(vmManager.getLastRefreshStatistics().circuitOpen, Eq(true));
+	EXPECT_THAT(vmManager.getQuarantinedVMs(), Eq(vector<string> { "vmA" }));
+	EXPECT_THAT(vmManager.getVMs().size(), Eq(3));
+}
+
+TEST(VMManagerTest, testQuarantinedVMDoesNotOpenCircuit) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	shared_ptr<CircuitBreaker> circuitBreaker = make_shared<CircuitBreaker>(1, 60000, 60000);
+	VMManager vmManager(make_shared<CircuitBreakingAppVirtRequest>(mockRequest, circuitBreaker));
+	vmManager.setFailurePolicy(1, 1);
+
+	// B is a bad record failing whenever it is requested, while the server is healthy
+	for (int i = 0; i < 4; i++) {
+		rigFailureRound(mockRequest, i % 2 == 0, true);
+		vmManager.refreshVMList();
+		Mock::VerifyAndClearExpectations(mockRequest.get());
+		EXPECT_THAT(circuitBreaker->getState(), Eq(CircuitState::CLOSED));
+		EXPECT_THAT(vmManager.getLastRefreshStatistics().circuitOpen, Eq(false));
+	}
+	EXPECT_THAT(vmManager.getQuarantinedVMs(), Eq(vector<string> { "vmB" }));
+	EXPECT_THAT(vmManager.getVMs().size(), Eq(2));
+	EXPECT_THAT(circuitBreaker->getStatistics().failures, Eq(0U));
+}
+
+TEST(VMManagerTest, testRefreshStatistics) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	VMManager vmManager(mockRequest);
+
+	rigFailVMB(mockRequest);
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(false));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	VMManager::RefreshStatistics statistics = vmManager.getLastRefreshStatistics();
+	EXPECT_THAT(statistics.listed, Eq(true));
+	EXPECT_THAT(statistics.requested, Eq(3U));
+	EXPECT_THAT(statistics.succeeded, Eq(2U));
+	EXPECT_THAT(statistics.failed, Eq(1U));
+	EXPECT_THAT(statistics.added, Eq(2U));
+	EXPECT_THAT(statistics.skipped, Eq(0U));
+
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vector<string> { "vmA", "vmB" }));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(vmAOn));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+	Mock::VerifyAndClearExpectations(mockRequest.get());
+
+	statistics = vmManager.getLastRefreshStatistics();
+	EXPECT_THAT(statistics.succeeded, Eq(2U));
+	EXPECT_THAT(statistics.added, Eq(1U));
+	EXPECT_THAT(statistics.changed, Eq(1U));
+	EXPECT_THAT(statistics.removed, Eq(1U));
+
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Throw(NebuServerException("")));
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(false));
+	EXPECT_THAT(vmManager.getLastRefreshStatistics().listed, Eq(false));
+}
+
+TEST(VMManagerTest, testRestoredVMsOnlyNotifyDifferences) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	shared_ptr<MockVMEventHandler> mockEventHandler = make_shared<MockVMEventHandler>();
+	VMManager vmManager(mockRequest);
+	vmManager.registerVMEventHandler(mockEventHandler);
+
+	EXPECT_CALL(*mockEventHandler, newVMAdded(_)).Times(0);
+	vmManager.restoreVM(make_shared<VirtualMachine>(vmAOff), 0);
+	vmManager.restoreVM(make_shared<VirtualMachine>(vmBOn), 0);
+	vmManager.restoreVM(make_shared<VirtualMachine>("vmD"), 0);
+	EXPECT_THAT(vmManager.getVMs().size(), Eq(3));
+	Mock::VerifyAndClearExpectations(mockEventHandler.get());
+
+	EXPECT_CALL(*mockEventHandler, newVMAdded(Pointee(Eq(vmCOff))));
+	EXPECT_CALL(*mockEventHandler, existingVMChanged(Pointee(Eq(vmAOn)), VMEvent::POWERED_ON));
+	EXPECT_CALL(*mockEventHandler, oldVMRemoved(Eq(VirtualMachine("vmD"))));
+	EXPECT_CALL(*mockRequest, getVirtualMachineIDs()).WillOnce(Return(vmList));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmA")).WillOnce(Return(vmAOn));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmB")).WillOnce(Return(vmBOn));
+	EXPECT_CALL(*mockRequest, getVirtualMachine("vmC")).WillOnce(Return(vmCOff));
+	EXPECT_THAT(vmManager.refreshVMList(), Eq(true));
+}
+
+TEST(VMManagerTest, testNotifyRestoredVMAdded) {
+	shared_ptr<MockAppVirtRequest> mockRequest = make_shared<MockAppVirtRequest>();
+	shared_ptr<MockVMEventHandler> mockEventHandler = make_shared<MockVMEventHandler>();
+	VMManager vmManager(mockRequest);
+	vmManager.registerVMEventHandler(mockEventHandler);
+	vmManager.restoreVM(make_shared<VirtualMachine>(vmAOff), 0);
+
+	EXPECT_CALL(*mockEventHandler, newVMAdded(Pointee(Eq(vmAOff))));
+	EXPECT_THAT(vmManager.notifyVMAdded("vmA"), Eq(true));
+	EXPECT_THAT(vmManager.notifyVMAdded("vmB"), Eq(false));
+}
+
 int main(int argc, char **argv) {
 	log4cxx::BasicConfigurator::configure();
 	log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::getOff());\